@@ -91,9 +91,12 @@ static unsigned int _jpg_read(JDEC *decoder, uint8_t *buf, unsigned int len)
     return len;
 }
 
+// tjpgd keeps its tables in LONG, 3100 bytes on the chip
+#define JPG_WORK_SIZE (3100 * sizeof(LONG) / 4)
+
 esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
 {
-    static uint8_t work[3100];
+    static uint8_t work[JPG_WORK_SIZE];
     JDEC decoder;
     esp_jpg_decoder_t jpeg;
 
@@ -104,7 +107,7 @@ esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jp
     jpeg.scale = scale;
     jpeg.index = 0;
 
-    JRESULT jres = jd_prepare(&decoder, _jpg_read, work, 3100, &jpeg);
+    JRESULT jres = jd_prepare(&decoder, _jpg_read, work, JPG_WORK_SIZE, &jpeg);
     if(jres != JDR_OK){
         ESP_LOGE(TAG, "JPG Header Parse Failed! %s", jd_errors[jres]);
         return ESP_FAIL;
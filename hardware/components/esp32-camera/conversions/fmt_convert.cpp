@@ -0,0 +1,370 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Pixel format conversions between every pixformat_t pair, a row at a time.
+ *
+ */
+#include <stddef.h>
+#include <string.h>
+#include "img_converters.h"
+#include "fmt_row.h"
+#include "yuv.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "fmt_convert";
+#endif
+
+namespace {
+
+// Every layout decodes to one of three pixel domains. Conversions inside a
+// domain are lossless, conversions across domains go through px_cast below.
+struct rgb_px {
+    uint8_t r, g, b;
+};
+
+struct yuv_px {
+    uint8_t y, u, v;
+};
+
+struct gray_px {
+    uint8_t y;
+};
+
+// RGB -> YUV is the BT.601 studio-swing inverse of the yuv2rgb() table
+static inline void px_cast(const rgb_px &i, yuv_px &o)
+{
+    o.y = (uint8_t)(((66 * i.r + 129 * i.g + 25 * i.b + 128) >> 8) + 16);
+    o.u = (uint8_t)(((-38 * i.r - 74 * i.g + 112 * i.b + 128) >> 8) + 128);
+    o.v = (uint8_t)(((112 * i.r - 94 * i.g - 18 * i.b + 128) >> 8) + 128);
+}
+
+static inline void px_cast(const rgb_px &i, gray_px &o)
+{
+    o.y = (uint8_t)((77 * i.r + 150 * i.g + 29 * i.b + 128) >> 8);
+}
+
+static inline void px_cast(const yuv_px &i, rgb_px &o)
+{
+    yuv2rgb(i.y, i.u, i.v, &o.r, &o.g, &o.b);
+}
+
+// the sensor's GRAYSCALE output is its Y channel, keep it that way
+static inline void px_cast(const yuv_px &i, gray_px &o)
+{
+    o.y = i.y;
+}
+
+static inline void px_cast(const gray_px &i, rgb_px &o)
+{
+    o.r = o.g = o.b = i.y;
+}
+
+static inline void px_cast(const gray_px &i, yuv_px &o)
+{
+    o.y = i.y;
+    o.u = o.v = 128;
+}
+
+template<typename T>
+static inline void px_cast(const T &i, T &o)
+{
+    o = i;
+}
+
+// Layouts with one pixel per bpp bytes get their pair/tail accessors here.
+template<typename F, typename P>
+struct packed_fmt {
+    typedef P px_t;
+    static inline void load2(const uint8_t *s, P *p)
+    {
+        F::load(s, p[0]);
+        F::load(s + F::bpp, p[1]);
+    }
+    static inline void store2(uint8_t *d, const P *p)
+    {
+        F::store(d, p[0]);
+        F::store(d + F::bpp, p[1]);
+    }
+    static inline void load1(const uint8_t *s, P &p)
+    {
+        F::load(s, p);
+    }
+    static inline void store1(uint8_t *d, const P &p)
+    {
+        F::store(d, p);
+    }
+};
+
+template<int F> struct row_fmt;
+
+template<> struct row_fmt<FMT_ROW_RGB565> : packed_fmt<row_fmt<FMT_ROW_RGB565>, rgb_px> {
+    enum { bpp = 2 };
+    static inline void load(const uint8_t *s, rgb_px &p)
+    {
+        p.r = s[0] & 0xF8;
+        p.g = (s[0] & 0x07) << 5 | (s[1] & 0xE0) >> 3;
+        p.b = (s[1] & 0x1F) << 3;
+    }
+    static inline void store(uint8_t *d, const rgb_px &p)
+    {
+        d[0] = (p.r & 0xF8) | (p.g >> 5);
+        d[1] = ((p.g & 0x1C) << 3) | (p.b >> 3);
+    }
+};
+
+template<> struct row_fmt<FMT_ROW_RGB565_LE> : packed_fmt<row_fmt<FMT_ROW_RGB565_LE>, rgb_px> {
+    enum { bpp = 2 };
+    static inline void load(const uint8_t *s, rgb_px &p)
+    {
+        const uint8_t be[2] = {s[1], s[0]};
+        row_fmt<FMT_ROW_RGB565>::load(be, p);
+    }
+    static inline void store(uint8_t *d, const rgb_px &p)
+    {
+        d[1] = (p.r & 0xF8) | (p.g >> 5);
+        d[0] = ((p.g & 0x1C) << 3) | (p.b >> 3);
+    }
+};
+
+template<> struct row_fmt<FMT_ROW_RGB555> : packed_fmt<row_fmt<FMT_ROW_RGB555>, rgb_px> {
+    enum { bpp = 2 };
+    static inline void load(const uint8_t *s, rgb_px &p)
+    {
+        p.r = (s[0] & 0x7C) << 1;
+        p.g = (s[0] & 0x03) << 6 | (s[1] & 0xE0) >> 2;
+        p.b = (s[1] & 0x1F) << 3;
+    }
+    static inline void store(uint8_t *d, const rgb_px &p)
+    {
+        d[0] = ((p.r & 0xF8) >> 1) | (p.g >> 6);
+        d[1] = ((p.g & 0x38) << 2) | (p.b >> 3);
+    }
+};
+
+template<> struct row_fmt<FMT_ROW_RGB444> : packed_fmt<row_fmt<FMT_ROW_RGB444>, rgb_px> {
+    enum { bpp = 2 };
+    static inline void load(const uint8_t *s, rgb_px &p)
+    {
+        p.r = (s[0] & 0x0F) << 4;
+        p.g = s[1] & 0xF0;
+        p.b = (s[1] & 0x0F) << 4;
+    }
+    static inline void store(uint8_t *d, const rgb_px &p)
+    {
+        d[0] = p.r >> 4;
+        d[1] = (p.g & 0xF0) | (p.b >> 4);
+    }
+};
+
+template<> struct row_fmt<FMT_ROW_BGR888> : packed_fmt<row_fmt<FMT_ROW_BGR888>, rgb_px> {
+    enum { bpp = 3 };
+    static inline void load(const uint8_t *s, rgb_px &p)
+    {
+        p.b = s[0];
+        p.g = s[1];
+        p.r = s[2];
+    }
+    static inline void store(uint8_t *d, const rgb_px &p)
+    {
+        d[0] = p.b;
+        d[1] = p.g;
+        d[2] = p.r;
+    }
+};
+
+template<> struct row_fmt<FMT_ROW_RGB888> : packed_fmt<row_fmt<FMT_ROW_RGB888>, rgb_px> {
+    enum { bpp = 3 };
+    static inline void load(const uint8_t *s, rgb_px &p)
+    {
+        p.r = s[0];
+        p.g = s[1];
+        p.b = s[2];
+    }
+    static inline void store(uint8_t *d, const rgb_px &p)
+    {
+        d[0] = p.r;
+        d[1] = p.g;
+        d[2] = p.b;
+    }
+};
+
+template<> struct row_fmt<FMT_ROW_GRAYSCALE> : packed_fmt<row_fmt<FMT_ROW_GRAYSCALE>, gray_px> {
+    enum { bpp = 1 };
+    static inline void load(const uint8_t *s, gray_px &p)
+    {
+        p.y = s[0];
+    }
+    static inline void store(uint8_t *d, const gray_px &p)
+    {
+        d[0] = p.y;
+    }
+};
+
+// YUYV shares one U/V sample between two pixels
+template<> struct row_fmt<FMT_ROW_YUV422> {
+    typedef yuv_px px_t;
+    enum { bpp = 2 };
+    static inline void load2(const uint8_t *s, yuv_px *p)
+    {
+        p[0].y = s[0];
+        p[1].y = s[2];
+        p[0].u = p[1].u = s[1];
+        p[0].v = p[1].v = s[3];
+    }
+    static inline void store2(uint8_t *d, const yuv_px *p)
+    {
+        d[0] = p[0].y;
+        d[1] = (p[0].u + p[1].u + 1) >> 1;
+        d[2] = p[1].y;
+        d[3] = (p[0].v + p[1].v + 1) >> 1;
+    }
+    // odd widths: the tail pixel borrows V from the (even width) source line
+    static inline void load1(const uint8_t *s, yuv_px &p)
+    {
+        p.y = s[0];
+        p.u = s[1];
+        p.v = s[3];
+    }
+    static inline void store1(uint8_t *d, const yuv_px &p)
+    {
+        d[0] = p.y;
+        d[1] = p.u;
+    }
+};
+
+template<int S, int D>
+struct row_conv {
+    static void run(const uint8_t *src, uint8_t *dst, size_t width)
+    {
+        typedef row_fmt<S> in;
+        typedef row_fmt<D> out;
+        typename in::px_t ip[2];
+        typename out::px_t op[2];
+        for (size_t i = width / 2; i; i--) {
+            in::load2(src, ip);
+            px_cast(ip[0], op[0]);
+            px_cast(ip[1], op[1]);
+            out::store2(dst, op);
+            src += 2 * in::bpp;
+            dst += 2 * out::bpp;
+        }
+        if (width & 1) {
+            in::load1(src, ip[0]);
+            px_cast(ip[0], op[0]);
+            out::store1(dst, op[0]);
+        }
+    }
+};
+
+template<int F>
+struct row_conv<F, F> {
+    static void run(const uint8_t *src, uint8_t *dst, size_t width)
+    {
+        memcpy(dst, src, width * row_fmt<F>::bpp);
+    }
+};
+
+#define ROW(s, d) row_conv<s, d>::run
+#define ROW_TABLE_LINE(s) { \
+    ROW(s, FMT_ROW_RGB565), ROW(s, FMT_ROW_RGB555), ROW(s, FMT_ROW_RGB444), ROW(s, FMT_ROW_YUV422), \
+    ROW(s, FMT_ROW_GRAYSCALE), ROW(s, FMT_ROW_BGR888), ROW(s, FMT_ROW_RGB888), ROW(s, FMT_ROW_RGB565_LE) }
+
+static const fmt_row_cb row_table[FMT_ROW_MAX][FMT_ROW_MAX] = {
+    ROW_TABLE_LINE(FMT_ROW_RGB565),
+    ROW_TABLE_LINE(FMT_ROW_RGB555),
+    ROW_TABLE_LINE(FMT_ROW_RGB444),
+    ROW_TABLE_LINE(FMT_ROW_YUV422),
+    ROW_TABLE_LINE(FMT_ROW_GRAYSCALE),
+    ROW_TABLE_LINE(FMT_ROW_BGR888),
+    ROW_TABLE_LINE(FMT_ROW_RGB888),
+    ROW_TABLE_LINE(FMT_ROW_RGB565_LE),
+};
+
+static const uint8_t row_bpp[FMT_ROW_MAX] = {2, 2, 2, 2, 1, 3, 3, 2};
+
+} // namespace
+
+fmt_row_t fmt_row_from_pixformat(pixformat_t format)
+{
+    switch (format) {
+    case PIXFORMAT_RGB565: return FMT_ROW_RGB565;
+    case PIXFORMAT_RGB555: return FMT_ROW_RGB555;
+    case PIXFORMAT_RGB444: return FMT_ROW_RGB444;
+    case PIXFORMAT_YUV422: return FMT_ROW_YUV422;
+    case PIXFORMAT_GRAYSCALE: return FMT_ROW_GRAYSCALE;
+    case PIXFORMAT_RGB888: return FMT_ROW_BGR888;
+    default:
+        break;
+    }
+    return FMT_ROW_MAX;
+}
+
+size_t fmt_row_bpp(fmt_row_t format)
+{
+    if (format >= FMT_ROW_MAX) {
+        return 0;
+    }
+    return row_bpp[format];
+}
+
+fmt_row_cb fmt_row_get(fmt_row_t src, fmt_row_t dst)
+{
+    if (src >= FMT_ROW_MAX || dst >= FMT_ROW_MAX) {
+        return NULL;
+    }
+    return row_table[src][dst];
+}
+
+size_t fmt_bytes_per_pixel(pixformat_t format)
+{
+    return fmt_row_bpp(fmt_row_from_pixformat(format));
+}
+
+bool fmt_convert(const uint8_t *src, pixformat_t src_format, uint8_t *dst, pixformat_t dst_format, uint16_t width, uint16_t height, const fmt_roi_t *roi)
+{
+    fmt_row_t s = fmt_row_from_pixformat(src_format);
+    fmt_row_t d = fmt_row_from_pixformat(dst_format);
+    fmt_row_cb convert_row = fmt_row_get(s, d);
+    if (!convert_row) {
+        ESP_LOGE(TAG, "Conversion %d -> %d is not supported", src_format, dst_format);
+        return false;
+    }
+
+    size_t x = 0, y = 0, w = width, h = height;
+    size_t src_stride = width * row_bpp[s];
+    size_t dst_stride = 0;
+    if (roi) {
+        x = roi->x;
+        y = roi->y;
+        w = roi->width;
+        h = roi->height;
+        if (roi->src_stride) {
+            src_stride = roi->src_stride;
+        }
+        dst_stride = roi->dst_stride;
+    }
+    if (!dst_stride) {
+        dst_stride = w * row_bpp[d];
+    }
+    if ((x + w) > width || (y + h) > height) {
+        ESP_LOGE(TAG, "ROI %ux%u+%u+%u is outside of %ux%u", (unsigned) w, (unsigned) h, (unsigned) x, (unsigned) y, width, height);
+        return false;
+    }
+    if (s == FMT_ROW_YUV422 && (x & 1)) {
+        ESP_LOGE(TAG, "YUV422 ROI must start on an even pixel");
+        return false;
+    }
+
+    src += y * src_stride + x * row_bpp[s];
+    for (size_t i = 0; i < h; i++) {
+        convert_row(src, dst, w);
+        src += src_stride;
+        dst += dst_stride;
+    }
+    return true;
+}
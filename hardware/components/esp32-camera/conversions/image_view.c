@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Stride-aware views over frame buffers, without copies.
+ *
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "img_converters.h"
+#include "fmt_row.h"
+
+#include "esp_system.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "image_view";
+#endif
+
+void fmt_view_init(image_view_t *view, uint8_t *buf, uint16_t width, uint16_t height, pixformat_t format)
+{
+    view->buf = buf;
+    view->width = width;
+    view->height = height;
+    view->stride = width * fmt_bytes_per_pixel(format);
+    view->step = 1;
+    view->format = format;
+}
+
+const uint8_t *fmt_view_line(const image_view_t *view, uint16_t y, uint8_t *line)
+{
+    const uint8_t *src = view->buf + y * view->stride;
+    if (view->step == 1) {
+        return src;
+    }
+
+    size_t step = view->step;
+    uint8_t *o = line;
+    if (view->format == PIXFORMAT_YUV422) {
+        // take the Y of every picked pixel and the chroma of the pair holding the first one
+        for (size_t x = 0; x < view->width; x += 2) {
+            size_t p0 = x * step, p1 = (x + 1) * step;
+            const uint8_t *pair = src + (p0 & ~1) * 2;
+            *o++ = src[p0 * 2];
+            *o++ = pair[1];
+            if (x + 1 < view->width) {
+                *o++ = src[p1 * 2];
+                *o++ = pair[3];
+            }
+        }
+        return line;
+    }
+
+    size_t bpp = fmt_bytes_per_pixel(view->format);
+    size_t inc = step * bpp;
+    switch (bpp) {
+    case 1:
+        for (size_t x = 0; x < view->width; x++, src += inc) {
+            *o++ = src[0];
+        }
+        break;
+    case 2:
+        for (size_t x = 0; x < view->width; x++, src += inc) {
+            *o++ = src[0];
+            *o++ = src[1];
+        }
+        break;
+    default:
+        for (size_t x = 0; x < view->width; x++, src += inc) {
+            *o++ = src[0];
+            *o++ = src[1];
+            *o++ = src[2];
+        }
+        break;
+    }
+    return line;
+}
+
+bool fb_view(camera_fb_t * fb, image_view_t * view)
+{
+    if (!fmt_bytes_per_pixel(fb->format)) {
+        ESP_LOGE(TAG, "Format %d has no pixels to view", fb->format);
+        return false;
+    }
+    fmt_view_init(view, fb->buf, fb->width, fb->height, fb->format);
+    if (view->stride * view->height > fb->len) {
+        ESP_LOGE(TAG, "Frame is shorter than %ux%u", fb->width, fb->height);
+        return false;
+    }
+    return true;
+}
+
+bool view_crop(const image_view_t * src, uint16_t x, uint16_t y, uint16_t width, uint16_t height, image_view_t * view)
+{
+    if (!width || !height || (uint32_t)x + width > src->width || (uint32_t)y + height > src->height) {
+        ESP_LOGE(TAG, "Crop %ux%u+%u+%u is outside of %ux%u", width, height, x, y, src->width, src->height);
+        return false;
+    }
+    size_t px = (size_t)x * src->step;
+    if (src->format == PIXFORMAT_YUV422 && (px & 1)) {
+        ESP_LOGE(TAG, "YUV422 crop must start on an even pixel");
+        return false;
+    }
+    *view = *src;
+    view->buf = src->buf + y * src->stride + px * fmt_bytes_per_pixel(src->format);
+    view->width = width;
+    view->height = height;
+    return true;
+}
+
+bool view_subsample(const image_view_t * src, uint8_t factor, image_view_t * view)
+{
+    if (!factor || (unsigned)src->step * factor > 255) {
+        ESP_LOGE(TAG, "Invalid subsampling factor %u", factor);
+        return false;
+    }
+    *view = *src;
+    view->width = (src->width + factor - 1) / factor;
+    view->height = (src->height + factor - 1) / factor;
+    view->stride = src->stride * factor;
+    view->step = src->step * factor;
+    return true;
+}
+
+bool view_convert(const image_view_t * src, uint8_t * dst, pixformat_t dst_format, size_t dst_stride)
+{
+    fmt_row_t s = fmt_row_from_pixformat(src->format);
+    fmt_row_t d = fmt_row_from_pixformat(dst_format);
+    fmt_row_cb convert_line = fmt_row_get(s, d);
+    if (!convert_line) {
+        ESP_LOGE(TAG, "Conversion %d -> %d is not supported", src->format, dst_format);
+        return false;
+    }
+    if (!dst_stride) {
+        dst_stride = src->width * fmt_row_bpp(d);
+    }
+
+    uint8_t *line = NULL;
+    if (src->step != 1) {
+        line = (uint8_t *)malloc(src->width * fmt_row_bpp(s));
+        if (!line) {
+            ESP_LOGE(TAG, "Scan line malloc failed");
+            return false;
+        }
+    }
+    for (int y = 0; y < src->height; y++) {
+        convert_line(fmt_view_line(src, y, line), dst, src->width);
+        dst += dst_stride;
+    }
+    free(line);
+    return true;
+}
+
+bool view2rgb888(const image_view_t * view, uint8_t * rgb_buf)
+{
+    return view_convert(view, rgb_buf, PIXFORMAT_RGB888, 0);
+}
@@ -0,0 +1,518 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Area resampler for frames in any uncompressed format and for decoded JPEGs.
+ *
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "img_resize.h"
+#include "esp_heap_caps.h"
+#include "fmt_row.h"
+#include "sdkconfig.h"
+#include "esp_jpg_decode.h"
+
+#include "esp_system.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "img_resize";
+#endif
+
+// weights are Q14, horizontally filtered lines are kept as Q4
+#define WEIGHT_BITS     14
+#define WEIGHT_ONE      (1 << WEIGHT_BITS)
+#define LINE_BITS       4
+
+typedef struct {
+    uint16_t *start;        // first source pixel of every output pixel
+    uint8_t *count;         // number of source pixels used
+    uint16_t *weight;       // taps weights per output pixel
+    uint8_t taps;
+} resize_axis_t;
+
+struct img_resize_t {
+    img_resize_line_cb cb;
+    void *arg;
+    uint16_t src_width;
+    uint16_t src_height;
+    uint16_t dst_width;
+    uint16_t dst_height;
+    fmt_roi_t content;
+    uint8_t channels;
+    uint8_t pad_value;
+    size_t src_line_len;
+    fmt_row_cb in_conv;     // source -> working layout, NULL if already there
+    fmt_row_cb out_conv;    // working layout -> dst_format, NULL if the same
+    resize_axis_t x;
+    resize_axis_t y;
+    uint8_t *line;          // source line in the working layout
+    uint16_t *ring;         // y.taps horizontally filtered lines
+    uint32_t *acc;          // vertical accumulator
+    uint8_t *work;          // output line in the working layout
+    uint8_t *out;           // output line in dst_format
+    uint16_t in_y;
+    uint16_t out_y;
+    bool padded;            // top border has been written
+};
+
+static void *_malloc(size_t size)
+{
+    // check if SPIRAM is enabled and allocate on SPIRAM if allocatable
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    // try allocating in internal memory
+    return malloc(size);
+}
+
+static void axis_free(resize_axis_t *a)
+{
+    free(a->start);
+    free(a->count);
+    free(a->weight);
+}
+
+static bool axis_init(resize_axis_t *a, uint16_t src, uint16_t dst, img_resize_filter_t filter)
+{
+    float s = (float)src / dst;
+    a->taps = (filter == IMG_RESIZE_AREA) ? (uint8_t)ceilf(s) + 1 : 2;
+    a->start = (uint16_t *)_malloc(dst * sizeof(uint16_t));
+    a->count = (uint8_t *)_malloc(dst);
+    a->weight = (uint16_t *)_malloc(dst * a->taps * sizeof(uint16_t));
+    if (!a->start || !a->count || !a->weight) {
+        return false;
+    }
+
+    for (int i = 0; i < dst; i++) {
+        uint16_t *q = a->weight + i * a->taps;
+        int first, n;
+        if (filter == IMG_RESIZE_AREA) {
+            float b0 = i * s, b1 = b0 + s;
+            first = (int)b0;
+            int last = (int)ceilf(b1) - 1;
+            if (last > src - 1) {
+                last = src - 1;
+            }
+            if (last - first + 1 > a->taps) {
+                last = first + a->taps - 1;
+            }
+            n = last - first + 1;
+            for (int t = 0; t < n; t++) {
+                float l = first + t;
+                q[t] = (uint16_t)((fminf(b1, l + 1) - fmaxf(b0, l)) / s * WEIGHT_ONE + 0.5f);
+            }
+        } else {
+            float c = (i + 0.5f) * s - 0.5f;
+            if (c < 0) {
+                c = 0;
+            }
+            first = (int)c;
+            if (first >= src - 1) {
+                first = src - 1;
+                n = 1;
+                q[0] = WEIGHT_ONE;
+            } else {
+                n = 2;
+                q[1] = (uint16_t)((c - first) * WEIGHT_ONE + 0.5f);
+                q[0] = WEIGHT_ONE - q[1];
+            }
+        }
+
+        // give the rounding error to the largest tap so every output sums to one
+        int sum = 0, big = 0;
+        for (int t = 0; t < n; t++) {
+            sum += q[t];
+            if (q[t] > q[big]) {
+                big = t;
+            }
+        }
+        q[big] += WEIGHT_ONE - sum;
+        a->start[i] = first;
+        a->count[i] = n;
+    }
+    return true;
+}
+
+static void resize_calc_content(const img_resize_config_t *config, uint16_t src_width, uint16_t src_height, fmt_roi_t *roi)
+{
+    memset(roi, 0, sizeof(fmt_roi_t));
+    roi->width = config->dst_width;
+    roi->height = config->dst_height;
+    if (!config->letterbox) {
+        return;
+    }
+    if ((uint32_t)config->dst_width * src_height <= (uint32_t)config->dst_height * src_width) {
+        roi->height = ((uint32_t)src_height * config->dst_width + src_width / 2) / src_width;
+    } else {
+        roi->width = ((uint32_t)src_width * config->dst_height + src_height / 2) / src_height;
+    }
+    if (!roi->width) {
+        roi->width = 1;
+    }
+    if (!roi->height) {
+        roi->height = 1;
+    }
+    roi->x = (config->dst_width - roi->width) / 2;
+    roi->y = (config->dst_height - roi->height) / 2;
+}
+
+static img_resize_handle_t resize_create(const img_resize_config_t *config, fmt_row_t src_fmt, const fmt_roi_t *content,
+                                         img_resize_line_cb cb, void *arg)
+{
+    fmt_row_t dst_fmt = fmt_row_from_pixformat(config->dst_format);
+    if (src_fmt == FMT_ROW_MAX || dst_fmt == FMT_ROW_MAX) {
+        ESP_LOGE(TAG, "Format %d -> %d is not supported", config->src_format, config->dst_format);
+        return NULL;
+    }
+    if (!config->src_width || !config->src_height || !config->dst_width || !config->dst_height || !cb) {
+        ESP_LOGE(TAG, "Invalid size %ux%u -> %ux%u", config->src_width, config->src_height, config->dst_width, config->dst_height);
+        return NULL;
+    }
+
+    img_resize_handle_t r = (img_resize_handle_t)calloc(1, sizeof(struct img_resize_t));
+    if (!r) {
+        ESP_LOGE(TAG, "calloc failed");
+        return NULL;
+    }
+    r->cb = cb;
+    r->arg = arg;
+    r->src_width = config->src_width;
+    r->src_height = config->src_height;
+    r->dst_width = config->dst_width;
+    r->dst_height = config->dst_height;
+    r->pad_value = config->pad_value;
+    if (content) {
+        r->content = *content;
+    } else {
+        resize_calc_content(config, config->src_width, config->src_height, &r->content);
+    }
+
+    // filter in 8 bit gray or BGR888 depending on the output
+    fmt_row_t work_fmt = (dst_fmt == FMT_ROW_GRAYSCALE) ? FMT_ROW_GRAYSCALE : FMT_ROW_BGR888;
+    r->channels = fmt_row_bpp(work_fmt);
+    r->src_line_len = config->src_width * fmt_row_bpp(src_fmt);
+    r->in_conv = (src_fmt == work_fmt) ? NULL : fmt_row_get(src_fmt, work_fmt);
+    r->out_conv = (dst_fmt == work_fmt) ? NULL : fmt_row_get(work_fmt, dst_fmt);
+
+    size_t cw = r->content.width * r->channels;
+    if (!axis_init(&r->x, config->src_width, r->content.width, config->filter)
+        || !axis_init(&r->y, config->src_height, r->content.height, config->filter)) {
+        goto fail;
+    }
+    r->line = (uint8_t *)_malloc(config->src_width * r->channels);
+    r->ring = (uint16_t *)_malloc(r->y.taps * cw * sizeof(uint16_t));
+    r->acc = (uint32_t *)_malloc(cw * sizeof(uint32_t));
+    r->work = (uint8_t *)_malloc(config->dst_width * r->channels);
+    if (!r->line || !r->ring || !r->acc || !r->work) {
+        goto fail;
+    }
+    if (r->out_conv) {
+        r->out = (uint8_t *)_malloc(config->dst_width * fmt_row_bpp(dst_fmt));
+        if (!r->out) {
+            goto fail;
+        }
+    }
+    memset(r->work, config->pad_value, config->dst_width * r->channels);
+    return r;
+
+fail:
+    ESP_LOGE(TAG, "_malloc failed");
+    img_resize_delete(r);
+    return NULL;
+}
+
+img_resize_handle_t img_resize_create(const img_resize_config_t *config, img_resize_line_cb cb, void *arg)
+{
+    return resize_create(config, fmt_row_from_pixformat(config->src_format), NULL, cb, arg);
+}
+
+void img_resize_calc_content(const img_resize_config_t *config, fmt_roi_t *roi)
+{
+    resize_calc_content(config, config->src_width, config->src_height, roi);
+}
+
+void img_resize_delete(img_resize_handle_t r)
+{
+    if (!r) {
+        return;
+    }
+    axis_free(&r->x);
+    axis_free(&r->y);
+    free(r->line);
+    free(r->ring);
+    free(r->acc);
+    free(r->work);
+    free(r->out);
+    free(r);
+}
+
+void img_resize_get_content(img_resize_handle_t r, fmt_roi_t *roi)
+{
+    *roi = r->content;
+}
+
+static bool resize_emit(img_resize_handle_t r, uint16_t y)
+{
+    const uint8_t *line = r->work;
+    if (r->out_conv) {
+        r->out_conv(r->work, r->out, r->dst_width);
+        line = r->out;
+    }
+    return r->cb(r->arg, y, line);
+}
+
+static bool resize_emit_pad(img_resize_handle_t r, uint16_t from, uint16_t to)
+{
+    if (from == to) {
+        return true;
+    }
+    // the side borders of r->work always hold the pad value, only the middle needs clearing
+    memset(r->work + r->content.x * r->channels, r->pad_value, r->content.width * r->channels);
+    for (uint16_t y = from; y < to; y++) {
+        if (!resize_emit(r, y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void resize_horizontal(img_resize_handle_t r, const uint8_t *src, uint16_t *dst)
+{
+    const resize_axis_t *a = &r->x;
+    const uint16_t *w = a->weight;
+    const int round = 1 << (WEIGHT_BITS - LINE_BITS - 1);
+    if (r->channels == 1) {
+        for (int i = 0; i < r->content.width; i++, w += a->taps) {
+            const uint8_t *s = src + a->start[i];
+            uint32_t acc = round;
+            for (int t = 0; t < a->count[i]; t++) {
+                acc += w[t] * s[t];
+            }
+            *dst++ = acc >> (WEIGHT_BITS - LINE_BITS);
+        }
+    } else {
+        for (int i = 0; i < r->content.width; i++, w += a->taps) {
+            const uint8_t *s = src + a->start[i] * 3;
+            uint32_t a0 = round, a1 = round, a2 = round;
+            for (int t = 0; t < a->count[i]; t++, s += 3) {
+                a0 += w[t] * s[0];
+                a1 += w[t] * s[1];
+                a2 += w[t] * s[2];
+            }
+            *dst++ = a0 >> (WEIGHT_BITS - LINE_BITS);
+            *dst++ = a1 >> (WEIGHT_BITS - LINE_BITS);
+            *dst++ = a2 >> (WEIGHT_BITS - LINE_BITS);
+        }
+    }
+}
+
+static void resize_vertical(img_resize_handle_t r, uint16_t y)
+{
+    const resize_axis_t *a = &r->y;
+    const uint16_t *w = a->weight + y * a->taps;
+    size_t len = r->content.width * r->channels;
+    uint32_t *acc = r->acc;
+    uint8_t *o = r->work + r->content.x * r->channels;
+
+    for (int t = 0; t < a->count[y]; t++) {
+        const uint16_t *l = r->ring + ((a->start[y] + t) % a->taps) * len;
+        uint32_t wt = w[t];
+        if (!t) {
+            for (size_t i = 0; i < len; i++) {
+                acc[i] = wt * l[i];
+            }
+        } else {
+            for (size_t i = 0; i < len; i++) {
+                acc[i] += wt * l[i];
+            }
+        }
+    }
+    const int shift = WEIGHT_BITS + LINE_BITS;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t v = (acc[i] + (1 << (shift - 1))) >> shift;
+        o[i] = v > 255 ? 255 : v;
+    }
+}
+
+bool img_resize_write(img_resize_handle_t r, const uint8_t *src, uint16_t lines)
+{
+    if (r->in_y + lines > r->src_height) {
+        ESP_LOGE(TAG, "Too many lines: %u + %u > %u", r->in_y, lines, r->src_height);
+        return false;
+    }
+    if (!r->padded) {
+        r->padded = true;
+        if (!resize_emit_pad(r, 0, r->content.y)) {
+            return false;
+        }
+    }
+
+    size_t len = r->content.width * r->channels;
+    for (; lines; lines--, src += r->src_line_len, r->in_y++) {
+        // lines that no remaining output pixel depends on are skipped
+        if (r->out_y >= r->content.height || r->in_y < r->y.start[r->out_y]) {
+            continue;
+        }
+        const uint8_t *line = src;
+        if (r->in_conv) {
+            r->in_conv(src, r->line, r->src_width);
+            line = r->line;
+        }
+        resize_horizontal(r, line, r->ring + (r->in_y % r->y.taps) * len);
+
+        while (r->out_y < r->content.height && r->y.start[r->out_y] + r->y.count[r->out_y] - 1 <= r->in_y) {
+            resize_vertical(r, r->out_y);
+            if (!resize_emit(r, r->content.y + r->out_y)) {
+                return false;
+            }
+            r->out_y++;
+            if (r->out_y == r->content.height && !resize_emit_pad(r, r->content.y + r->content.height, r->dst_height)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    uint8_t *dst;
+    size_t line_len;
+} resize_mem_t;
+
+static bool _mem_write(void *arg, uint16_t y, const uint8_t *line)
+{
+    resize_mem_t *m = (resize_mem_t *)arg;
+    memcpy(m->dst + y * m->line_len, line, m->line_len);
+    return true;
+}
+
+bool img_resize(const uint8_t *src, const img_resize_config_t *config, uint8_t *dst)
+{
+    resize_mem_t m = { dst, config->dst_width * fmt_bytes_per_pixel(config->dst_format) };
+    img_resize_handle_t r = img_resize_create(config, _mem_write, &m);
+    if (!r) {
+        return false;
+    }
+    bool ret = img_resize_write(r, src, config->src_height);
+    img_resize_delete(r);
+    return ret;
+}
+
+// width and height from the SOFn marker
+bool jpg_get_size(const uint8_t *src, size_t len, uint16_t *width, uint16_t *height)
+{
+    if (len < 4 || src[0] != 0xFF || src[1] != 0xD8) {
+        return false;
+    }
+    size_t i = 2;
+    while (i + 9 <= len) {
+        if (src[i] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = src[i + 1];
+        if (marker == 0xFF) {
+            i++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            i += 2;
+            continue;
+        }
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            *height = src[i + 5] << 8 | src[i + 6];
+            *width = src[i + 7] << 8 | src[i + 8];
+            return *width && *height;
+        }
+        i += 2 + (src[i + 2] << 8 | src[i + 3]);
+    }
+    return false;
+}
+
+typedef struct {
+    const uint8_t *input;
+    img_resize_handle_t resize;
+    uint8_t *band;          // one row of MCUs
+    uint16_t width;
+    uint16_t band_y;
+} resize_jpg_t;
+
+static size_t _jpg_read(void *arg, size_t index, uint8_t *buf, size_t len)
+{
+    resize_jpg_t *jpeg = (resize_jpg_t *)arg;
+    if (buf) {
+        memcpy(buf, jpeg->input + index, len);
+    }
+    return len;
+}
+
+static bool _jpg_write(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    resize_jpg_t *jpeg = (resize_jpg_t *)arg;
+    if (!data) {
+        // start and end of the image
+        return true;
+    }
+    if (x == 0) {
+        jpeg->band_y = y;
+    }
+    size_t line_len = jpeg->width * 3;
+    uint8_t *o = jpeg->band + (y - jpeg->band_y) * line_len + x * 3;
+    for (int i = 0; i < h; i++) {
+        memcpy(o, data, w * 3);
+        data += w * 3;
+        o += line_len;
+    }
+    if (x + w == jpeg->width) {
+        return img_resize_write(jpeg->resize, jpeg->band, y + h - jpeg->band_y);
+    }
+    return true;
+}
+
+bool jpg_resize_cb(const uint8_t *src, size_t src_len, const img_resize_config_t *config, img_resize_line_cb cb, void *arg)
+{
+    uint16_t width, height;
+    if (!jpg_get_size(src, src_len, &width, &height)) {
+        ESP_LOGE(TAG, "JPEG size not found");
+        return false;
+    }
+
+    // let the decoder drop whole powers of two first, the letterbox follows the full size image
+    fmt_roi_t content;
+    resize_calc_content(config, width, height, &content);
+    int scale = JPG_SCALE_NONE;
+    while (scale < JPG_SCALE_MAX && (width >> (scale + 1)) >= content.width && (height >> (scale + 1)) >= content.height) {
+        scale++;
+    }
+
+    img_resize_config_t cfg = *config;
+    cfg.src_width = width >> scale;
+    cfg.src_height = height >> scale;
+    cfg.src_format = PIXFORMAT_RGB888;
+
+    resize_jpg_t jpeg = { src, NULL, NULL, cfg.src_width, 0 };
+    jpeg.resize = resize_create(&cfg, FMT_ROW_RGB888, &content, cb, arg);
+    // MCUs are at most 16 lines high
+    jpeg.band = (uint8_t *)_malloc(cfg.src_width * 3 * 16);
+    bool ret = false;
+    if (jpeg.resize && jpeg.band) {
+        ret = esp_jpg_decode(src_len, (jpg_scale_t)scale, _jpg_read, _jpg_write, (void *)&jpeg) == ESP_OK;
+    } else {
+        ESP_LOGE(TAG, "_malloc failed");
+    }
+    free(jpeg.band);
+    img_resize_delete(jpeg.resize);
+    return ret;
+}
+
+bool jpg_resize(const uint8_t *src, size_t src_len, const img_resize_config_t *config, uint8_t *dst)
+{
+    resize_mem_t m = { dst, config->dst_width * fmt_bytes_per_pixel(config->dst_format) };
+    return jpg_resize_cb(src, src_len, config, _mem_write, &m);
+}
@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Packs images into normalized model input tensors.
+ *
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "img_tensor.h"
+
+#include "esp_system.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "img_tensor";
+#endif
+
+struct img_tensor_t {
+    uint16_t width;
+    uint16_t height;
+    uint8_t channels;
+    img_tensor_type_t type;
+    void *out;
+    union {
+        int8_t q[3][256];
+        float f[3][256];
+    } lut;                  // pixel value -> tensor element, per channel
+};
+
+size_t img_tensor_size(const img_tensor_config_t *config)
+{
+    size_t elem = config->type == IMG_TENSOR_FLOAT ? sizeof(float) : sizeof(int8_t);
+    return (size_t)config->width * config->height * config->channels * elem;
+}
+
+img_tensor_handle_t img_tensor_create(const img_tensor_config_t *config, void *out)
+{
+    if (!out || !config->width || !config->height || (config->channels != 1 && config->channels != 3)) {
+        ESP_LOGE(TAG, "Invalid tensor %ux%ux%u", config->channels, config->height, config->width);
+        return NULL;
+    }
+    for (int c = 0; c < config->channels; c++) {
+        if (config->std[c] == 0 || (config->type == IMG_TENSOR_INT8 && config->scale[c] == 0)) {
+            ESP_LOGE(TAG, "Channel %d has a zero std or scale", c);
+            return NULL;
+        }
+    }
+
+    img_tensor_handle_t t = (img_tensor_handle_t)calloc(1, sizeof(struct img_tensor_t));
+    if (!t) {
+        ESP_LOGE(TAG, "calloc failed");
+        return NULL;
+    }
+    t->width = config->width;
+    t->height = config->height;
+    t->channels = config->channels;
+    t->type = config->type;
+    t->out = out;
+
+    // normalisation and quantisation collapse into one table per channel
+    for (int c = 0; c < config->channels; c++) {
+        for (int p = 0; p < 256; p++) {
+            float x = (p - config->mean[c]) / config->std[c];
+            if (config->type == IMG_TENSOR_FLOAT) {
+                t->lut.f[c][p] = x;
+            } else {
+                long q = lroundf(x / config->scale[c]) + config->zero_point[c];
+                t->lut.q[c][p] = q < -128 ? -128 : (q > 127 ? 127 : q);
+            }
+        }
+    }
+    return t;
+}
+
+void img_tensor_delete(img_tensor_handle_t t)
+{
+    free(t);
+}
+
+bool img_tensor_write_line(void *handle, uint16_t y, const uint8_t *line)
+{
+    img_tensor_handle_t t = (img_tensor_handle_t)handle;
+    if (y >= t->height) {
+        ESP_LOGE(TAG, "Line %u is outside of the tensor", y);
+        return false;
+    }
+    size_t plane = (size_t)t->width * t->height;
+    size_t offset = (size_t)y * t->width;
+    uint16_t w = t->width;
+
+    if (t->channels == 1) {
+        if (t->type == IMG_TENSOR_FLOAT) {
+            float *o = (float *)t->out + offset;
+            for (int x = 0; x < w; x++) {
+                o[x] = t->lut.f[0][line[x]];
+            }
+        } else {
+            int8_t *o = (int8_t *)t->out + offset;
+            for (int x = 0; x < w; x++) {
+                o[x] = t->lut.q[0][line[x]];
+            }
+        }
+        return true;
+    }
+
+    // the line is B, G, R, the tensor planes are R, G, B
+    if (t->type == IMG_TENSOR_FLOAT) {
+        float *r = (float *)t->out + offset, *g = r + plane, *b = g + plane;
+        for (int x = 0; x < w; x++, line += 3) {
+            b[x] = t->lut.f[2][line[0]];
+            g[x] = t->lut.f[1][line[1]];
+            r[x] = t->lut.f[0][line[2]];
+        }
+    } else {
+        int8_t *r = (int8_t *)t->out + offset, *g = r + plane, *b = g + plane;
+        for (int x = 0; x < w; x++, line += 3) {
+            b[x] = t->lut.q[2][line[0]];
+            g[x] = t->lut.q[1][line[1]];
+            r[x] = t->lut.q[0][line[2]];
+        }
+    }
+    return true;
+}
+
+static void tensor_resize_config(const img_tensor_config_t *config, img_resize_config_t *rc)
+{
+    memset(rc, 0, sizeof(img_resize_config_t));
+    rc->dst_width = config->width;
+    rc->dst_height = config->height;
+    rc->dst_format = config->channels == 1 ? PIXFORMAT_GRAYSCALE : PIXFORMAT_RGB888;
+    rc->filter = config->filter;
+    rc->letterbox = config->letterbox;
+    rc->pad_value = config->pad_value;
+}
+
+bool img_to_tensor(const uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, const img_tensor_config_t *config,
+                   void *out, fmt_roi_t *content)
+{
+    img_resize_config_t rc;
+    tensor_resize_config(config, &rc);
+    rc.src_width = width;
+    rc.src_height = height;
+    rc.src_format = format;
+
+    img_tensor_handle_t t = img_tensor_create(config, out);
+    if (!t) {
+        return false;
+    }
+    bool ret = false;
+    img_resize_handle_t r = img_resize_create(&rc, img_tensor_write_line, t);
+    if (r) {
+        ret = img_resize_write(r, src, height);
+        if (content) {
+            img_resize_get_content(r, content);
+        }
+        img_resize_delete(r);
+    }
+    img_tensor_delete(t);
+    return ret;
+}
+
+bool jpg_to_tensor(const uint8_t *src, size_t src_len, const img_tensor_config_t *config, void *out, fmt_roi_t *content)
+{
+    img_resize_config_t rc;
+    tensor_resize_config(config, &rc);
+    if (content) {
+        if (!jpg_get_size(src, src_len, &rc.src_width, &rc.src_height)) {
+            ESP_LOGE(TAG, "JPEG size not found");
+            return false;
+        }
+        img_resize_calc_content(&rc, content);
+    }
+
+    img_tensor_handle_t t = img_tensor_create(config, out);
+    if (!t) {
+        return false;
+    }
+    bool ret = jpg_resize_cb(src, src_len, &rc, img_tensor_write_line, t);
+    img_tensor_delete(t);
+    return ret;
+}
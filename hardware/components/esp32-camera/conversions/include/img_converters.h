@@ -123,6 +123,324 @@ bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint
 
 bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t * out, jpg_scale_t scale);
 
+/**
+ * @brief Region of interest and line strides for fmt_convert
+ */
+typedef struct {
+    uint16_t x;                 /*!< Left edge of the region in the source, in pixels (even for YUV422) */
+    uint16_t y;                 /*!< Top edge of the region in the source, in lines */
+    uint16_t width;             /*!< Width of the region in pixels */
+    uint16_t height;            /*!< Height of the region in lines */
+    size_t src_stride;          /*!< Bytes between source lines, 0 when the source is tightly packed */
+    size_t dst_stride;          /*!< Bytes between destination lines, 0 when the output is tightly packed */
+} fmt_roi_t;
+
+/**
+ * @brief Bytes per pixel of an uncompressed format
+ *
+ * @param format    RGB565, RGB555, RGB444, YUV422, GRAYSCALE or RGB888
+ *
+ * @return bytes per pixel (2 for YUV422) or 0 if the format is not a raw pixel format
+ */
+size_t fmt_bytes_per_pixel(pixformat_t format);
+
+/**
+ * @brief Convert between any two uncompressed pixel formats
+ *
+ * RGB888 is stored B, G, R like the rest of the converters. YUV422 is studio
+ * swing BT.601 and GRAYSCALE is its Y channel.
+ *
+ * @param src       Source buffer
+ * @param src_format Format of the source image
+ * @param dst       Output buffer, large enough for the region in dst_format
+ * @param dst_format Format of the output image
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param roi       Region and strides, NULL to convert the whole packed image
+ *
+ * @return true on success
+ */
+bool fmt_convert(const uint8_t *src, pixformat_t src_format, uint8_t *dst, pixformat_t dst_format, uint16_t width, uint16_t height, const fmt_roi_t *roi);
+
+/**
+ * @brief Non-owning view of an uncompressed image inside a larger buffer
+ *
+ * Views are cheap to copy and never own the pixels: cropping or subsampling
+ * only changes the pointer, the size, the stride and the step.
+ */
+typedef struct {
+    uint8_t * buf;              /*!< First pixel of the view */
+    uint16_t width;             /*!< Width in pixels */
+    uint16_t height;            /*!< Height in lines */
+    size_t stride;              /*!< Bytes between the first pixels of two lines */
+    uint8_t step;               /*!< Pixels of the buffer between two pixels of the view, 1 when packed */
+    pixformat_t format;         /*!< Any uncompressed format */
+} image_view_t;
+
+/**
+ * @brief View of a whole camera frame buffer
+ *
+ * @param fb        Frame buffer in an uncompressed format
+ * @param view      Populated with the view
+ *
+ * @return true on success, false for JPEG and other compressed frames
+ */
+bool fb_view(camera_fb_t * fb, image_view_t * view);
+
+/**
+ * @brief View of a rectangle inside another view
+ *
+ * @param src       Parent view
+ * @param x         Left edge in pixels of the parent (even for YUV422 without subsampling)
+ * @param y         Top edge in lines of the parent
+ * @param width     Width in pixels
+ * @param height    Height in lines
+ * @param view      Populated with the view, may be the same as src
+ *
+ * @return true on success, false if the rectangle does not fit
+ */
+bool view_crop(const image_view_t * src, uint16_t x, uint16_t y, uint16_t width, uint16_t height, image_view_t * view);
+
+/**
+ * @brief View of every factor-th pixel and line of another view (nearest neighbour)
+ *
+ * @param src       Parent view
+ * @param factor    Subsampling factor, 1 or more
+ * @param view      Populated with the view, may be the same as src
+ *
+ * @return true on success
+ */
+bool view_subsample(const image_view_t * src, uint8_t factor, image_view_t * view);
+
+/**
+ * @brief Convert a view into a buffer of another uncompressed format
+ *
+ * @param src       Source view
+ * @param dst       Output buffer
+ * @param dst_format Format of the output
+ * @param dst_stride Bytes between output lines, 0 when tightly packed
+ *
+ * @return true on success
+ */
+bool view_convert(const image_view_t * src, uint8_t * dst, pixformat_t dst_format, size_t dst_stride);
+
+/**
+ * @brief Convert a view to JPEG
+ *
+ * @param view      Source view in RGB565, RGB555, RGB444, RGB888, YUYV or GRAYSCALE format
+ * @param quality   JPEG quality of the resulting image
+ * @param cb        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool view2jpg_cb(const image_view_t * view, uint8_t quality, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief JPEG encoder fed a few rows at a time, see jpg_stream_start()
+ */
+typedef struct jpg_stream_s jpg_stream_t;
+
+/**
+ * @brief Start encoding an image that arrives a few rows at a time
+ *
+ * Only the encoder state, 8 or 16 lines of MCU buffer and one scan line are kept
+ * in RAM, the rows are encoded as they are given and the output is handed to the
+ * callback as it is produced. Rows from esp_camera_set_line_callback() can go
+ * straight in, without waiting for the whole frame.
+ *
+ * @param width     Width in pixels of the image
+ * @param height    Height in pixels of the image
+ * @param format    Format of the rows: RGB565, RGB555, RGB444, RGB888, YUYV or GRAYSCALE
+ * @param quality   JPEG quality of the resulting image
+ * @param cb        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return the encoder, or NULL if it could not be allocated
+ */
+jpg_stream_t *jpg_stream_start(uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Encode the next rows of the image
+ *
+ * @param stream    Encoder from jpg_stream_start()
+ * @param rows      Rows in the format given to jpg_stream_start(), without padding
+ * @param count     Number of rows
+ *
+ * @return true on success
+ */
+bool jpg_stream_rows(jpg_stream_t *stream, const uint8_t *rows, uint16_t count);
+
+/**
+ * @brief Finish the JPEG and free the encoder
+ *
+ * @param stream    Encoder from jpg_stream_start(), freed even if the image is incomplete
+ *
+ * @return true if every row was given and the image was written
+ */
+bool jpg_stream_end(jpg_stream_t *stream);
+
+/**
+ * @brief Convert a view to a JPEG buffer
+ *
+ * @param view      Source view
+ * @param quality   JPEG quality of the resulting image
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool view2jpg(const image_view_t * view, uint8_t quality, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert a view to a BMP buffer
+ *
+ * @param view      Source view
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool view2bmp(const image_view_t * view, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert a view to a packed RGB888 buffer
+ *
+ * @param view      Source view
+ * @param rgb_buf   Pointer to the output buffer (width * height * 3)
+ *
+ * @return true on success
+ */
+bool view2rgb888(const image_view_t * view, uint8_t * rgb_buf);
+
+/**
+ * @brief Callback receiving one decoded line of a QOI image
+ *
+ * @param arg   Pointer given to qoi_decode_cb
+ * @param y     Line number, from 0 to height - 1
+ * @param line  Line in the requested pixel format
+ *
+ * @return true to continue decoding
+ */
+typedef bool (*qoi_line_cb)(void * arg, uint16_t y, const uint8_t *line);
+
+/**
+ * @brief Encode a view as lossless QOI, RGB without alpha
+ *
+ * Only one scan line and the 64 entry colour index are kept in RAM, the output
+ * is handed to the callback in chunks of up to 512 bytes, so it can go straight to a file.
+ *
+ * @param view      Source view in RGB565, RGB555, RGB444, RGB888, YUYV or GRAYSCALE format
+ * @param cb        Callback to be called to write the bytes of the output QOI
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool view2qoi_cb(const image_view_t * view, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Encode a view as a QOI buffer
+ *
+ * @param view      Source view
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool view2qoi(const image_view_t * view, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Encode image data as QOI
+ *
+ * @param src       Source buffer in RGB565, RGB555, RGB444, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Source image format
+ * @param cb        Callback to be called to write the bytes of the output QOI
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool fmt2qoi_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Encode image data as a QOI buffer
+ *
+ * @param src       Source buffer in RGB565, RGB555, RGB444, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Source image format
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool fmt2qoi(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Encode camera frame buffer as QOI
+ *
+ * @param fb        Source camera frame buffer
+ * @param cb        Callback to be called to write the bytes of the output QOI
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool frame2qoi_cb(camera_fb_t * fb, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Encode camera frame buffer as a QOI buffer
+ *
+ * @param fb        Source camera frame buffer
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool frame2qoi(camera_fb_t * fb, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Read the dimensions from a QOI header
+ *
+ * @param src       QOI data
+ * @param src_len   Length in bytes of the QOI data
+ * @param width     Pointer to be populated with the image width
+ * @param height    Pointer to be populated with the image height
+ *
+ * @return true if the header is valid
+ */
+bool qoi_get_size(const uint8_t *src, size_t src_len, uint16_t *width, uint16_t *height);
+
+/**
+ * @brief Decode QOI line by line
+ *
+ * @param src       QOI data
+ * @param src_len   Length in bytes of the QOI data
+ * @param format    Format of the lines handed to the callback (not JPEG)
+ * @param cb        Callback receiving every decoded line
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool qoi_decode_cb(const uint8_t *src, size_t src_len, pixformat_t format, qoi_line_cb cb, void * arg);
+
+/**
+ * @brief Decode QOI to RGB888
+ *
+ * @param src       QOI data
+ * @param src_len   Length in bytes of the QOI data
+ * @param rgb_buf   Pointer to the output buffer (width * height * 3)
+ *
+ * @return true on success
+ */
+bool qoi2rgb888(const uint8_t *src, size_t src_len, uint8_t * rgb_buf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Area resampler for frames in any uncompressed format and for decoded JPEGs.
+ *
+ */
+#ifndef _IMG_RESIZE_H_
+#define _IMG_RESIZE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_camera.h"
+#include "img_converters.h"
+
+typedef enum {
+    IMG_RESIZE_AREA,            /*!< Source pixels are weighted by how much of the output pixel they cover */
+    IMG_RESIZE_BILINEAR,        /*!< Two taps per axis around the output pixel centre */
+} img_resize_filter_t;
+
+/**
+ * @brief Resampler configuration
+ */
+typedef struct {
+    uint16_t src_width;         /*!< Width in pixels of the source image */
+    uint16_t src_height;        /*!< Height in lines of the source image */
+    pixformat_t src_format;     /*!< Format of the source image, any uncompressed format */
+    uint16_t dst_width;         /*!< Width in pixels of the output image */
+    uint16_t dst_height;        /*!< Height in lines of the output image */
+    pixformat_t dst_format;     /*!< Format of the output image, any uncompressed format */
+    img_resize_filter_t filter; /*!< Resampling filter */
+    bool letterbox;             /*!< Keep the aspect ratio and pad the remaining borders */
+    uint8_t pad_value;          /*!< Gray level of the letterbox borders */
+} img_resize_config_t;
+
+/**
+ * @brief Called for every output line, in order
+ *
+ * @param arg       Pointer given when the resampler was created
+ * @param y         Output line index
+ * @param line      dst_width pixels in dst_format, valid only during the call
+ *
+ * @return false to abort the conversion
+ */
+typedef bool (* img_resize_line_cb)(void * arg, uint16_t y, const uint8_t *line);
+
+typedef struct img_resize_t * img_resize_handle_t;
+
+/**
+ * @brief Create a streaming resampler
+ *
+ * Source lines are pushed in order with img_resize_write() and every output
+ * line is handed to the callback as soon as the source lines it depends on
+ * have arrived, so only a few lines are kept in memory.
+ *
+ * @param config    Resampler configuration
+ * @param cb        Callback receiving the output lines
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return handle or NULL on invalid configuration or if out of memory
+ */
+img_resize_handle_t img_resize_create(const img_resize_config_t *config, img_resize_line_cb cb, void *arg);
+
+/**
+ * @brief Push source lines
+ *
+ * @param handle    Resampler
+ * @param src       Packed source lines in src_format
+ * @param lines     Number of lines in src
+ *
+ * @return true on success, false if the callback aborted or too many lines were written
+ */
+bool img_resize_write(img_resize_handle_t handle, const uint8_t *src, uint16_t lines);
+
+/**
+ * @brief Region of the output covered by the image, the rest is letterbox padding
+ *
+ * @param handle    Resampler
+ * @param roi       Populated with the position and size of the image (strides are zero)
+ */
+void img_resize_get_content(img_resize_handle_t handle, fmt_roi_t *roi);
+
+/**
+ * @brief Region of the output an image would cover, without creating a resampler
+ *
+ * @param config    Resampler configuration
+ * @param roi       Populated with the position and size of the image (strides are zero)
+ */
+void img_resize_calc_content(const img_resize_config_t *config, fmt_roi_t *roi);
+
+/**
+ * @brief Free the resampler
+ */
+void img_resize_delete(img_resize_handle_t handle);
+
+/**
+ * @brief Resample a whole image buffer
+ *
+ * @param src       Source buffer described by config
+ * @param config    Resampler configuration
+ * @param dst       Output buffer (dst_width * dst_height pixels in dst_format)
+ *
+ * @return true on success
+ */
+bool img_resize(const uint8_t *src, const img_resize_config_t *config, uint8_t *dst);
+
+/**
+ * @brief Read the image size from the JPEG headers
+ *
+ * @param src       JPEG data
+ * @param src_len   Length in bytes of the JPEG data
+ * @param width     Populated with the width in pixels
+ * @param height    Populated with the height in pixels
+ *
+ * @return true if a frame header was found
+ */
+bool jpg_get_size(const uint8_t *src, size_t src_len, uint16_t *width, uint16_t *height);
+
+/**
+ * @brief Decode and resample a JPEG image line by line
+ *
+ * The largest power-of-two decoder scale that still covers the output is
+ * applied first, the resampler does the rest.
+ *
+ * @param src       JPEG data
+ * @param src_len   Length in bytes of the JPEG data
+ * @param config    Resampler configuration, the src_* fields are ignored
+ * @param cb        Callback receiving the output lines
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool jpg_resize_cb(const uint8_t *src, size_t src_len, const img_resize_config_t *config, img_resize_line_cb cb, void *arg);
+
+/**
+ * @brief Decode and resample a JPEG image into a buffer
+ *
+ * @param src       JPEG data
+ * @param src_len   Length in bytes of the JPEG data
+ * @param config    Resampler configuration, the src_* fields are ignored
+ * @param dst       Output buffer (dst_width * dst_height pixels in dst_format)
+ *
+ * @return true on success
+ */
+bool jpg_resize(const uint8_t *src, size_t src_len, const img_resize_config_t *config, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IMG_RESIZE_H_ */
@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Packs images into normalized model input tensors.
+ *
+ */
+#ifndef _IMG_TENSOR_H_
+#define _IMG_TENSOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "img_resize.h"
+
+typedef enum {
+    IMG_TENSOR_INT8,            /*!< int8, q = round(x / scale) + zero_point */
+    IMG_TENSOR_FLOAT,           /*!< float32, x */
+} img_tensor_type_t;
+
+/**
+ * @brief Model input description
+ *
+ * Every pixel value p (0..255) becomes x = (p - mean) / std for its channel.
+ * The tensor is planar (CHW), with the channels in R, G, B order.
+ */
+typedef struct {
+    uint16_t width;             /*!< Tensor width */
+    uint16_t height;            /*!< Tensor height */
+    uint8_t channels;           /*!< 3 for R, G, B planes or 1 for a luma plane */
+    img_tensor_type_t type;     /*!< Element type */
+    float mean[3];              /*!< Per channel offset, in pixel units */
+    float std[3];               /*!< Per channel divisor, in pixel units (255 maps to 0..1) */
+    float scale[3];             /*!< Per channel quantisation scale, IMG_TENSOR_INT8 only */
+    int8_t zero_point[3];       /*!< Per channel zero point, IMG_TENSOR_INT8 only */
+    img_resize_filter_t filter; /*!< Resampling filter */
+    bool letterbox;             /*!< Keep the aspect ratio and fill the borders with pad_value */
+    uint8_t pad_value;          /*!< Pixel value of the letterbox borders, before normalisation */
+} img_tensor_config_t;
+
+typedef struct img_tensor_t * img_tensor_handle_t;
+
+/**
+ * @brief Size in bytes of the tensor described by config
+ */
+size_t img_tensor_size(const img_tensor_config_t *config);
+
+/**
+ * @brief Create a tensor packer writing into out
+ *
+ * Lines are given with img_tensor_write_line(), which has the signature of
+ * img_resize_line_cb so the packer can sit directly behind a resampler.
+ *
+ * @param config    Tensor description
+ * @param out       Tensor buffer, img_tensor_size() bytes
+ *
+ * @return handle or NULL on invalid configuration or if out of memory
+ */
+img_tensor_handle_t img_tensor_create(const img_tensor_config_t *config, void *out);
+
+/**
+ * @brief Pack one line
+ *
+ * @param handle    Tensor packer (img_tensor_handle_t)
+ * @param y         Tensor row
+ * @param line      width pixels in RGB888 (3 channels) or GRAYSCALE (1 channel)
+ *
+ * @return true on success
+ */
+bool img_tensor_write_line(void *handle, uint16_t y, const uint8_t *line);
+
+/**
+ * @brief Free the tensor packer
+ */
+void img_tensor_delete(img_tensor_handle_t handle);
+
+/**
+ * @brief Resample and pack an image buffer
+ *
+ * @param src       Source buffer in any uncompressed format
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param config    Tensor description
+ * @param out       Tensor buffer, img_tensor_size() bytes
+ * @param content   Optional, populated with the tensor region covered by the image
+ *
+ * @return true on success
+ */
+bool img_to_tensor(const uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, const img_tensor_config_t *config,
+                   void *out, fmt_roi_t *content);
+
+/**
+ * @brief Decode, resample and pack a JPEG image
+ *
+ * @param src       JPEG data
+ * @param src_len   Length in bytes of the JPEG data
+ * @param config    Tensor description
+ * @param out       Tensor buffer, img_tensor_size() bytes
+ * @param content   Optional, populated with the tensor region covered by the image
+ *
+ * @return true on success
+ */
+bool jpg_to_tensor(const uint8_t *src, size_t src_len, const img_tensor_config_t *config, void *out, fmt_roi_t *content);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IMG_TENSOR_H_ */
@@ -0,0 +1,76 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Row converters shared by the format conversions, the JPEG encoder and decoder.
+ *
+ */
+#ifndef _CONVERSIONS_FMT_ROW_H_
+#define _CONVERSIONS_FMT_ROW_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor.h"
+#include "img_converters.h"
+
+/**
+ * Pixel layouts understood by the row converters.
+ * The first entries map to pixformat_t, the rest are byte orders used
+ * internally by the JPEG encoder and decoder.
+ */
+typedef enum {
+    FMT_ROW_RGB565,     // PIXFORMAT_RGB565, big-endian as sent by the sensor
+    FMT_ROW_RGB555,     // PIXFORMAT_RGB555, 0RRRRRGG GGGBBBBB
+    FMT_ROW_RGB444,     // PIXFORMAT_RGB444, xxxxRRRR GGGGBBBB
+    FMT_ROW_YUV422,     // PIXFORMAT_YUV422, Y0 U Y1 V
+    FMT_ROW_GRAYSCALE,  // PIXFORMAT_GRAYSCALE
+    FMT_ROW_BGR888,     // PIXFORMAT_RGB888, stored B, G, R
+    FMT_ROW_RGB888,     // R, G, B as consumed by jpge and produced by tjpgd
+    FMT_ROW_RGB565_LE,  // little-endian RGB565 as produced by jpg2rgb565
+    FMT_ROW_MAX
+} fmt_row_t;
+
+typedef void (* fmt_row_cb)(const uint8_t *src, uint8_t *dst, size_t width);
+
+/**
+ * @brief Map a pixformat_t to its row layout
+ *
+ * @return the layout or FMT_ROW_MAX for compressed/unsupported formats
+ */
+fmt_row_t fmt_row_from_pixformat(pixformat_t format);
+
+/**
+ * @brief Bytes per pixel of a row layout (YUV422 counts as 2)
+ */
+size_t fmt_row_bpp(fmt_row_t format);
+
+/**
+ * @brief Get the converter for one line of pixels
+ *
+ * @return converter or NULL if either layout is invalid
+ */
+fmt_row_cb fmt_row_get(fmt_row_t src, fmt_row_t dst);
+
+/**
+ * @brief Packed view over a tightly packed buffer
+ */
+void fmt_view_init(image_view_t *view, uint8_t *buf, uint16_t width, uint16_t height, pixformat_t format);
+
+/**
+ * @brief Line y of a view with its pixels packed
+ *
+ * @param line      Scratch of width * bpp bytes, used only when the view has a step
+ *
+ * @return pointer into the view, or line once it has been filled
+ */
+const uint8_t *fmt_view_line(const image_view_t *view, uint16_t y, uint8_t *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONVERSIONS_FMT_ROW_H_ */
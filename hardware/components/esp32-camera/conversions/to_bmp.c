@@ -16,7 +16,7 @@
 #include "img_converters.h"
 #include "soc/efuse_reg.h"
 #include "esp_heap_caps.h"
-#include "yuv.h"
+#include "fmt_row.h"
 #include "sdkconfig.h"
 #include "esp_jpg_decode.h"
 
@@ -68,9 +68,8 @@ static void *_malloc(size_t size)
 }
 
 //output buffer and image width
-static bool _rgb_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+static bool _jpg_write(rgb_jpg_decoder * jpeg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data, fmt_row_t out_fmt)
 {
-    rgb_jpg_decoder * jpeg = (rgb_jpg_decoder *)arg;
     if(!data){
         if(x == 0 && y == 0){
             //write start
@@ -91,80 +90,31 @@ static bool _rgb_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t
         return true;
     }
 
-    size_t jw = jpeg->width*3;
-    size_t t = y * jw;
-    size_t b = t + (h * jw);
-    size_t l = x * 3;
-    uint8_t *out = jpeg->output+jpeg->data_offset;
-    uint8_t *o = out;
-    size_t iy, ix;
-
-    w = w * 3;
-
-    for(iy=t; iy<b; iy+=jw) {
-        o = out+iy+l;
-        for(ix=0; ix<w; ix+= 3) {
-            o[ix] = data[ix+2];
-            o[ix+1] = data[ix+1];
-            o[ix+2] = data[ix];
-        }
-        data+=w;
+    fmt_row_cb convert_line = fmt_row_get(FMT_ROW_RGB888, out_fmt);
+    size_t bpp = fmt_row_bpp(out_fmt);
+    size_t jw = jpeg->width * bpp;
+    uint8_t *o = jpeg->output + jpeg->data_offset + (y * jw) + (x * bpp);
+
+    for(size_t iy=0; iy<h; iy++) {
+        convert_line(data, o, w);
+        data += w * 3;
+        o += jw;
     }
     return true;
 }
 
-static bool _rgb565_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+static bool _rgb_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
 {
-    rgb_jpg_decoder * jpeg = (rgb_jpg_decoder *)arg;
-    if(!data){
-        if(x == 0 && y == 0){
-            //write start
-            jpeg->width = w;
-            jpeg->height = h;
-            //if output is null, this is BMP
-            if(!jpeg->output){
-                size_t out_size = (w*h*3)+jpeg->data_offset;
-                jpeg->output = (uint8_t *)_malloc(out_size);
-                if(!jpeg->output){
-                    ESP_LOGE(TAG, "_malloc failed! %zu", out_size);
-                    return false;
-                }
-            }
-        } else {
-            //write end
-        }
-        return true;
-    }
+    return _jpg_write((rgb_jpg_decoder *)arg, x, y, w, h, data, FMT_ROW_BGR888);
+}
 
-    size_t jw = jpeg->width*3;
-    size_t jw2 = jpeg->width*2;
-    size_t t = y * jw;
-    size_t t2 = y * jw2;
-    size_t b = t + (h * jw);
-    size_t l = x * 2;
-    uint8_t *out = jpeg->output+jpeg->data_offset;
-    uint8_t *o = out;
-    size_t iy, iy2, ix, ix2;
-
-    w = w * 3;
-
-    for(iy=t, iy2=t2; iy<b; iy+=jw, iy2+=jw2) {
-        o = out+iy2+l;
-        for(ix2=ix=0; ix<w; ix+= 3, ix2 +=2) {
-            uint16_t r = data[ix];
-            uint16_t g = data[ix+1];
-            uint16_t b = data[ix+2];
-            uint16_t c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
-            o[ix2+1] = c>>8;
-            o[ix2] = c&0xff;
-        }
-        data+=w;
-    }
-    return true;
+static bool _rgb565_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    return _jpg_write((rgb_jpg_decoder *)arg, x, y, w, h, data, FMT_ROW_RGB565_LE);
 }
 
 //input buffer
-static unsigned int _jpg_read(void * arg, size_t index, uint8_t *buf, size_t len)
+static size_t _jpg_read(void * arg, size_t index, uint8_t *buf, size_t len)
 {
     rgb_jpg_decoder * jpeg = (rgb_jpg_decoder *)arg;
     if(buf) {
@@ -245,75 +195,46 @@ bool jpg2bmp(const uint8_t *src, size_t src_len, uint8_t ** out, size_t * out_le
 
 bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint8_t * rgb_buf)
 {
-    int pix_count = 0;
     if(format == PIXFORMAT_JPEG) {
         return jpg2rgb888(src_buf, src_len, rgb_buf, JPG_SCALE_NONE);
-    } else if(format == PIXFORMAT_RGB888) {
-        memcpy(rgb_buf, src_buf, src_len);
-    } else if(format == PIXFORMAT_RGB565) {
-        int i;
-        uint8_t hb, lb;
-        pix_count = src_len / 2;
-        for(i=0; i<pix_count; i++) {
-            hb = *src_buf++;
-            lb = *src_buf++;
-            *rgb_buf++ = (lb & 0x1F) << 3;
-            *rgb_buf++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
-            *rgb_buf++ = hb & 0xF8;
-        }
-    } else if(format == PIXFORMAT_GRAYSCALE) {
-        int i;
-        uint8_t b;
-        pix_count = src_len;
-        for(i=0; i<pix_count; i++) {
-            b = *src_buf++;
-            *rgb_buf++ = b;
-            *rgb_buf++ = b;
-            *rgb_buf++ = b;
-        }
-    } else if(format == PIXFORMAT_YUV422) {
-        pix_count = src_len / 2;
-        int i, maxi = pix_count / 2;
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        for(i=0; i<maxi; i++) {
-            y0 = *src_buf++;
-            u = *src_buf++;
-            y1 = *src_buf++;
-            v = *src_buf++;
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-        }
     }
+    fmt_row_t in_fmt = fmt_row_from_pixformat(format);
+    fmt_row_cb convert_line = fmt_row_get(in_fmt, FMT_ROW_BGR888);
+    if(!convert_line) {
+        ESP_LOGE(TAG, "Format %d can not be converted to RGB888", format);
+        return false;
+    }
+    //the whole buffer is converted as a single line
+    convert_line(src_buf, rgb_buf, src_len / fmt_row_bpp(in_fmt));
     return true;
 }
 
-bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len)
+bool view2bmp(const image_view_t * view, uint8_t ** out, size_t * out_len)
 {
-    if(format == PIXFORMAT_JPEG) {
-        return jpg2bmp(src, src_len, out, out_len);
-    }
-
     *out = NULL;
     *out_len = 0;
 
-    int pix_count = width*height;
+    pixformat_t format = view->format;
+    int width = view->width;
+    int height = view->height;
+    fmt_row_t in_fmt = fmt_row_from_pixformat(format);
+    fmt_row_t out_fmt = (format == PIXFORMAT_GRAYSCALE) ? FMT_ROW_GRAYSCALE : FMT_ROW_BGR888;
+    fmt_row_cb convert_line = fmt_row_get(in_fmt, out_fmt);
+    if(!convert_line) {
+        ESP_LOGE(TAG, "Format %d can not be converted to BMP", format);
+        return false;
+    }
 
     // With BMP, 8-bit greyscale requires a palette.
     // For a 640x480 image though, that's a savings
     // over going RGB-24.
     int bpp = (format == PIXFORMAT_GRAYSCALE) ? 1 : 3;
     int palette_size = (format == PIXFORMAT_GRAYSCALE) ? 4 * 256 : 0;
-    size_t out_size = (pix_count * bpp) + BMP_HEADER_LEN + palette_size;
-    uint8_t * out_buf = (uint8_t *)_malloc(out_size);
+    // BMP rows are padded to 4 bytes, crops can have any width
+    size_t row_len = (width * bpp + 3) & ~3;
+    size_t gather_len = (view->step == 1) ? 0 : width * fmt_row_bpp(in_fmt);
+    size_t out_size = (row_len * height) + BMP_HEADER_LEN + palette_size;
+    uint8_t * out_buf = (uint8_t *)_malloc(out_size + gather_len);
     if(!out_buf) {
         ESP_LOGE(TAG, "_malloc failed! %u", out_size);
         return false;
@@ -331,7 +252,7 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     bitmap->planes = 1;
     bitmap->bitsperpixel = bpp * 8;
     bitmap->compression = 0;
-    bitmap->imagesize = pix_count * bpp;
+    bitmap->imagesize = row_len * height;
     bitmap->ypixelpermeter = 0x0B13 ; //2835 , 72 DPI
     bitmap->xpixelpermeter = 0x0B13 ; //2835 , 72 DPI
     bitmap->numcolorspallette = 0;
@@ -339,7 +260,6 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
 
     uint8_t * palette_buf = out_buf + BMP_HEADER_LEN;
     uint8_t * pix_buf = palette_buf + palette_size;
-    uint8_t * src_buf = src;
 
     if (palette_size > 0) {
         // Grayscale palette
@@ -354,47 +274,28 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
         }
     }
 
-    //convert data to RGB888
-    if(format == PIXFORMAT_RGB888) {
-        memcpy(pix_buf, src_buf, pix_count*3);
-    } else if(format == PIXFORMAT_RGB565) {
-        int i;
-        uint8_t hb, lb;
-        for(i=0; i<pix_count; i++) {
-            hb = *src_buf++;
-            lb = *src_buf++;
-            *pix_buf++ = (lb & 0x1F) << 3;
-            *pix_buf++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
-            *pix_buf++ = hb & 0xF8;
-        }
-    } else if(format == PIXFORMAT_GRAYSCALE) {
-        memcpy(pix_buf, src_buf, pix_count);
-    } else if(format == PIXFORMAT_YUV422) {
-        int i, maxi = pix_count / 2;
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        for(i=0; i<maxi; i++) {
-            y0 = *src_buf++;
-            u = *src_buf++;
-            y1 = *src_buf++;
-            v = *src_buf++;
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            *pix_buf++ = b;
-            *pix_buf++ = g;
-            *pix_buf++ = r;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            *pix_buf++ = b;
-            *pix_buf++ = g;
-            *pix_buf++ = r;
-        }
+    //convert data to RGB888, subsampled lines are gathered past the end of the bitmap
+    uint8_t * gather_buf = out_buf + out_size;
+    for (int y = 0; y < height; y++) {
+        uint8_t * row = pix_buf + y * row_len;
+        convert_line(fmt_view_line(view, y, gather_buf), row, width);
+        memset(row + width * bpp, 0, row_len - width * bpp);
     }
     *out = out_buf;
     *out_len = out_size;
     return true;
 }
 
+bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len)
+{
+    if(format == PIXFORMAT_JPEG) {
+        return jpg2bmp(src, src_len, out, out_len);
+    }
+    image_view_t view;
+    fmt_view_init(&view, src, width, height, format);
+    return view2bmp(&view, out, out_len);
+}
+
 bool frame2bmp(camera_fb_t * fb, uint8_t ** out, size_t * out_len)
 {
     return fmt2bmp(fb->buf, fb->len, fb->width, fb->height, fb->format, out, out_len);
@@ -13,13 +13,14 @@
 // limitations under the License.
 #include <stddef.h>
 #include <string.h>
+#include <new>
 #include "esp_attr.h"
 #include "soc/efuse_reg.h"
 #include "esp_heap_caps.h"
 #include "esp_camera.h"
 #include "img_converters.h"
 #include "jpge.h"
-#include "yuv.h"
+#include "fmt_row.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -43,59 +44,23 @@ static void *_malloc(size_t size)
     return NULL;
 }
 
-static IRAM_ATTR void convert_line_format(uint8_t * src, pixformat_t format, uint8_t * dst, size_t width, size_t in_channels, size_t line)
-{
-    int i=0, o=0, l=0;
-    if(format == PIXFORMAT_GRAYSCALE) {
-        memcpy(dst, src + line * width, width);
-    } else if(format == PIXFORMAT_RGB888) {
-        l = width * 3;
-        src += l * line;
-        for(i=0; i<l; i+=3) {
-            dst[o++] = src[i+2];
-            dst[o++] = src[i+1];
-            dst[o++] = src[i];
-        }
-    } else if(format == PIXFORMAT_RGB565) {
-        l = width * 2;
-        src += l * line;
-        for(i=0; i<l; i+=2) {
-            dst[o++] = src[i] & 0xF8;
-            dst[o++] = (src[i] & 0x07) << 5 | (src[i+1] & 0xE0) >> 3;
-            dst[o++] = (src[i+1] & 0x1F) << 3;
-        }
-    } else if(format == PIXFORMAT_YUV422) {
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        l = width * 2;
-        src += l * line;
-        for(i=0; i<l; i+=4) {
-            y0 = src[i];
-            u = src[i+1];
-            y1 = src[i+2];
-            v = src[i+3];
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            dst[o++] = r;
-            dst[o++] = g;
-            dst[o++] = b;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            dst[o++] = r;
-            dst[o++] = g;
-            dst[o++] = b;
-        }
-    }
-}
-
-bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpge::output_stream *dst_stream)
+//Set up the encoder for the format, returns the conversion to its scan lines and their length
+static fmt_row_cb encoder_init(jpge::jpeg_encoder *encoder, jpge::output_stream *dst_stream, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, size_t *line_len)
 {
     int num_channels = 3;
     jpge::subsampling_t subsampling = jpge::H2V2;
+    fmt_row_t line_fmt = FMT_ROW_RGB888;
 
     if(format == PIXFORMAT_GRAYSCALE) {
         num_channels = 1;
         subsampling = jpge::Y_ONLY;
+        line_fmt = FMT_ROW_GRAYSCALE;
+    }
+
+    fmt_row_cb convert_line = fmt_row_get(fmt_row_from_pixformat(format), line_fmt);
+    if(!convert_line) {
+        ESP_LOGE(TAG, "Format %d can not be encoded", format);
+        return NULL;
     }
 
     if(!quality) {
@@ -108,21 +73,36 @@ bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t fo
     comp_params.m_subsampling = subsampling;
     comp_params.m_quality = quality;
 
+    if (!encoder->init(dst_stream, width, height, num_channels, comp_params)) {
+        ESP_LOGE(TAG, "JPG encoder init failed");
+        return NULL;
+    }
+    *line_len = width * num_channels;
+    return convert_line;
+}
+
+bool convert_image(const image_view_t *view, uint8_t quality, jpge::output_stream *dst_stream)
+{
+    uint16_t width = view->width;
+    uint16_t height = view->height;
     jpge::jpeg_encoder dst_image;
+    size_t line_len;
 
-    if (!dst_image.init(dst_stream, width, height, num_channels, comp_params)) {
-        ESP_LOGE(TAG, "JPG encoder init failed");
+    fmt_row_cb convert_line = encoder_init(&dst_image, dst_stream, width, height, view->format, quality, &line_len);
+    if (!convert_line) {
         return false;
     }
 
-    uint8_t* line = (uint8_t*)_malloc(width * num_channels);
+    // subsampled views are gathered into the tail of the scan line buffer first
+    size_t gather_len = (view->step == 1) ? 0 : width * fmt_row_bpp(fmt_row_from_pixformat(view->format));
+    uint8_t* line = (uint8_t*)_malloc(line_len + gather_len);
     if(!line) {
         ESP_LOGE(TAG, "Scan line malloc failed");
         return false;
     }
 
     for (int i = 0; i < height; i++) {
-        convert_line_format(src, format, line, width, num_channels, i);
+        convert_line(fmt_view_line(view, i, line + line_len), line, width);
         if (!dst_image.process_scanline(line)) {
             ESP_LOGE(TAG, "JPG process line %u failed", i);
             free(line);
@@ -159,10 +139,82 @@ public:
     }
 };
 
-bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg)
+struct jpg_stream_s {
+    callback_stream dst_stream;
+    jpge::jpeg_encoder encoder;
+    fmt_row_cb convert_line;
+    size_t row_len;
+    uint16_t width, height, y;
+    uint8_t *line;
+
+    jpg_stream_s(jpg_out_cb cb, void * arg) : dst_stream(cb, arg) { }
+};
+
+jpg_stream_t *jpg_stream_start(uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg)
+{
+    size_t line_len = width * (format == PIXFORMAT_GRAYSCALE ? 1 : 3);
+    void *mem = _malloc(sizeof(jpg_stream_t) + line_len);
+    if(!mem) {
+        ESP_LOGE(TAG, "JPG stream malloc failed");
+        return NULL;
+    }
+    jpg_stream_t *stream = new (mem) jpg_stream_t(cb, arg);
+    stream->convert_line = encoder_init(&stream->encoder, &stream->dst_stream, width, height, format, quality, &line_len);
+    if (!stream->convert_line) {
+        stream->~jpg_stream_t();
+        free(mem);
+        return NULL;
+    }
+    stream->line = (uint8_t *)(stream + 1);
+    stream->row_len = width * fmt_row_bpp(fmt_row_from_pixformat(format));
+    stream->width = width;
+    stream->height = height;
+    stream->y = 0;
+    return stream;
+}
+
+bool jpg_stream_rows(jpg_stream_t *stream, const uint8_t *rows, uint16_t count)
+{
+    if (count > stream->height - stream->y) {
+        ESP_LOGE(TAG, "JPG stream got %u rows past the end", count - (stream->height - stream->y));
+        return false;
+    }
+    for (uint16_t i = 0; i < count; i++, rows += stream->row_len) {
+        stream->convert_line(rows, stream->line, stream->width);
+        if (!stream->encoder.process_scanline(stream->line)) {
+            ESP_LOGE(TAG, "JPG process line %u failed", stream->y);
+            return false;
+        }
+        stream->y++;
+    }
+    return true;
+}
+
+bool jpg_stream_end(jpg_stream_t *stream)
+{
+    bool ok = stream->y == stream->height;
+    if (!ok) {
+        ESP_LOGE(TAG, "JPG stream ended after %u of %u rows", stream->y, stream->height);
+    } else if (!stream->encoder.process_scanline(NULL)) {
+        ESP_LOGE(TAG, "JPG image finish failed");
+        ok = false;
+    }
+    stream->~jpg_stream_t();
+    free(stream);
+    return ok;
+}
+
+bool view2jpg_cb(const image_view_t * view, uint8_t quality, jpg_out_cb cb, void * arg)
 {
     callback_stream dst_stream(cb, arg);
-    return convert_image(src, width, height, format, quality, &dst_stream);
+    return convert_image(view, quality, &dst_stream);
+}
+
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg)
+{
+    image_view_t view;
+    fmt_view_init(&view, src, width, height, format);
+    return view2jpg_cb(&view, quality, cb, arg);
 }
 
 bool frame2jpg_cb(camera_fb_t * fb, uint8_t quality, jpg_out_cb cb, void * arg)
@@ -205,7 +257,7 @@ public:
     }
 };
 
-bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t ** out, size_t * out_len)
+bool view2jpg(const image_view_t * view, uint8_t quality, uint8_t ** out, size_t * out_len)
 {
     //todo: allocate proper buffer for holding JPEG data
     //this should be enough for CIF frame size
@@ -219,7 +271,7 @@ bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     }
     memory_stream dst_stream(jpg_buf, jpg_buf_len);
 
-    if(!convert_image(src, width, height, format, quality, &dst_stream)) {
+    if(!convert_image(view, quality, &dst_stream)) {
         free(jpg_buf);
         return false;
     }
@@ -229,6 +281,13 @@ bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     return true;
 }
 
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t ** out, size_t * out_len)
+{
+    image_view_t view;
+    fmt_view_init(&view, src, width, height, format);
+    return view2jpg(&view, quality, out, out_len);
+}
+
 bool frame2jpg(camera_fb_t * fb, uint8_t quality, uint8_t ** out, size_t * out_len)
 {
     return fmt2jpg(fb->buf, fb->len, fb->width, fb->height, fb->format, quality, out, out_len);
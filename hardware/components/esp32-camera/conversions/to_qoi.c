@@ -0,0 +1,386 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * QOI encoder.
+ *
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "img_converters.h"
+#include "esp_heap_caps.h"
+#include "fmt_row.h"
+#include "sdkconfig.h"
+
+#include "esp_system.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "to_qoi";
+#endif
+
+/*
+ * QOI, "The Quite OK Image Format" (https://qoiformat.org), 3 channels.
+ * The encoder keeps only the 64 entry colour index and one scan line, the
+ * output goes out in small chunks so it can be written straight to a file.
+ */
+#define QOI_OP_INDEX    0x00
+#define QOI_OP_DIFF     0x40
+#define QOI_OP_LUMA     0x80
+#define QOI_OP_RUN      0xc0
+#define QOI_OP_RGB      0xfe
+#define QOI_OP_RGBA     0xff
+#define QOI_MASK_2      0xc0
+
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING     8
+#define QOI_CHUNK_SIZE  512
+
+// a pixel is 0xAARRGGBB, alpha is always 0xff in the encoder so zeroed index entries never hit
+#define QOI_PX(r, g, b, a)  (((uint32_t)(a) << 24) | ((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (b))
+#define QOI_R(px)           (((px) >> 16) & 0xff)
+#define QOI_G(px)           (((px) >> 8) & 0xff)
+#define QOI_B(px)           ((px) & 0xff)
+#define QOI_A(px)           ((px) >> 24)
+#define QOI_HASH(px)        ((QOI_R(px) * 3 + QOI_G(px) * 5 + QOI_B(px) * 7 + QOI_A(px) * 11) % 64)
+
+static const uint8_t qoi_padding[QOI_PADDING] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+typedef struct {
+    jpg_out_cb cb;
+    void * arg;
+    size_t index;           // bytes handed to the callback so far
+    size_t len;             // bytes in chunk
+    uint32_t table[64];
+    uint32_t prev;
+    uint8_t run;
+    uint8_t chunk[QOI_CHUNK_SIZE];
+} qoi_encoder_t;
+
+static void *_malloc(size_t size)
+{
+    // check if SPIRAM is enabled and allocate on SPIRAM if allocatable
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    // try allocating in internal memory
+    return malloc(size);
+}
+
+static void *_realloc(void *ptr, size_t size)
+{
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    return realloc(ptr, size);
+}
+
+static bool qoi_flush(qoi_encoder_t *q)
+{
+    if (q->len) {
+        size_t written = q->cb(q->arg, q->index, q->chunk, q->len);
+        if (written != q->len) {
+            ESP_LOGE(TAG, "Write failed at %u", (unsigned)q->index);
+            return false;
+        }
+        q->index += q->len;
+        q->len = 0;
+    }
+    return true;
+}
+
+static inline void qoi_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint32_t qoi_get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// line is R, G, B
+static bool qoi_encode_line(qoi_encoder_t *q, const uint8_t *line, uint16_t width)
+{
+    for (int x = 0; x < width; x++, line += 3) {
+        // worst case is a flushed run followed by QOI_OP_RGB
+        if (q->len > QOI_CHUNK_SIZE - 5 && !qoi_flush(q)) {
+            return false;
+        }
+        uint32_t px = QOI_PX(line[0], line[1], line[2], 0xff);
+        if (px == q->prev) {
+            if (++q->run == 62) {
+                q->chunk[q->len++] = QOI_OP_RUN | (q->run - 1);
+                q->run = 0;
+            }
+            continue;
+        }
+        if (q->run) {
+            q->chunk[q->len++] = QOI_OP_RUN | (q->run - 1);
+            q->run = 0;
+        }
+
+        int h = QOI_HASH(px);
+        if (q->table[h] == px) {
+            q->chunk[q->len++] = QOI_OP_INDEX | h;
+        } else {
+            q->table[h] = px;
+            int8_t dr = QOI_R(px) - QOI_R(q->prev);
+            int8_t dg = QOI_G(px) - QOI_G(q->prev);
+            int8_t db = QOI_B(px) - QOI_B(q->prev);
+            int8_t dr_dg = dr - dg;
+            int8_t db_dg = db - dg;
+            if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                q->chunk[q->len++] = QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+            } else if (dg > -33 && dg < 32 && dr_dg > -9 && dr_dg < 8 && db_dg > -9 && db_dg < 8) {
+                q->chunk[q->len++] = QOI_OP_LUMA | (dg + 32);
+                q->chunk[q->len++] = (dr_dg + 8) << 4 | (db_dg + 8);
+            } else {
+                q->chunk[q->len++] = QOI_OP_RGB;
+                q->chunk[q->len++] = line[0];
+                q->chunk[q->len++] = line[1];
+                q->chunk[q->len++] = line[2];
+            }
+        }
+        q->prev = px;
+    }
+    return true;
+}
+
+bool view2qoi_cb(const image_view_t * view, jpg_out_cb cb, void * arg)
+{
+    fmt_row_t in_fmt = fmt_row_from_pixformat(view->format);
+    fmt_row_cb convert_line = fmt_row_get(in_fmt, FMT_ROW_RGB888);
+    if (!convert_line) {
+        ESP_LOGE(TAG, "Format %d can not be encoded", view->format);
+        return false;
+    }
+
+    size_t line_len = view->width * 3;
+    size_t gather_len = (view->step == 1) ? 0 : view->width * fmt_row_bpp(in_fmt);
+    qoi_encoder_t *q = (qoi_encoder_t *)calloc(1, sizeof(qoi_encoder_t));
+    uint8_t *line = (uint8_t *)malloc(line_len + gather_len);
+    if (!q || !line) {
+        ESP_LOGE(TAG, "malloc failed");
+        free(q);
+        free(line);
+        return false;
+    }
+    q->cb = cb;
+    q->arg = arg;
+    q->prev = QOI_PX(0, 0, 0, 0xff);
+
+    memcpy(q->chunk, "qoif", 4);
+    qoi_put32(q->chunk + 4, view->width);
+    qoi_put32(q->chunk + 8, view->height);
+    q->chunk[12] = 3;   // RGB
+    q->chunk[13] = 0;   // sRGB with linear alpha
+    q->len = QOI_HEADER_SIZE;
+
+    bool ret = true;
+    for (int y = 0; ret && y < view->height; y++) {
+        convert_line(fmt_view_line(view, y, line + line_len), line, view->width);
+        ret = qoi_encode_line(q, line, view->width);
+    }
+    if (ret) {
+        if (q->run) {
+            q->chunk[q->len++] = QOI_OP_RUN | (q->run - 1);
+        }
+        if (q->len > QOI_CHUNK_SIZE - QOI_PADDING) {
+            ret = qoi_flush(q);
+        }
+        memcpy(q->chunk + q->len, qoi_padding, QOI_PADDING);
+        q->len += QOI_PADDING;
+        ret = ret && qoi_flush(q);
+    }
+    free(line);
+    free(q);
+    return ret;
+}
+
+bool fmt2qoi_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, jpg_out_cb cb, void * arg)
+{
+    image_view_t view;
+    fmt_view_init(&view, src, width, height, format);
+    return view2qoi_cb(&view, cb, arg);
+}
+
+bool frame2qoi_cb(camera_fb_t * fb, jpg_out_cb cb, void * arg)
+{
+    return fmt2qoi_cb(fb->buf, fb->len, fb->width, fb->height, fb->format, cb, arg);
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+} qoi_memory_t;
+
+static size_t _memory_write(void * arg, size_t index, const void* data, size_t len)
+{
+    qoi_memory_t *m = (qoi_memory_t *)arg;
+    if (index + len > m->size) {
+        size_t size = m->size * 2;
+        while (size < index + len) {
+            size *= 2;
+        }
+        uint8_t *buf = (uint8_t *)_realloc(m->buf, size);
+        if (!buf) {
+            ESP_LOGE(TAG, "realloc failed! %u", (unsigned)size);
+            return 0;
+        }
+        m->buf = buf;
+        m->size = size;
+    }
+    memcpy(m->buf + index, data, len);
+    m->len = index + len;
+    return len;
+}
+
+bool view2qoi(const image_view_t * view, uint8_t ** out, size_t * out_len)
+{
+    // camera frames usually land between a third and a half of RGB888, grow from there
+    qoi_memory_t m = { NULL, (size_t)view->width * view->height + QOI_HEADER_SIZE + QOI_PADDING, 0 };
+    m.buf = (uint8_t *)_malloc(m.size);
+    if (!m.buf) {
+        ESP_LOGE(TAG, "_malloc failed! %u", (unsigned)m.size);
+        return false;
+    }
+    if (!view2qoi_cb(view, _memory_write, &m)) {
+        free(m.buf);
+        return false;
+    }
+    *out = m.buf;
+    *out_len = m.len;
+    return true;
+}
+
+bool fmt2qoi(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len)
+{
+    image_view_t view;
+    fmt_view_init(&view, src, width, height, format);
+    return view2qoi(&view, out, out_len);
+}
+
+bool frame2qoi(camera_fb_t * fb, uint8_t ** out, size_t * out_len)
+{
+    return fmt2qoi(fb->buf, fb->len, fb->width, fb->height, fb->format, out, out_len);
+}
+
+bool qoi_get_size(const uint8_t *src, size_t src_len, uint16_t *width, uint16_t *height)
+{
+    if (src_len < QOI_HEADER_SIZE + QOI_PADDING || memcmp(src, "qoif", 4)) {
+        return false;
+    }
+    uint32_t w = qoi_get32(src + 4), h = qoi_get32(src + 8);
+    if (!w || !h || w > UINT16_MAX || h > UINT16_MAX || (src[12] != 3 && src[12] != 4)) {
+        return false;
+    }
+    *width = w;
+    *height = h;
+    return true;
+}
+
+bool qoi_decode_cb(const uint8_t *src, size_t src_len, pixformat_t format, qoi_line_cb cb, void * arg)
+{
+    uint16_t width, height;
+    if (!qoi_get_size(src, src_len, &width, &height)) {
+        ESP_LOGE(TAG, "Not a QOI image");
+        return false;
+    }
+    fmt_row_t out_fmt = fmt_row_from_pixformat(format);
+    fmt_row_cb convert_line = fmt_row_get(FMT_ROW_RGB888, out_fmt);
+    if (!convert_line) {
+        ESP_LOGE(TAG, "Format %d is not supported", format);
+        return false;
+    }
+
+    size_t line_len = width * 3;
+    uint8_t *line = (uint8_t *)malloc(line_len + width * fmt_row_bpp(out_fmt));
+    if (!line) {
+        ESP_LOGE(TAG, "malloc failed");
+        return false;
+    }
+    uint8_t *out = line + line_len;
+
+    uint32_t table[64] = {0};
+    uint32_t px = QOI_PX(0, 0, 0, 0xff);
+    size_t p = QOI_HEADER_SIZE;
+    size_t end = src_len - QOI_PADDING;
+    int run = 0;
+    bool ret = true;
+    for (int y = 0; ret && y < height; y++) {
+        uint8_t *o = line;
+        for (int x = 0; x < width; x++, o += 3) {
+            if (run) {
+                run--;
+            } else {
+                if (p >= end) {
+                    ESP_LOGE(TAG, "Data ends at line %d", y);
+                    ret = false;
+                    break;
+                }
+                uint8_t b1 = src[p++];
+                if (b1 == QOI_OP_RGB) {
+                    px = QOI_PX(src[p], src[p + 1], src[p + 2], QOI_A(px));
+                    p += 3;
+                } else if (b1 == QOI_OP_RGBA) {
+                    px = QOI_PX(src[p], src[p + 1], src[p + 2], src[p + 3]);
+                    p += 4;
+                } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                    px = table[b1];
+                } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                    px = QOI_PX((QOI_R(px) + ((b1 >> 4) & 3) - 2) & 0xff, (QOI_G(px) + ((b1 >> 2) & 3) - 2) & 0xff,
+                                (QOI_B(px) + (b1 & 3) - 2) & 0xff, QOI_A(px));
+                } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                    uint8_t b2 = src[p++];
+                    int dg = (b1 & 0x3f) - 32;
+                    px = QOI_PX((QOI_R(px) + dg - 8 + ((b2 >> 4) & 0x0f)) & 0xff, (QOI_G(px) + dg) & 0xff,
+                                (QOI_B(px) + dg - 8 + (b2 & 0x0f)) & 0xff, QOI_A(px));
+                } else {
+                    run = b1 & 0x3f;
+                }
+                table[QOI_HASH(px)] = px;
+            }
+            o[0] = QOI_R(px);
+            o[1] = QOI_G(px);
+            o[2] = QOI_B(px);
+        }
+        if (ret) {
+            convert_line(line, out, width);
+            ret = cb(arg, y, out);
+        }
+    }
+    free(line);
+    return ret;
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t line_len;
+} qoi_lines_t;
+
+static bool _lines_write(void * arg, uint16_t y, const uint8_t *line)
+{
+    qoi_lines_t *l = (qoi_lines_t *)arg;
+    memcpy(l->buf + y * l->line_len, line, l->line_len);
+    return true;
+}
+
+bool qoi2rgb888(const uint8_t *src, size_t src_len, uint8_t * rgb_buf)
+{
+    uint16_t width, height;
+    if (!qoi_get_size(src, src_len, &width, &height)) {
+        ESP_LOGE(TAG, "Not a QOI image");
+        return false;
+    }
+    qoi_lines_t l = { rgb_buf, width * 3 };
+    return qoi_decode_cb(src, src_len, PIXFORMAT_RGB888, _lines_write, &l);
+}
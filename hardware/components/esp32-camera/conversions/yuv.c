@@ -17,13 +17,13 @@
 typedef struct {
         int16_t vY;
         int16_t vVr;
-        int16_t vVg;
         int16_t vUg;
+        int16_t vVg;
         int16_t vUb;
 } yuv_table_row;
 
 static const yuv_table_row yuv_table[256] = {
-    //  Y    Vr    Vg    Ug    Ub     // #
+    //  Y    Vr    Ug    Vg    Ub     // #
     {  -18, -204,   50,  104, -258 }, // 0
     {  -17, -202,   49,  103, -256 }, // 1
     {  -16, -201,   49,  102, -254 }, // 2
@@ -15,9 +15,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdalign.h>
+#include <stddef.h>
+#include <stdatomic.h>
 #include "esp_heap_caps.h"
 #include "ll_cam.h"
 #include "cam_hal.h"
+#include "cam_jpeg.h"
 
 #if (ESP_IDF_VERSION_MAJOR == 3) && (ESP_IDF_VERSION_MINOR == 3)
 #include "rom/ets_sys.h"
@@ -42,71 +45,183 @@
 static const char *TAG = "cam_hal";
 static cam_obj_t *cam_obj = NULL;
 
-static const uint32_t JPEG_SOI_MARKER = 0xFFD8FF;  // written in little-endian for esp32
-static const uint16_t JPEG_EOI_MARKER = 0xD9FF;  // written in little-endian for esp32
+static camera_fb_t *cam_frame_fb(int frame_pos)
+{
+    return &cam_obj->frames[frame_pos].fb;
+}
 
-static int cam_verify_jpeg_soi(const uint8_t *inbuf, uint32_t length)
+static int cam_frame_pos(camera_fb_t *fb)
 {
-    for (uint32_t i = 0; i < length; i++) {
-        if (memcmp(&inbuf[i], &JPEG_SOI_MARKER, 3) == 0) {
-            //ESP_LOGW(TAG, "SOI: %d", (int) i);
-            return i;
-        }
+    return (cam_frame_t *)((uint8_t *)fb - offsetof(cam_frame_t, fb)) - cam_obj->frames;
+}
+
+static void cam_free_frame(int frame_pos)
+{
+    atomic_fetch_or_explicit(&cam_obj->free_mask, 1u << frame_pos, memory_order_release);
+}
+
+static void IRAM_ATTR cam_count_drop(cam_obj_t *cam, cam_drop_t reason)
+{
+    atomic_fetch_add_explicit(&cam->drops[reason], 1, memory_order_relaxed);
+}
+
+//Frames lost since the driver started, by every reason but cam_take timing out
+static uint32_t cam_dropped_total(void)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < CAM_DROP_TIMEOUT; i++) {
+        total += atomic_load_explicit(&cam_obj->drops[i], memory_order_relaxed);
     }
-    ESP_LOGW(TAG, "NO-SOI");
-    return -1;
+    return total;
 }
 
-static int cam_verify_jpeg_eoi(const uint8_t *inbuf, uint32_t length)
+//Claim a frame to capture into. In grab latest mode the oldest queued frame is recycled
+//when none is free, as long as a newer one stays queued for the application
+static int cam_get_free_frame(void)
 {
-    int offset = -1;
-    uint8_t *dptr = (uint8_t *)inbuf + length - 2;
-    while (dptr > inbuf) {
-        if (memcmp(dptr, &JPEG_EOI_MARKER, 2) == 0) {
-            offset = dptr - inbuf;
-            //ESP_LOGW(TAG, "EOI: %d", length - (offset + 2));
-            return offset;
+    uint32_t mask = atomic_load_explicit(&cam_obj->free_mask, memory_order_acquire);
+    while (mask) {
+        int frame_pos = __builtin_ctz(mask);
+        if (atomic_compare_exchange_weak_explicit(&cam_obj->free_mask, &mask, mask & ~(1u << frame_pos),
+                memory_order_acquire, memory_order_acquire)) {
+            return frame_pos;
         }
-        dptr--;
+    }
+    uint8_t oldest;
+    if (cam_obj->grab_mode == CAMERA_GRAB_LATEST && cam_ring_count(&cam_obj->frame_ring) > 1
+            && cam_ring_pop(&cam_obj->frame_ring, &oldest)) {
+        cam_count_drop(cam_obj, CAM_DROP_OVERWRITTEN);
+        return oldest;
     }
     return -1;
 }
 
-static bool cam_get_next_frame(int * frame_pos)
+static uint8_t *cam_alloc_fb(size_t size, uint32_t caps)
 {
-    if(!cam_obj->frames[*frame_pos].en){
-        for (int x = 0; x < cam_obj->frame_cnt; x++) {
-            if (cam_obj->frames[x].en) {
-                *frame_pos = x;
-                return true;
-            }
-        }
-    } else {
-        return true;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+    // In IDF v4.2 and earlier, memory returned by heap_caps_aligned_alloc must be freed using heap_caps_aligned_free.
+    // And heap_caps_aligned_free is deprecated on v4.3.
+    return (uint8_t *)heap_caps_aligned_alloc(16, size, caps);
+#else
+    return (uint8_t *)heap_caps_malloc(size, caps);
+#endif
+}
+
+//JPEG adaptive sizing: fit the frame buffer to the recent frame sizes before capturing into it
+//cam_task owns the frame here, the application can not hold the old buffer
+static void cam_fit_frame(int frame_pos)
+{
+    cam_frame_t *frame = &cam_obj->frames[frame_pos];
+    size_t size;
+    if (!cam_jpeg_sizer_resize(&cam_obj->jpeg_sizer, frame->size, &size)) {
+        return;
     }
-    return false;
+    uint8_t *buf = cam_alloc_fb(size, cam_obj->fb_caps);
+    if (buf == NULL) {
+        //keep the old buffer, frames that do not fit it are dropped with FB-OVF
+        ESP_LOGW(TAG, "FB-RESIZE %u -> %u failed", (unsigned) frame->size, (unsigned) size);
+        return;
+    }
+    free(frame->fb.buf);
+    frame->fb.buf = buf;
+    frame->size = size;
+    cam_obj->jpeg_sizer.resizes++;
 }
 
+//frame_pos is -1 while cam_task holds no frame
 static bool cam_start_frame(int * frame_pos)
 {
-    if (cam_get_next_frame(frame_pos)) {
+    //let the sensor settle after an on demand capture was armed
+    uint8_t skip = atomic_load(&cam_obj->skip_frames);
+    while (skip && !atomic_compare_exchange_weak(&cam_obj->skip_frames, &skip, skip - 1)) {
+    }
+    if (skip) {
+        return false;
+    }
+    if (*frame_pos < 0) {
+        *frame_pos = cam_get_free_frame();
+        if (*frame_pos < 0) {
+            cam_count_drop(cam_obj, CAM_DROP_STARVED);
+        }
+    }
+    if (*frame_pos >= 0) {
+        if (cam_obj->jpeg_adaptive) {
+            cam_fit_frame(*frame_pos);
+        }
         if(ll_cam_start(cam_obj, *frame_pos)){
             // Vsync the frame manually
             ll_cam_do_vsync(cam_obj);
             uint64_t us = (uint64_t)esp_timer_get_time();
             cam_obj->frames[*frame_pos].fb.timestamp.tv_sec = us / 1000000UL;
             cam_obj->frames[*frame_pos].fb.timestamp.tv_usec = us % 1000000UL;
+            cam_obj->frames[*frame_pos].fb.seq = ++cam_obj->frame_seq;
             return true;
         }
     }
     return false;
 }
 
+//Append the cnt-th DMA chunk of a JPEG to its frame buffer and look for the EOI in the new data
+//Returns false if the chunk does not fit in the frame buffer
+static bool cam_jpeg_chunk(camera_fb_t *fb, int cnt, int *eoi)
+{
+    size_t start = fb->len;
+    if (cam_obj->psram_mode) {
+        //the DMA writes the frame buffer directly and wraps around at its end
+        start = cnt * cam_obj->dma_half_buffer_size;
+        if (start >= cam_obj->dma_buffer_size) {
+            return false;
+        }
+        fb->len = start + cam_obj->dma_half_buffer_size;
+        if (fb->len > cam_obj->dma_buffer_size) {
+            fb->len = cam_obj->dma_buffer_size;
+        }
+    } else {
+        size_t pixels_per_dma = cam_obj->dma_half_buffer_size / cam_obj->dma_bytes_per_item;
+        if (cam_obj->frames[cam_frame_pos(fb)].size < (fb->len + pixels_per_dma)) {
+            return false;
+        }
+        fb->len += ll_cam_memcpy(cam_obj, &fb->buf[fb->len],
+            &cam_obj->dma_buffer[(cnt % cam_obj->dma_half_buffer_cnt) * cam_obj->dma_half_buffer_size],
+            cam_obj->dma_half_buffer_size);
+    }
+    //start one byte early in case the marker is split between two chunks
+    *eoi = cam_jpeg_find_eoi(fb->buf, start ? start - 1 : 0, fb->len);
+    return true;
+}
+
+//Hand the rows completed by the last copy to the line callback, returns the rows handed so far
+//offset is the position in the frame of the first byte in the buffer, not 0 without frame buffers
+static uint16_t cam_line_band(const camera_fb_t *fb, size_t offset, uint16_t rows_done, camera_line_cb_t cb, void *arg)
+{
+    size_t row_bytes = cam_obj->width * cam_obj->fb_bytes_per_pixel;
+    size_t rows = fb->len / row_bytes;
+    if (rows > cam_obj->height) {
+        rows = cam_obj->height;
+    }
+    if (rows <= rows_done) {
+        //a DMA buffer shorter than a row
+        return rows_done;
+    }
+    camera_line_band_t band = {
+        .buf = &fb->buf[rows_done * row_bytes - offset],
+        .len = (rows - rows_done) * row_bytes,
+        .y = rows_done,
+        .rows = rows - rows_done,
+        .width = cam_obj->width,
+        .height = cam_obj->height,
+        .seq = fb->seq,
+    };
+    cb(&band, arg);
+    return rows;
+}
+
 void IRAM_ATTR ll_cam_send_event(cam_obj_t *cam, cam_event_t cam_event, BaseType_t * HPTaskAwoken)
 {
     if (xQueueSendFromISR(cam->event_queue, (void *)&cam_event, HPTaskAwoken) != pdTRUE) {
         ll_cam_stop(cam);
         cam->state = CAM_STATE_IDLE;
+        cam_count_drop(cam, CAM_DROP_EVENT_OVERFLOW);
         ESP_CAMERA_ETS_PRINTF(DRAM_STR("cam_hal: EV-%s-OVF\r\n"), cam_event==CAM_IN_SUC_EOF_EVENT ? DRAM_STR("EOF") : DRAM_STR("VSYNC"));
     }
 }
@@ -115,7 +230,12 @@ void IRAM_ATTR ll_cam_send_event(cam_obj_t *cam, cam_event_t cam_event, BaseType
 static void cam_task(void *arg)
 {
     int cnt = 0;
-    int frame_pos = 0;
+    int eoi = -1;
+    int frame_pos = -1;
+    bool overflow = false;//the frame did not fit its frame buffer
+    camera_line_cb_t line_cb = NULL;
+    void *line_cb_arg = NULL;
+    uint16_t line_rows = 0;
     cam_obj->state = CAM_STATE_IDLE;
     cam_event_t cam_event = 0;
 
@@ -124,6 +244,19 @@ static void cam_task(void *arg)
     while (1) {
         xQueueReceive(cam_obj->event_queue, (void *)&cam_event, portMAX_DELAY);
         DBG_PIN_SET(1);
+        if (cam_event == CAM_PAUSE_EVENT) {
+            //the frame being captured is in the old mode, the queue and DMA plan change while paused
+            ll_cam_stop(cam_obj);
+            if (frame_pos >= 0) {
+                cam_free_frame(frame_pos);
+                frame_pos = -1;
+            }
+            cam_obj->state = CAM_STATE_IDLE;
+            xSemaphoreGive(cam_obj->task_paused);
+            xSemaphoreTake(cam_obj->task_resume, portMAX_DELAY);
+            DBG_PIN_SET(0);
+            continue;
+        }
         switch (cam_obj->state) {
 
             case CAM_STATE_IDLE: {
@@ -131,9 +264,16 @@ static void cam_task(void *arg)
                     //DBG_PIN_SET(1);
                     if(cam_start_frame(&frame_pos)){
                         cam_obj->frames[frame_pos].fb.len = 0;
+                        cam_luma_start(&cam_obj->luma, cam_obj->frames[frame_pos].fb.luma);
+                        cam_stats_start(&cam_obj->stats, cam_obj->frames[frame_pos].fb.stats);
                         cam_obj->state = CAM_STATE_READ_BUF;
                     }
                     cnt = 0;
+                    eoi = -1;
+                    overflow = false;
+                    line_cb = cam_obj->line_cb;
+                    line_cb_arg = cam_obj->line_cb_arg;
+                    line_rows = 0;
                 }
             }
             break;
@@ -143,22 +283,40 @@ static void cam_task(void *arg)
                 size_t pixels_per_dma = (cam_obj->dma_half_buffer_size * cam_obj->fb_bytes_per_pixel) / (cam_obj->dma_bytes_per_item * cam_obj->in_bytes_per_pixel);
 
                 if (cam_event == CAM_IN_SUC_EOF_EVENT) {
-                    if(!cam_obj->psram_mode){
+                    if (cam_obj->jpeg_mode) {
+                        //once the EOI is in, the rest of the frame is padding and is not copied
+                        if (eoi < 0 && !cam_jpeg_chunk(frame_buffer_event, cnt, &eoi)) {
+                            ESP_LOGW(TAG, "FB-OVF");
+                            overflow = true;
+                            ll_cam_stop(cam_obj);
+                            DBG_PIN_SET(0);
+                            continue;
+                        }
+                        //Check for JPEG SOI in the first buffer. stop if not found
+                        if (cnt == 0 && cam_jpeg_find_soi(frame_buffer_event->buf, frame_buffer_event->len) != 0) {
+                            ESP_LOGW(TAG, "NO-SOI");
+                            cam_count_drop(cam_obj, CAM_DROP_NO_SOI);
+                            ll_cam_stop(cam_obj);
+                            cam_obj->state = CAM_STATE_IDLE;
+                        }
+                    } else if(!cam_obj->psram_mode){
                         if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
                             ESP_LOGW(TAG, "FB-OVF");
+                            overflow = true;
                             ll_cam_stop(cam_obj);
                             DBG_PIN_SET(0);
                             continue;
                         }
+                        //without frame buffers every copy goes to the start of a buffer for one DMA transfer
+                        size_t offset = cam_obj->rows_only ? frame_buffer_event->len : 0;
                         frame_buffer_event->len += ll_cam_memcpy(cam_obj,
-                            &frame_buffer_event->buf[frame_buffer_event->len],
+                            &frame_buffer_event->buf[frame_buffer_event->len - offset],
                             &cam_obj->dma_buffer[(cnt % cam_obj->dma_half_buffer_cnt) * cam_obj->dma_half_buffer_size],
                             cam_obj->dma_half_buffer_size);
-                    }
-                    //Check for JPEG SOI in the first buffer. stop if not found
-                    if (cam_obj->jpeg_mode && cnt == 0 && cam_verify_jpeg_soi(frame_buffer_event->buf, frame_buffer_event->len) != 0) {
-                        ll_cam_stop(cam_obj);
-                        cam_obj->state = CAM_STATE_IDLE;
+                        if (line_cb) {
+                            line_rows = cam_line_band(frame_buffer_event, offset, line_rows, line_cb, line_cb_arg);
+                        }
+                        cam_stats_add(&cam_obj->stats, frame_buffer_event->buf, frame_buffer_event->len);
                     }
                     cnt++;
 
@@ -167,61 +325,70 @@ static void cam_task(void *arg)
                     ll_cam_stop(cam_obj);
 
                     if (cnt || !cam_obj->jpeg_mode || cam_obj->psram_mode) {
+                        bool done = true;
+
                         if (cam_obj->jpeg_mode) {
-                            if (!cam_obj->psram_mode) {
-                                if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
-                                    ESP_LOGW(TAG, "FB-OVF");
-                                    cnt--;
-                                } else {
-                                    frame_buffer_event->len += ll_cam_memcpy(cam_obj,
-                                        &frame_buffer_event->buf[frame_buffer_event->len],
-                                        &cam_obj->dma_buffer[(cnt % cam_obj->dma_half_buffer_cnt) * cam_obj->dma_half_buffer_size],
-                                        cam_obj->dma_half_buffer_size);
-                                }
+                            //the tail of the frame has no EOF of its own
+                            //also reached after an overflow on an EOF, which stopped the copies
+                            if (eoi < 0 && !cam_jpeg_chunk(frame_buffer_event, cnt, &eoi)) {
+                                ESP_LOGW(TAG, "FB-OVF");
+                                overflow = true;
+                                cam_jpeg_sizer_overflow(&cam_obj->jpeg_sizer, cam_obj->frames[frame_pos].size);
                             }
-                            cnt++;
-                        }
-
-                        cam_obj->frames[frame_pos].en = 0;
-
-                        if (cam_obj->psram_mode) {
-                            if (cam_obj->jpeg_mode) {
-                                frame_buffer_event->len = cnt * cam_obj->dma_half_buffer_size;
+                            if (eoi >= 0) {
+                                frame_buffer_event->len = eoi + 2;
+                                cam_jpeg_sizer_add(&cam_obj->jpeg_sizer, frame_buffer_event->len);
                             } else {
-                                frame_buffer_event->len = cam_obj->recv_size;
+                                done = false;
+                                ESP_LOGW(TAG, "NO-EOI");
                             }
-                        } else if (!cam_obj->jpeg_mode) {
+                        } else if (cam_obj->psram_mode) {
+                            frame_buffer_event->len = cam_obj->recv_size;
+                        } else {
                             if (frame_buffer_event->len != cam_obj->fb_size) {
-                                cam_obj->frames[frame_pos].en = 1;
+                                done = false;
                                 ESP_LOGE(TAG, "FB-SIZE: %u != %u", frame_buffer_event->len, (unsigned) cam_obj->fb_size);
+                            } else {
+                                cam_stats_finish(&cam_obj->stats);
                             }
                         }
-                        //send frame
-                        if(!cam_obj->frames[frame_pos].en && xQueueSend(cam_obj->frame_buffer_queue, (void *)&frame_buffer_event, 0) != pdTRUE) {
-                            //pop frame buffer from the queue
-                            camera_fb_t * fb2 = NULL;
-                            if(xQueueReceive(cam_obj->frame_buffer_queue, &fb2, 0) == pdTRUE) {
-                                //push the new frame to the end of the queue
-                                if (xQueueSend(cam_obj->frame_buffer_queue, (void *)&frame_buffer_event, 0) != pdTRUE) {
-                                    cam_obj->frames[frame_pos].en = 1;
-                                    ESP_LOGE(TAG, "FBQ-SND");
-                                }
-                                //free the popped buffer
-                                cam_give(fb2);
+                        if (!done) {
+                            //counted once per frame, an overflow also leaves it without EOI or short
+                            cam_count_drop(cam_obj, overflow ? CAM_DROP_FB_OVERFLOW
+                                : cam_obj->jpeg_mode ? CAM_DROP_NO_EOI : CAM_DROP_BAD_SIZE);
+                        }
+                        //send frame, a frame is in the ring at most once so there is always room
+                        //without frame buffers the rows went to the line callback and cam_task keeps the buffer
+                        if (done && !cam_obj->rows_only) {
+                            if (cam_obj->grab_mode == CAMERA_GRAB_ON_DEMAND) {
+                                //one frame per request, stop before cam_take can arm the next one
+                                ll_cam_vsync_intr_enable(cam_obj, false);
+                                atomic_store(&cam_obj->armed, false);
+                            }
+                            if (cam_ring_push(&cam_obj->frame_ring, frame_pos)) {
+                                frame_pos = -1;
+                                xSemaphoreGive(cam_obj->frame_ready);
                             } else {
-                                //queue is full and we could not pop a frame from it
-                                cam_obj->frames[frame_pos].en = 1;
-                                ESP_LOGE(TAG, "FBQ-RCV");
+                                ESP_LOGE(TAG, "FBQ-SND");
                             }
                         }
                     }
 
-                    if(!cam_start_frame(&frame_pos)){
+                    if(cam_obj->grab_mode == CAMERA_GRAB_ON_DEMAND && !atomic_load(&cam_obj->armed)){
+                        cam_obj->state = CAM_STATE_IDLE;
+                    } else if(!cam_start_frame(&frame_pos)){
                         cam_obj->state = CAM_STATE_IDLE;
                     } else {
                         cam_obj->frames[frame_pos].fb.len = 0;
+                        cam_luma_start(&cam_obj->luma, cam_obj->frames[frame_pos].fb.luma);
+                        cam_stats_start(&cam_obj->stats, cam_obj->frames[frame_pos].fb.stats);
                     }
                     cnt = 0;
+                    eoi = -1;
+                    overflow = false;
+                    line_cb = cam_obj->line_cb;
+                    line_cb_arg = cam_obj->line_cb_arg;
+                    line_rows = 0;
                 }
             }
             break;
@@ -249,7 +416,7 @@ static lldesc_t * allocate_dma_descriptors(uint32_t count, uint16_t size, uint8_
     return dma;
 }
 
-static esp_err_t cam_dma_config(const camera_config_t *config)
+static esp_err_t cam_dma_sizes(void)
 {
     bool ret = ll_cam_dma_sizes(cam_obj);
     if (0 == ret) {
@@ -262,15 +429,20 @@ static esp_err_t cam_dma_config(const camera_config_t *config)
     ESP_LOGI(TAG, "buffer_size: %d, half_buffer_size: %d, node_buffer_size: %d, node_cnt: %d, total_cnt: %d",
              (int) cam_obj->dma_buffer_size, (int) cam_obj->dma_half_buffer_size, (int) cam_obj->dma_node_buffer_size,
              (int) cam_obj->dma_node_cnt, (int) cam_obj->frame_copy_cnt);
+    return ESP_OK;
+}
 
-    cam_obj->dma_buffer = NULL;
-    cam_obj->dma = NULL;
-
-    cam_obj->frames = (cam_frame_t *)heap_caps_aligned_calloc(alignof(cam_frame_t), 1, cam_obj->frame_cnt * sizeof(cam_frame_t), MALLOC_CAP_DEFAULT);
-    CAM_CHECK(cam_obj->frames != NULL, "frames malloc failed", ESP_FAIL);
-
+//Bytes every frame buffer needs in the current mode, and in EDMA mode the alignment on top
+static esp_err_t cam_fb_alloc_size(size_t *size, uint8_t *align)
+{
     uint8_t dma_align = 0;
     size_t fb_size = cam_obj->fb_size;
+    if (cam_obj->rows_only) {
+        //room for one DMA transfer, which the DMA sizes keep to whole lines
+        fb_size = cam_obj->dma_half_buffer_size * cam_obj->fb_bytes_per_pixel / (cam_obj->dma_bytes_per_item * cam_obj->in_bytes_per_pixel);
+        size_t row_bytes = cam_obj->width * cam_obj->fb_bytes_per_pixel;
+        CAM_CHECK(fb_size % row_bytes == 0, "DMA transfer is not whole lines", ESP_FAIL);
+    }
     if (cam_obj->psram_mode) {
         dma_align = ll_cam_get_dma_align(cam_obj);
         if (cam_obj->fb_size < cam_obj->recv_size) {
@@ -278,50 +450,157 @@ static esp_err_t cam_dma_config(const camera_config_t *config)
         }
     }
 
+    if (cam_obj->jpeg_adaptive) {
+        //start at half the fixed size, cam_task resizes the buffers once frames come in
+        size_t chunk = cam_obj->dma_half_buffer_size / cam_obj->dma_bytes_per_item;
+        cam_jpeg_sizer_init(&cam_obj->jpeg_sizer, chunk, fb_size);
+        fb_size = (fb_size / 2 + chunk - 1) / chunk * chunk;
+    }
+    *size = fb_size;
+    *align = dma_align;
+    return ESP_OK;
+}
+
+//Give a frame a buffer of at least fb_size bytes, a larger one is kept.
+//In EDMA mode the descriptors that point into it are made again for the current DMA plan
+static esp_err_t cam_alloc_frame(int x, size_t fb_size, uint8_t dma_align)
+{
+    cam_frame_t *frame = &cam_obj->frames[x];
+    if (frame->fb.buf == NULL || frame->size < fb_size) {
+        free(frame->fb.buf - frame->fb_offset);
+        frame->fb.buf = NULL;
+        frame->fb_offset = 0;
+        size_t alloc_size = fb_size * sizeof(uint8_t) + dma_align;
+        ESP_LOGI(TAG, "Allocating %d Byte frame buffer in %s", alloc_size, cam_obj->fb_caps & MALLOC_CAP_SPIRAM ? "PSRAM" : "OnBoard RAM");
+        frame->fb.buf = cam_alloc_fb(alloc_size, cam_obj->fb_caps);
+        CAM_CHECK(frame->fb.buf != NULL, "frame buffer malloc failed", ESP_FAIL);
+        frame->size = fb_size;
+        if (cam_obj->psram_mode) {
+            //align PSRAM buffer, the free path takes fb_offset off again
+            frame->fb_offset = dma_align - ((uint32_t)frame->fb.buf & (dma_align - 1));
+            frame->fb.buf += frame->fb_offset;
+            ESP_LOGI(TAG, "Frame[%d]: Offset: %u, Addr: 0x%08X", x, frame->fb_offset, (unsigned) frame->fb.buf);
+        }
+    }
+    if (cam_obj->psram_mode) {
+        free(frame->dma);
+        frame->dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, frame->fb.buf);
+        CAM_CHECK(frame->dma != NULL, "frame dma malloc failed", ESP_FAIL);
+    }
+    return ESP_OK;
+}
+
+//The DMA buffer cam_task copies out of and its descriptors, EDMA mode writes the frame buffers instead
+static esp_err_t cam_alloc_dma(void)
+{
+    free(cam_obj->dma);
+    free(cam_obj->dma_buffer);
+    cam_obj->dma = NULL;
+    cam_obj->dma_buffer = NULL;
+    if (cam_obj->psram_mode) {
+        return ESP_OK;
+    }
+    cam_obj->dma_buffer = (uint8_t *)heap_caps_malloc(cam_obj->dma_buffer_size * sizeof(uint8_t), MALLOC_CAP_DMA);
+    if(NULL == cam_obj->dma_buffer) {
+        ESP_LOGE(TAG,"%s(%d): DMA buffer %d Byte malloc failed, the current largest free block:%d Byte", __FUNCTION__, __LINE__,
+                 (int) cam_obj->dma_buffer_size, (int) heap_caps_get_largest_free_block(MALLOC_CAP_DMA));
+        return ESP_FAIL;
+    }
+
+    cam_obj->dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->dma_buffer);
+    CAM_CHECK(cam_obj->dma != NULL, "dma malloc failed", ESP_FAIL);
+    return ESP_OK;
+}
+
+static esp_err_t cam_dma_config(const camera_config_t *config)
+{
+    CAM_CHECK(cam_dma_sizes() == ESP_OK, "DMA sizes failed", ESP_FAIL);
+
+    cam_obj->frames = (cam_frame_t *)heap_caps_aligned_calloc(alignof(cam_frame_t), 1, cam_obj->frame_cnt * sizeof(cam_frame_t), MALLOC_CAP_DEFAULT);
+    CAM_CHECK(cam_obj->frames != NULL, "frames malloc failed", ESP_FAIL);
+
+    size_t fb_size;
+    uint8_t dma_align;
+    CAM_CHECK(cam_fb_alloc_size(&fb_size, &dma_align) == ESP_OK, "frame buffer size failed", ESP_FAIL);
+
     /* Allocate memory for frame buffer */
-    size_t alloc_size = fb_size * sizeof(uint8_t) + dma_align;
     uint32_t _caps = MALLOC_CAP_8BIT;
     if (CAMERA_FB_IN_DRAM == config->fb_location) {
         _caps |= MALLOC_CAP_INTERNAL;
     } else {
         _caps |= MALLOC_CAP_SPIRAM;
     }
+    cam_obj->fb_caps = _caps;
     for (int x = 0; x < cam_obj->frame_cnt; x++) {
-        cam_obj->frames[x].dma = NULL;
-        cam_obj->frames[x].fb_offset = 0;
-        cam_obj->frames[x].en = 0;
-        ESP_LOGI(TAG, "Allocating %d Byte frame buffer in %s", alloc_size, _caps & MALLOC_CAP_SPIRAM ? "PSRAM" : "OnBoard RAM");
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
-        // In IDF v4.2 and earlier, memory returned by heap_caps_aligned_alloc must be freed using heap_caps_aligned_free.
-        // And heap_caps_aligned_free is deprecated on v4.3.
-        cam_obj->frames[x].fb.buf = (uint8_t *)heap_caps_aligned_alloc(16, alloc_size, _caps);
-#else
-        cam_obj->frames[x].fb.buf = (uint8_t *)heap_caps_malloc(alloc_size, _caps);
-#endif
-        CAM_CHECK(cam_obj->frames[x].fb.buf != NULL, "frame buffer malloc failed", ESP_FAIL);
-        if (cam_obj->psram_mode) {
-            //align PSRAM buffer. TODO: save the offset so proper address can be freed later
-            cam_obj->frames[x].fb_offset = dma_align - ((uint32_t)cam_obj->frames[x].fb.buf & (dma_align - 1));
-            cam_obj->frames[x].fb.buf += cam_obj->frames[x].fb_offset;
-            ESP_LOGI(TAG, "Frame[%d]: Offset: %u, Addr: 0x%08X", x, cam_obj->frames[x].fb_offset, (unsigned) cam_obj->frames[x].fb.buf);
-            cam_obj->frames[x].dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->frames[x].fb.buf);
-            CAM_CHECK(cam_obj->frames[x].dma != NULL, "frame dma malloc failed", ESP_FAIL);
+        CAM_CHECK(cam_alloc_frame(x, fb_size, dma_align) == ESP_OK, "frame alloc failed", ESP_FAIL);
+        if (cam_obj->luma.shift) {
+            cam_obj->frames[x].fb.luma_width = cam_obj->width >> cam_obj->luma.shift;
+            cam_obj->frames[x].fb.luma_height = cam_obj->height >> cam_obj->luma.shift;
+            cam_obj->frames[x].fb.luma = (uint8_t *)heap_caps_malloc(cam_obj->frames[x].fb.luma_width * cam_obj->frames[x].fb.luma_height, _caps);
+            CAM_CHECK(cam_obj->frames[x].fb.luma != NULL, "luma plane malloc failed", ESP_FAIL);
         }
-        cam_obj->frames[x].en = 1;
+        if (cam_obj->stats_on) {
+            cam_obj->frames[x].fb.stats = (camera_frame_stats_t *)heap_caps_calloc(1, sizeof(camera_frame_stats_t), MALLOC_CAP_DEFAULT);
+            CAM_CHECK(cam_obj->frames[x].fb.stats != NULL, "frame stats malloc failed", ESP_FAIL);
+        }
+        cam_free_frame(x);
     }
 
-    if (!cam_obj->psram_mode) {
-        cam_obj->dma_buffer = (uint8_t *)heap_caps_malloc(cam_obj->dma_buffer_size * sizeof(uint8_t), MALLOC_CAP_DMA);
-        if(NULL == cam_obj->dma_buffer) {
-            ESP_LOGE(TAG,"%s(%d): DMA buffer %d Byte malloc failed, the current largest free block:%d Byte", __FUNCTION__, __LINE__,
-                     (int) cam_obj->dma_buffer_size, (int) heap_caps_get_largest_free_block(MALLOC_CAP_DMA));
-            return ESP_FAIL;
-        }
+    if (cam_obj->luma.shift) {
+        cam_obj->luma.acc = (uint16_t *)heap_caps_calloc(cam_obj->width >> cam_obj->luma.shift, sizeof(uint16_t), MALLOC_CAP_DEFAULT);
+        CAM_CHECK(cam_obj->luma.acc != NULL, "luma sums malloc failed", ESP_FAIL);
+    }
+
+    return cam_alloc_dma();
+}
+
+//Sample mode, geometry and receive sizes of a pixel format and frame size
+static esp_err_t cam_set_frame_mode(pixformat_t pixformat, framesize_t frame_size, uint32_t xclk_freq_hz, uint16_t sensor_pid)
+{
+    esp_err_t ret = ll_cam_set_sample_mode(cam_obj, pixformat, xclk_freq_hz, sensor_pid);
+    CAM_CHECK(ret == ESP_OK, "ll_cam_set_sample_mode failed", ret);
+    cam_obj->jpeg_mode = pixformat == PIXFORMAT_JPEG;
+    cam_obj->width = resolution[frame_size].width;
+    cam_obj->height = resolution[frame_size].height;
+    cam_stats_config(&cam_obj->stats, cam_obj->width, cam_obj->height, cam_obj->fb_bytes_per_pixel);
+
+    if(cam_obj->jpeg_mode){
+#ifdef CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_AUTO
+        cam_obj->recv_size = cam_obj->width * cam_obj->height / 5;
+#else
+        cam_obj->recv_size = CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE;
+#endif
+        cam_obj->fb_size = cam_obj->recv_size;
+    } else {
+        cam_obj->recv_size = cam_obj->width * cam_obj->height * cam_obj->in_bytes_per_pixel;
+        cam_obj->fb_size = cam_obj->width * cam_obj->height * cam_obj->fb_bytes_per_pixel;
+    }
+    //the sizes of adaptive buffers only hold for JPEG
+    cam_obj->jpeg_adaptive = cam_obj->jpeg_mode && cam_obj->jpeg_adaptive_req;
+    return ESP_OK;
+}
 
-        cam_obj->dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->dma_buffer);
-        CAM_CHECK(cam_obj->dma != NULL, "dma malloc failed", ESP_FAIL);
+static esp_err_t cam_create_task(void)
+{
+    size_t queue_size = cam_obj->dma_half_buffer_cnt - 1;
+    if (queue_size == 0) {
+        queue_size = 1;
+    }
+    cam_obj->event_queue = xQueueCreate(queue_size, sizeof(cam_event_t));
+    CAM_CHECK(cam_obj->event_queue != NULL, "event_queue create failed", ESP_FAIL);
+    if (cam_obj->task_handle) {
+        //paused by cam_reconfig
+        xSemaphoreGive(cam_obj->task_resume);
+        return ESP_OK;
     }
 
+#if CONFIG_CAMERA_CORE0
+    xTaskCreatePinnedToCore(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle, 0);
+#elif CONFIG_CAMERA_CORE1
+    xTaskCreatePinnedToCore(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle, 1);
+#else
+    xTaskCreate(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle);
+#endif
     return ESP_OK;
 }
 
@@ -361,59 +640,71 @@ esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint
     CAM_CHECK(NULL != config, "config pointer is invalid", ESP_ERR_INVALID_ARG);
     esp_err_t ret = ESP_OK;
 
-    ret = ll_cam_set_sample_mode(cam_obj, (pixformat_t)config->pixel_format, config->xclk_freq_hz, sensor_pid);
-    CAM_CHECK_GOTO(ret == ESP_OK, "ll_cam_set_sample_mode failed", err);
-    
-    cam_obj->jpeg_mode = config->pixel_format == PIXFORMAT_JPEG;
 #if CONFIG_IDF_TARGET_ESP32
     cam_obj->psram_mode = false;
 #else
     cam_obj->psram_mode = (config->xclk_freq_hz == 16000000);
 #endif
+    cam_obj->jpeg_adaptive_req = config->jpeg_adaptive;
+    if (cam_obj->jpeg_adaptive_req && cam_obj->psram_mode) {
+        //the DMA descriptors point into the frame buffers
+        ESP_LOGW(TAG, "no adaptive JPEG frame buffers in EDMA mode");
+        cam_obj->jpeg_adaptive_req = false;
+    }
+    ret = cam_set_frame_mode((pixformat_t)config->pixel_format, frame_size, config->xclk_freq_hz, sensor_pid);
+    CAM_CHECK_GOTO(ret == ESP_OK, "frame mode failed", err);
+
     cam_obj->frame_cnt = config->fb_count;
-    cam_obj->width = resolution[frame_size].width;
-    cam_obj->height = resolution[frame_size].height;
+    CAM_CHECK_GOTO(cam_obj->frame_cnt <= CAM_RING_MAX, "too many frame buffers", err);
+    //no frame buffers: rows only go to the line callback
+    cam_obj->rows_only = cam_obj->frame_cnt == 0;
+    if (cam_obj->rows_only) {
+        CAM_CHECK_GOTO(!cam_obj->jpeg_mode && !cam_obj->psram_mode, "no frame buffers in JPEG or EDMA mode", err);
+        cam_obj->frame_cnt = 1;
+    }
 
-    if(cam_obj->jpeg_mode){
-#ifdef CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_AUTO
-        cam_obj->recv_size = cam_obj->width * cam_obj->height / 5;
+    if (config->luma_scale) {
+#if CONFIG_IDF_TARGET_ESP32
+        //the plane is made by the DMA filter, four pixels at a time
+        CAM_CHECK_GOTO(config->pixel_format == PIXFORMAT_YUV422, "luma plane needs YUV422", err);
+        CAM_CHECK_GOTO(config->luma_scale == 4 || config->luma_scale == 8, "luma_scale must be 4 or 8", err);
+        CAM_CHECK_GOTO(cam_obj->width % config->luma_scale == 0 && cam_obj->height % config->luma_scale == 0,
+            "frame size is not a multiple of luma_scale", err);
+        cam_obj->luma.shift = config->luma_scale == 4 ? 2 : 3;
+        cam_obj->luma.width = cam_obj->width;
 #else
-        cam_obj->recv_size = CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE;
+        CAM_CHECK_GOTO(false, "luma plane is only made by the ESP32 DMA filters", err);
 #endif
-        cam_obj->fb_size = cam_obj->recv_size;
-    } else {
-        cam_obj->recv_size = cam_obj->width * cam_obj->height * cam_obj->in_bytes_per_pixel;
-        cam_obj->fb_size = cam_obj->width * cam_obj->height * cam_obj->fb_bytes_per_pixel;
+    }
+
+    if (config->frame_stats) {
+        //measured in the rows cam_task copies, EDMA writes the frame buffers itself
+        CAM_CHECK_GOTO(config->pixel_format == PIXFORMAT_YUV422 || config->pixel_format == PIXFORMAT_GRAYSCALE,
+            "frame stats need YUV422 or GRAYSCALE", err);
+        CAM_CHECK_GOTO(!cam_obj->psram_mode && !cam_obj->rows_only, "no frame stats in EDMA mode or without frame buffers", err);
+#if CONFIG_CAMERA_CONVERTER_ENABLED
+        CAM_CHECK_GOTO(config->conv_mode == CONV_DISABLE, "no frame stats with a conversion mode", err);
+#endif
+        cam_obj->stats_on = true;
     }
 
     ret = cam_dma_config(config);
     CAM_CHECK_GOTO(ret == ESP_OK, "cam_dma_config failed", err);
 
-    size_t queue_size = cam_obj->dma_half_buffer_cnt - 1;
-    if (queue_size == 0) {
-        queue_size = 1;
-    }
-    cam_obj->event_queue = xQueueCreate(queue_size, sizeof(cam_event_t));
-    CAM_CHECK_GOTO(cam_obj->event_queue != NULL, "event_queue create failed", err);
-
-    size_t frame_buffer_queue_len = cam_obj->frame_cnt;
-    if (config->grab_mode == CAMERA_GRAB_LATEST && cam_obj->frame_cnt > 1) {
-        frame_buffer_queue_len = cam_obj->frame_cnt - 1;
-    }
-    cam_obj->frame_buffer_queue = xQueueCreate(frame_buffer_queue_len, sizeof(camera_fb_t*));
-    CAM_CHECK_GOTO(cam_obj->frame_buffer_queue != NULL, "frame_buffer_queue create failed", err);
+    cam_obj->grab_mode = config->grab_mode;
+    cam_obj->warmup_frames = config->grab_warmup_frames;
+    cam_ring_init(&cam_obj->frame_ring, cam_obj->frame_cnt);
+    cam_obj->frame_ready = xSemaphoreCreateBinary();
+    CAM_CHECK_GOTO(cam_obj->frame_ready != NULL, "frame_ready create failed", err);
+    cam_obj->task_paused = xSemaphoreCreateBinary();
+    cam_obj->task_resume = xSemaphoreCreateBinary();
+    CAM_CHECK_GOTO(cam_obj->task_paused != NULL && cam_obj->task_resume != NULL, "task semaphores create failed", err);
 
     ret = ll_cam_init_isr(cam_obj);
     CAM_CHECK_GOTO(ret == ESP_OK, "cam intr alloc failed", err);
 
-
-#if CONFIG_CAMERA_CORE0
-    xTaskCreatePinnedToCore(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle, 0);
-#elif CONFIG_CAMERA_CORE1
-    xTaskCreatePinnedToCore(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle, 1);
-#else
-    xTaskCreate(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle);
-#endif
+    ret = cam_create_task();
+    CAM_CHECK_GOTO(ret == ESP_OK, "cam_task create failed", err);
 
     ESP_LOGI(TAG, "cam config ok");
     return ESP_OK;
@@ -423,6 +714,88 @@ err:
     return ESP_FAIL;
 }
 
+//cam_task finishes the event it is on and parks, it is not killed halfway. Frames not taken are dropped
+static void cam_park_task(void)
+{
+    cam_stop();
+    cam_event_t pause = CAM_PAUSE_EVENT;
+    xQueueReset(cam_obj->event_queue);
+    xQueueSend(cam_obj->event_queue, &pause, portMAX_DELAY);
+    xSemaphoreTake(cam_obj->task_paused, portMAX_DELAY);
+
+    uint8_t pos;
+    while (cam_ring_pop(&cam_obj->frame_ring, &pos)) {
+        cam_free_frame(pos);
+        cam_count_drop(cam_obj, CAM_DROP_OVERWRITTEN);
+    }
+    atomic_store(&cam_obj->armed, false);
+    atomic_store(&cam_obj->skip_frames, 0);
+}
+
+esp_err_t cam_reconfig(pixformat_t pixformat, framesize_t frame_size, uint32_t xclk_freq_hz, uint16_t sensor_pid)
+{
+    CAM_CHECK(cam_obj != NULL && cam_obj->task_handle != NULL, "camera is not configured", ESP_ERR_INVALID_STATE);
+    CAM_CHECK(!cam_obj->luma.shift, "no mode switch with a luma plane", ESP_ERR_NOT_SUPPORTED);
+    CAM_CHECK(!cam_obj->rows_only || pixformat != PIXFORMAT_JPEG, "no frame buffers in JPEG mode", ESP_ERR_NOT_SUPPORTED);
+    CAM_CHECK(!cam_obj->stats_on || pixformat == PIXFORMAT_YUV422 || pixformat == PIXFORMAT_GRAYSCALE,
+        "frame stats need YUV422 or GRAYSCALE", ESP_ERR_NOT_SUPPORTED);
+    CAM_CHECK(!cam_obj->suspended, "capture is suspended", ESP_ERR_INVALID_STATE);
+    CAM_CHECK(!atomic_load_explicit(&cam_obj->taken_mask, memory_order_relaxed), "frame buffers are still held", ESP_ERR_INVALID_STATE);
+
+    cam_park_task();
+    vQueueDelete(cam_obj->event_queue);
+    cam_obj->event_queue = NULL;
+
+    esp_err_t ret = cam_set_frame_mode(pixformat, frame_size, xclk_freq_hz, sensor_pid);
+    if (ret == ESP_OK) {
+        ret = cam_dma_sizes();
+    }
+    size_t fb_size;
+    uint8_t dma_align;
+    if (ret == ESP_OK) {
+        ret = cam_fb_alloc_size(&fb_size, &dma_align);
+    }
+    //buffers large enough for the new mode are kept
+    for (int x = 0; ret == ESP_OK && x < cam_obj->frame_cnt; x++) {
+        ret = cam_alloc_frame(x, fb_size, dma_align);
+    }
+    if (ret == ESP_OK) {
+        ret = cam_alloc_dma();
+    }
+    if (ret == ESP_OK) {
+        ret = cam_create_task();
+    }
+    if (ret != ESP_OK) {
+        //cam_task stays parked, only cam_deinit is left
+        ESP_LOGE(TAG, "switching to %dx%d failed", cam_obj->width, cam_obj->height);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "cam reconfig ok: %dx%d", cam_obj->width, cam_obj->height);
+    return ESP_OK;
+}
+
+esp_err_t cam_suspend(void)
+{
+    CAM_CHECK(cam_obj != NULL && cam_obj->task_handle != NULL, "camera is not configured", ESP_ERR_INVALID_STATE);
+    if (cam_obj->suspended) {
+        return ESP_OK;
+    }
+    cam_park_task();
+    cam_obj->suspended = true;
+    return ESP_OK;
+}
+
+esp_err_t cam_resume(void)
+{
+    CAM_CHECK(cam_obj != NULL && cam_obj->suspended, "capture is not suspended", ESP_ERR_INVALID_STATE);
+    //the queue, DMA plan and frame buffers are the ones cam_task parked with
+    cam_obj->suspended = false;
+    xQueueReset(cam_obj->event_queue);
+    xSemaphoreGive(cam_obj->task_resume);
+    cam_start();
+    return ESP_OK;
+}
+
 esp_err_t cam_deinit(void)
 {
     if (!cam_obj) {
@@ -436,8 +809,14 @@ esp_err_t cam_deinit(void)
     if (cam_obj->event_queue) {
         vQueueDelete(cam_obj->event_queue);
     }
-    if (cam_obj->frame_buffer_queue) {
-        vQueueDelete(cam_obj->frame_buffer_queue);
+    if (cam_obj->frame_ready) {
+        vSemaphoreDelete(cam_obj->frame_ready);
+    }
+    if (cam_obj->task_paused) {
+        vSemaphoreDelete(cam_obj->task_paused);
+    }
+    if (cam_obj->task_resume) {
+        vSemaphoreDelete(cam_obj->task_resume);
     }
 
     ll_cam_deinit(cam_obj);
@@ -448,9 +827,18 @@ esp_err_t cam_deinit(void)
     if (cam_obj->dma_buffer) {
         free(cam_obj->dma_buffer);
     }
+    if (cam_obj->luma.acc) {
+        free(cam_obj->luma.acc);
+    }
     if (cam_obj->frames) {
         for (int x = 0; x < cam_obj->frame_cnt; x++) {
             free(cam_obj->frames[x].fb.buf - cam_obj->frames[x].fb_offset);
+            if (cam_obj->frames[x].fb.luma) {
+                free(cam_obj->frames[x].fb.luma);
+            }
+            if (cam_obj->frames[x].fb.stats) {
+                free(cam_obj->frames[x].fb.stats);
+            }
             if (cam_obj->frames[x].dma) {
                 free(cam_obj->frames[x].dma);
             }
@@ -471,47 +859,97 @@ void cam_stop(void)
 
 void cam_start(void)
 {
-    ll_cam_vsync_intr_enable(cam_obj, true);
+    //on demand capture is started by cam_take
+    if (cam_obj->grab_mode != CAMERA_GRAB_ON_DEMAND) {
+        ll_cam_vsync_intr_enable(cam_obj, true);
+    }
+}
+
+//Pop the oldest filled frame, or in grab latest mode the newest one and free the rest
+static bool cam_pop_frame(int *frame_pos)
+{
+    uint8_t pos, newer;
+    if (!cam_ring_pop(&cam_obj->frame_ring, &pos)) {
+        return false;
+    }
+    if (cam_obj->grab_mode == CAMERA_GRAB_LATEST) {
+        while (cam_ring_pop(&cam_obj->frame_ring, &newer)) {
+            cam_free_frame(pos);
+            cam_count_drop(cam_obj, CAM_DROP_OVERWRITTEN);
+            pos = newer;
+        }
+    }
+    atomic_store_explicit(&cam_obj->frames[pos].refs, 1, memory_order_relaxed);
+    atomic_fetch_or_explicit(&cam_obj->taken_mask, 1u << pos, memory_order_relaxed);
+    *frame_pos = pos;
+    return true;
+}
+
+static bool cam_wait_frame(int *frame_pos, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (!cam_pop_frame(frame_pos)) {
+        TickType_t ticks_spent = xTaskGetTickCount() - start;
+        if (ticks_spent >= timeout || xSemaphoreTake(cam_obj->frame_ready, timeout - ticks_spent) != pdTRUE) {
+            return cam_pop_frame(frame_pos);
+        }
+    }
+    return true;
+}
+
+//Drop frames left from an earlier request and start capturing, warm-up frames first
+static void cam_arm_capture(void)
+{
+    uint8_t pos;
+    while (cam_ring_pop(&cam_obj->frame_ring, &pos)) {
+        cam_free_frame(pos);
+        cam_count_drop(cam_obj, CAM_DROP_OVERWRITTEN);
+    }
+    //a capture still running from a request that timed out is used as it is
+    //only cam_take arms, the warm-up count is published before cam_task can see armed
+    if (!atomic_load(&cam_obj->armed)) {
+        atomic_store(&cam_obj->skip_frames, cam_obj->warmup_frames);
+        atomic_store(&cam_obj->armed, true);
+        ll_cam_vsync_intr_enable(cam_obj, true);
+    }
 }
 
 camera_fb_t *cam_take(TickType_t timeout)
 {
     camera_fb_t *dma_buffer = NULL;
-    TickType_t start = xTaskGetTickCount();
-    xQueueReceive(cam_obj->frame_buffer_queue, (void *)&dma_buffer, timeout);
+    int frame_pos;
+    if (cam_obj->rows_only) {
+        ESP_LOGW(TAG, "No frame buffers, rows only go to the line callback");
+        return NULL;
+    }
+    if (cam_obj->grab_mode == CAMERA_GRAB_ON_DEMAND) {
+        cam_arm_capture();
+    }
+    bool ok = cam_wait_frame(&frame_pos, timeout);
 #if CONFIG_IDF_TARGET_ESP32S3
     // Currently (22.01.2024) there is a bug in ESP-IDF v5.2, that causes
     // GDMA to fall into a strange state if it is running while WiFi STA is connecting.
     // This code tries to reset GDMA if frame is not received, to try and help with
     // this case. It is possible to have some side effects too, though none come to mind
-    if (!dma_buffer) {
+    if (!ok) {
         ll_cam_dma_reset(cam_obj);
-        xQueueReceive(cam_obj->frame_buffer_queue, (void *)&dma_buffer, timeout);
+        ok = cam_wait_frame(&frame_pos, timeout);
     }
 #endif
-    if (dma_buffer) {
-        if(cam_obj->jpeg_mode){
-            // find the end marker for JPEG. Data after that can be discarded
-            int offset_e = cam_verify_jpeg_eoi(dma_buffer->buf, dma_buffer->len);
-            if (offset_e >= 0) {
-                // adjust buffer length
-                dma_buffer->len = offset_e + sizeof(JPEG_EOI_MARKER);
-                return dma_buffer;
-            } else {
-                ESP_LOGW(TAG, "NO-EOI");
-                cam_give(dma_buffer);
-                TickType_t ticks_spent = xTaskGetTickCount() - start;
-                if (ticks_spent >= timeout) {
-                    return NULL; /* We are out of time */
-                }
-                return cam_take(timeout - ticks_spent);//recurse!!!!
-            }
-        } else if(cam_obj->psram_mode && cam_obj->in_bytes_per_pixel != cam_obj->fb_bytes_per_pixel){
+    if (ok) {
+        dma_buffer = cam_frame_fb(frame_pos);
+        uint32_t dropped = cam_dropped_total();
+        dma_buffer->meta.dropped = dropped - atomic_exchange_explicit(&cam_obj->dropped_seen, dropped, memory_order_relaxed);
+        uint64_t start_us = (uint64_t)dma_buffer->timestamp.tv_sec * 1000000UL + dma_buffer->timestamp.tv_usec;
+        dma_buffer->meta.latency_us = (uint64_t)esp_timer_get_time() - start_us;
+        //JPEG frames are queued with their exact length, found by cam_task
+        if(!cam_obj->jpeg_mode && cam_obj->psram_mode && cam_obj->in_bytes_per_pixel != cam_obj->fb_bytes_per_pixel){
             //currently this is used only for YUV to GRAYSCALE
             dma_buffer->len = ll_cam_memcpy(cam_obj, dma_buffer->buf, dma_buffer->buf, dma_buffer->len);
         }
         return dma_buffer;
     } else {
+        cam_count_drop(cam_obj, CAM_DROP_TIMEOUT);
         ESP_LOGW(TAG, "Failed to get the frame on time!");
 // #if CONFIG_IDF_TARGET_ESP32S3
 //         ll_cam_dma_print_state(cam_obj);
@@ -520,18 +958,74 @@ camera_fb_t *cam_take(TickType_t timeout)
     return NULL;
 }
 
+void cam_retain(camera_fb_t *dma_buffer)
+{
+    int frame_pos = cam_frame_pos(dma_buffer);
+    if (frame_pos < 0 || frame_pos >= cam_obj->frame_cnt) {
+        return;
+    }
+    atomic_fetch_add_explicit(&cam_obj->frames[frame_pos].refs, 1, memory_order_relaxed);
+}
+
 void cam_give(camera_fb_t *dma_buffer)
 {
-    for (int x = 0; x < cam_obj->frame_cnt; x++) {
-        if (&cam_obj->frames[x].fb == dma_buffer) {
-            cam_obj->frames[x].en = 1;
-            break;
+    int frame_pos = cam_frame_pos(dma_buffer);
+    if (frame_pos < 0 || frame_pos >= cam_obj->frame_cnt) {
+        return;
+    }
+    //ignore a frame that was already given back
+    _Atomic uint32_t *refs = &cam_obj->frames[frame_pos].refs;
+    uint32_t n = atomic_load_explicit(refs, memory_order_relaxed);
+    do {
+        if (!n) {
+            return;
         }
+    } while (!atomic_compare_exchange_weak_explicit(refs, &n, n - 1, memory_order_acq_rel, memory_order_relaxed));
+    //the last reference frees the frame
+    if (n == 1) {
+        atomic_fetch_and_explicit(&cam_obj->taken_mask, ~(1u << frame_pos), memory_order_relaxed);
+        cam_free_frame(frame_pos);
     }
 }
 
 void cam_give_all(void) {
+    uint32_t taken = atomic_exchange_explicit(&cam_obj->taken_mask, 0, memory_order_relaxed);
     for (int x = 0; x < cam_obj->frame_cnt; x++) {
-        cam_obj->frames[x].en = 1;
+        if (taken & (1u << x)) {
+            atomic_store_explicit(&cam_obj->frames[x].refs, 0, memory_order_relaxed);
+        }
+    }
+    atomic_fetch_or_explicit(&cam_obj->free_mask, taken, memory_order_release);
+}
+
+uint32_t cam_get_starved_count(void)
+{
+    return atomic_load_explicit(&cam_obj->drops[CAM_DROP_STARVED], memory_order_relaxed);
+}
+
+void cam_get_drop_stats(camera_drop_stats_t *stats)
+{
+    uint32_t drops[CAM_DROP_MAX];
+    for (int i = 0; i < CAM_DROP_MAX; i++) {
+        drops[i] = atomic_load_explicit(&cam_obj->drops[i], memory_order_relaxed);
+    }
+    stats->fb_overflow = drops[CAM_DROP_FB_OVERFLOW];
+    stats->no_soi = drops[CAM_DROP_NO_SOI];
+    stats->no_eoi = drops[CAM_DROP_NO_EOI];
+    stats->bad_size = drops[CAM_DROP_BAD_SIZE];
+    stats->event_overflow = drops[CAM_DROP_EVENT_OVERFLOW];
+    stats->starved = drops[CAM_DROP_STARVED];
+    stats->overwritten = drops[CAM_DROP_OVERWRITTEN];
+    stats->timeout = drops[CAM_DROP_TIMEOUT];
+}
+
+esp_err_t cam_set_line_callback(camera_line_cb_t cb, void *arg)
+{
+    //rows only exist where cam_task copies them out of the DMA buffer
+    if (cam_obj->jpeg_mode || cam_obj->psram_mode) {
+        return ESP_ERR_NOT_SUPPORTED;
     }
+    cam_obj->line_cb_arg = arg;
+    cam_obj->line_cb = cb;
+    return ESP_OK;
 }
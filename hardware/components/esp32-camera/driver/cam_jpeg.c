@@ -0,0 +1,155 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * JPEG marker search for the copies of cam_task.
+ *
+ */
+#include <string.h>
+#include "cam_jpeg.h"
+
+size_t cam_jpeg_find_ff(const uint8_t *buf, size_t len)
+{
+    size_t i = 0;
+    while (i < len && ((uintptr_t)(buf + i) & 3)) {
+        if (buf[i] == 0xFF) {
+            return i;
+        }
+        i++;
+    }
+    // a byte of w is 0xFF when the same byte of ~w is zero
+    for (; i + 4 <= len; i += 4) {
+        uint32_t w;
+        memcpy(&w, buf + i, 4);
+        if ((~w - 0x01010101u) & w & 0x80808080u) {
+            break;
+        }
+    }
+    while (i < len && buf[i] != 0xFF) {
+        i++;
+    }
+    return i;
+}
+
+int cam_jpeg_find_soi(const uint8_t *buf, size_t len)
+{
+    size_t i = 0;
+    while (len >= 3 && i <= len - 3) {
+        i += cam_jpeg_find_ff(buf + i, len - 2 - i);
+        if (i > len - 3) {
+            break;
+        }
+        if (buf[i + 1] == 0xD8 && buf[i + 2] == 0xFF) {
+            return i;
+        }
+        i++;
+    }
+    return -1;
+}
+
+int cam_jpeg_find_eoi(const uint8_t *buf, size_t from, size_t len)
+{
+    if (len < 2) {
+        return -1;
+    }
+    // every position i < last can be followed by a D9
+    size_t i = from, last = len - 1;
+    while (i < last && ((uintptr_t)(buf + i) & 3)) {
+        if (buf[i] == 0xFF && buf[i + 1] == 0xD9) {
+            return i;
+        }
+        i++;
+    }
+    // stuffed 0xFF are common in entropy coded data, check the lanes here instead of
+    // returning to the caller for each one
+    for (; i + 4 <= last; i += 4) {
+        uint32_t w;
+        memcpy(&w, buf + i, 4);
+        if ((~w - 0x01010101u) & w & 0x80808080u) {
+            for (size_t k = i; k < i + 4; k++) {
+                if (buf[k] == 0xFF && buf[k + 1] == 0xD9) {
+                    return k;
+                }
+            }
+        }
+    }
+    for (; i < last; i++) {
+        if (buf[i] == 0xFF && buf[i + 1] == 0xD9) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void cam_jpeg_sizer_init(cam_jpeg_sizer_t *sizer, size_t chunk, size_t max)
+{
+    memset(sizer, 0, sizeof(cam_jpeg_sizer_t));
+    sizer->chunk = chunk ? chunk : 1;
+    sizer->max = max;
+}
+
+void cam_jpeg_sizer_add(cam_jpeg_sizer_t *sizer, size_t len)
+{
+    uint32_t v = len;
+    size_t n = sizer->count;
+    if (n == CAM_JPEG_SIZE_HISTORY) {
+        //drop the oldest size from the sorted copy
+        uint32_t old = sizer->recent[sizer->pos];
+        size_t i = 0;
+        while (sizer->sorted[i] != old) {
+            i++;
+        }
+        memmove(&sizer->sorted[i], &sizer->sorted[i + 1], (n - 1 - i) * sizeof(uint32_t));
+        n--;
+    } else {
+        sizer->count++;
+    }
+    if (sizer->floor_frames && --sizer->floor_frames == 0) {
+        sizer->floor = 0;
+    }
+    sizer->recent[sizer->pos] = v;
+    sizer->pos = (sizer->pos + 1) % CAM_JPEG_SIZE_HISTORY;
+    size_t i = n;
+    while (i && sizer->sorted[i - 1] > v) {
+        sizer->sorted[i] = sizer->sorted[i - 1];
+        i--;
+    }
+    sizer->sorted[i] = v;
+}
+
+void cam_jpeg_sizer_overflow(cam_jpeg_sizer_t *sizer, size_t size)
+{
+    size_t len = size * 2 < sizer->max ? size * 2 : sizer->max;
+    sizer->overflows++;
+    cam_jpeg_sizer_add(sizer, len);
+    //the percentile leaves out a single large frame, the floor does not
+    sizer->floor = len;
+    sizer->floor_frames = CAM_JPEG_OVERFLOW_HOLD;
+}
+
+size_t cam_jpeg_sizer_target(const cam_jpeg_sizer_t *sizer)
+{
+    if (!sizer->count) {
+        return 0;
+    }
+    //95th percentile: the top size of every 20 in the history is left out
+    size_t len = sizer->sorted[sizer->count - 1 - sizer->count / 20];
+    len += len / CAM_JPEG_SIZE_MARGIN;
+    //every copy needs room for a whole DMA chunk
+    len = (len + sizer->chunk - 1) / sizer->chunk * sizer->chunk;
+    len = len > sizer->floor ? len : sizer->floor;
+    return len < sizer->max ? len : sizer->max;
+}
+
+bool cam_jpeg_sizer_resize(const cam_jpeg_sizer_t *sizer, size_t size, size_t *new_size)
+{
+    size_t target = cam_jpeg_sizer_target(sizer);
+    if (!target || target == size) {
+        return false;
+    }
+    if (target < size && target >= size - size / 4) {
+        return false;
+    }
+    *new_size = target;
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Lock-free ring of frame indices between cam_task and cam_take.
+ *
+ */
+#include "cam_ring.h"
+
+void cam_ring_init(cam_ring_t *ring, uint32_t size)
+{
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    ring->size = size > CAM_RING_MAX ? CAM_RING_MAX : size;
+}
+
+bool cam_ring_push(cam_ring_t *ring, uint8_t value)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= ring->size) {
+        return false;
+    }
+    atomic_store_explicit(&ring->slots[tail % CAM_RING_MAX], value, memory_order_relaxed);
+    // publishes the slot and everything written to the frame before it
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool cam_ring_pop(cam_ring_t *ring, uint8_t *value)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    while (head != atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+        // the slot can only be rewritten after head moved past it, then the exchange fails
+        uint8_t v = atomic_load_explicit(&ring->slots[head % CAM_RING_MAX], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &head, head + 1,
+                memory_order_acq_rel, memory_order_acquire)) {
+            *value = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t cam_ring_count(cam_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) - head;
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Luma statistics of a frame, measured while cam_task copies it.
+ *
+ */
+#include <string.h>
+#include "cam_stats.h"
+
+void cam_stats_config(cam_stats_t *stats, uint16_t width, uint16_t height, uint8_t bytes_per_pixel)
+{
+    stats->width = width;
+    stats->height = height;
+    stats->bytes_per_pixel = bytes_per_pixel;
+    for (int i = 0; i <= CAMERA_STATS_GRID; i++) {
+        stats->tile_x[i] = (uint32_t)i * width / CAMERA_STATS_GRID;
+        stats->tile_y[i] = (uint32_t)i * height / CAMERA_STATS_GRID;
+    }
+}
+
+void cam_stats_start(cam_stats_t *stats, camera_frame_stats_t *out)
+{
+    stats->out = out;
+    stats->y = 0;
+    stats->tile_row = 0;
+    stats->grad = 0;
+    memset(stats->tile_sum, 0, sizeof(stats->tile_sum));
+    if (out) {
+        memset(out, 0, sizeof(*out));
+    }
+}
+
+/*
+ * One row. The first pixel of a row has no left neighbour and the first row no
+ * row above, they count as the same value, so the loop has no edge cases. step
+ * is a constant in each caller, the compiler makes a loop for either format.
+ */
+static inline void stats_row(cam_stats_t *stats, const uint8_t *row, const uint8_t *above, const int step)
+{
+    uint32_t *hist = stats->out->hist;
+    uint32_t *tile_sum = &stats->tile_sum[stats->tile_row * CAMERA_STATS_GRID];
+    uint32_t grad = 0;
+    uint8_t left = row[0];
+    uint16_t x = 0;
+    for (int t = 0; t < CAMERA_STATS_GRID; t++) {
+        uint32_t sum = 0;
+        for (uint16_t end = stats->tile_x[t + 1]; x < end; x++) {
+            uint8_t v = row[x * step];
+            int dx = v - left;
+            int dy = v - above[x * step];
+            hist[v >> 2]++;
+            sum += v;
+            grad += dx * dx + dy * dy;
+            left = v;
+        }
+        tile_sum[t] += sum;
+    }
+    // at most 2 * 255^2 per pixel, a row of 2592 pixels still fits 32 bits
+    stats->grad += grad;
+}
+
+void cam_stats_add(cam_stats_t *stats, const uint8_t *frame, size_t len)
+{
+    if (!stats->out) {
+        return;
+    }
+    size_t row_bytes = (size_t)stats->width * stats->bytes_per_pixel;
+    size_t rows = len / row_bytes;
+    if (rows > stats->height) {
+        rows = stats->height;
+    }
+    for (; stats->y < rows; stats->y++) {
+        const uint8_t *row = frame + stats->y * row_bytes;
+        const uint8_t *above = stats->y ? row - row_bytes : row;
+        while (stats->y >= stats->tile_y[stats->tile_row + 1]) {
+            stats->tile_row++;
+        }
+        if (stats->bytes_per_pixel == 2) {
+            stats_row(stats, row, above, 2);
+        } else {
+            stats_row(stats, row, above, 1);
+        }
+    }
+}
+
+void cam_stats_finish(cam_stats_t *stats)
+{
+    camera_frame_stats_t *out = stats->out;
+    if (!out) {
+        return;
+    }
+    uint32_t sum = 0;
+    for (int r = 0; r < CAMERA_STATS_GRID; r++) {
+        uint32_t rows = stats->tile_y[r + 1] - stats->tile_y[r];
+        for (int t = 0; t < CAMERA_STATS_GRID; t++) {
+            uint32_t n = rows * (stats->tile_x[t + 1] - stats->tile_x[t]);
+            uint32_t s = stats->tile_sum[r * CAMERA_STATS_GRID + t];
+            out->tiles[r * CAMERA_STATS_GRID + t] = n ? (s + n / 2) / n : 0;
+            sum += s;
+        }
+    }
+    out->count = (uint32_t)stats->y * stats->width;
+    if (out->count) {
+        out->mean = (sum + out->count / 2) / out->count;
+        out->sharpness = stats->grad / out->count;
+    }
+}
@@ -0,0 +1,304 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Software auto exposure from the luma of the frames.
+ *
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera_ae.h"
+#include "esp_jpg_decode.h"
+#include "fmt_row.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char *TAG = "camera_ae";
+#endif
+
+#define AE_SAMPLES      4096        // pixels sampled from an uncompressed frame, about
+#define AE_GAMMA        2.2f        // the sensors put out about linear light ^ (1 / 2.2)
+#define AE_STEP_MAX     8.0f        // most the exposure changes by in one step
+#define AE_AEC_MAX      1200        // OV2640 exposure range, in lines
+#define AE_AGC_MAX      30          // OV2640 gain range, 1x to 31x
+#define AE_AGC_MAX_OV3660 64        // OV3660 and OV5640 gain range, up to about 64x
+
+static void hist_add(camera_luma_hist_t *hist, const uint8_t *luma, size_t n, uint32_t *sum)
+{
+    for (size_t i = 0; i < n; i++) {
+        hist->bins[luma[i] >> 2]++;
+        *sum += luma[i];
+    }
+    hist->count += n;
+}
+
+static void hist_finish(camera_luma_hist_t *hist, uint32_t sum)
+{
+    hist->mean = hist->count ? (sum + hist->count / 2) / hist->count : 0;
+}
+
+// every step-th pixel of every step-th row, step even so YUV422 pairs stay whole
+static esp_err_t hist_raw(const camera_fb_t *fb, camera_luma_hist_t *hist)
+{
+    fmt_row_t fmt = fmt_row_from_pixformat(fb->format);
+    fmt_row_cb to_luma = fmt_row_get(fmt, FMT_ROW_GRAYSCALE);
+    if (!to_luma) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    size_t bpp = fmt_row_bpp(fmt);
+    if (fb->len < fb->width * fb->height * bpp) {
+        return ESP_FAIL;
+    }
+    size_t step = 2;
+    while ((fb->width / step) * (fb->height / step) > AE_SAMPLES) {
+        step += 2;
+    }
+    uint32_t sum = 0;
+    uint8_t luma[2];
+    for (size_t y = step / 2; y < fb->height; y += step) {
+        const uint8_t *row = fb->buf + y * fb->width * bpp;
+        for (size_t x = (step / 2) & ~1; x + 1 < fb->width; x += step) {
+            to_luma(row + x * bpp, luma, 2);
+            hist_add(hist, luma, 1, &sum);
+        }
+    }
+    hist_finish(hist, sum);
+    return ESP_OK;
+}
+
+typedef struct {
+    const camera_fb_t *fb;
+    camera_luma_hist_t *hist;
+    fmt_row_cb to_luma;
+    uint32_t sum;
+} jpeg_hist_t;
+
+static size_t jpeg_read(void *arg, size_t index, uint8_t *buf, size_t len)
+{
+    jpeg_hist_t *jpeg = arg;
+    if (buf) {
+        memcpy(buf, jpeg->fb->buf + index, len);
+    }
+    return len;
+}
+
+static bool jpeg_write(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    jpeg_hist_t *jpeg = arg;
+    uint8_t luma[32];
+    if (!data) {
+        return true;
+    }
+    for (uint16_t row = 0; row < h; row++) {
+        for (uint16_t i = 0; i < w; i += sizeof(luma)) {
+            size_t n = w - i < sizeof(luma) ? w - i : sizeof(luma);
+            jpeg->to_luma(data + i * 3, luma, n);
+            hist_add(jpeg->hist, luma, n, &jpeg->sum);
+        }
+        data += w * 3;
+    }
+    return true;
+}
+
+// the DC coefficients are all an eighth scale decode needs, no IDCT
+static esp_err_t hist_jpeg(const camera_fb_t *fb, camera_luma_hist_t *hist)
+{
+    jpeg_hist_t jpeg = {
+        .fb = fb,
+        .hist = hist,
+        .to_luma = fmt_row_get(FMT_ROW_RGB888, FMT_ROW_GRAYSCALE),
+    };
+    if (esp_jpg_decode(fb->len, JPG_SCALE_8X, jpeg_read, jpeg_write, &jpeg) != ESP_OK) {
+        ESP_LOGW(TAG, "JPEG frame could not be decoded");
+        return ESP_FAIL;
+    }
+    hist_finish(hist, jpeg.sum);
+    return ESP_OK;
+}
+
+esp_err_t camera_luma_histogram(const camera_fb_t *fb, camera_luma_hist_t *hist)
+{
+    if (!fb || !hist) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(hist, 0, sizeof(*hist));
+    if (fb->stats) {
+        memcpy(hist->bins, fb->stats->hist, sizeof(hist->bins));
+        hist->count = fb->stats->count;
+        hist->mean = fb->stats->mean;
+        return ESP_OK;
+    }
+    if (fb->luma) {
+        uint32_t sum = 0;
+        hist_add(hist, fb->luma, fb->luma_width * fb->luma_height, &sum);
+        hist_finish(hist, sum);
+        return ESP_OK;
+    }
+    if (fb->format == PIXFORMAT_JPEG) {
+        return hist_jpeg(fb, hist);
+    }
+    return hist_raw(fb, hist);
+}
+
+// gain of an agc_gain setting: agc_gain + 1 times on the OV2640, about as much on OV3660 and OV5640
+static float gain_factor(int agc_gain)
+{
+    return agc_gain + 1.0f;
+}
+
+static int clamp(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// writes what changed, or both settings if forced
+static esp_err_t ae_apply(camera_ae_t *ae, sensor_t *s, int aec_value, int agc_gain, bool force)
+{
+    if (((force || aec_value != ae->aec_value) && s->set_aec_value(s, aec_value))
+        || ((force || agc_gain != ae->agc_gain) && s->set_agc_gain(s, agc_gain))) {
+        ESP_LOGE(TAG, "Could not set exposure %d gain %d", aec_value, agc_gain);
+        return ESP_FAIL;
+    }
+    // a sensor that clamps the exposure to its frame length has less range than configured
+    if (s->status.aec_value < aec_value) {
+        ae->config.aec_max = s->status.aec_value > 0 ? s->status.aec_value : 1;
+        aec_value = ae->config.aec_max;
+    }
+    ae->aec_value = aec_value;
+    ae->agc_gain = agc_gain;
+    ae->skip = ae->config.latency;
+    return ESP_OK;
+}
+
+esp_err_t camera_ae_init(camera_ae_t *ae, sensor_t *s, const camera_ae_config_t *config)
+{
+    static const camera_ae_config_t defaults = CAMERA_AE_CONFIG_DEFAULT();
+    if (!ae || !s) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!config) {
+        config = &defaults;
+    }
+    if (config->target == 0 || config->tolerance >= config->target || config->target + config->tolerance > 255
+        || config->stable_frames == 0 || config->damping == 0 || config->damping > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s->set_aec_value || !s->set_agc_gain || !s->set_exposure_ctrl || !s->set_gain_ctrl) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    memset(ae, 0, sizeof(*ae));
+    ae->config = *config;
+    if (!ae->config.aec_max) {
+        ae->config.aec_max = AE_AEC_MAX;
+    }
+    if (!ae->config.agc_max) {
+        bool wide = s->id.PID == OV3660_PID || s->id.PID == OV5640_PID;
+        ae->config.agc_max = wide ? AE_AGC_MAX_OV3660 : AE_AGC_MAX;
+    }
+    if (s->set_exposure_ctrl(s, 0) || s->set_gain_ctrl(s, 0)) {
+        ESP_LOGE(TAG, "Could not switch to manual exposure");
+        return ESP_FAIL;
+    }
+    // the manual registers may hold anything, start from the settings the sensor reports
+    return ae_apply(ae, s, clamp(s->status.aec_value, 1, ae->config.aec_max),
+                    clamp(s->status.agc_gain, 0, ae->config.agc_max), true);
+}
+
+esp_err_t camera_ae_update(camera_ae_t *ae, sensor_t *s, const camera_fb_t *fb)
+{
+    if (!ae || !s || !fb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ae->skip) {
+        ae->skip--;
+        return ESP_OK;
+    }
+    camera_luma_hist_t hist;
+    esp_err_t err = camera_luma_histogram(fb, &hist);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ae->mean = hist.mean;
+    const camera_ae_config_t *c = &ae->config;
+    if (abs((int)hist.mean - c->target) <= c->tolerance) {
+        if (ae->exposed < c->stable_frames) {
+            ae->exposed++;
+        }
+        ae->state = ae->exposed >= c->stable_frames ? CAMERA_AE_CONVERGED : CAMERA_AE_SEARCHING;
+        return ESP_OK;
+    }
+    ae->exposed = 0;
+
+    // the error in linear light, damped and capped so a clipped frame does not throw it too far
+    float ratio = (float)c->target / (hist.mean ? hist.mean : 1);
+    float step = powf(ratio, AE_GAMMA * c->damping / 100.0f);
+    step = fminf(fmaxf(step, 1.0f / AE_STEP_MAX), AE_STEP_MAX);
+    // with most of the frame black or white the mean says little about how far off it is
+    if (hist.bins[0] > hist.count / 2) {
+        step = AE_STEP_MAX;
+    } else if (hist.bins[CAMERA_AE_BINS - 1] > hist.count / 2) {
+        step = 1.0f / AE_STEP_MAX;
+    }
+    float exposure = ae->aec_value * gain_factor(ae->agc_gain) * step;
+
+    // the least gain that reaches the exposure, the exposure time makes up for its coarse steps
+    int agc_gain = 0;
+    while (agc_gain < c->agc_max && exposure > c->aec_max * gain_factor(agc_gain)) {
+        agc_gain++;
+    }
+    int aec_value = clamp(lroundf(exposure / gain_factor(agc_gain)), 1, c->aec_max);
+    if (aec_value == ae->aec_value && agc_gain == ae->agc_gain) {
+        // less than a step from here, or no more range
+        bool darker = hist.mean > c->target;
+        bool at_limit = darker ? (aec_value == 1 && agc_gain == 0) : (aec_value == c->aec_max && agc_gain == c->agc_max);
+        if (at_limit) {
+            ae->state = CAMERA_AE_LIMITED;
+            return ESP_OK;
+        }
+        if (!darker && aec_value == c->aec_max) {
+            agc_gain++;
+        } else {
+            aec_value += darker ? -1 : 1;
+        }
+    }
+    ae->state = CAMERA_AE_SEARCHING;
+    ae->steps++;
+    ESP_LOGD(TAG, "mean %u: exposure %d gain %d", hist.mean, aec_value, agc_gain);
+    return ae_apply(ae, s, aec_value, agc_gain, false);
+}
+
+esp_err_t camera_ae_capture(camera_ae_t *ae, uint8_t max_frames, camera_fb_t **fb)
+{
+    if (fb) {
+        *fb = NULL;
+    }
+    if (!ae || !fb || !max_frames) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sensor_t *s = esp_camera_sensor_get();
+    for (uint8_t i = 0; i < max_frames; i++) {
+        camera_fb_t *frame = esp_camera_fb_get();
+        if (!frame) {
+            return ESP_FAIL;
+        }
+        esp_err_t err = camera_ae_update(ae, s, frame);
+        if (err != ESP_OK) {
+            esp_camera_fb_return(frame);
+            return err;
+        }
+        // the last frame is handed out as it is, ae->state still says searching
+        if (ae->state != CAMERA_AE_SEARCHING || i + 1 == max_frames) {
+            if (ae->state == CAMERA_AE_SEARCHING) {
+                ESP_LOGW(TAG, "Exposure not stable after %u frames, mean luma %u", max_frames, ae->mean);
+            }
+            *fb = frame;
+            return ESP_OK;
+        }
+        esp_camera_fb_return(frame);
+    }
+    return ESP_FAIL;
+}
@@ -0,0 +1,437 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Best of a burst, by sharpness.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "camera_burst.h"
+#include "fmt_row.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char *TAG = "camera_burst";
+#endif
+
+#define SHARP_SAMPLES   16384       // pixels sampled from an uncompressed frame, about
+
+// every step-th pixel of every step-th row and its neighbours, step even so YUV422 pairs stay whole
+static esp_err_t sharpness_raw(const camera_fb_t *fb, uint32_t *score)
+{
+    fmt_row_t fmt = fmt_row_from_pixformat(fb->format);
+    fmt_row_cb to_luma = fmt_row_get(fmt, FMT_ROW_GRAYSCALE);
+    if (!to_luma) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    size_t bpp = fmt_row_bpp(fmt);
+    size_t stride = fb->width * bpp;
+    if (fb->width < 2 || fb->height < 2 || fb->len < stride * fb->height) {
+        return ESP_FAIL;
+    }
+    size_t step = 2;
+    while ((fb->width / step) * (fb->height / step) > SHARP_SAMPLES) {
+        step += 2;
+    }
+    uint64_t sum = 0;
+    uint32_t n = 0;
+    uint8_t luma[2], below[2];
+    for (size_t y = step / 2; y + 1 < fb->height; y += step) {
+        const uint8_t *row = fb->buf + y * stride;
+        for (size_t x = (step / 2) & ~1; x + 1 < fb->width; x += step) {
+            to_luma(row + x * bpp, luma, 2);
+            to_luma(row + stride + x * bpp, below, 2);
+            int dx = luma[1] - luma[0];
+            int dy = below[0] - luma[0];
+            sum += dx * dx + dy * dy;
+            n++;
+        }
+    }
+    *score = n ? sum / n : 0;
+    return ESP_OK;
+}
+
+/*
+ * Baseline JPEG, entropy decoded only. A DCT coefficient F(u, v) adds about
+ * F^2 * 4 * (sin^2(u pi / 16) + sin^2(v pi / 16)) / 64 to the mean squared
+ * difference between neighbouring pixels of its block, the weights below are
+ * 256 times that factor, in zigzag order. The score is then in the units of
+ * sharpness_raw() without an IDCT or colour conversion.
+ */
+static const uint16_t ac_weight[64] = {
+       0,   39,   39,  150,   78,  150,  316,  189,
+     189,  316,  512,  355,  300,  355,  512,  708,
+     551,  466,  466,  551,  708,  874,  747,  662,
+     632,  662,  747,  874,  985,  913,  858,  828,
+     828,  858,  913,  985, 1024, 1024, 1024, 1024,
+    1024, 1024, 1024, 1135, 1190, 1220, 1220, 1190,
+    1135, 1301, 1386, 1416, 1386, 1301, 1497, 1582,
+    1582, 1497, 1693, 1748, 1693, 1859, 1859, 1970,
+};
+
+typedef struct {
+    uint8_t lut_len[256];       // length of the code the next 8 bits start with, 0 if it is longer
+    uint8_t lut[256];           // its value
+    int32_t maxcode[17];        // largest code of every length, -1 for none
+    uint16_t mincode[17];       // smallest code of every length
+    uint16_t valptr[17];        // index in vals of the smallest code of every length
+    uint8_t vals[256];
+} jpg_huff_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h, v;               // sampling factors, blocks per MCU across and down
+    uint8_t tq;                 // quantization table
+    uint8_t td, ta;             // DC and AC Huffman tables
+} jpg_comp_t;
+
+typedef struct {
+    jpg_huff_t huff[2][2];      // [DC, AC][table]
+    uint8_t qt[4][64];          // zigzag order
+    jpg_comp_t comp[3];
+    uint8_t ncomp;
+    uint16_t width, height;
+    uint16_t restart;           // MCUs between restart markers, 0 for none
+} jpg_scan_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t bits;              // next bits, first one in the msb
+    int n;                      // bits in it
+    int pad;                    // zero bytes fed at a marker or the end of the data
+} jpg_bits_t;
+
+static bool huff_build(jpg_huff_t *h, const uint8_t *counts, const uint8_t *vals)
+{
+    uint32_t code = 0;
+    int k = 0;
+    memset(h->lut_len, 0, sizeof(h->lut_len));
+    for (int len = 1; len <= 16; len++) {
+        int n = counts[len - 1];
+        // more codes than the length has room for, or than vals holds
+        if (code + n > (1u << len) || k + n > (int)sizeof(h->vals)) {
+            return false;
+        }
+        h->valptr[len] = k;
+        h->mincode[len] = code;
+        h->maxcode[len] = n ? (int32_t)(code + n - 1) : -1;
+        for (int j = 0; j < n; j++, k++, code++) {
+            h->vals[k] = vals[k];
+            if (len <= 8) {
+                int first = code << (8 - len);
+                memset(&h->lut_len[first], len, 1 << (8 - len));
+                memset(&h->lut[first], vals[k], 1 << (8 - len));
+            }
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+static esp_err_t jpg_parse(jpg_scan_t *jpg, const uint8_t *src, size_t len, size_t *scan)
+{
+    if (len < 4 || src[0] != 0xFF || src[1] != 0xD8) {
+        return ESP_FAIL;
+    }
+    bool sof = false;
+    size_t i = 2;
+    while (i + 4 <= len) {
+        if (src[i] != 0xFF) {
+            return ESP_FAIL;
+        }
+        uint8_t marker = src[i + 1];
+        if (marker == 0xFF) {
+            i++;
+            continue;
+        }
+        size_t seg = src[i + 2] << 8 | src[i + 3];
+        if (seg < 2 || i + 2 + seg > len) {
+            return ESP_FAIL;
+        }
+        const uint8_t *p = src + i + 4;
+        const uint8_t *end = src + i + 2 + seg;
+        if (marker == 0xDB) {
+            while (p + 65 <= end) {
+                // 16 bit tables are only for 12 bit samples
+                if (*p >> 4) {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                memcpy(jpg->qt[*p & 3], p + 1, 64);
+                p += 65;
+            }
+        } else if (marker == 0xC4) {
+            while (p + 17 <= end) {
+                uint8_t tc = *p >> 4, th = *p & 0x0F;
+                int total = 0;
+                for (int k = 0; k < 16; k++) {
+                    total += p[1 + k];
+                }
+                if (tc > 1 || th > 1 || total > 256 || p + 17 + total > end
+                    || !huff_build(&jpg->huff[tc][th], p + 1, p + 17)) {
+                    return ESP_FAIL;
+                }
+                p += 17 + total;
+            }
+        } else if (marker == 0xC0 || marker == 0xC1) {
+            if (seg < 8 || p[0] != 8) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            jpg->height = p[1] << 8 | p[2];
+            jpg->width = p[3] << 8 | p[4];
+            jpg->ncomp = p[5];
+            if ((jpg->ncomp != 1 && jpg->ncomp != 3) || seg < 8u + 3 * jpg->ncomp) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            for (int c = 0; c < jpg->ncomp; c++) {
+                jpg_comp_t *comp = &jpg->comp[c];
+                comp->id = p[6 + 3 * c];
+                comp->h = p[7 + 3 * c] >> 4;
+                comp->v = p[7 + 3 * c] & 0x0F;
+                comp->tq = p[8 + 3 * c] & 3;
+                if (comp->h < 1 || comp->h > 4 || comp->v < 1 || comp->v > 4) {
+                    return ESP_FAIL;
+                }
+            }
+            sof = true;
+        } else if (marker == 0xDD && seg >= 4) {
+            jpg->restart = p[0] << 8 | p[1];
+        } else if (marker == 0xDA) {
+            if (seg < 3) {
+                return ESP_FAIL;
+            }
+            // one scan with every component, as the sensors and jpge write them
+            if (!sof || seg < 3u + 2 * p[0] || p[0] != jpg->ncomp) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            for (int c = 0; c < jpg->ncomp; c++) {
+                if (p[1 + 2 * c] != jpg->comp[c].id) {
+                    return ESP_ERR_NOT_SUPPORTED;
+                }
+                jpg->comp[c].td = (p[2 + 2 * c] >> 4) & 1;
+                jpg->comp[c].ta = p[2 + 2 * c] & 1;
+            }
+            *scan = i + 2 + seg;
+            return ESP_OK;
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            // progressive, lossless or arithmetic coded
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        i += 2 + seg;
+    }
+    return ESP_FAIL;
+}
+
+// at least 25 bits in the buffer, zeros once a marker or the end is reached
+static inline void bits_fill(jpg_bits_t *b)
+{
+    while (b->n <= 24) {
+        uint32_t c = 0;
+        if (b->p < b->end && b->p[0] != 0xFF) {
+            c = *b->p++;
+        } else if (b->p + 1 < b->end && b->p[1] == 0x00) {
+            c = 0xFF;
+            b->p += 2;
+        } else {
+            b->pad++;
+        }
+        b->bits |= c << (24 - b->n);
+        b->n += 8;
+    }
+}
+
+static inline int huff_decode(jpg_bits_t *b, const jpg_huff_t *h)
+{
+    bits_fill(b);
+    uint32_t peek = b->bits >> 24;
+    int len = h->lut_len[peek];
+    int value;
+    if (len) {
+        value = h->lut[peek];
+    } else {
+        for (len = 9;; len++) {
+            if (len > 16) {
+                return -1;
+            }
+            int32_t code = b->bits >> (32 - len);
+            if (code <= h->maxcode[len]) {
+                value = h->vals[h->valptr[len] + code - h->mincode[len]];
+                break;
+            }
+        }
+    }
+    b->bits <<= len;
+    b->n -= len;
+    return value;
+}
+
+// s bits, 1 to 16, as a signed coefficient
+static inline int bits_get(jpg_bits_t *b, int s)
+{
+    bits_fill(b);
+    int v = b->bits >> (32 - s);
+    b->bits <<= s;
+    b->n -= s;
+    return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+static esp_err_t jpg_restart(jpg_bits_t *b)
+{
+    b->bits = 0;
+    b->n = 0;
+    b->pad = 0;
+    if (b->p + 1 >= b->end || b->p[0] != 0xFF || (b->p[1] & 0xF8) != 0xD0) {
+        return ESP_FAIL;
+    }
+    b->p += 2;
+    return ESP_OK;
+}
+
+static esp_err_t jpg_energy(const jpg_scan_t *jpg, jpg_bits_t *b, uint32_t *score)
+{
+    int hmax = 1, vmax = 1;
+    int units[3] = {1, 1, 1};
+    if (jpg->ncomp > 1) {
+        for (int c = 0; c < jpg->ncomp; c++) {
+            hmax = jpg->comp[c].h > hmax ? jpg->comp[c].h : hmax;
+            vmax = jpg->comp[c].v > vmax ? jpg->comp[c].v : vmax;
+            units[c] = jpg->comp[c].h * jpg->comp[c].v;
+        }
+    }
+    uint32_t mcus = ((jpg->width + 8 * hmax - 1) / (8 * hmax)) * ((jpg->height + 8 * vmax - 1) / (8 * vmax));
+    uint64_t energy = 0;
+    uint32_t blocks = 0;
+    for (uint32_t m = 0; m < mcus; m++) {
+        if (jpg->restart && m && m % jpg->restart == 0 && jpg_restart(b) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        for (int c = 0; c < jpg->ncomp; c++) {
+            const jpg_comp_t *comp = &jpg->comp[c];
+            const jpg_huff_t *dc = &jpg->huff[0][comp->td];
+            const jpg_huff_t *ac = &jpg->huff[1][comp->ta];
+            const uint8_t *q = jpg->qt[comp->tq];
+            for (int u = 0; u < units[c]; u++) {
+                int s = huff_decode(b, dc);
+                if (s < 0 || s > 11) {
+                    return ESP_FAIL;
+                }
+                if (s) {
+                    bits_get(b, s);
+                }
+                // the chroma blocks are only decoded to get past them
+                uint64_t e = 0;
+                for (int k = 1; k < 64; k++) {
+                    int rs = huff_decode(b, ac);
+                    if (rs < 0) {
+                        return ESP_FAIL;
+                    }
+                    s = rs & 0x0F;
+                    if (!s) {
+                        if (rs != 0xF0) {
+                            break;
+                        }
+                        k += 15;
+                        continue;
+                    }
+                    k += rs >> 4;
+                    if (k > 63 || s > 11) {
+                        return ESP_FAIL;
+                    }
+                    int32_t f = bits_get(b, s) * q[k];
+                    e += (uint64_t)((int64_t)f * f) * ac_weight[k];
+                }
+                if (c == 0) {
+                    energy += e;
+                    blocks++;
+                }
+            }
+        }
+        // more than the bytes read ahead: the data ended before the image
+        if (b->pad > 4) {
+            return ESP_FAIL;
+        }
+    }
+    *score = blocks ? (energy >> 14) / blocks : 0;
+    return ESP_OK;
+}
+
+static esp_err_t sharpness_jpeg(const camera_fb_t *fb, uint32_t *score)
+{
+    jpg_scan_t *jpg = calloc(1, sizeof(jpg_scan_t));
+    if (!jpg) {
+        ESP_LOGE(TAG, "Could not allocate the Huffman tables");
+        return ESP_ERR_NO_MEM;
+    }
+    size_t scan = 0;
+    esp_err_t err = jpg_parse(jpg, fb->buf, fb->len, &scan);
+    if (err == ESP_OK) {
+        jpg_bits_t b = { .p = fb->buf + scan, .end = fb->buf + fb->len };
+        err = jpg_energy(jpg, &b, score);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "JPEG frame could not be scored");
+    }
+    free(jpg);
+    return err;
+}
+
+esp_err_t camera_frame_sharpness(const camera_fb_t *fb, uint32_t *score)
+{
+    if (!fb || !score) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fb->stats) {
+        *score = fb->stats->sharpness;
+        return ESP_OK;
+    }
+    if (fb->format == PIXFORMAT_JPEG) {
+        return sharpness_jpeg(fb, score);
+    }
+    return sharpness_raw(fb, score);
+}
+
+esp_err_t camera_burst_capture(uint8_t count, camera_fb_t **fb, uint32_t *score)
+{
+    if (!fb || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *fb = NULL;
+    camera_fb_t *best = NULL;
+    uint32_t best_score = 0;
+    esp_err_t err = ESP_FAIL;
+    for (uint8_t i = 0; i < count; i++) {
+        camera_fb_t *frame = esp_camera_fb_get();
+        if (!frame) {
+            break;
+        }
+        uint32_t s;
+        err = camera_frame_sharpness(frame, &s);
+        if (err != ESP_OK) {
+            esp_camera_fb_return(frame);
+            continue;
+        }
+        // the less sharp of the two goes back now, the driver can fill it with the next frame
+        if (!best || s > best_score) {
+            if (best) {
+                esp_camera_fb_return(best);
+            }
+            best = frame;
+            best_score = s;
+        } else {
+            esp_camera_fb_return(frame);
+        }
+    }
+    if (!best) {
+        return err;
+    }
+    ESP_LOGD(TAG, "sharpest frame %u, score %u", (unsigned)best->seq, (unsigned)best_score);
+    *fb = best;
+    if (score) {
+        *score = best_score;
+    }
+    return ESP_OK;
+}
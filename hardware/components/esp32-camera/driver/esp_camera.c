@@ -24,54 +24,11 @@
 #include "nvs.h"
 #include "sensor.h"
 #include "sccb.h"
+#include "sccb_shadow.h"
 #include "cam_hal.h"
 #include "esp_camera.h"
 #include "xclk.h"
-#if CONFIG_OV2640_SUPPORT
-#include "ov2640.h"
-#endif
-#if CONFIG_OV7725_SUPPORT
-#include "ov7725.h"
-#endif
-#if CONFIG_OV3660_SUPPORT
-#include "ov3660.h"
-#endif
-#if CONFIG_OV5640_SUPPORT
-#include "ov5640.h"
-#endif
-#if CONFIG_NT99141_SUPPORT
-#include "nt99141.h"
-#endif
-#if CONFIG_OV7670_SUPPORT
-#include "ov7670.h"
-#endif
-#if CONFIG_GC2145_SUPPORT
-#include "gc2145.h"
-#endif
-#if CONFIG_GC032A_SUPPORT
-#include "gc032a.h"
-#endif
-#if CONFIG_GC0308_SUPPORT
-#include "gc0308.h"
-#endif
-#if CONFIG_BF3005_SUPPORT
-#include "bf3005.h"
-#endif
-#if CONFIG_BF20A6_SUPPORT
-#include "bf20a6.h"
-#endif
-#if CONFIG_SC101IOT_SUPPORT
-#include "sc101iot.h"
-#endif
-#if CONFIG_SC030IOT_SUPPORT
-#include "sc030iot.h"
-#endif
-#if CONFIG_SC031GS_SUPPORT
-#include "sc031gs.h"
-#endif
-#if CONFIG_MEGA_CCM_SUPPORT
-#include "mega_ccm.h"
-#endif
+#include "sensor_detect.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -84,10 +41,38 @@ static const char *TAG = "camera";
 typedef struct {
     sensor_t sensor;
     camera_fb_t fb;
+    bool suspended;
 } camera_state_t;
 
 static const char *CAMERA_SENSOR_NVS_KEY = "sensor";
 static const char *CAMERA_PIXFORMAT_NVS_KEY = "pixformat";
+static const char *CAMERA_PROFILE_NVS_KEY = "profile";
+
+#if ESP_IDF_VERSION_MAJOR > 3
+typedef nvs_handle_t camera_nvs_handle_t;
+#else
+typedef nvs_handle camera_nvs_handle_t;
+#endif
+
+// Bumped whenever camera_status_t or a sensor's snapshot layout changes
+#define CAMERA_PROFILE_VERSION  1
+#define CAMERA_PROFILE_REGS_MAX 1024
+
+// NVS blob of esp_camera_save_profile, the sensor's save_regs snapshot follows
+typedef struct {
+    uint8_t version;
+    uint8_t pixformat;
+    uint16_t pid;
+    camera_status_t status;
+} camera_profile_t;
+
+typedef struct {
+    const uint8_t *regs;
+    size_t len;
+} camera_snapshot_t;
+
+// The sensor half of a mode change, called with the capture already in the new mode
+typedef int (*camera_sensor_update_t)(sensor_t *s, pixformat_t pixformat, framesize_t frame_size, const void *arg);
 static camera_state_t *s_state = NULL;
 
 #if CONFIG_IDF_TARGET_ESP32S3 // LCD_CAM module of ESP32-S3 will generate xclk
@@ -98,59 +83,6 @@ static camera_state_t *s_state = NULL;
 #define CAMERA_DISABLE_OUT_CLOCK() camera_disable_out_clock()
 #endif
 
-typedef struct {
-    int (*detect)(int slv_addr, sensor_id_t *id);
-    int (*init)(sensor_t *sensor);
-} sensor_func_t;
-
-static const sensor_func_t g_sensors[] = {
-#if CONFIG_OV7725_SUPPORT
-    {ov7725_detect, ov7725_init},
-#endif
-#if CONFIG_OV7670_SUPPORT
-    {ov7670_detect, ov7670_init},
-#endif
-#if CONFIG_OV2640_SUPPORT
-    {ov2640_detect, ov2640_init},
-#endif
-#if CONFIG_OV3660_SUPPORT
-    {ov3660_detect, ov3660_init},
-#endif
-#if CONFIG_OV5640_SUPPORT
-    {ov5640_detect, ov5640_init},
-#endif
-#if CONFIG_NT99141_SUPPORT
-    {nt99141_detect, nt99141_init},
-#endif
-#if CONFIG_GC2145_SUPPORT
-    {gc2145_detect, gc2145_init},
-#endif
-#if CONFIG_GC032A_SUPPORT
-    {gc032a_detect, gc032a_init},
-#endif
-#if CONFIG_GC0308_SUPPORT
-    {gc0308_detect, gc0308_init},
-#endif
-#if CONFIG_BF3005_SUPPORT
-    {bf3005_detect, bf3005_init},
-#endif
-#if CONFIG_BF20A6_SUPPORT
-    {bf20a6_detect, bf20a6_init},
-#endif
-#if CONFIG_SC101IOT_SUPPORT
-    {sc101iot_detect, sc101iot_init},
-#endif
-#if CONFIG_SC030IOT_SUPPORT
-    {sc030iot_detect, sc030iot_init},
-#endif
-#if CONFIG_SC031GS_SUPPORT
-    {sc031gs_detect, sc031gs_init},
-#endif
-#if CONFIG_MEGA_CCM_SUPPORT
-    {mega_ccm_detect, mega_ccm_init},
-#endif
-};
-
 static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out_camera_model)
 {
     esp_err_t ret = ESP_OK;
@@ -209,43 +141,14 @@ static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out
         vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 
-    ESP_LOGD(TAG, "Searching for camera address");
     vTaskDelay(10 / portTICK_PERIOD_MS);
-
-    uint8_t slv_addr = SCCB_Probe();
-
-    if (slv_addr == 0) {
-        ret = ESP_ERR_NOT_FOUND;
-        goto err;
-    }
-
-    ESP_LOGI(TAG, "Detected camera at address=0x%02x", slv_addr);
-    s_state->sensor.slv_addr = slv_addr;
     s_state->sensor.xclk_freq_hz = config->xclk_freq_hz;
-
-    /**
-     * Read sensor ID and then initialize sensor
-     * Attention: Some sensors have the same SCCB address. Therefore, several attempts may be made in the detection process
-     */
-    sensor_id_t *id = &s_state->sensor.id;
-    for (size_t i = 0; i < sizeof(g_sensors) / sizeof(sensor_func_t); i++) {
-        if (g_sensors[i].detect(slv_addr, id)) {
-            camera_sensor_info_t *info = esp_camera_sensor_get_info(id);
-            if (NULL != info) {
-                *out_camera_model = info->model;
-                ESP_LOGI(TAG, "Detected %s camera", info->name);
-                g_sensors[i].init(&s_state->sensor);
-                break;
-            }
-        }
-    }
-
-    if (CAMERA_NONE == *out_camera_model) { //If no supported sensors are detected
-        ESP_LOGE(TAG, "Detected camera not supported.");
-        ret = ESP_ERR_NOT_SUPPORTED;
+    ret = sensor_detect(&s_state->sensor, out_camera_model);
+    if (ret != ESP_OK) {
         goto err;
     }
 
+    sensor_id_t *id = &s_state->sensor.id;
     ESP_LOGI(TAG, "Camera PID=0x%02x VER=0x%02x MIDL=0x%02x MIDH=0x%02x",
              id->PID, id->VER, id->MIDH, id->MIDL);
 
@@ -351,10 +254,15 @@ fail:
 esp_err_t esp_camera_deinit()
 {
     esp_err_t ret = cam_deinit();
+    if (s_state && s_state->suspended) {
+        //the LEDC timer is not left paused for the next esp_camera_init
+        camera_resume_out_clock();
+    }
     CAMERA_DISABLE_OUT_CLOCK();
     if (s_state) {
         SCCB_Deinit();
 
+        sccb_shadow_delete(s_state->sensor.shadow);
         free(s_state);
         s_state = NULL;
     }
@@ -362,11 +270,53 @@ esp_err_t esp_camera_deinit()
     return ret;
 }
 
+esp_err_t esp_camera_suspend(void)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_state->suspended) {
+        return ESP_OK;
+    }
+    esp_err_t err = cam_suspend();
+    if (err != ESP_OK) {
+        return err;
+    }
+    //the sensor only takes SCCB writes while XCLK runs
+    sensor_t *s = &s_state->sensor;
+    if (s->set_standby && s->set_standby(s, 1)) {
+        ESP_LOGW(TAG, "Sensor standby failed, it idles without XCLK");
+    }
+    camera_suspend_out_clock();
+    s_state->suspended = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_resume(void)
+{
+    if (s_state == NULL || !s_state->suspended) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = camera_resume_out_clock();
+    if (err != ESP_OK) {
+        return err;
+    }
+    //standby keeps the registers, so the shadow still holds and leaving standby is the only write
+    sensor_t *s = &s_state->sensor;
+    if (s->set_standby && s->set_standby(s, 0)) {
+        ESP_LOGE(TAG, "Failed to wake the sensor");
+        camera_suspend_out_clock();
+        return ESP_FAIL;
+    }
+    s_state->suspended = false;
+    return cam_resume();
+}
+
 #define FB_GET_TIMEOUT (4000 / portTICK_PERIOD_MS)
 
 camera_fb_t *esp_camera_fb_get()
 {
-    if (s_state == NULL) {
+    if (s_state == NULL || s_state->suspended) {
         return NULL;
     }
     camera_fb_t *fb = cam_take(FB_GET_TIMEOUT);
@@ -375,6 +325,10 @@ camera_fb_t *esp_camera_fb_get()
         fb->width = resolution[s_state->sensor.status.framesize].width;
         fb->height = resolution[s_state->sensor.status.framesize].height;
         fb->format = s_state->sensor.pixformat;
+        fb->meta.aec_value = s_state->sensor.status.aec_value;
+        fb->meta.agc_gain = s_state->sensor.status.agc_gain;
+        fb->meta.aec = s_state->sensor.status.aec;
+        fb->meta.agc = s_state->sensor.status.agc;
     }
     return fb;
 }
@@ -387,6 +341,113 @@ void esp_camera_fb_return(camera_fb_t *fb)
     cam_give(fb);
 }
 
+void esp_camera_fb_retain(camera_fb_t *fb)
+{
+    if (s_state == NULL) {
+        return;
+    }
+    cam_retain(fb);
+}
+
+void esp_camera_fb_release(camera_fb_t *fb)
+{
+    esp_camera_fb_return(fb);
+}
+
+uint32_t esp_camera_fb_starved_count(void)
+{
+    if (s_state == NULL) {
+        return 0;
+    }
+    return cam_get_starved_count();
+}
+
+esp_err_t esp_camera_get_drop_stats(camera_drop_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    cam_get_drop_stats(stats);
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_set_line_callback(camera_line_cb_t cb, void *arg)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return cam_set_line_callback(cb, arg);
+}
+
+static esp_err_t camera_check_mode(sensor_t *s, pixformat_t pixformat, framesize_t frame_size)
+{
+    camera_sensor_info_t *info = esp_camera_sensor_get_info(&s->id);
+    if (frame_size >= FRAMESIZE_INVALID || (info && frame_size > info->max_size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (PIXFORMAT_JPEG == pixformat && info && !info->support_jpeg) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+// Moves the capture to the new mode and updates the sensor, both go back to the old mode if the sensor fails
+static esp_err_t camera_change_mode(pixformat_t pixformat, framesize_t frame_size, camera_sensor_update_t update, const void *arg, esp_err_t sensor_err)
+{
+    sensor_t *s = &s_state->sensor;
+    if (s_state->suspended) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pixformat_t old_pixformat = s->pixformat;
+    framesize_t old_frame_size = s->status.framesize;
+    bool reconfig = pixformat != old_pixformat || frame_size != old_frame_size;
+
+    //the capture goes first, it refuses while frame buffers are held
+    if (reconfig) {
+        esp_err_t err = cam_reconfig(pixformat, frame_size, s->xclk_freq_hz, s->id.PID);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (update(s, pixformat, frame_size, arg)) {
+        ESP_LOGE(TAG, "Failed to switch the sensor to %dx%d", resolution[frame_size].width, resolution[frame_size].height);
+        s->pixformat = old_pixformat;
+        s->status.framesize = old_frame_size;
+        if (reconfig && cam_reconfig(old_pixformat, old_frame_size, s->xclk_freq_hz, s->id.PID) == ESP_OK) {
+            cam_start();
+        }
+        return sensor_err;
+    }
+    if (reconfig) {
+        cam_start();
+    }
+    return ESP_OK;
+}
+
+static int sensor_switch_mode(sensor_t *s, pixformat_t pixformat, framesize_t frame_size, const void *arg)
+{
+    if (s->set_mode) {
+        return s->set_mode(s, pixformat, frame_size);
+    }
+    s->pixformat = pixformat;
+    return s->set_framesize(s, frame_size) || s->set_pixformat(s, pixformat);
+}
+
+esp_err_t esp_camera_switch_mode(pixformat_t pixformat, framesize_t frame_size)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = camera_check_mode(&s_state->sensor, pixformat, frame_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return camera_change_mode(pixformat, frame_size, sensor_switch_mode, NULL, ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE);
+}
+
 sensor_t *esp_camera_sensor_get()
 {
     if (s_state == NULL) {
@@ -397,90 +458,179 @@ sensor_t *esp_camera_sensor_get()
 
 esp_err_t esp_camera_save_to_nvs(const char *key)
 {
-#if ESP_IDF_VERSION_MAJOR > 3
-    nvs_handle_t handle;
-#else
-    nvs_handle handle;
-#endif
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+    camera_nvs_handle_t handle;
     esp_err_t ret = nvs_open(key, NVS_READWRITE, &handle);
-
-    if (ret == ESP_OK) {
-        sensor_t *s = esp_camera_sensor_get();
-        if (s != NULL) {
-            ret = nvs_set_blob(handle, CAMERA_SENSOR_NVS_KEY, &s->status, sizeof(camera_status_t));
-            if (ret == ESP_OK) {
-                uint8_t pf = s->pixformat;
-                ret = nvs_set_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, pf);
-            }
-            return ret;
-        } else {
-            return ESP_ERR_CAMERA_NOT_DETECTED;
-        }
-        nvs_close(handle);
-        return ret;
-    } else {
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%d) opening nvs key \"%s\"", ret, key);
         return ret;
     }
+    ret = nvs_set_blob(handle, CAMERA_SENSOR_NVS_KEY, &s->status, sizeof(camera_status_t));
+    if (ret == ESP_OK) {
+        uint8_t pf = s->pixformat;
+        ret = nvs_set_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, pf);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
 }
 
 esp_err_t esp_camera_load_from_nvs(const char *key)
 {
-#if ESP_IDF_VERSION_MAJOR > 3
-    nvs_handle_t handle;
-#else
-    nvs_handle handle;
-#endif
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+    camera_nvs_handle_t handle;
+    esp_err_t ret = nvs_open(key, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%d) opening nvs key \"%s\"", ret, key);
+        return ret;
+    }
+    camera_status_t st;
+    size_t size = sizeof(camera_status_t);
+    ret = nvs_get_blob(handle, CAMERA_SENSOR_NVS_KEY, &st, &size);
+    if (ret == ESP_OK) {
+        s->set_ae_level(s, st.ae_level);
+        s->set_aec2(s, st.aec2);
+        s->set_aec_value(s, st.aec_value);
+        s->set_agc_gain(s, st.agc_gain);
+        s->set_awb_gain(s, st.awb_gain);
+        s->set_bpc(s, st.bpc);
+        s->set_brightness(s, st.brightness);
+        s->set_colorbar(s, st.colorbar);
+        s->set_contrast(s, st.contrast);
+        s->set_dcw(s, st.dcw);
+        s->set_denoise(s, st.denoise);
+        s->set_exposure_ctrl(s, st.aec);
+        s->set_framesize(s, st.framesize);
+        s->set_gain_ctrl(s, st.agc);
+        s->set_gainceiling(s, st.gainceiling);
+        s->set_hmirror(s, st.hmirror);
+        s->set_lenc(s, st.lenc);
+        s->set_quality(s, st.quality);
+        s->set_raw_gma(s, st.raw_gma);
+        s->set_saturation(s, st.saturation);
+        s->set_sharpness(s, st.sharpness);
+        s->set_special_effect(s, st.special_effect);
+        s->set_vflip(s, st.vflip);
+        s->set_wb_mode(s, st.wb_mode);
+        s->set_whitebal(s, st.awb);
+        s->set_wpc(s, st.wpc);
+    }
     uint8_t pf;
+    ret = nvs_get_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, &pf);
+    if (ret == ESP_OK) {
+        s->set_pixformat(s, pf);
+    }
+    nvs_close(handle);
+    return ret;
+}
 
-    esp_err_t ret = nvs_open(key, NVS_READWRITE, &handle);
+esp_err_t esp_camera_save_profile(const char *key)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensor_t *s = &s_state->sensor;
+    if (!s->save_regs) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uint8_t *blob = malloc(sizeof(camera_profile_t) + CAMERA_PROFILE_REGS_MAX);
+    if (!blob) {
+        return ESP_ERR_NO_MEM;
+    }
+    camera_profile_t *profile = (camera_profile_t *)blob;
+    profile->version = CAMERA_PROFILE_VERSION;
+    profile->pixformat = s->pixformat;
+    profile->pid = s->id.PID;
+    profile->status = s->status;
+    int len = s->save_regs(s, blob + sizeof(camera_profile_t), CAMERA_PROFILE_REGS_MAX);
+    if (len < 0) {
+        ESP_LOGE(TAG, "Failed to read the sensor registers");
+        free(blob);
+        return ESP_FAIL;
+    }
 
+    camera_nvs_handle_t handle;
+    esp_err_t ret = nvs_open(key, NVS_READWRITE, &handle);
     if (ret == ESP_OK) {
-        sensor_t *s = esp_camera_sensor_get();
-        camera_status_t st;
-        if (s != NULL) {
-            size_t size = sizeof(camera_status_t);
-            ret = nvs_get_blob(handle, CAMERA_SENSOR_NVS_KEY, &st, &size);
-            if (ret == ESP_OK) {
-                s->set_ae_level(s, st.ae_level);
-                s->set_aec2(s, st.aec2);
-                s->set_aec_value(s, st.aec_value);
-                s->set_agc_gain(s, st.agc_gain);
-                s->set_awb_gain(s, st.awb_gain);
-                s->set_bpc(s, st.bpc);
-                s->set_brightness(s, st.brightness);
-                s->set_colorbar(s, st.colorbar);
-                s->set_contrast(s, st.contrast);
-                s->set_dcw(s, st.dcw);
-                s->set_denoise(s, st.denoise);
-                s->set_exposure_ctrl(s, st.aec);
-                s->set_framesize(s, st.framesize);
-                s->set_gain_ctrl(s, st.agc);
-                s->set_gainceiling(s, st.gainceiling);
-                s->set_hmirror(s, st.hmirror);
-                s->set_lenc(s, st.lenc);
-                s->set_quality(s, st.quality);
-                s->set_raw_gma(s, st.raw_gma);
-                s->set_saturation(s, st.saturation);
-                s->set_sharpness(s, st.sharpness);
-                s->set_special_effect(s, st.special_effect);
-                s->set_vflip(s, st.vflip);
-                s->set_wb_mode(s, st.wb_mode);
-                s->set_whitebal(s, st.awb);
-                s->set_wpc(s, st.wpc);
-            }
-            ret = nvs_get_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, &pf);
-            if (ret == ESP_OK) {
-                s->set_pixformat(s, pf);
-            }
-        } else {
-            return ESP_ERR_CAMERA_NOT_DETECTED;
+        ret = nvs_set_blob(handle, CAMERA_PROFILE_NVS_KEY, blob, sizeof(camera_profile_t) + len);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
         }
         nvs_close(handle);
-        return ret;
     } else {
         ESP_LOGW(TAG, "Error (%d) opening nvs key \"%s\"", ret, key);
+    }
+    free(blob);
+    return ret;
+}
+
+static int sensor_load_regs(sensor_t *s, pixformat_t pixformat, framesize_t frame_size, const void *arg)
+{
+    const camera_snapshot_t *snapshot = arg;
+    s->pixformat = pixformat;
+    s->status.framesize = frame_size;
+    return s->load_regs(s, snapshot->regs, snapshot->len);
+}
+
+esp_err_t esp_camera_load_profile(const char *key)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensor_t *s = &s_state->sensor;
+    if (!s->load_regs) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    camera_nvs_handle_t handle;
+    esp_err_t ret = nvs_open(key, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%d) opening nvs key \"%s\"", ret, key);
         return ret;
     }
+    uint8_t *blob = NULL;
+    size_t size = 0;
+    ret = nvs_get_blob(handle, CAMERA_PROFILE_NVS_KEY, NULL, &size);
+    if (ret == ESP_OK && (size < sizeof(camera_profile_t) || size > sizeof(camera_profile_t) + CAMERA_PROFILE_REGS_MAX)) {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    if (ret == ESP_OK) {
+        blob = malloc(size);
+        ret = blob ? nvs_get_blob(handle, CAMERA_PROFILE_NVS_KEY, blob, &size) : ESP_ERR_NO_MEM;
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        free(blob);
+        return ret;
+    }
+
+    camera_profile_t profile;
+    memcpy(&profile, blob, sizeof(profile));
+    camera_snapshot_t snapshot = {blob + sizeof(profile), size - sizeof(profile)};
+    if (profile.version != CAMERA_PROFILE_VERSION) {
+        ESP_LOGW(TAG, "Profile \"%s\" has version %u, expected %u", key, profile.version, CAMERA_PROFILE_VERSION);
+        ret = ESP_ERR_INVALID_VERSION;
+    } else if (profile.pid != s->id.PID) {
+        ESP_LOGW(TAG, "Profile \"%s\" is for sensor PID 0x%x, not 0x%x", key, profile.pid, s->id.PID);
+        ret = ESP_ERR_CAMERA_NOT_SUPPORTED;
+    } else {
+        ret = camera_check_mode(s, profile.pixformat, profile.status.framesize);
+    }
+    if (ret == ESP_OK) {
+        ret = camera_change_mode(profile.pixformat, profile.status.framesize, sensor_load_regs, &snapshot, ESP_FAIL);
+    }
+    if (ret == ESP_OK) {
+        s->status = profile.status;
+    }
+    free(blob);
+    return ret;
 }
 
 void esp_camera_return_all(void) {
@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Software auto exposure: the sensor's own AEC/AGC are switched off and the
+ * exposure and gain are set from the luma of the frames the application gets.
+ *
+ *  camera_ae_t ae;
+ *  camera_ae_config_t config = CAMERA_AE_CONFIG_DEFAULT();
+ *  camera_ae_init(&ae, esp_camera_sensor_get(), &config);
+ *  ...
+ *  camera_fb_t *fb;
+ *  if (camera_ae_capture(&ae, 10, &fb) == ESP_OK) {
+ *      if (ae.state != CAMERA_AE_SEARCHING) {
+ *          // exposed to the target
+ *      }
+ *      esp_camera_fb_return(fb);
+ *  }
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAMERA_AE_BINS CAMERA_STATS_BINS
+
+/**
+ * @brief Luma histogram of a frame
+ */
+typedef struct {
+    uint32_t bins[CAMERA_AE_BINS];  /*!< Pixels by luma / 4 */
+    uint32_t count;                 /*!< Pixels sampled */
+    uint8_t mean;                   /*!< Mean luma of the pixels sampled */
+} camera_luma_hist_t;
+
+/**
+ * @brief Controller settings
+ */
+typedef struct {
+    uint8_t target;                 /*!< Mean luma to expose for */
+    uint8_t tolerance;              /*!< Mean luma this close to the target is exposed */
+    uint8_t stable_frames;          /*!< Exposed frames in a row before the exposure is stable */
+    uint8_t damping;                /*!< Percent of the exposure error corrected in one step, less overshoots less */
+    uint8_t latency;                /*!< Frames the sensor takes to apply new settings, they are not measured */
+    uint16_t aec_max;               /*!< Longest exposure to set with set_aec_value(), 0 for the sensor's */
+    uint8_t agc_max;                /*!< Highest gain to set with set_agc_gain(), 0 for the sensor's */
+} camera_ae_config_t;
+
+#define CAMERA_AE_CONFIG_DEFAULT() { \
+    .target = 110, \
+    .tolerance = 10, \
+    .stable_frames = 1, \
+    .damping = 70, \
+    .latency = 1, \
+    .aec_max = 0, \
+    .agc_max = 0, \
+}
+
+typedef enum {
+    CAMERA_AE_SEARCHING,            /*!< Still moving the exposure */
+    CAMERA_AE_CONVERGED,            /*!< The mean luma is on the target */
+    CAMERA_AE_LIMITED,              /*!< Off the target with the exposure and gain at their limit */
+} camera_ae_state_t;
+
+/**
+ * @brief Controller state, kept between captures so the next one starts from the last exposure
+ */
+typedef struct {
+    camera_ae_config_t config;
+    camera_ae_state_t state;
+    uint16_t aec_value;             /*!< Exposure set on the sensor */
+    uint8_t agc_gain;               /*!< Gain set on the sensor */
+    uint8_t mean;                   /*!< Mean luma of the last frame measured */
+    uint8_t exposed;                /*!< Frames in a row within the tolerance */
+    uint8_t skip;                   /*!< Frames left before the last settings show */
+    uint32_t steps;                 /*!< Exposure changes made */
+} camera_ae_t;
+
+/**
+ * @brief Build the luma histogram of a frame
+ *
+ * Copies the frame stats or uses the luma plane if the frame has them. Otherwise about 4K pixels
+ * are sampled, from the Y of YUV422, GRAYSCALE or RGB, and a JPEG frame is
+ * decoded at an eighth of its size.
+ *
+ * @param fb    Frame
+ * @param hist  Filled with the histogram
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED for a pixel format without luma
+ *      - ESP_FAIL if the JPEG frame could not be decoded
+ */
+esp_err_t camera_luma_histogram(const camera_fb_t *fb, camera_luma_hist_t *hist);
+
+/**
+ * @brief Switch the sensor to manual exposure and gain and start the controller from its settings
+ *
+ * @param ae        Controller
+ * @param s         Sensor
+ * @param config    Settings, NULL for CAMERA_AE_CONFIG_DEFAULT()
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if an argument is NULL or the settings are out of range
+ *      - ESP_ERR_NOT_SUPPORTED if the sensor cannot set its exposure and gain
+ *      - ESP_FAIL if the sensor could not be switched to manual exposure
+ */
+esp_err_t camera_ae_init(camera_ae_t *ae, sensor_t *s, const camera_ae_config_t *config);
+
+/**
+ * @brief Measure a frame and step the exposure and gain towards the target
+ *
+ * The exposure is moved by a damped share of the error in the sensor's linear
+ * light, longer exposures first and gain only once the exposure is at aec_max.
+ * Frames taken before new settings can show are counted but not measured.
+ *
+ * @param ae    Controller
+ * @param s     Sensor
+ * @param fb    Frame, taken after the previous one given to the controller
+ *
+ * @return
+ *      - ESP_OK on success, ae->state tells whether the exposure is stable
+ *      - ESP_ERR_NOT_SUPPORTED for a pixel format without luma
+ *      - ESP_FAIL if the frame could not be decoded or the sensor not set
+ */
+esp_err_t camera_ae_update(camera_ae_t *ae, sensor_t *s, const camera_fb_t *fb);
+
+/**
+ * @brief Get frames until the exposure is stable
+ *
+ * Runs the frames from esp_camera_fb_get() through camera_ae_update() and
+ * returns the first one that is exposed, or that cannot be exposed better, or
+ * the last of max_frames with ae->state still CAMERA_AE_SEARCHING.
+ *
+ * Only ESP_OK hands out a frame, the caller gives it back with
+ * esp_camera_fb_return(). Every other frame taken, on an error as well, is
+ * back with the driver when the call returns.
+ *
+ * @param ae            Controller set up with camera_ae_init()
+ * @param max_frames    Frames to try, at least 1
+ * @param fb            The frame on ESP_OK, NULL on an error
+ *
+ * @return
+ *      - ESP_OK with the frame, ae->state tells whether the exposure settled
+ *      - ESP_ERR_INVALID_ARG if an argument is NULL or max_frames is 0
+ *      - ESP_ERR_NOT_SUPPORTED for a pixel format without luma
+ *      - ESP_FAIL if no frame came, or the sensor could not be set
+ */
+esp_err_t camera_ae_capture(camera_ae_t *ae, uint8_t max_frames, camera_fb_t **fb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Best of a burst: a few frames are taken back to back and the sharpest one is
+ * kept, so a frame blurred by the camera or the scene moving is not the one used.
+ *
+ *  camera_fb_t *fb;
+ *  if (camera_burst_capture(4, &fb, NULL) == ESP_OK) {
+ *      // the sharpest of 4 frames
+ *      esp_camera_fb_return(fb);
+ *  }
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Score how sharp a frame is, cheaply
+ *
+ * The score is the mean over the pixels of the squared luma differences to the
+ * next pixel on the right and below, higher is sharper. It depends on the scene,
+ * so it only compares frames of the same scene in the same format.
+ *
+ * - Frames with fb->stats use its sharpness, measured on every pixel.
+ * - YUV422, GRAYSCALE and RGB frames are sampled at about 16K pixels.
+ * - JPEG frames are entropy decoded without the IDCT and the score is worked out
+ *   from the luma AC coefficients, weighted by how much each adds to the differences.
+ *
+ * @param fb    Frame
+ * @param score Set to the score
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if an argument is NULL
+ *      - ESP_ERR_NOT_SUPPORTED for a pixel format without luma, or a JPEG that is not baseline
+ *      - ESP_FAIL if the JPEG frame is corrupt
+ */
+esp_err_t camera_frame_sharpness(const camera_fb_t *fb, uint32_t *score);
+
+/**
+ * @brief Take frames back to back and keep the sharpest one
+ *
+ * Needs fb_count 2 or more: the sharpest frame so far is held while the next
+ * one is taken, and the less sharp of the two goes back to the driver at once.
+ * Frames that cannot be scored are returned and left out.
+ *
+ * @param count     Frames to take, at least 1
+ * @param fb        The sharpest frame, to give back with esp_camera_fb_return(). NULL if there is none
+ * @param score     Set to its camera_frame_sharpness() score, may be NULL
+ *
+ * @return
+ *      - ESP_OK with the sharpest frame, also if the driver stopped giving frames before count
+ *      - ESP_ERR_INVALID_ARG if fb is NULL or count is 0
+ *      - ESP_FAIL if no frame came
+ *      - The camera_frame_sharpness() error if no frame could be scored
+ */
+esp_err_t camera_burst_capture(uint8_t count, camera_fb_t **fb, uint32_t *score);
+
+#ifdef __cplusplus
+}
+#endif
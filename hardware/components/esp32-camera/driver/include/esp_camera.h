@@ -87,7 +87,8 @@ extern "C" {
  */
 typedef enum {
     CAMERA_GRAB_WHEN_EMPTY,         /*!< Fills buffers when they are empty. Less resources but first 'fb_count' frames might be old */
-    CAMERA_GRAB_LATEST              /*!< Except when 1 frame buffer is used, queue will always contain the last 'fb_count' frames */
+    CAMERA_GRAB_LATEST,             /*!< Except when 1 frame buffer is used, queue will always contain the last 'fb_count' frames */
+    CAMERA_GRAB_ON_DEMAND           /*!< Capture is stopped until esp_camera_fb_get(), which skips 'grab_warmup_frames' and returns the next frame */
 } camera_grab_mode_t;
 
 /**
@@ -147,9 +148,13 @@ typedef struct {
     framesize_t frame_size;         /*!< Size of the output image: FRAMESIZE_ + QVGA|CIF|VGA|SVGA|XGA|SXGA|UXGA  */
 
     int jpeg_quality;               /*!< Quality of JPEG output. 0-63 lower means higher quality  */
-    size_t fb_count;                /*!< Number of frame buffers to be allocated. If more than one, then each frame will be acquired (double speed)  */
+    size_t fb_count;                /*!< Number of frame buffers to be allocated. If more than one, then each frame will be acquired (double speed). 0 for rows to esp_camera_set_line_callback() only  */
     camera_fb_location_t fb_location; /*!< The location where the frame buffer will be allocated */
     camera_grab_mode_t grab_mode;   /*!< When buffers should be filled */
+    uint8_t grab_warmup_frames;     /*!< CAMERA_GRAB_ON_DEMAND: frames skipped after capture starts, so exposure can settle */
+    uint8_t luma_scale;             /*!< ESP32, YUV422: 4 or 8 to also get the luma downscaled that many times in fb->luma, made while the frame is copied. 0 for none */
+    bool frame_stats;               /*!< YUV422, GRAYSCALE: also get the luma histogram, sharpness and tile means of every frame in fb->stats, made while the frame is copied. Not in EDMA mode */
+    bool jpeg_adaptive;             /*!< JPEG: start the frame buffers at half their size and resize them between captures to the recent frame sizes. Not in EDMA mode */
 #if CONFIG_CAMERA_CONVERTER_ENABLED
     camera_conv_mode_t conv_mode;   /*!< RGB<->YUV Conversion mode */
 #endif
@@ -157,6 +162,32 @@ typedef struct {
     int sccb_i2c_port;              /*!< If pin_sccb_sda is -1, use the already configured I2C bus by number */
 } camera_config_t;
 
+/**
+ * @brief Capture details of a frame, filled in when the frame is handed out
+ */
+typedef struct {
+    uint32_t dropped;           /*!< Frames lost since the previous frame was handed out, for any reason in camera_drop_stats_t */
+    uint32_t latency_us;        /*!< Time from the VSYNC that started the frame to esp_camera_fb_get() returning it */
+    uint16_t aec_value;         /*!< Sensor exposure setting, the sensor's own choice is not read back while aec is on */
+    uint8_t agc_gain;           /*!< Sensor gain setting, the sensor's own choice is not read back while agc is on */
+    uint8_t aec : 1;            /*!< Automatic exposure was on */
+    uint8_t agc : 1;            /*!< Automatic gain was on */
+} camera_fb_meta_t;
+
+#define CAMERA_STATS_BINS 64
+#define CAMERA_STATS_GRID 8
+
+/**
+ * @brief Luma statistics of a frame, filled in while the frame is copied
+ */
+typedef struct {
+    uint32_t hist[CAMERA_STATS_BINS];   /*!< Pixels by luma / 4 */
+    uint32_t count;                     /*!< Pixels counted, width * height */
+    uint8_t mean;                       /*!< Mean luma */
+    uint32_t sharpness;                 /*!< Mean of the squared luma differences to the pixel on the left and the one above, higher is sharper */
+    uint8_t tiles[CAMERA_STATS_GRID * CAMERA_STATS_GRID]; /*!< Mean luma of the frame cut in CAMERA_STATS_GRID by CAMERA_STATS_GRID tiles, row by row */
+} camera_frame_stats_t;
+
 /**
  * @brief Data structure of camera frame buffer
  */
@@ -167,8 +198,51 @@ typedef struct {
     size_t height;              /*!< Height of the buffer in pixels */
     pixformat_t format;         /*!< Format of the pixel data */
     struct timeval timestamp;   /*!< Timestamp since boot of the first DMA buffer of the frame */
+    uint32_t seq;               /*!< Number of the frame since the driver started, gaps are frames that were not delivered */
+    uint8_t * luma;             /*!< Box filtered luma plane, luma_width * luma_height bytes, NULL unless camera_config_t.luma_scale is set */
+    size_t luma_width;          /*!< Width of the luma plane in pixels */
+    size_t luma_height;         /*!< Height of the luma plane in pixels */
+    camera_frame_stats_t * stats; /*!< Luma statistics of the frame, NULL unless camera_config_t.frame_stats is set */
+    camera_fb_meta_t meta;      /*!< Capture details */
 } camera_fb_t;
 
+/**
+ * @brief Frames the driver lost, by reason, counted since esp_camera_init()
+ *
+ * The names in brackets are the warnings logged for each.
+ */
+typedef struct {
+    uint32_t fb_overflow;       /*!< Frame larger than its frame buffer (FB-OVF) */
+    uint32_t no_soi;            /*!< JPEG frame that does not start with a SOI marker (NO-SOI) */
+    uint32_t no_eoi;            /*!< JPEG frame without an EOI marker (NO-EOI) */
+    uint32_t bad_size;          /*!< Frame shorter than the resolution (FB-SIZE) */
+    uint32_t event_overflow;    /*!< Frame cut by the interrupt event queue overflowing (EV-VSYNC-OVF, EV-EOF-OVF) */
+    uint32_t starved;           /*!< Frame not captured because every frame buffer was in use */
+    uint32_t overwritten;       /*!< Frame replaced by a newer one, or left over from an earlier on demand request, before it was handed out */
+    uint32_t timeout;           /*!< esp_camera_fb_get() calls that returned no frame ("Failed to get the frame on time!") */
+} camera_drop_stats_t;
+
+/**
+ * @brief Band of rows that has just been copied into a frame buffer
+ */
+typedef struct {
+    const uint8_t * buf;        /*!< Pointer to the first row of the band, rows follow each other without padding */
+    size_t len;                 /*!< Length of the band in bytes */
+    uint16_t y;                 /*!< First row of the band */
+    uint16_t rows;              /*!< Number of rows in the band */
+    uint16_t width;             /*!< Width of the frame in pixels */
+    uint16_t height;            /*!< Height of the frame in pixels, the band with y + rows == height ends the frame */
+    uint32_t seq;               /*!< Number of the frame, as in camera_fb_t */
+} camera_line_band_t;
+
+/**
+ * @brief Callback receiving the rows of a frame while it is being captured
+ *
+ * @param band  Rows that are complete, in the format of the frame buffer
+ * @param arg   Pointer given to esp_camera_set_line_callback()
+ */
+typedef void (*camera_line_cb_t)(const camera_line_band_t *band, void *arg);
+
 #define ESP_ERR_CAMERA_BASE 0x20000
 #define ESP_ERR_CAMERA_NOT_DETECTED             (ESP_ERR_CAMERA_BASE + 1)
 #define ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE (ESP_ERR_CAMERA_BASE + 2)
@@ -200,6 +274,59 @@ esp_err_t esp_camera_init(const camera_config_t* config);
  */
 esp_err_t esp_camera_deinit(void);
 
+/**
+ * @brief Stop the camera between captures without deinitializing it
+ *
+ * Stops the capture and XCLK and puts the sensor in its software standby, if its
+ * driver has one (OV2640, OV3660, OV5640). The frame buffers, DMA descriptors,
+ * cam_task and the sensor registers with their shadow are kept, so
+ * esp_camera_resume() costs a fraction of esp_camera_deinit() and esp_camera_init().
+ * Frames that were not taken are dropped, frames the application holds stay valid
+ * and can be returned at any time. Until esp_camera_resume(), esp_camera_fb_get()
+ * returns NULL and the sensor can not be written.
+ *
+ * @return
+ *      - ESP_OK on success, also if the camera was suspended already
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_suspend(void);
+
+/**
+ * @brief Start the camera again after esp_camera_suspend()
+ *
+ * Restarts XCLK, takes the sensor out of standby, which is the only register
+ * write, and starts the capture. Like after esp_camera_init(), the first frames
+ * may still be settling; CAMERA_GRAB_ON_DEMAND skips its warm-up frames again.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet or is not suspended
+ *      - ESP_FAIL if the sensor did not leave standby, the camera stays suspended
+ */
+esp_err_t esp_camera_resume(void);
+
+/**
+ * @brief Switch the pixel format and frame size while the driver runs.
+ *
+ * Faster than esp_camera_deinit() and esp_camera_init(): sensors with a set_mode
+ * (OV2640) write only the registers that differ between the two modes, and the
+ * capture keeps its task and the frame buffers that are large enough. Every frame
+ * buffer has to be returned first, frames of the old mode that were not taken are
+ * dropped. Not supported with a luma plane, or to JPEG with frame stats.
+ *
+ * @param pixformat     New pixel format
+ * @param frame_size    New frame size
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet, is suspended or frame buffers are still held
+ *      - ESP_ERR_INVALID_ARG if the frame size is too large for the sensor
+ *      - ESP_ERR_NOT_SUPPORTED if the sensor has no JPEG, the driver uses a luma plane, or JPEG with frame stats
+ *      - ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE if the sensor could not be switched, capture goes on in the old mode
+ *      - ESP_FAIL if the new buffers could not be allocated, esp_camera_deinit() is left
+ */
+esp_err_t esp_camera_switch_mode(pixformat_t pixformat, framesize_t frame_size);
+
 /**
  * @brief Obtain pointer to a frame buffer.
  *
@@ -214,6 +341,70 @@ camera_fb_t* esp_camera_fb_get(void);
  */
 void esp_camera_fb_return(camera_fb_t * fb);
 
+/**
+ * @brief Take one more reference to a frame buffer, to share it with another task without copying.
+ *
+ * The frame buffer is reused only after every reference has been dropped with
+ * esp_camera_fb_release() or esp_camera_fb_return().
+ *
+ * @param fb    Frame buffer from esp_camera_fb_get() that is still referenced
+ */
+void esp_camera_fb_retain(camera_fb_t * fb);
+
+/**
+ * @brief Drop one reference to a frame buffer, same as esp_camera_fb_return().
+ *
+ * @param fb    Pointer to the frame buffer
+ */
+void esp_camera_fb_release(camera_fb_t * fb);
+
+/**
+ * @brief Number of frames the driver could not capture because every frame buffer was in use.
+ *
+ * A growing count means consumers hold frames too long for fb_count.
+ */
+uint32_t esp_camera_fb_starved_count(void);
+
+/**
+ * @brief Get the counts of frames lost, by reason.
+ *
+ * The counts only go up, poll them and alert on the difference.
+ *
+ * @param stats Filled with the counts
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if stats is NULL
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_get_drop_stats(camera_drop_stats_t *stats);
+
+/**
+ * @brief Set a callback that gets every band of rows as soon as it is in the frame buffer.
+ *
+ * The callback runs on the camera task once for every DMA buffer copied out, so a band
+ * is the few rows of one DMA transfer and the last one comes before the frame is queued
+ * for esp_camera_fb_get(). Consumers such as an encoder can work on the frame while it
+ * arrives instead of after it. The callback must return before the next DMA buffer is
+ * full, or frames are dropped. The band is valid during the callback only.
+ *
+ * With fb_count 0 no frame buffer is allocated, only room for one DMA transfer: the
+ * rows reach the callback and nothing else, esp_camera_fb_get() returns NULL.
+ *
+ * Only YUV422, RGB565 and GRAYSCALE frames copied out of the DMA buffer have rows,
+ * JPEG and EDMA (16MHz XCLK) modes are not supported. A change takes effect from the
+ * next frame.
+ *
+ * @param cb    Callback, or NULL to stop calling it
+ * @param arg   Pointer to be passed to the callback
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ *      - ESP_ERR_NOT_SUPPORTED in JPEG or EDMA mode
+ */
+esp_err_t esp_camera_set_line_callback(camera_line_cb_t cb, void *arg);
+
 /**
  * @brief Get a pointer to the image sensor control structure
  *
@@ -235,6 +426,43 @@ esp_err_t esp_camera_save_to_nvs(const char *key);
  */
 esp_err_t esp_camera_load_from_nvs(const char *key);
 
+/**
+ * @brief Save the sensor registers as a profile in non-volatile-storage (NVS)
+ *
+ * Stores a raw snapshot of the registers the sensor driver programs, together
+ * with the pixel format, the sensor status and the sensor PID. Restoring it with
+ * esp_camera_load_profile() is one batched register write instead of replaying
+ * every setter like esp_camera_load_from_nvs() does.
+ *
+ * @param key   A unique nvs key name for the profile
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ *      - ESP_ERR_NOT_SUPPORTED if the sensor driver has no register snapshots
+ *      - ESP_FAIL if the registers could not be read, or an NVS error
+ */
+esp_err_t esp_camera_save_profile(const char *key);
+
+/**
+ * @brief Restore a profile saved with esp_camera_save_profile()
+ *
+ * If the profile was saved in another pixel format or frame size the capture is
+ * switched like esp_camera_switch_mode() does, and every frame buffer has to be
+ * returned first.
+ *
+ * @param key   A unique nvs key name for the profile
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet, is suspended or frame buffers are still held
+ *      - ESP_ERR_NOT_SUPPORTED if the sensor driver has no register snapshots
+ *      - ESP_ERR_INVALID_VERSION if the profile was saved by an incompatible driver
+ *      - ESP_ERR_CAMERA_NOT_SUPPORTED if the profile was saved with another sensor
+ *      - ESP_FAIL if the sensor could not be written, capture goes on in the old mode
+ */
+esp_err_t esp_camera_load_profile(const char *key);
+
 /**
  * @brief Return all frame buffers to be reused again.
  */
@@ -10,6 +10,7 @@
 #define __SENSOR_H__
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -215,12 +216,14 @@ typedef struct _sensor {
     pixformat_t pixformat;
     camera_status_t status;
     int xclk_freq_hz;
+    struct sccb_shadow *shadow; // Register shadow of the drivers that keep one, NULL otherwise
 
     // Sensor function pointers
     int  (*init_status)         (sensor_t *sensor);
     int  (*reset)               (sensor_t *sensor); // Reset the configuration of the sensor, and return ESP_OK if reset is successful
     int  (*set_pixformat)       (sensor_t *sensor, pixformat_t pixformat);
     int  (*set_framesize)       (sensor_t *sensor, framesize_t framesize);
+    int  (*set_mode)            (sensor_t *sensor, pixformat_t pixformat, framesize_t framesize); // Both at once, writing only what changes. NULL if not supported
     int  (*set_contrast)        (sensor_t *sensor, int level);
     int  (*set_brightness)      (sensor_t *sensor, int level);
     int  (*set_saturation)      (sensor_t *sensor, int level);
@@ -256,6 +259,10 @@ typedef struct _sensor {
     int  (*set_res_raw)         (sensor_t *sensor, int startX, int startY, int endX, int endY, int offsetX, int offsetY, int totalX, int totalY, int outputX, int outputY, bool scale, bool binning);
     int  (*set_pll)             (sensor_t *sensor, int bypass, int mul, int sys, int root, int pre, int seld5, int pclken, int pclk);
     int  (*set_xclk)            (sensor_t *sensor, int timer, int xclk);
+
+    int  (*save_regs)           (sensor_t *sensor, uint8_t *buf, size_t size); // Snapshot of the tuned registers, returns its length or -1. NULL if not supported
+    int  (*load_regs)           (sensor_t *sensor, const uint8_t *buf, size_t len); // Writes a save_regs snapshot back in one batched pass
+    int  (*set_standby)         (sensor_t *sensor, int enable); // Software standby that keeps the registers, needs XCLK to leave it. NULL if not supported
 } sensor_t;
 
 camera_sensor_info_t *esp_camera_sensor_get_info(sensor_id_t *id);
@@ -47,16 +47,60 @@ esp_err_t cam_init(const camera_config_t *config);
 
 esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint16_t sensor_pid);
 
+/**
+ * @brief Switch the capture to another pixel format and frame size without cam_deinit()
+ *
+ * Stops the capture, parks cam_task, re-plans the DMA and grows the frame buffers
+ * that are too small for the new mode. Capture stays stopped until cam_start().
+ * Frames of the old mode that were not taken are dropped.
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_STATE Not configured, or the application still holds frame buffers
+ *     - ESP_ERR_NOT_SUPPORTED With a luma plane, JPEG without frame buffers or JPEG with frame stats
+ *     - ESP_FAIL Out of memory, only cam_deinit() is left
+ */
+esp_err_t cam_reconfig(pixformat_t pixformat, framesize_t frame_size, uint32_t xclk_freq_hz, uint16_t sensor_pid);
+
+/**
+ * @brief Stop the capture and park cam_task, keeping the DMA plan and the frame buffers
+ *
+ * Frames that were not taken are dropped, frames the application holds stay valid.
+ * cam_reconfig() is refused until cam_resume().
+ *
+ * @return
+ *     - ESP_OK Success, also if the capture was suspended already
+ *     - ESP_ERR_INVALID_STATE Not configured
+ */
+esp_err_t cam_suspend(void);
+
+/**
+ * @brief Wake cam_task parked by cam_suspend() and start the capture
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_STATE Not suspended
+ */
+esp_err_t cam_resume(void);
+
 void cam_stop(void);
 
 void cam_start(void);
 
 camera_fb_t *cam_take(TickType_t timeout);
 
+void cam_retain(camera_fb_t *dma_buffer);
+
 void cam_give(camera_fb_t *dma_buffer);
 
 void cam_give_all(void);
 
+uint32_t cam_get_starved_count(void);
+
+void cam_get_drop_stats(camera_drop_stats_t *stats);
+
+esp_err_t cam_set_line_callback(camera_line_cb_t cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
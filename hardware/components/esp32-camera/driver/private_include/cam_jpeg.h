@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * JPEG marker search for the copies of cam_task.
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Find the first 0xFF byte, testing a 32-bit word at a time
+ *
+ * @param buf Data to search
+ * @param len Length of the data
+ *
+ * @return Offset of the first 0xFF byte, or len if there is none
+ */
+size_t cam_jpeg_find_ff(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Find the first JPEG SOI marker (FF D8 FF)
+ *
+ * @param buf Data to search
+ * @param len Length of the data
+ *
+ * @return Offset of the marker, or -1 if there is none
+ */
+int cam_jpeg_find_soi(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Find the first JPEG EOI marker (FF D9) starting at or after an offset
+ *
+ * Meant to be called on every chunk of a frame as it arrives: pass the offset of
+ * the new data minus one, so a marker split over two chunks is still found.
+ * Entropy coded data has every 0xFF stuffed, so the first EOI is the end of the image.
+ *
+ * @param buf  Start of the frame
+ * @param from First offset the marker may start at
+ * @param len  Bytes of the frame received so far
+ *
+ * @return Offset of the marker, or -1 if there is none
+ */
+int cam_jpeg_find_eoi(const uint8_t *buf, size_t from, size_t len);
+
+#define CAM_JPEG_SIZE_HISTORY   32  // frames the buffer size follows
+#define CAM_JPEG_SIZE_MARGIN    4   // buffers are 1/4 larger than the size percentile
+#define CAM_JPEG_OVERFLOW_HOLD  128 // frames the buffers stay grown after an overflow
+
+/**
+ * @brief Buffer size for adaptive JPEG frame buffers
+ *
+ * Keeps the sizes of the last CAM_JPEG_SIZE_HISTORY frames, sorted, and sizes
+ * the buffers for their 95th percentile plus a margin. A frame that did not
+ * fit counts as twice the buffer it overflowed, and the buffers stay at least
+ * that large for CAM_JPEG_OVERFLOW_HOLD frames: they grow at the first overflow
+ * when the scene gets busier, large frames that come back now and then are not
+ * dropped every time, and the buffers shrink once no frame overflowed for a while.
+ */
+typedef struct {
+    uint32_t recent[CAM_JPEG_SIZE_HISTORY];//ring of frame sizes, oldest at pos once full
+    uint32_t sorted[CAM_JPEG_SIZE_HISTORY];//the same sizes, ascending
+    uint8_t pos;
+    uint8_t count;
+    uint32_t chunk;//buffer sizes are whole DMA copies
+    uint32_t max;//the fixed frame buffer size
+    uint32_t floor;//smallest target after an overflow
+    uint8_t floor_frames;//frames until the floor is dropped
+    uint32_t overflows;//frames that did not fit their buffer
+    uint32_t resizes;//buffers reallocated
+} cam_jpeg_sizer_t;
+
+/**
+ * @brief Start with no history
+ *
+ * @param sizer Sizer to initialize
+ * @param chunk Bytes of JPEG data per DMA copy
+ * @param max   Largest buffer size
+ */
+void cam_jpeg_sizer_init(cam_jpeg_sizer_t *sizer, size_t chunk, size_t max);
+
+/**
+ * @brief Add the size of a received frame
+ */
+void cam_jpeg_sizer_add(cam_jpeg_sizer_t *sizer, size_t len);
+
+/**
+ * @brief Record a frame that did not fit a buffer of size bytes
+ */
+void cam_jpeg_sizer_overflow(cam_jpeg_sizer_t *sizer, size_t size);
+
+/**
+ * @brief Buffer size for the frames in the history, 0 while it is empty
+ */
+size_t cam_jpeg_sizer_target(const cam_jpeg_sizer_t *sizer);
+
+/**
+ * @brief Check whether a buffer should be reallocated before the next capture
+ *
+ * Buffers grow as soon as they are below the target and shrink only once they
+ * are a quarter above it, so a size near the edge does not reallocate every frame.
+ *
+ * @param sizer    Sizer with the recent frames
+ * @param size     Current buffer size
+ * @param new_size Set to the size to reallocate to
+ *
+ * @return true if the buffer should be reallocated
+ */
+bool cam_jpeg_sizer_resize(const cam_jpeg_sizer_t *sizer, size_t size, size_t *new_size);
+
+#ifdef __cplusplus
+}
+#endif
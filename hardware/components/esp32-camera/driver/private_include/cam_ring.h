@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Lock-free ring of frame indices between cam_task and cam_take.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAM_RING_MAX 32
+
+/**
+ * @brief Single producer, single consumer ring of frame indices
+ *
+ * cam_task pushes, cam_take pops. The producer may also pop the oldest entry to
+ * recycle a frame nobody took yet: head only moves forward through a compare and
+ * swap, so each entry goes to exactly one of the two.
+ */
+typedef struct {
+    _Atomic uint32_t head;          // next entry to pop
+    _Atomic uint32_t tail;          // next entry to push, written by the producer only
+    uint32_t size;                  // capacity, up to CAM_RING_MAX
+    _Atomic uint8_t slots[CAM_RING_MAX];
+} cam_ring_t;
+
+/**
+ * @brief Empty the ring and set its capacity
+ */
+void cam_ring_init(cam_ring_t *ring, uint32_t size);
+
+/**
+ * @brief Add an entry, producer only
+ *
+ * @return false if the ring is full
+ */
+bool cam_ring_push(cam_ring_t *ring, uint8_t value);
+
+/**
+ * @brief Remove the oldest entry
+ *
+ * @return false if the ring is empty
+ */
+bool cam_ring_pop(cam_ring_t *ring, uint8_t *value);
+
+/**
+ * @brief Number of entries, exact only while the other side is idle
+ */
+uint32_t cam_ring_count(cam_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Luma statistics of a frame, measured while cam_task copies it.
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Luma statistics of the frame being copied, see camera_frame_stats_t
+ *
+ * cam_task hands over the frame after every DMA copy and the rows it completed
+ * are measured while they are still in the cache. The row above is read back
+ * from the frame buffer, so the copies do not have to end on a row.
+ */
+typedef struct {
+    camera_frame_stats_t *out;      // stats of the frame, NULL when the frame has none
+    uint16_t width;                 // frame size in pixels
+    uint16_t height;
+    uint8_t bytes_per_pixel;        // 2 for YUV422, the Y comes first, 1 for GRAYSCALE
+    uint16_t y;                     // next row to measure
+    uint8_t tile_row;               // grid row of y
+    uint16_t tile_x[CAMERA_STATS_GRID + 1]; // first column of every grid column, and the width
+    uint16_t tile_y[CAMERA_STATS_GRID + 1]; // first row of every grid row, and the height
+    uint32_t tile_sum[CAMERA_STATS_GRID * CAMERA_STATS_GRID];
+    uint64_t grad;                  // sum of the squared differences
+} cam_stats_t;
+
+/**
+ * @brief Set the frame geometry, for a new mode
+ *
+ * @param stats             Accumulator
+ * @param width             Frame width in pixels
+ * @param height            Frame height in pixels
+ * @param bytes_per_pixel   Frame buffer bytes per pixel, 2 for YUV422 and 1 for GRAYSCALE
+ */
+void cam_stats_config(cam_stats_t *stats, uint16_t width, uint16_t height, uint8_t bytes_per_pixel);
+
+/**
+ * @brief Start the stats of a new frame
+ *
+ * @param stats Accumulator
+ * @param out   Stats of the frame, NULL for none
+ */
+void cam_stats_start(cam_stats_t *stats, camera_frame_stats_t *out);
+
+/**
+ * @brief Measure the rows completed by the last copy
+ *
+ * @param stats Accumulator
+ * @param frame Start of the frame buffer
+ * @param len   Bytes of the frame copied so far
+ */
+void cam_stats_add(cam_stats_t *stats, const uint8_t *frame, size_t len);
+
+/**
+ * @brief Work out the means once the whole frame is in
+ */
+void cam_stats_finish(cam_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
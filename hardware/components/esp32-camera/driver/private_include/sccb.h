@@ -9,14 +9,52 @@
 #ifndef __SCCB_H__
 #define __SCCB_H__
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 int SCCB_Init(int pin_sda, int pin_scl);
 int SCCB_Use_Port(int sccb_i2c_port);
 int SCCB_Deinit(void);
 uint8_t SCCB_Probe(void);
+// Makes the device at the address usable without a probe, for an address known from before
+int SCCB_Install_Device(uint8_t slv_addr);
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg);
 int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data);
 uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data);
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data);
+
+// Writes runs of registers queued by a batch, each run as [n][register][n values]
+// with the register in big endian. Chained runs go out in one command list joined
+// by repeated STARTs, otherwise every run is a transaction of its own. `sent` gets
+// the bytes of runs in the command lists that went through, a failed chain is not
+// sent as a whole.
+int SCCB_Write_Runs(uint8_t slv_addr, uint8_t reg_bytes, bool chain, const uint8_t *runs, size_t len, size_t *sent);
+
+#define SCCB_BATCH_SIZE 128
+
+// How a sensor takes batched writes. The driver keeps it across its batches, so a
+// sensor that refused a run or a chain once stays on single writes.
+typedef struct {
+    uint8_t burst;              // longest run, 1 for sensors without auto-increment
+    bool chain;                 // the sensor takes a repeated START between writes
+} sccb_batch_mode_t;
+
+// Register writes queued for SCCB_Write_Runs. Writes to consecutive registers are
+// merged into one auto-increment run of up to `burst` values.
+typedef struct {
+    uint8_t slv_addr;
+    uint8_t reg_bytes;          // 1 or 2 byte register addresses
+    sccb_batch_mode_t *mode;
+    uint16_t len;               // bytes queued in buf
+    uint16_t run;               // offset of the last run in buf
+    uint16_t next_reg;          // register that continues the last run
+    uint8_t buf[SCCB_BATCH_SIZE];
+} sccb_batch_t;
+
+void SCCB_Batch_Init(sccb_batch_t *batch, uint8_t slv_addr, uint8_t reg_bytes, sccb_batch_mode_t *mode);
+int SCCB_Batch_Write(sccb_batch_t *batch, uint16_t reg, uint8_t data);
+// Flushes the queued writes, then waits. For the REG_DLY entries of register lists.
+int SCCB_Batch_Delay(sccb_batch_t *batch, uint32_t ms);
+int SCCB_Batch_Flush(sccb_batch_t *batch);
 #endif // __SCCB_H__
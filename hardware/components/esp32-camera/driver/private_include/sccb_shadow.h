@@ -0,0 +1,41 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Write-through shadow of sensor registers.
+ *
+ */
+#ifndef __SCCB_SHADOW_H__
+#define __SCCB_SHADOW_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCCB_SHADOW_SIZE 512    // direct mapped slots, a power of two
+
+// Registers the sensor changes by itself or that act on every write, never shadowed
+typedef bool (*sccb_shadow_volatile_t)(uint8_t bank, uint16_t reg);
+
+typedef struct sccb_shadow {
+    uint32_t key[SCCB_SHADOW_SIZE];     // 0 for a free slot
+    uint8_t value[SCCB_SHADOW_SIZE];
+    sccb_shadow_volatile_t is_volatile;
+    bool verify;                        // read the hardware on every hit and compare
+    uint32_t hits;                      // reads answered from the shadow
+    uint32_t suppressed;                // writes of the value the register already has
+    uint32_t mismatches;                // shadow values the hardware did not have, when verifying
+} sccb_shadow_t;
+
+// All functions take NULL for a sensor without a shadow and then do nothing
+sccb_shadow_t *sccb_shadow_create(sccb_shadow_volatile_t is_volatile);
+void sccb_shadow_delete(sccb_shadow_t *shadow);
+// Forgets every register, after a software reset of the sensor
+void sccb_shadow_reset(sccb_shadow_t *shadow);
+bool sccb_shadow_get(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t *value);
+void sccb_shadow_set(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t value);
+void sccb_shadow_forget(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg);
+// True if the register is known to hold the value already, the write can be left out
+bool sccb_shadow_unchanged(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t value);
+bool sccb_shadow_verifying(const sccb_shadow_t *shadow);
+// Compares a shadowed value with the one read from the sensor and keeps the latter
+uint8_t sccb_shadow_check(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t hw_value);
+#endif // __SCCB_SHADOW_H__
@@ -0,0 +1,48 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "esp_err.h"
+#include "sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Find the sensor on the SCCB bus and attach its driver
+ *
+ * With CONFIG_CAMERA_CACHE_SENSOR_ID the address and model found are kept in RTC
+ * memory. After a reset or deep sleep only that sensor is asked for its ID, the
+ * whole bus is probed again if it does not answer with it.
+ *
+ * @param sensor            Sensor to fill in, slv_addr and id are set and the driver's init is called
+ * @param out_camera_model  Model of the sensor, CAMERA_NONE if there is none
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if nothing answers on the bus
+ *      - ESP_ERR_NOT_SUPPORTED if the sensor found has no driver
+ */
+esp_err_t sensor_detect(sensor_t *sensor, camera_model_t *out_camera_model);
+
+/**
+ * @brief Drop the remembered sensor, the next sensor_detect() probes the whole bus
+ */
+void sensor_detect_forget(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,3 +8,8 @@ esp_err_t xclk_timer_conf(int ledc_timer, int xclk_freq_hz);
 esp_err_t camera_enable_out_clock(const camera_config_t *config);
 
 void camera_disable_out_clock(void);
+
+// Stops the XCLK output of camera_enable_out_clock and starts it again, keeping its configuration
+void camera_suspend_out_clock(void);
+
+esp_err_t camera_resume_out_clock(void);
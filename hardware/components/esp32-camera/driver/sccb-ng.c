@@ -75,11 +75,26 @@ i2c_master_dev_handle_t *get_handle_from_address(uint8_t slv_addr)
     return NULL;
 }
 
+// the handle of a device SCCB_Install_Device added, NULL if it was not
+static i2c_master_dev_handle_t sccb_device(uint8_t slv_addr)
+{
+    i2c_master_dev_handle_t *handle = get_handle_from_address(slv_addr);
+    return handle ? *handle : NULL;
+}
+
 int SCCB_Install_Device(uint8_t slv_addr)
 {
     esp_err_t ret;
     i2c_master_bus_handle_t bus_handle;
 
+    for (uint8_t i = 0; i < device_count; i++)
+    {
+        if (slv_addr == devices[i].address)
+        {
+            return 0;
+        }
+    }
+
     if (device_count > MAX_DEVICES)
     {
         ESP_LOGE(TAG, "cannot add more than %d devices", MAX_DEVICES);
@@ -235,7 +250,11 @@ uint8_t SCCB_Probe(void)
 
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
 {
-    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
 
     uint8_t tx_buffer[1];
     uint8_t rx_buffer[1];
@@ -254,7 +273,11 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
 
 int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data)
 {
-    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
 
     uint8_t tx_buffer[2];
     tx_buffer[0] = reg;
@@ -272,7 +295,11 @@ int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data)
 
 uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
 {
-    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
 
     uint8_t rx_buffer[1];
 
@@ -291,7 +318,11 @@ uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
 
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
 {
-    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
 
     uint8_t tx_buffer[3];
     tx_buffer[0] = reg >> 8;
@@ -309,7 +340,11 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
 
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
 {
-    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
 
     uint8_t rx_buffer[2];
 
@@ -329,7 +364,11 @@ uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
 
 int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
 {
-    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
 
     uint8_t tx_buffer[4];
     tx_buffer[0] = reg >> 8;
@@ -345,3 +384,30 @@ int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
     }
     return ret == ESP_OK ? 0 : -1;
 }
+
+int SCCB_Write_Runs(uint8_t slv_addr, uint8_t reg_bytes, bool chain, const uint8_t *runs, size_t len, size_t *sent)
+{
+    i2c_master_dev_handle_t dev_handle = sccb_device(slv_addr);
+    esp_err_t ret = ESP_OK;
+
+    // the master driver has no repeated START between writes, every run is a transmit of its own
+    *sent = 0;
+    if (dev_handle == NULL)
+    {
+        return -1;
+    }
+    for (size_t i = 0; ret == ESP_OK && i < len; i += 1 + reg_bytes + runs[i])
+    {
+        ret = i2c_master_transmit(dev_handle, &runs[i + 1], reg_bytes + runs[i], TIMEOUT_MS);
+        if (ret == ESP_OK)
+        {
+            *sent = i + 1 + reg_bytes + runs[i];
+        }
+    }
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "SCCB_Write_Runs Failed addr:0x%02x, ret:%d", slv_addr, ret);
+    }
+    return ret == ESP_OK ? 0 : -1;
+}
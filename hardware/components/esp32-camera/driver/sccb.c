@@ -115,6 +115,12 @@ uint8_t SCCB_Probe(void)
     return 0;
 }
 
+int SCCB_Install_Device(uint8_t slv_addr)
+{
+    // the legacy driver addresses devices by their address alone
+    return 0;
+}
+
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
 {
     uint8_t data=0;
@@ -259,3 +265,29 @@ int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
     }
     return ret == ESP_OK ? 0 : -1;
 }
+
+int SCCB_Write_Runs(uint8_t slv_addr, uint8_t reg_bytes, bool chain, const uint8_t *runs, size_t len, size_t *sent)
+{
+    esp_err_t ret = ESP_OK;
+    size_t i = 0;
+    *sent = 0;
+    while (ret == ESP_OK && i < len) {
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+        do {
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+            i2c_master_write(cmd, &runs[i + 1], reg_bytes + runs[i], ACK_CHECK_EN);
+            i += 1 + reg_bytes + runs[i];
+        } while (chain && i < len);
+        i2c_master_stop(cmd);
+        ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+        i2c_cmd_link_delete(cmd);
+        if (ret == ESP_OK) {
+            *sent = i;
+        }
+    }
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "SCCB_Write_Runs Failed addr:0x%02x, ret:%d", slv_addr, ret);
+    }
+    return ret == ESP_OK ? 0 : -1;
+}
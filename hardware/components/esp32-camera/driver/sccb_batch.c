@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * SCCB batched register writes, on top of either I2C driver.
+ *
+ */
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "sccb.h"
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#else
+#include "esp_log.h"
+static const char *TAG = "sccb";
+#endif
+
+void SCCB_Batch_Init(sccb_batch_t *batch, uint8_t slv_addr, uint8_t reg_bytes, sccb_batch_mode_t *mode)
+{
+    batch->slv_addr = slv_addr;
+    batch->reg_bytes = reg_bytes;
+    batch->mode = mode;
+    if (!mode->burst) {
+        mode->burst = 1;
+    }
+    batch->len = 0;
+    batch->run = 0;
+    batch->next_reg = 0;
+}
+
+// The sensor did not take the runs, send every register from offset `from` on its own
+static int sccb_batch_write_single(sccb_batch_t *batch, size_t from)
+{
+    const uint8_t *buf = batch->buf;
+    for (size_t i = from; i < batch->len; i += 1 + batch->reg_bytes + buf[i]) {
+        uint16_t reg = batch->reg_bytes == 2 ? (buf[i + 1] << 8) | buf[i + 2] : buf[i + 1];
+        const uint8_t *data = &buf[i + 1 + batch->reg_bytes];
+        for (size_t n = 0; n < buf[i]; n++) {
+            int ret = batch->reg_bytes == 2 ? SCCB_Write16(batch->slv_addr, reg + n, data[n])
+                                            : SCCB_Write(batch->slv_addr, reg + n, data[n]);
+            if (ret) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * The runs after the last command list that went through are sent again one
+ * register at a time. Those of a failed chain may have been taken in part, the
+ * sensor then gets some of their writes twice, in the order of the batch, so
+ * every register still ends up with the value written last. Index registers of
+ * indirect tables are the exception: a batch starts their sequences in a
+ * command list of its own, see load_regs of the OV2640.
+ */
+int SCCB_Batch_Flush(sccb_batch_t *batch)
+{
+    int ret = 0;
+    size_t sent = 0;
+    sccb_batch_mode_t *mode = batch->mode;
+    if (!batch->len) {
+        return 0;
+    }
+    if (mode->burst > 1 || mode->chain) {
+        ret = SCCB_Write_Runs(batch->slv_addr, batch->reg_bytes, mode->chain, batch->buf, batch->len, &sent);
+        if (ret) {
+            ESP_LOGW(TAG, "batched write to 0x%02x failed, single writes from now on", batch->slv_addr);
+            mode->burst = 1;
+            mode->chain = false;
+        }
+    }
+    if (mode->burst == 1 && !mode->chain) {
+        ret = sccb_batch_write_single(batch, sent);
+    }
+    batch->len = 0;
+    return ret;
+}
+
+int SCCB_Batch_Write(sccb_batch_t *batch, uint16_t reg, uint8_t data)
+{
+    uint8_t *buf = batch->buf;
+    if (batch->len && reg == batch->next_reg && buf[batch->run] < batch->mode->burst && batch->len < SCCB_BATCH_SIZE) {
+        buf[batch->len++] = data;
+        buf[batch->run]++;
+        batch->next_reg++;
+        return 0;
+    }
+    if (batch->len + 2 + batch->reg_bytes > SCCB_BATCH_SIZE) {
+        int ret = SCCB_Batch_Flush(batch);
+        if (ret) {
+            return ret;
+        }
+    }
+    batch->run = batch->len;
+    buf[batch->len++] = 1;
+    if (batch->reg_bytes == 2) {
+        buf[batch->len++] = reg >> 8;
+    }
+    buf[batch->len++] = reg & 0xff;
+    buf[batch->len++] = data;
+    batch->next_reg = reg + 1;
+    return 0;
+}
+
+int SCCB_Batch_Delay(sccb_batch_t *batch, uint32_t ms)
+{
+    int ret = SCCB_Batch_Flush(batch);
+    vTaskDelay(ms / portTICK_PERIOD_MS);
+    return ret;
+}
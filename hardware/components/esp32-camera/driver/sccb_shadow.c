@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Write-through shadow of sensor registers.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "sccb_shadow.h"
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#else
+#include "esp_log.h"
+static const char *TAG = "sccb_shadow";
+#endif
+
+#ifndef CONFIG_SCCB_SHADOW_VERIFY
+#define CONFIG_SCCB_SHADOW_VERIFY 0
+#endif
+
+static inline uint32_t shadow_key(uint8_t bank, uint16_t reg)
+{
+    return 0x80000000 | ((uint32_t)bank << 16) | reg;
+}
+
+// 8 bit registers of up to two banks get a slot each, 16 bit ones are spread by their high bits
+static inline uint32_t shadow_slot(uint8_t bank, uint16_t reg)
+{
+    return (reg ^ ((reg >> 9) * 0x61) ^ (bank << 8)) & (SCCB_SHADOW_SIZE - 1);
+}
+
+sccb_shadow_t *sccb_shadow_create(sccb_shadow_volatile_t is_volatile)
+{
+    sccb_shadow_t *shadow = calloc(1, sizeof(sccb_shadow_t));
+    if (!shadow) {
+        ESP_LOGW(TAG, "No memory for the register shadow, every access goes to the sensor");
+        return NULL;
+    }
+    shadow->is_volatile = is_volatile;
+    shadow->verify = CONFIG_SCCB_SHADOW_VERIFY;
+    return shadow;
+}
+
+void sccb_shadow_delete(sccb_shadow_t *shadow)
+{
+    free(shadow);
+}
+
+void sccb_shadow_reset(sccb_shadow_t *shadow)
+{
+    if (shadow) {
+        memset(shadow->key, 0, sizeof(shadow->key));
+    }
+}
+
+static bool shadow_skip(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg)
+{
+    return !shadow || (shadow->is_volatile && shadow->is_volatile(bank, reg));
+}
+
+bool sccb_shadow_get(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t *value)
+{
+    if (shadow_skip(shadow, bank, reg)) {
+        return false;
+    }
+    uint32_t slot = shadow_slot(bank, reg);
+    if (shadow->key[slot] != shadow_key(bank, reg)) {
+        return false;
+    }
+    shadow->hits++;
+    *value = shadow->value[slot];
+    return true;
+}
+
+void sccb_shadow_set(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t value)
+{
+    if (shadow_skip(shadow, bank, reg)) {
+        return;
+    }
+    uint32_t slot = shadow_slot(bank, reg);
+    shadow->key[slot] = shadow_key(bank, reg);
+    shadow->value[slot] = value;
+}
+
+void sccb_shadow_forget(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg)
+{
+    if (!shadow) {
+        return;
+    }
+    uint32_t slot = shadow_slot(bank, reg);
+    if (shadow->key[slot] == shadow_key(bank, reg)) {
+        shadow->key[slot] = 0;
+    }
+}
+
+bool sccb_shadow_unchanged(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t value)
+{
+    if (shadow_skip(shadow, bank, reg)) {
+        return false;
+    }
+    uint32_t slot = shadow_slot(bank, reg);
+    if (shadow->key[slot] != shadow_key(bank, reg) || shadow->value[slot] != value) {
+        return false;
+    }
+    shadow->suppressed++;
+    return true;
+}
+
+bool sccb_shadow_verifying(const sccb_shadow_t *shadow)
+{
+    return shadow && shadow->verify;
+}
+
+uint8_t sccb_shadow_check(sccb_shadow_t *shadow, uint8_t bank, uint16_t reg, uint8_t hw_value)
+{
+    if (shadow_skip(shadow, bank, reg)) {
+        return hw_value;
+    }
+    uint32_t slot = shadow_slot(bank, reg);
+    if (shadow->key[slot] == shadow_key(bank, reg) && shadow->value[slot] != hw_value) {
+        ESP_LOGE(TAG, "Shadow of bank %u reg 0x%04x is 0x%02x, the sensor has 0x%02x", bank, reg, shadow->value[slot], hw_value);
+        shadow->mismatches++;
+        shadow->value[slot] = hw_value;
+    }
+    return hw_value;
+}
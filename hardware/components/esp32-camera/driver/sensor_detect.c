@@ -0,0 +1,243 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "sccb.h"
+#include "sensor_detect.h"
+#if CONFIG_OV2640_SUPPORT
+#include "ov2640.h"
+#endif
+#if CONFIG_OV7725_SUPPORT
+#include "ov7725.h"
+#endif
+#if CONFIG_OV3660_SUPPORT
+#include "ov3660.h"
+#endif
+#if CONFIG_OV5640_SUPPORT
+#include "ov5640.h"
+#endif
+#if CONFIG_NT99141_SUPPORT
+#include "nt99141.h"
+#endif
+#if CONFIG_OV7670_SUPPORT
+#include "ov7670.h"
+#endif
+#if CONFIG_GC2145_SUPPORT
+#include "gc2145.h"
+#endif
+#if CONFIG_GC032A_SUPPORT
+#include "gc032a.h"
+#endif
+#if CONFIG_GC0308_SUPPORT
+#include "gc0308.h"
+#endif
+#if CONFIG_BF3005_SUPPORT
+#include "bf3005.h"
+#endif
+#if CONFIG_BF20A6_SUPPORT
+#include "bf20a6.h"
+#endif
+#if CONFIG_SC101IOT_SUPPORT
+#include "sc101iot.h"
+#endif
+#if CONFIG_SC030IOT_SUPPORT
+#include "sc030iot.h"
+#endif
+#if CONFIG_SC031GS_SUPPORT
+#include "sc031gs.h"
+#endif
+#if CONFIG_MEGA_CCM_SUPPORT
+#include "mega_ccm.h"
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char *TAG = "camera";
+#endif
+
+typedef struct {
+    camera_model_t model;
+    int (*detect)(int slv_addr, sensor_id_t *id);
+    int (*init)(sensor_t *sensor);
+} sensor_func_t;
+
+static const sensor_func_t g_sensors[] = {
+#if CONFIG_OV7725_SUPPORT
+    {CAMERA_OV7725, ov7725_detect, ov7725_init},
+#endif
+#if CONFIG_OV7670_SUPPORT
+    {CAMERA_OV7670, ov7670_detect, ov7670_init},
+#endif
+#if CONFIG_OV2640_SUPPORT
+    {CAMERA_OV2640, ov2640_detect, ov2640_init},
+#endif
+#if CONFIG_OV3660_SUPPORT
+    {CAMERA_OV3660, ov3660_detect, ov3660_init},
+#endif
+#if CONFIG_OV5640_SUPPORT
+    {CAMERA_OV5640, ov5640_detect, ov5640_init},
+#endif
+#if CONFIG_NT99141_SUPPORT
+    {CAMERA_NT99141, nt99141_detect, nt99141_init},
+#endif
+#if CONFIG_GC2145_SUPPORT
+    {CAMERA_GC2145, gc2145_detect, gc2145_init},
+#endif
+#if CONFIG_GC032A_SUPPORT
+    {CAMERA_GC032A, gc032a_detect, gc032a_init},
+#endif
+#if CONFIG_GC0308_SUPPORT
+    {CAMERA_GC0308, gc0308_detect, gc0308_init},
+#endif
+#if CONFIG_BF3005_SUPPORT
+    {CAMERA_BF3005, bf3005_detect, bf3005_init},
+#endif
+#if CONFIG_BF20A6_SUPPORT
+    {CAMERA_BF20A6, bf20a6_detect, bf20a6_init},
+#endif
+#if CONFIG_SC101IOT_SUPPORT
+    {CAMERA_SC101IOT, sc101iot_detect, sc101iot_init},
+#endif
+#if CONFIG_SC030IOT_SUPPORT
+    {CAMERA_SC030IOT, sc030iot_detect, sc030iot_init},
+#endif
+#if CONFIG_SC031GS_SUPPORT
+    {CAMERA_SC031GS, sc031gs_detect, sc031gs_init},
+#endif
+#if CONFIG_MEGA_CCM_SUPPORT
+    {CAMERA_MEGA_CCM, mega_ccm_detect, mega_ccm_init},
+#endif
+};
+
+#define SENSOR_COUNT (sizeof(g_sensors) / sizeof(g_sensors[0]))
+
+#if CONFIG_CAMERA_CACHE_SENSOR_ID
+#define SENSOR_ID_MAGIC 0x53454e53
+
+// RTC memory holds garbage after power on, the check word tells a kept entry from it
+typedef struct {
+    uint32_t magic;
+    uint8_t slv_addr;
+    uint8_t model;
+    uint16_t pid;
+    uint32_t check;
+} sensor_id_cache_t;
+
+static RTC_NOINIT_ATTR sensor_id_cache_t s_id_cache;
+
+static uint32_t id_cache_check(const sensor_id_cache_t *cache)
+{
+    return ~(cache->magic ^ ((uint32_t)cache->pid << 16 | cache->model << 8 | cache->slv_addr));
+}
+
+static void id_cache_store(uint8_t slv_addr, camera_model_t model, uint16_t pid)
+{
+    s_id_cache.magic = SENSOR_ID_MAGIC;
+    s_id_cache.slv_addr = slv_addr;
+    s_id_cache.model = model;
+    s_id_cache.pid = pid;
+    s_id_cache.check = id_cache_check(&s_id_cache);
+}
+
+static const sensor_func_t *id_cache_lookup(uint8_t *slv_addr)
+{
+    if (s_id_cache.magic != SENSOR_ID_MAGIC || s_id_cache.check != id_cache_check(&s_id_cache)) {
+        return NULL;
+    }
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        if (g_sensors[i].model == s_id_cache.model) {
+            *slv_addr = s_id_cache.slv_addr;
+            return &g_sensors[i];
+        }
+    }
+    return NULL;
+}
+#endif
+
+// Asks one driver for its sensor at the address
+static camera_sensor_info_t *sensor_identify(const sensor_func_t *drv, uint8_t slv_addr, sensor_id_t *id)
+{
+    if (!drv->detect(slv_addr, id)) {
+        return NULL;
+    }
+    return esp_camera_sensor_get_info(id);
+}
+
+static void sensor_attach(const sensor_func_t *drv, uint8_t slv_addr, const camera_sensor_info_t *info, sensor_t *sensor)
+{
+    ESP_LOGI(TAG, "Detected %s camera", info->name);
+    sensor->slv_addr = slv_addr;
+    drv->init(sensor);
+}
+
+esp_err_t sensor_detect(sensor_t *sensor, camera_model_t *out_camera_model)
+{
+    camera_sensor_info_t *info = NULL;
+    *out_camera_model = CAMERA_NONE;
+#if CONFIG_CAMERA_CACHE_SENSOR_ID
+    uint8_t cached_addr;
+    const sensor_func_t *cached = id_cache_lookup(&cached_addr);
+    // sccb-ng only knows the devices SCCB_Probe installed, and the bus was set up again since
+    if (cached && SCCB_Install_Device(cached_addr) == 0) {
+        info = sensor_identify(cached, cached_addr, &sensor->id);
+        if (info && info->model == s_id_cache.model && sensor->id.PID == s_id_cache.pid) {
+            ESP_LOGD(TAG, "Remembered camera at address=0x%02x", cached_addr);
+            *out_camera_model = info->model;
+            sensor_attach(cached, cached_addr, info, sensor);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "The remembered camera did not answer, probing the bus");
+        sensor_detect_forget();
+    }
+#endif
+
+    ESP_LOGD(TAG, "Searching for camera address");
+    uint8_t slv_addr = SCCB_Probe();
+    if (slv_addr == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "Detected camera at address=0x%02x", slv_addr);
+
+    /**
+     * Read sensor ID and then initialize sensor
+     * Attention: Some sensors have the same SCCB address. Therefore, several attempts may be made in the detection process
+     */
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        info = sensor_identify(&g_sensors[i], slv_addr, &sensor->id);
+        if (NULL != info) {
+            *out_camera_model = info->model;
+            sensor_attach(&g_sensors[i], slv_addr, info, sensor);
+            break;
+        }
+    }
+    if (CAMERA_NONE == *out_camera_model) { //If no supported sensors are detected
+        ESP_LOGE(TAG, "Detected camera not supported.");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#if CONFIG_CAMERA_CACHE_SENSOR_ID
+    id_cache_store(slv_addr, *out_camera_model, sensor->id.PID);
+#endif
+    return ESP_OK;
+}
+
+void sensor_detect_forget(void)
+{
+#if CONFIG_CAMERA_CACHE_SENSOR_ID
+    s_id_cache.magic = 0;
+#endif
+}
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sccb.h"
+#include "sccb_shadow.h"
 #include "xclk.h"
 #include "ov2640.h"
 #include "ov2640_regs.h"
@@ -25,6 +26,48 @@ static const char* TAG = "ov2640";
 #endif
 
 static volatile ov2640_bank_t reg_bank = BANK_MAX;
+static sccb_shadow_t *shadow;
+// load_regs chains single writes by repeated STARTs, until the sensor refuses them
+static sccb_batch_mode_t batch_mode;
+
+/*
+ * A mode switch runs the frame size and pixel format lists into a delta instead
+ * of the sensor. It keeps the last value of every register that differs from the
+ * shadow, and set_mode sends only those with one DSP bypass and one settle time.
+ */
+#define OV2640_DELTA_MAX 64
+typedef struct {
+    uint16_t reg[OV2640_DELTA_MAX];     // bank << 8 | register
+    uint8_t value[OV2640_DELTA_MAX];
+    size_t len;
+    bool overflow;
+    bool com7;                          // COM7 changes, see reg_window
+} ov2640_delta_t;
+static ov2640_delta_t *delta;
+
+// registers the AEC and AGC update, and the address/data pairs of the indirect tables
+static bool reg_volatile(uint8_t bank, uint16_t reg)
+{
+    if (bank == BANK_SENSOR) {
+        return reg == GAIN || reg == REG04 || reg == AEC || reg == REG45;
+    }
+    return reg == RESET || reg == BPADDR || reg == BPDATA || (reg >= 0x90 && reg <= 0x97);
+}
+
+// the sensor window a new resolution in COM7 reloads the defaults of, the lists write it after COM7
+static bool reg_window(uint8_t bank, uint8_t reg)
+{
+    return bank == BANK_SENSOR && (reg == COM1 || reg == REG32 || (reg >= HSTART && reg <= VSTOP));
+}
+
+static void forget_window(void)
+{
+    static const uint8_t window[] = {COM1, REG32, HSTART, HSTOP, VSTART, VSTOP};
+    for (size_t i = 0; i < sizeof(window); i++) {
+        sccb_shadow_forget(shadow, BANK_SENSOR, window[i]);
+    }
+}
+
 static int set_bank(sensor_t *sensor, ov2640_bank_t bank)
 {
     int res = 0;
@@ -35,53 +78,128 @@ static int set_bank(sensor_t *sensor, ov2640_bank_t bank)
     return res;
 }
 
-static int write_regs(sensor_t *sensor, const uint8_t (*regs)[2])
+// CONFIG_SCCB_SHADOW_VERIFY: the sensor's own value of a shadowed register
+static int verify_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg)
 {
-    int i=0, res = 0;
-    while (regs[i][0]) {
-        if (regs[i][0] == BANK_SEL) {
-            res = set_bank(sensor, regs[i][1]);
-        } else {
-            res = SCCB_Write(sensor->slv_addr, regs[i][0], regs[i][1]);
-        }
-        if (res) {
-            return res;
+    int ret = set_bank(sensor, bank);
+    if (ret) {
+        return ret;
+    }
+    return sccb_shadow_check(shadow, bank, reg, SCCB_Read(sensor->slv_addr, reg));
+}
+
+// RESET and the bypass are left to set_mode, which frames the whole delta with them
+static void delta_add(ov2640_bank_t bank, uint8_t reg, uint8_t value)
+{
+    uint8_t current;
+    if (bank == BANK_DSP && (reg == RESET || reg == R_BYPASS)) {
+        return;
+    }
+    uint16_t key = (bank << 8) | reg;
+    bool same = !(delta->com7 && reg_window(bank, reg)) && sccb_shadow_get(shadow, bank, reg, &current) && current == value;
+    for (size_t i = 0; i < delta->len; i++) {
+        if (delta->reg[i] == key) {
+            if (same) {
+                // written back to what the sensor has
+                delta->len--;
+                memmove(&delta->reg[i], &delta->reg[i + 1], (delta->len - i) * sizeof(delta->reg[0]));
+                memmove(&delta->value[i], &delta->value[i + 1], delta->len - i);
+            } else {
+                delta->value[i] = value;
+            }
+            return;
         }
-        i++;
     }
-    return res;
+    if (same) {
+        return;
+    }
+    if (delta->len == OV2640_DELTA_MAX) {
+        delta->overflow = true;
+        return;
+    }
+    delta->reg[delta->len] = key;
+    delta->value[delta->len++] = value;
+    delta->com7 |= bank == BANK_SENSOR && reg == COM7;
+}
+
+// The DSP needs this long after a window or format change, a mode switch waits once at the end
+static void settle(void)
+{
+    if (!delta) {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
 }
 
 static int write_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg, uint8_t value)
 {
+    if (reg == BANK_SEL) {
+        return set_bank(sensor, value);
+    }
+    if (delta) {
+        delta_add(bank, reg, value);
+        return 0;
+    }
+    if (sccb_shadow_unchanged(shadow, bank, reg, value)
+        && (!sccb_shadow_verifying(shadow) || verify_reg(sensor, bank, reg) == value)) {
+        return 0;
+    }
     int ret = set_bank(sensor, bank);
     if(!ret) {
         ret = SCCB_Write(sensor->slv_addr, reg, value);
     }
+    if (ret) {
+        sccb_shadow_forget(shadow, bank, reg);
+    } else if (bank == BANK_SENSOR && reg == COM7 && (value & COM7_SRST)) {
+        sccb_shadow_reset(shadow);
+        reg_bank = BANK_MAX;
+    } else {
+        sccb_shadow_set(shadow, bank, reg, value);
+        if (bank == BANK_SENSOR && reg == COM7) {
+            forget_window();
+        }
+    }
     return ret;
 }
 
-static int set_reg_bits(sensor_t *sensor, uint8_t bank, uint8_t reg, uint8_t offset, uint8_t mask, uint8_t value)
+// BANK_SEL entries only pick the bank of the registers after them, write_reg selects it when needed
+static int write_regs(sensor_t *sensor, const uint8_t (*regs)[2])
 {
-    int ret = 0;
-    uint8_t c_value, new_value;
-
-    ret = set_bank(sensor, bank);
-    if(ret) {
-        return ret;
+    int i=0, res = 0;
+    ov2640_bank_t bank = reg_bank;
+    while (regs[i][0]) {
+        if (regs[i][0] == BANK_SEL) {
+            bank = regs[i][1];
+        } else {
+            res = write_reg(sensor, bank, regs[i][0], regs[i][1]);
+        }
+        if (res) {
+            return res;
+        }
+        i++;
     }
-    c_value = SCCB_Read(sensor->slv_addr, reg);
-    new_value = (c_value & ~(mask << offset)) | ((value & mask) << offset);
-    ret = SCCB_Write(sensor->slv_addr, reg, new_value);
-    return ret;
+    return res;
 }
 
 static int read_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg)
 {
+    uint8_t value;
+    if (sccb_shadow_get(shadow, bank, reg, &value)) {
+        return sccb_shadow_verifying(shadow) ? verify_reg(sensor, bank, reg) : value;
+    }
     if(set_bank(sensor, bank)){
         return 0;
     }
-    return SCCB_Read(sensor->slv_addr, reg);
+    value = SCCB_Read(sensor->slv_addr, reg);
+    sccb_shadow_set(shadow, bank, reg, value);
+    return value;
+}
+
+static int set_reg_bits(sensor_t *sensor, uint8_t bank, uint8_t reg, uint8_t offset, uint8_t mask, uint8_t value)
+{
+    uint8_t c_value, new_value;
+    c_value = read_reg(sensor, bank, reg);
+    new_value = (c_value & ~(mask << offset)) | ((value & mask) << offset);
+    return write_reg(sensor, bank, reg, new_value);
 }
 
 static uint8_t get_reg_bits(sensor_t *sensor, uint8_t bank, uint8_t reg, uint8_t offset, uint8_t mask)
@@ -128,7 +246,7 @@ static int set_pixformat(sensor_t *sensor, pixformat_t pixformat)
         break;
     }
     if(!ret) {
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        settle();
     }
 
     return ret;
@@ -201,7 +319,7 @@ static int set_window(sensor_t *sensor, ov2640_sensor_mode_t mode, int offset_x,
     WRITE_REG_OR_RETURN(BANK_DSP, R_DVP_SP, c.pclk);
     WRITE_REG_OR_RETURN(BANK_DSP, R_BYPASS, R_BYPASS_DSP_EN);
 
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+    settle();
     //required when changing resolution
     set_pixformat(sensor, sensor->pixformat);
 
@@ -245,6 +363,209 @@ static int set_framesize(sensor_t *sensor, framesize_t framesize)
     return ret;
 }
 
+static int set_mode(sensor_t *sensor, pixformat_t pixformat, framesize_t framesize)
+{
+    int ret = 0;
+    ov2640_delta_t changes = { .len = 0 };
+
+    // set_window programs the pixel format too
+    sensor->pixformat = pixformat;
+    delta = &changes;
+    ret = set_framesize(sensor, framesize);
+    delta = NULL;
+    if (ret || changes.overflow || !shadow) {
+        ESP_LOGD(TAG, "Mode switch with the full register lists");
+        return set_framesize(sensor, framesize);
+    }
+    ESP_LOGD(TAG, "Mode switch to %d/%d: %u registers", pixformat, framesize, (unsigned)changes.len);
+    if (!changes.len) {
+        return 0;
+    }
+
+    WRITE_REG_OR_RETURN(BANK_DSP, R_BYPASS, R_BYPASS_DSP_BYPAS);
+    WRITE_REG_OR_RETURN(BANK_DSP, RESET, pixformat == PIXFORMAT_JPEG ? RESET_JPEG | RESET_DVP : RESET_DVP);
+    for (size_t i = 0; i < changes.len; i++) {
+        WRITE_REG_OR_RETURN(changes.reg[i] >> 8, changes.reg[i] & 0xff, changes.value[i]);
+    }
+    WRITE_REG_OR_RETURN(BANK_DSP, RESET, 0x00);
+    WRITE_REG_OR_RETURN(BANK_DSP, R_BYPASS, R_BYPASS_DSP_EN);
+    settle();
+    return ret;
+}
+
+/*
+ * Register profiles: save_regs reads back every register the register lists and
+ * the setters program, plus the SDE table behind BPADDR/BPDATA, as sections of
+ * [bank][n] followed by n register/value pairs. load_regs writes a snapshot in
+ * one chained batch framed by the DSP bypass, instead of replaying the setters,
+ * and leaves out the registers the shadow knows to hold their value already.
+ * The gamma and lens tables behind 0x90-0x97 come from the reset list only.
+ */
+#define OV2640_BANK_SDE 2       // pseudo bank of the SDE table, registers are its indices
+#define OV2640_SDE_SIZE 16
+static uint8_t profile_map[2][32];      // bitmaps of the saved registers per bank
+
+static void profile_mark(ov2640_bank_t bank, uint8_t reg)
+{
+    // trigger registers, the bypass load_regs frames the snapshot with and the indirect tables
+    if (reg == BANK_SEL || (bank == BANK_DSP && (reg == R_BYPASS || reg == MC_BIST || reg_volatile(bank, reg)))) {
+        return;
+    }
+    profile_map[bank][reg >> 3] |= 1 << (reg & 7);
+}
+
+static void profile_mark_list(const uint8_t (*regs)[2])
+{
+    ov2640_bank_t bank = BANK_DSP;
+    for (int i = 0; regs[i][0]; i++) {
+        if (regs[i][0] == BANK_SEL) {
+            bank = regs[i][1];
+        } else {
+            profile_mark(bank, regs[i][0]);
+        }
+    }
+}
+
+static void profile_init(void)
+{
+    static const uint8_t dsp_regs[] = {HSIZE, VSIZE, XOFFL, YOFFL, VHYX, TEST, ZMOW, ZMOH, ZMHH, R_DVP_SP, QS,
+                                       CTRL0, CTRL1, CTRL2, CTRL3, 0xC7};
+    static const uint8_t sensor_regs[] = {GAIN, REG04, COM7, CLKRC, COM8, COM9, AEC, REG45};
+    profile_mark_list(ov2640_settings_cif);
+    profile_mark_list(ov2640_settings_to_cif);
+    profile_mark_list(ov2640_settings_to_svga);
+    profile_mark_list(ov2640_settings_to_uxga);
+    profile_mark_list(ov2640_settings_jpeg3);
+    profile_mark_list(ov2640_settings_yuv422);
+    profile_mark_list(ov2640_settings_rgb565);
+    for (size_t i = 0; i < sizeof(dsp_regs); i++) {
+        profile_mark(BANK_DSP, dsp_regs[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        profile_mark(BANK_DSP, wb_modes_regs[0][i]);
+        profile_mark(BANK_SENSOR, ae_levels_regs[0][i]);
+    }
+    for (size_t i = 0; i < sizeof(sensor_regs); i++) {
+        profile_mark(BANK_SENSOR, sensor_regs[i]);
+    }
+}
+
+static bool profile_has(ov2640_bank_t bank, uint8_t reg)
+{
+    return profile_map[bank][reg >> 3] & (1 << (reg & 7));
+}
+
+static int save_regs(sensor_t *sensor, uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+    for (int bank = BANK_DSP; bank <= OV2640_BANK_SDE; bank++) {
+        int regs = bank == OV2640_BANK_SDE ? OV2640_SDE_SIZE : 256;
+        size_t head = len;
+        len += 2;
+        for (int reg = 0; reg < regs; reg++) {
+            int value;
+            if (bank == OV2640_BANK_SDE) {
+                if (write_reg(sensor, BANK_DSP, BPADDR, reg)) {
+                    return -1;
+                }
+                value = read_reg(sensor, BANK_DSP, BPDATA);
+            } else if (profile_has(bank, reg)) {
+                value = read_reg(sensor, bank, reg);
+                if (bank == BANK_SENSOR && reg == COM7) {
+                    value &= ~COM7_SRST;
+                }
+            } else {
+                continue;
+            }
+            if (len + 2 > size) {
+                return -1;
+            }
+            buf[len++] = reg;
+            buf[len++] = value;
+        }
+        buf[head] = bank;
+        buf[head + 1] = (len - head - 2) / 2;
+    }
+    return len;
+}
+
+static int load_regs(sensor_t *sensor, const uint8_t *buf, size_t len)
+{
+    // the whole snapshot is checked before anything is written
+    for (size_t i = 0; i < len; i += 2 + 2 * buf[i + 1]) {
+        if (i + 2 > len || buf[i] > OV2640_BANK_SDE || i + 2 + 2 * buf[i + 1] > len) {
+            ESP_LOGE(TAG, "Malformed register snapshot");
+            return -1;
+        }
+        for (size_t n = 0; n < buf[i + 1]; n++) {
+            uint8_t reg = buf[i + 2 + 2 * n];
+            if (buf[i] == OV2640_BANK_SDE ? reg >= OV2640_SDE_SIZE : !profile_has(buf[i], reg)) {
+                ESP_LOGE(TAG, "Register 0x%02x of bank %u is not part of a snapshot", reg, buf[i]);
+                return -1;
+            }
+        }
+    }
+
+    // no auto-increment on this sensor, but one command list carries many writes
+    sccb_batch_t batch;
+    SCCB_Batch_Init(&batch, sensor->slv_addr, 1, &batch_mode);
+    int ret = SCCB_Batch_Write(&batch, BANK_SEL, BANK_DSP);
+    ret = ret || SCCB_Batch_Write(&batch, R_BYPASS, R_BYPASS_DSP_BYPAS);
+    ret = ret || SCCB_Batch_Write(&batch, RESET, sensor->pixformat == PIXFORMAT_JPEG ? RESET_JPEG | RESET_DVP : RESET_DVP);
+    for (size_t i = 0; !ret && i < len; i += 2 + 2 * buf[i + 1]) {
+        const uint8_t *pairs = &buf[i + 2];
+        size_t n = buf[i + 1];
+        if (buf[i] == OV2640_BANK_SDE) {
+            // BPDATA steps the index, a failed list must not be sent again from the middle of the table
+            ret = SCCB_Batch_Flush(&batch);
+            ret = ret || SCCB_Batch_Write(&batch, BANK_SEL, BANK_DSP);
+            for (size_t k = 0; !ret && k < n; k++) {
+                // BPDATA steps the index, only gaps need a new one
+                if (!k || pairs[2 * k] != pairs[2 * k - 2] + 1) {
+                    ret = SCCB_Batch_Write(&batch, BPADDR, pairs[2 * k]);
+                }
+                ret = ret || SCCB_Batch_Write(&batch, BPDATA, pairs[2 * k + 1]);
+            }
+            continue;
+        }
+        ret = SCCB_Batch_Write(&batch, BANK_SEL, buf[i]);
+        // COM7 reloads the sensor window defaults, it goes before the rest of the bank and
+        // then the shadow can not tell which of them already have their value
+        bool skip = !sccb_shadow_verifying(shadow);
+        for (size_t k = 0; !ret && k < n; k++) {
+            if (buf[i] == BANK_SENSOR && pairs[2 * k] == COM7 && !sccb_shadow_unchanged(shadow, BANK_SENSOR, COM7, pairs[2 * k + 1])) {
+                ret = SCCB_Batch_Write(&batch, COM7, pairs[2 * k + 1]);
+                skip = false;
+            }
+        }
+        for (size_t k = 0; !ret && k < n; k++) {
+            if ((buf[i] != BANK_SENSOR || pairs[2 * k] != COM7)
+                && !(skip && sccb_shadow_unchanged(shadow, buf[i], pairs[2 * k], pairs[2 * k + 1]))) {
+                ret = SCCB_Batch_Write(&batch, pairs[2 * k], pairs[2 * k + 1]);
+            }
+        }
+    }
+    ret = ret || SCCB_Batch_Write(&batch, BANK_SEL, BANK_DSP);
+    ret = ret || SCCB_Batch_Write(&batch, RESET, 0x00);
+    ret = ret || SCCB_Batch_Write(&batch, R_BYPASS, R_BYPASS_DSP_EN);
+    ret = ret || SCCB_Batch_Flush(&batch);
+    if (ret) {
+        sccb_shadow_reset(shadow);
+        reg_bank = BANK_MAX;
+        return -1;
+    }
+
+    reg_bank = BANK_DSP;
+    for (size_t i = 0; i < len; i += 2 + 2 * buf[i + 1]) {
+        for (size_t n = 0; buf[i] != OV2640_BANK_SDE && n < buf[i + 1]; n++) {
+            sccb_shadow_set(shadow, buf[i], buf[i + 2 + 2 * n], buf[i + 3 + 2 * n]);
+        }
+    }
+    sccb_shadow_set(shadow, BANK_DSP, R_BYPASS, R_BYPASS_DSP_EN);
+    settle();
+    return 0;
+}
+
 static int set_contrast(sensor_t *sensor, int level)
 {
     int ret=0;
@@ -503,6 +824,12 @@ static int set_xclk(sensor_t *sensor, int timer, int xclk)
     return ret;
 }
 
+// Standby keeps the registers, the sensor only stops its clocks and counters
+static int set_standby(sensor_t *sensor, int enable)
+{
+    return write_reg_bits(sensor, BANK_SENSOR, COM2, COM2_STDBY, enable?1:0);
+}
+
 static int init_status(sensor_t *sensor){
     sensor->status.brightness = 0;
     sensor->status.contrast = 0;
@@ -565,10 +892,19 @@ int ov2640_detect(int slv_addr, sensor_id_t *id)
 
 int ov2640_init(sensor_t *sensor)
 {
+    // detection selected the sensor bank behind our back
+    reg_bank = BANK_MAX;
+    shadow = sccb_shadow_create(reg_volatile);
+    batch_mode = (sccb_batch_mode_t){ .burst = 1, .chain = true };
+    sensor->shadow = shadow;
+    profile_init();
     sensor->reset = reset;
     sensor->init_status = init_status;
     sensor->set_pixformat = set_pixformat;
     sensor->set_framesize = set_framesize;
+    sensor->set_mode = set_mode;
+    sensor->save_regs = save_regs;
+    sensor->load_regs = load_regs;
     sensor->set_contrast  = set_contrast;
     sensor->set_brightness= set_brightness;
     sensor->set_saturation= set_saturation;
@@ -607,6 +943,7 @@ int ov2640_init(sensor_t *sensor)
     sensor->set_res_raw = set_res_raw;
     sensor->set_pll = _set_pll;
     sensor->set_xclk = set_xclk;
+    sensor->set_standby = set_standby;
     ESP_LOGD(TAG, "OV2640 Attached");
     return 0;
 }
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sccb.h"
+#include "sccb_shadow.h"
 #include "xclk.h"
 #include "ov5640.h"
 #include "ov5640_regs.h"
@@ -26,16 +27,51 @@ static const char *TAG = "ov5640";
 
 //#define REG_DEBUG_ON
 
+static sccb_shadow_t *shadow;
+// auto-increment runs chained by repeated STARTs, until the sensor refuses them
+static sccb_batch_mode_t batch_mode;
+
+// reset and group commands, and the registers the AEC, AGC and AWB update
+static bool reg_volatile(uint8_t bank, uint16_t reg)
+{
+    return reg == SYSTEM_CTROL0 || reg == 0x3212
+        || (reg >= 0x3400 && reg <= 0x3406)
+        || (reg >= 0x3500 && reg <= 0x350d)
+        || (reg >= 0x56a0 && reg <= 0x56a1);
+}
+
 static int read_reg(uint8_t slv_addr, const uint16_t reg){
+    uint8_t value;
+    if (sccb_shadow_get(shadow, 0, reg, &value)) {
+        if (!sccb_shadow_verifying(shadow)) {
+            return value;
+        }
+        return sccb_shadow_check(shadow, 0, reg, SCCB_Read16(slv_addr, reg));
+    }
     int ret = SCCB_Read16(slv_addr, reg);
 #ifdef REG_DEBUG_ON
     if (ret < 0) {
         ESP_LOGE(TAG, "READ REG 0x%04x FAILED: %d", reg, ret);
     }
 #endif
+    if (ret >= 0) {
+        sccb_shadow_set(shadow, 0, reg, ret);
+    }
     return ret;
 }
 
+static void shadow_written(const uint16_t reg, uint8_t value, int ret)
+{
+    if (ret) {
+        sccb_shadow_forget(shadow, 0, reg);
+    } else if (reg == SYSTEM_CTROL0 && (value & 0x80)) {
+        // software reset
+        sccb_shadow_reset(shadow);
+    } else {
+        sccb_shadow_set(shadow, 0, reg, value);
+    }
+}
+
 static int check_reg_mask(uint8_t slv_addr, uint16_t reg, uint8_t mask){
     return (read_reg(slv_addr, reg) & mask) == mask;
 }
@@ -108,6 +144,10 @@ static int read_reg16(uint8_t slv_addr, const uint16_t reg){
 static int write_reg(uint8_t slv_addr, const uint16_t reg, uint8_t value){
     int ret = 0;
 #ifndef REG_DEBUG_ON
+    if (sccb_shadow_unchanged(shadow, 0, reg, value)
+        && (!sccb_shadow_verifying(shadow) || sccb_shadow_check(shadow, 0, reg, SCCB_Read16(slv_addr, reg)) == value)) {
+        return 0;
+    }
     ret = SCCB_Write16(slv_addr, reg, value);
 #else
     int old_value = read_reg(slv_addr, reg);
@@ -125,6 +165,7 @@ static int write_reg(uint8_t slv_addr, const uint16_t reg, uint8_t value){
         ESP_LOGE(TAG, "WRITE REG 0x%04x FAILED: %d", reg, ret);
     }
 #endif
+    shadow_written(reg, value, ret);
     return ret;
 }
 
@@ -145,14 +186,30 @@ static int set_reg_bits(uint8_t slv_addr, uint16_t reg, uint8_t offset, uint8_t
 static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
 {
     int i = 0, ret = 0;
+    // the OV5640 increments the register address after every data byte, so the
+    // consecutive registers of the lists go out as one write
+    sccb_batch_t batch;
+    SCCB_Batch_Init(&batch, slv_addr, 2, &batch_mode);
     while (!ret && regs[i][0] != REGLIST_TAIL) {
         if (regs[i][0] == REG_DLY) {
-            vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
+            ret = SCCB_Batch_Delay(&batch, regs[i][1]);
         } else {
+#ifndef REG_DEBUG_ON
+            ret = SCCB_Batch_Write(&batch, regs[i][0], regs[i][1]);
+            shadow_written(regs[i][0], regs[i][1], 0);
+#else
             ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+#endif
         }
         i++;
     }
+    if (!ret) {
+        ret = SCCB_Batch_Flush(&batch);
+    }
+    if (ret) {
+        // some of the queued writes may not have made it
+        sccb_shadow_reset(shadow);
+    }
     return ret;
 }
 
@@ -166,10 +223,12 @@ static int write_reg16(uint8_t slv_addr, const uint16_t reg, uint16_t value)
 
 static int write_addr_reg(uint8_t slv_addr, const uint16_t reg, uint16_t x_value, uint16_t y_value)
 {
-    if (write_reg16(slv_addr, reg, x_value) || write_reg16(slv_addr, reg + 2, y_value)) {
-        return -1;
-    }
-    return 0;
+    const uint16_t regs[][2] = {
+        {reg, x_value >> 8}, {reg + 1, x_value & 0xff},
+        {reg + 2, y_value >> 8}, {reg + 3, y_value & 0xff},
+        {REGLIST_TAIL, 0x00}
+    };
+    return write_regs(slv_addr, regs);
 }
 
 #define write_reg_bits(slv_addr, reg, mask, enable) set_reg_bits(slv_addr, reg, 0, mask, (enable)?(mask):0)
@@ -1043,6 +1102,12 @@ static int set_xclk(sensor_t *sensor, int timer, int xclk)
     return ret;
 }
 
+// Software power down keeps the registers, SYSTEM_CTROL0 is read back as it is never shadowed
+static int set_standby(sensor_t *sensor, int enable)
+{
+    return write_reg_bits(sensor->slv_addr, SYSTEM_CTROL0, 0x40, enable);
+}
+
 static int init_status(sensor_t *sensor)
 {
     sensor->status.brightness = 0;
@@ -1091,6 +1156,9 @@ int ov5640_detect(int slv_addr, sensor_id_t *id)
 
 int ov5640_init(sensor_t *sensor)
 {
+    shadow = sccb_shadow_create(reg_volatile);
+    batch_mode = (sccb_batch_mode_t){ .burst = UINT8_MAX, .chain = true };
+    sensor->shadow = shadow;
     sensor->reset = reset;
     sensor->set_pixformat = set_pixformat;
     sensor->set_framesize = set_framesize;
@@ -1126,5 +1194,6 @@ int ov5640_init(sensor_t *sensor)
     sensor->set_res_raw = set_res_raw;
     sensor->set_pll = _set_pll;
     sensor->set_xclk = set_xclk;
+    sensor->set_standby = set_standby;
     return 0;
 }
@@ -0,0 +1,179 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "esp_attr.h"
+#include "ll_cam_dma_filter.h"
+
+//sample1 of a DMA element, a byte of the frame in every sampling mode
+#define DMA_SAMPLE1(e)  (((e) >> 16) & 0xFF)
+//sample2, the second byte of a SM_0A0B_0C0D element
+#define DMA_SAMPLE2(e)  ((e) & 0xFF)
+
+/*
+ * The filters read whole DMA elements and write whole words of the frame buffer:
+ * four output bytes are packed with shifts and masks and stored at once, instead of
+ * four byte stores. The DMA buffer is always word aligned, the frame buffer position
+ * is not, so bytes are stored one at a time up to the first aligned word and after
+ * the last one.
+ */
+
+//Copy sample1 of n elements, stride elements apart
+static inline void copy_sample1(uint8_t* dst, const uint32_t* el, size_t n, size_t stride)
+{
+    for (; n && ((uintptr_t)dst & 3); n--, el += stride) {
+        *dst++ = DMA_SAMPLE1(el[0]);
+    }
+    uint32_t* out = (uint32_t*)dst;
+    for (size_t i = n / 4; i; i--, el += 4 * stride) {
+        *out++ = DMA_SAMPLE1(el[0]) | (DMA_SAMPLE1(el[stride]) << 8)
+            | (DMA_SAMPLE1(el[2 * stride]) << 16) | (DMA_SAMPLE1(el[3 * stride]) << 24);
+    }
+    dst = (uint8_t*)out;
+    for (n &= 3; n; n--, el += stride) {
+        *dst++ = DMA_SAMPLE1(el[0]);
+    }
+}
+
+//Both samples of two elements, y0 u y1 v
+static inline uint32_t pack_samples(const uint32_t* el)
+{
+    return DMA_SAMPLE1(el[0]) | (DMA_SAMPLE2(el[0]) << 8) | (DMA_SAMPLE1(el[1]) << 16) | (DMA_SAMPLE2(el[1]) << 24);
+}
+
+//Copy both samples of n elements
+static inline void copy_samples(uint8_t* dst, const uint32_t* el, size_t n)
+{
+    if ((uintptr_t)dst & 1) {
+        //never the case for whole pixels in an aligned frame buffer
+        for (; n; n--, el++) {
+            *dst++ = DMA_SAMPLE1(el[0]);
+            *dst++ = DMA_SAMPLE2(el[0]);
+        }
+        return;
+    }
+    if (n && ((uintptr_t)dst & 2)) {
+        *dst++ = DMA_SAMPLE1(el[0]);
+        *dst++ = DMA_SAMPLE2(el[0]);
+        el++;
+        n--;
+    }
+    uint32_t* out = (uint32_t*)dst;
+    for (size_t i = n / 2; i; i--, el += 2) {
+        *out++ = pack_samples(el);
+    }
+    if (n & 1) {
+        dst = (uint8_t*)out;
+        dst[0] = DMA_SAMPLE1(el[0]);
+        dst[1] = DMA_SAMPLE2(el[0]);
+    }
+}
+
+size_t IRAM_ATTR ll_cam_dma_filter_jpeg(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    size_t elements = len / sizeof(dma_elem_t);
+    copy_sample1(dst, (const uint32_t*)src, elements, 1);
+    return elements;
+}
+
+size_t IRAM_ATTR ll_cam_dma_filter_grayscale(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    size_t elements = len / sizeof(dma_elem_t);
+    copy_sample1(dst, (const uint32_t*)src, elements, 1);
+    return elements;
+}
+
+size_t IRAM_ATTR ll_cam_dma_filter_grayscale_highspeed(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const uint32_t* el = (const uint32_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t n = (elements / 8) * 4;
+    copy_sample1(dst, el, n, 2);
+    // the final sample of a line in SM_0A0B_0B0C sampling mode needs special handling
+    if ((elements & 0x7) != 0) {
+        dst[n] = DMA_SAMPLE1(el[2 * n]);
+        dst[n + 1] = DMA_SAMPLE1(el[2 * n + 2]);
+        elements += 1;
+    }
+    return elements / 2;
+}
+
+size_t IRAM_ATTR ll_cam_dma_filter_yuyv(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    size_t elements = len / sizeof(dma_elem_t);
+    copy_samples(dst, (const uint32_t*)src, elements);
+    return elements * 2;
+}
+
+size_t IRAM_ATTR ll_cam_dma_filter_yuyv_highspeed(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const uint32_t* el = (const uint32_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t n = (elements / 8) * 8;
+    copy_sample1(dst, el, n, 1);
+    if ((elements & 0x7) != 0) {
+        dst[n] = DMA_SAMPLE1(el[n]);//y0
+        dst[n + 1] = DMA_SAMPLE1(el[n + 1]);//u
+        dst[n + 2] = DMA_SAMPLE1(el[n + 2]);//y1
+        dst[n + 3] = DMA_SAMPLE2(el[n + 2]);//v
+        elements += 4;
+    }
+    return elements;
+}
+
+/*
+ * The luma filters store words only: with a luma plane the width is a multiple of 4
+ * and every DMA transfer whole lines, so each copy starts word aligned.
+ */
+size_t IRAM_ATTR ll_cam_dma_filter_yuyv_luma(uint8_t* dst, const uint8_t* src, size_t len, cam_luma_t *luma)
+{
+    const uint32_t* el = (const uint32_t*)src;
+    uint32_t* out = (uint32_t*)dst;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 4;
+    for (size_t i = 0; i < end; ++i) {
+        out[0] = pack_samples(el);
+        out[1] = pack_samples(el + 2);
+        //the four pixels are in one plane column, the plane is at least 4 times smaller
+        cam_luma_add(luma, DMA_SAMPLE1(el[0]) + DMA_SAMPLE1(el[1]) + DMA_SAMPLE1(el[2]) + DMA_SAMPLE1(el[3]), 4);
+        el += 4;
+        out += 2;
+    }
+    return elements * 2;
+}
+
+size_t IRAM_ATTR ll_cam_dma_filter_yuyv_highspeed_luma(uint8_t* dst, const uint8_t* src, size_t len, cam_luma_t *luma)
+{
+    const uint32_t* el = (const uint32_t*)src;
+    uint32_t* out = (uint32_t*)dst;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 8;
+    for (size_t i = 0; i < end; ++i) {
+        uint32_t y0 = DMA_SAMPLE1(el[0]), y1 = DMA_SAMPLE1(el[2]), y2 = DMA_SAMPLE1(el[4]), y3 = DMA_SAMPLE1(el[6]);
+        out[0] = y0 | (DMA_SAMPLE1(el[1]) << 8) | (y1 << 16) | (DMA_SAMPLE1(el[3]) << 24);
+        out[1] = y2 | (DMA_SAMPLE1(el[5]) << 8) | (y3 << 16) | (DMA_SAMPLE1(el[7]) << 24);
+        cam_luma_add(luma, y0 + y1 + y2 + y3, 4);
+        el += 8;
+        out += 2;
+    }
+    if ((elements & 0x7) != 0) {
+        dst = (uint8_t*)out;
+        dst[0] = DMA_SAMPLE1(el[0]);//y0
+        dst[1] = DMA_SAMPLE1(el[1]);//u
+        dst[2] = DMA_SAMPLE1(el[2]);//y1
+        dst[3] = DMA_SAMPLE2(el[2]);//v
+        cam_luma_add(luma, dst[0] + dst[2], 2);
+        elements += 4;
+    }
+    return elements;
+}
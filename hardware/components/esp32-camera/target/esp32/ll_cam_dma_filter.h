@@ -0,0 +1,55 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cam_luma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef union {
+    struct {
+        uint32_t sample2:8;
+        uint32_t unused2:8;
+        uint32_t sample1:8;
+        uint32_t unused1:8;
+    };
+    uint32_t val;
+} dma_elem_t;
+
+typedef size_t (*dma_filter_t)(uint8_t* dst, const uint8_t* src, size_t len);
+
+//YUV422 filters that also build the luma plane of the frame
+typedef size_t (*dma_luma_filter_t)(uint8_t* dst, const uint8_t* src, size_t len, cam_luma_t *luma);
+
+/*
+ * Copy the samples out of the I2S DMA buffer, len is in DMA bytes and the return
+ * value in frame buffer bytes. The _highspeed filters are for the sampling modes
+ * with one sample per DMA element.
+ */
+size_t ll_cam_dma_filter_jpeg(uint8_t* dst, const uint8_t* src, size_t len);
+size_t ll_cam_dma_filter_grayscale(uint8_t* dst, const uint8_t* src, size_t len);
+size_t ll_cam_dma_filter_grayscale_highspeed(uint8_t* dst, const uint8_t* src, size_t len);
+size_t ll_cam_dma_filter_yuyv(uint8_t* dst, const uint8_t* src, size_t len);
+size_t ll_cam_dma_filter_yuyv_highspeed(uint8_t* dst, const uint8_t* src, size_t len);
+size_t ll_cam_dma_filter_yuyv_luma(uint8_t* dst, const uint8_t* src, size_t len, cam_luma_t *luma);
+size_t ll_cam_dma_filter_yuyv_highspeed_luma(uint8_t* dst, const uint8_t* src, size_t len, cam_luma_t *luma);
+
+#ifdef __cplusplus
+}
+#endif
@@ -600,3 +600,17 @@ esp_err_t xclk_timer_conf(int ledc_timer, int xclk_freq_hz)
     LCD_CAM.cam_ctrl.cam_update = 1;
     return ESP_OK;
 }
+
+// implements functions from xclk.c, XCLK is the module clock of LCD_CAM and stops with it
+void camera_suspend_out_clock(void)
+{
+    LCD_CAM.cam_ctrl.cam_clk_sel = 0;
+    LCD_CAM.cam_ctrl.cam_update = 1;
+}
+
+esp_err_t camera_resume_out_clock(void)
+{
+    LCD_CAM.cam_ctrl.cam_clk_sel = 3;
+    LCD_CAM.cam_ctrl.cam_update = 1;
+    return ESP_OK;
+}
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2026 BikeTitans contributors
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Downscaled luma plane built by the DMA filters.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Box filtered luma plane, built by the DMA filter while it copies a YUV422 frame
+ *
+ * Every pixel adds its Y to the sum of its plane column, every scale lines the sums
+ * become one line of the plane. The DMA transfers hold whole lines, so the state
+ * only has to last from one transfer to the next.
+ */
+typedef struct {
+    uint8_t shift;          // log2 of the scale, 2 or 3, 0 without a luma plane
+    uint16_t width;         // width of the frame in pixels
+    uint16_t x;             // next pixel of the line
+    uint16_t y;             // line of the frame
+    uint16_t *acc;          // sums of the plane line being built, width >> shift of them
+    uint8_t *out;           // next line of the plane, NULL when the frame has no plane
+} cam_luma_t;
+
+/**
+ * @brief Start the plane of a new frame
+ */
+static inline void cam_luma_start(cam_luma_t *luma, uint8_t *plane)
+{
+    luma->x = 0;
+    luma->y = 0;
+    luma->out = plane;
+    if (luma->acc) {
+        memset(luma->acc, 0, (luma->width >> luma->shift) * sizeof(uint16_t));
+    }
+}
+
+/**
+ * @brief Add the luma sum of the next n pixels, all in the same plane column
+ */
+static inline void cam_luma_add(cam_luma_t *luma, uint32_t sum, uint16_t n)
+{
+    luma->acc[luma->x >> luma->shift] += sum;
+    luma->x += n;
+    if (luma->x < luma->width) {
+        return;
+    }
+    luma->x = 0;
+    if ((++luma->y & ((1 << luma->shift) - 1)) == 0) {
+        uint16_t w = luma->width >> luma->shift;
+        uint8_t bits = 2 * luma->shift;
+        for (uint16_t i = 0; i < w; i++) {
+            luma->out[i] = (luma->acc[i] + (1 << (bits - 1))) >> bits;
+            luma->acc[i] = 0;
+        }
+        luma->out += w;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -30,6 +30,10 @@
 #endif
 #include "esp_log.h"
 #include "esp_camera.h"
+#include "cam_ring.h"
+#include "cam_luma.h"
+#include "cam_jpeg.h"
+#include "cam_stats.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
@@ -77,9 +81,23 @@
 
 typedef enum {
     CAM_IN_SUC_EOF_EVENT = 0,
-    CAM_VSYNC_EVENT
+    CAM_VSYNC_EVENT,
+    CAM_PAUSE_EVENT,//sent by cam_reconfig and cam_suspend, cam_task drops its frame and waits for task_resume
 } cam_event_t;
 
+//reasons for losing a frame, camera_drop_stats_t in this order
+typedef enum {
+    CAM_DROP_FB_OVERFLOW = 0,
+    CAM_DROP_NO_SOI,
+    CAM_DROP_NO_EOI,
+    CAM_DROP_BAD_SIZE,
+    CAM_DROP_EVENT_OVERFLOW,
+    CAM_DROP_STARVED,
+    CAM_DROP_OVERWRITTEN,
+    CAM_DROP_TIMEOUT,
+    CAM_DROP_MAX,
+} cam_drop_t;
+
 typedef enum {
     CAM_STATE_IDLE = 0,
     CAM_STATE_READ_BUF = 1,
@@ -87,10 +105,11 @@ typedef enum {
 
 typedef struct {
     camera_fb_t fb;
-    uint8_t en;
+    _Atomic uint32_t refs;//references held by the application
     //for RGB/YUV modes
     lldesc_t *dma;
     size_t fb_offset;
+    size_t size;//bytes allocated for fb.buf, changed between captures by JPEG adaptive sizing
 } cam_frame_t;
 
 typedef struct {
@@ -109,7 +128,21 @@ typedef struct {
     cam_frame_t *frames;
 
     QueueHandle_t event_queue;
-    QueueHandle_t frame_buffer_queue;
+    cam_ring_t frame_ring;//filled frames, oldest first
+    SemaphoreHandle_t frame_ready;//given on every push, cam_take waits on it
+    SemaphoreHandle_t task_paused;//given by cam_task on CAM_PAUSE_EVENT
+    SemaphoreHandle_t task_resume;//given by cam_reconfig once the new mode is set up
+    _Atomic uint32_t free_mask;//frames cam_task may capture into
+    _Atomic uint32_t taken_mask;//frames held by the application
+    uint32_t frame_seq;
+    _Atomic uint32_t drops[CAM_DROP_MAX];//frames lost by reason, some counted by the ISR
+    _Atomic uint32_t dropped_seen;//frames lost up to the last cam_take, without timeouts
+    camera_grab_mode_t grab_mode;
+    uint8_t warmup_frames;//CAMERA_GRAB_ON_DEMAND
+    _Atomic uint8_t skip_frames;//warm-up frames left, set by cam_take before armed, counted down by cam_task
+    _Atomic bool armed;//a CAMERA_GRAB_ON_DEMAND capture is running
+    camera_line_cb_t line_cb;//latched by cam_task at the start of every frame
+    void *line_cb_arg;
     TaskHandle_t task_handle;
     intr_handle_t cam_intr_handle;
 
@@ -126,6 +159,7 @@ typedef struct {
     uint32_t recv_size;
     bool swap_data;
     bool psram_mode;
+    bool rows_only;//fb_count 0, frames are not kept and only reach the line callback
 
     //for RGB/YUV modes
     uint16_t width;
@@ -139,6 +173,14 @@ typedef struct {
     uint8_t fb_bytes_per_pixel;
 #endif
     uint32_t fb_size;
+    uint32_t fb_caps;
+    bool jpeg_adaptive_req;//camera_config_t.jpeg_adaptive, kept for mode switches
+    bool jpeg_adaptive;//resize the frame buffers to jpeg_sizer
+    cam_jpeg_sizer_t jpeg_sizer;
+    cam_luma_t luma;//ESP32 YUV422, plane of the frame being copied
+    bool stats_on;//camera_config_t.frame_stats
+    cam_stats_t stats;//luma statistics of the frame being copied
+    bool suspended;//cam_task parked by cam_suspend
 
     cam_state_t state;
 } cam_obj_t;
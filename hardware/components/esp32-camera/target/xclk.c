@@ -15,6 +15,7 @@ static const char* TAG = "camera_xclk";
 
 #define NO_CAMERA_LEDC_CHANNEL 0xFF
 static ledc_channel_t g_ledc_channel = NO_CAMERA_LEDC_CHANNEL;
+static ledc_timer_t g_ledc_timer;
 
 esp_err_t xclk_timer_conf(int ledc_timer, int xclk_freq_hz)
 {
@@ -47,6 +48,7 @@ esp_err_t camera_enable_out_clock(const camera_config_t* config)
     }
 
     g_ledc_channel = config->ledc_channel;
+    g_ledc_timer = config->ledc_timer;
     ledc_channel_config_t ch_conf = {0};
     ch_conf.gpio_num = config->pin_xclk;
     ch_conf.speed_mode = LEDC_LOW_SPEED_MODE;
@@ -70,3 +72,30 @@ void camera_disable_out_clock()
         g_ledc_channel = NO_CAMERA_LEDC_CHANNEL;
     }
 }
+
+void camera_suspend_out_clock(void)
+{
+    if (g_ledc_channel != NO_CAMERA_LEDC_CHANNEL) {
+        ledc_stop(LEDC_LOW_SPEED_MODE, g_ledc_channel, 0);
+        ledc_timer_pause(LEDC_LOW_SPEED_MODE, g_ledc_timer);
+    }
+}
+
+esp_err_t camera_resume_out_clock(void)
+{
+    if (g_ledc_channel == NO_CAMERA_LEDC_CHANNEL) {
+        return ESP_OK;
+    }
+    esp_err_t err = ledc_timer_resume(LEDC_LOW_SPEED_MODE, g_ledc_timer);
+    if (err == ESP_OK) {
+        // ledc_stop left the channel configured, a duty update turns the output back on
+        err = ledc_set_duty(LEDC_LOW_SPEED_MODE, g_ledc_channel, 1);
+    }
+    if (err == ESP_OK) {
+        err = ledc_update_duty(LEDC_LOW_SPEED_MODE, g_ledc_channel);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "resuming XCLK failed, rc=%x", err);
+    }
+    return err;
+}
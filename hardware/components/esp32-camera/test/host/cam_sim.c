@@ -0,0 +1,795 @@
+/*
+ * Fake ll_cam backend and sensor for running driver/cam_hal.c on the host.
+ *
+ * The backend follows the ESP32-S3 one: one byte per DMA item, 1 KB EOFs in
+ * JPEG mode, line aligned EOFs otherwise, and a circular DMA buffer (or the
+ * frame buffer itself in PSRAM mode). The sensor thread plays the part of the
+ * camera and the two interrupts: it sends VSYNC at every frame start, writes
+ * the payload where the armed DMA would and sends an EOF for every full half
+ * buffer. Data sent while the DMA is stopped is lost, as on the chip.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "esp_timer.h"
+#include "ll_cam.h"
+#include "cam_hal.h"
+#include "cam_sim.h"
+
+static const char *TAG = "cam_sim";
+
+// what the sensor sends, changed by a mode switch
+typedef struct {
+    pixformat_t format;
+    size_t recv_size;
+    size_t chunk;                   // bytes per EOF
+} cam_sim_mode_t;
+
+typedef struct {
+    cam_obj_t *cam;
+    const cam_sim_config_t *config;
+    pthread_mutex_t lock;
+    pthread_cond_t woken;           // asleep cleared
+    cam_sim_mode_t mode[2];         // before and after the switch
+    bool switching;                 // the sensor is being reprogrammed
+    bool switched;
+    uint32_t switch_seq;            // first frame sent in the new mode
+    bool asleep;                    // suspended or waking up, until the capture is resumed
+    bool slept;                     // the sensor saw asleep at the start of a frame, it sends no more events
+    uint32_t wake_seq;              // first frame sent after waking up
+    camera_config_t cc;             // for cam_init and cam_config again with reinit
+    int64_t cpu_us;                 // cam_task CPU time of the tasks deleted by reinit
+    int64_t cpu_start;
+    bool vsync_en;
+    bool dma_on;
+    int dma_frame;
+    size_t dma_pos;
+    int64_t *end_us;                // end of frame time, by sequence number
+    volatile bool done;
+    cam_sim_stats_t *stats;
+    QueueHandle_t share_queues[4];
+} cam_sim_t;
+
+typedef struct {
+    camera_fb_t *fb;
+    uint32_t sum;
+} cam_sim_share_t;
+
+static cam_sim_t s_sim = { .lock = PTHREAD_MUTEX_INITIALIZER, .woken = PTHREAD_COND_INITIALIZER };
+
+/*
+ * ll_cam
+ */
+bool ll_cam_stop(cam_obj_t *cam)
+{
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.dma_on = false;
+    pthread_mutex_unlock(&s_sim.lock);
+    return true;
+}
+
+static size_t sim_fb_bytes(cam_obj_t *cam)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < cam->frame_cnt; i++) {
+        bytes += malloc_usable_size(cam->frames[i].fb.buf - cam->frames[i].fb_offset);
+    }
+    return bytes;
+}
+
+bool ll_cam_start(cam_obj_t *cam, int frame_pos)
+{
+    // after adaptive JPEG sizing, which only cam_task does
+    size_t bytes = sim_fb_bytes(cam);
+    if (bytes > s_sim.stats->fb_bytes_max) {
+        s_sim.stats->fb_bytes_max = bytes;
+    }
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.dma_on = true;
+    s_sim.dma_frame = frame_pos;
+    s_sim.dma_pos = 0;
+    pthread_mutex_unlock(&s_sim.lock);
+    return true;
+}
+
+esp_err_t ll_cam_config(cam_obj_t *cam, const camera_config_t *config)
+{
+    s_sim.cam = cam;
+    return ESP_OK;
+}
+
+esp_err_t ll_cam_deinit(cam_obj_t *cam)
+{
+    return ESP_OK;
+}
+
+void ll_cam_vsync_intr_enable(cam_obj_t *cam, bool en)
+{
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.vsync_en = en;
+    pthread_mutex_unlock(&s_sim.lock);
+}
+
+esp_err_t ll_cam_set_pin(cam_obj_t *cam, const camera_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t ll_cam_init_isr(cam_obj_t *cam)
+{
+    return ESP_OK;
+}
+
+void ll_cam_do_vsync(cam_obj_t *cam)
+{
+}
+
+uint8_t ll_cam_get_dma_align(cam_obj_t *cam)
+{
+    return 16;
+}
+
+// same node and EOF sizes as the ESP32-S3 backend
+static bool ll_cam_calc_rgb_dma(cam_obj_t *cam)
+{
+    size_t node_max = LCD_CAM_DMA_NODE_BUFFER_MAX_SIZE;
+    size_t line_width = cam->width * cam->in_bytes_per_pixel;
+    size_t node_size = node_max;
+    size_t nodes_per_line = 1;
+
+    if (line_width >= node_max) {
+        for (size_t i = node_max; i > 0; i--) {
+            if ((line_width % i) == 0) {
+                node_size = i;
+                nodes_per_line = line_width / node_size;
+                break;
+            }
+        }
+    } else {
+        for (size_t i = node_max; i > 0; i--) {
+            if ((i % line_width) == 0) {
+                size_t lines_per_node = i / line_width;
+                while ((cam->height % lines_per_node) != 0) {
+                    lines_per_node--;
+                }
+                node_size = lines_per_node * line_width;
+                break;
+            }
+        }
+    }
+    cam->dma_node_buffer_size = node_size;
+
+    size_t dma_half_buffer_max = CONFIG_CAMERA_DMA_BUFFER_SIZE_MAX / 2;
+    if (line_width > dma_half_buffer_max) {
+        ESP_LOGE(TAG, "Resolution too high");
+        return false;
+    }
+    size_t dma_half_buffer_min = node_size * nodes_per_line;
+    size_t dma_half_buffer = (dma_half_buffer_max / dma_half_buffer_min) * dma_half_buffer_min;
+    while ((cam->height % (dma_half_buffer / line_width)) != 0) {
+        dma_half_buffer -= dma_half_buffer_min;
+    }
+    size_t dma_buffer_size = 2 * dma_half_buffer_max;
+    if (cam->psram_mode) {
+        dma_buffer_size = cam->recv_size;
+    } else {
+        dma_buffer_size = (dma_buffer_size / dma_half_buffer) * dma_half_buffer;
+    }
+    cam->dma_buffer_size = dma_buffer_size;
+    cam->dma_half_buffer_size = dma_half_buffer;
+    cam->dma_half_buffer_cnt = dma_buffer_size / dma_half_buffer;
+    return true;
+}
+
+bool ll_cam_dma_sizes(cam_obj_t *cam)
+{
+    cam->dma_bytes_per_item = 1;
+    if (!cam->jpeg_mode) {
+        return ll_cam_calc_rgb_dma(cam);
+    }
+    if (cam->psram_mode) {
+        cam->dma_buffer_size = cam->recv_size;
+        cam->dma_half_buffer_size = 1024;
+        cam->dma_half_buffer_cnt = cam->dma_buffer_size / cam->dma_half_buffer_size;
+    } else {
+        cam->dma_half_buffer_cnt = 16;
+        cam->dma_buffer_size = cam->dma_half_buffer_cnt * 1024;
+        cam->dma_half_buffer_size = 1024;
+    }
+    cam->dma_node_buffer_size = cam->dma_half_buffer_size;
+    return true;
+}
+
+size_t ll_cam_memcpy(cam_obj_t *cam, uint8_t *out, const uint8_t *in, size_t len)
+{
+    memcpy(out, in, len);
+    return len;
+}
+
+esp_err_t ll_cam_set_sample_mode(cam_obj_t *cam, pixformat_t pix_format, uint32_t xclk_freq_hz, uint16_t sensor_pid)
+{
+    if (pix_format == PIXFORMAT_YUV422 || pix_format == PIXFORMAT_RGB565) {
+        cam->in_bytes_per_pixel = 2;
+        cam->fb_bytes_per_pixel = 2;
+    } else if (pix_format == PIXFORMAT_JPEG || pix_format == PIXFORMAT_GRAYSCALE) {
+        // GRAYSCALE as the sensors that send Y8
+        cam->in_bytes_per_pixel = 1;
+        cam->fb_bytes_per_pixel = 1;
+    } else {
+        ESP_LOGE(TAG, "Requested format is not supported");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+void ll_cam_dma_print_state(cam_obj_t *cam)
+{
+}
+
+void ll_cam_dma_reset(cam_obj_t *cam)
+{
+}
+
+/*
+ * Payloads. The sequence number goes in 7 bit bytes so it never makes a marker,
+ * JPEG bodies are random with 0xFF stuffed like entropy coded data.
+ */
+static uint32_t sim_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void sim_put_seq(uint8_t *p, uint32_t seq)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (seq >> (7 * i)) & 0x7f;
+    }
+}
+
+static uint32_t sim_get_seq(const uint8_t *p)
+{
+    uint32_t seq = 0;
+    for (int i = 0; i < 4; i++) {
+        seq |= (uint32_t)(p[i] & 0x7f) << (7 * i);
+    }
+    return seq;
+}
+
+static size_t sim_payload_len(const cam_sim_config_t *config, const cam_sim_mode_t *mode, uint32_t seq)
+{
+    if (mode->format != PIXFORMAT_JPEG) {
+        return mode->recv_size;
+    }
+    if (config->jpeg_trace_len) {
+        return config->jpeg_trace[(seq - 1) % config->jpeg_trace_len];
+    }
+    size_t len = config->jpeg_size;
+    if (config->jpeg_jitter) {
+        uint32_t r = seq * 2654435761u;
+        len += (size_t)(sim_rand(&r) % (2 * config->jpeg_jitter + 1)) - config->jpeg_jitter;
+    }
+    return len < 16 ? 16 : len;
+}
+
+static size_t sim_payload_max(const cam_sim_config_t *config)
+{
+    size_t len = config->jpeg_size + config->jpeg_jitter;
+    for (size_t i = 0; i < config->jpeg_trace_len; i++) {
+        len = config->jpeg_trace[i] > len ? config->jpeg_trace[i] : len;
+    }
+    return len;
+}
+
+// room for a frame of either mode
+static size_t sim_frame_max(const cam_sim_config_t *config)
+{
+    framesize_t size = config->switch_after && config->switch_size > config->frame_size ? config->switch_size : config->frame_size;
+    return resolution[size].width * resolution[size].height * 2 + sim_payload_max(config) + CONFIG_CAMERA_DMA_BUFFER_SIZE_MAX;
+}
+
+static size_t sim_payload(const cam_sim_config_t *config, const cam_sim_mode_t *mode, uint32_t seq, uint8_t *buf)
+{
+    size_t len = sim_payload_len(config, mode, seq);
+    uint32_t r = seq * 2654435761u + 1;
+    if (mode->format != PIXFORMAT_JPEG) {
+        sim_put_seq(buf, seq);
+        for (size_t i = 4; i < len; i++) {
+            buf[i] = seq * 31 + i * 7 + (i >> 9);
+        }
+        return len;
+    }
+    static const uint8_t soi[] = {0xFF, 0xD8, 0xFF, 0xE0};
+    memcpy(buf, soi, sizeof(soi));
+    sim_put_seq(buf + 4, seq);
+    size_t i = 8;
+    while (i < len - 2) {
+        uint8_t b = sim_rand(&r);
+        if (b == 0xFF) {
+            if (i + 1 >= len - 2) {
+                b = 0;
+            } else {
+                buf[i++] = 0xFF;
+                b = 0;
+            }
+        }
+        buf[i++] = b;
+    }
+    buf[len - 2] = 0xFF;
+    buf[len - 1] = 0xD9;
+    return len;
+}
+
+/*
+ * Sensor
+ */
+static void sleep_until(int64_t us)
+{
+    int64_t now = esp_timer_get_time();
+    if (us > now) {
+        struct timespec ts = {(us - now) / 1000000, ((us - now) % 1000000) * 1000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+// waits for the next event time, but after a late wake up keeps at least min_gap
+// to the previous event: the bus can not deliver a burst of EOFs
+static void sim_pace(int64_t *last, int64_t at, int64_t min_gap)
+{
+    sleep_until(*last + min_gap > at ? *last + min_gap : at);
+    *last = esp_timer_get_time();
+}
+
+static void sim_event(cam_event_t event)
+{
+    BaseType_t woken;
+    s_sim.stats->events++;
+    if (!uxQueueSpacesAvailable(s_sim.cam->event_queue)) {
+        s_sim.stats->event_overflows++;
+    }
+    ll_cam_send_event(s_sim.cam, event, &woken);
+    if (s_sim.config->lockstep) {
+        host_queue_wait_drained(s_sim.cam->event_queue);
+    }
+}
+
+static void sim_vsync(void)
+{
+    pthread_mutex_lock(&s_sim.lock);
+    bool en = s_sim.vsync_en;
+    pthread_mutex_unlock(&s_sim.lock);
+    if (en) {
+        s_sim.stats->vsyncs++;
+        sim_event(CAM_VSYNC_EVENT);
+    }
+}
+
+// one DMA transfer, returns true if it ends with an EOF
+static bool sim_dma_write(const uint8_t *data, size_t len, bool first)
+{
+    cam_obj_t *cam = s_sim.cam;
+    bool eof = false;
+    pthread_mutex_lock(&s_sim.lock);
+    if (!s_sim.dma_on) {
+        s_sim.stats->missed += first;
+    } else {
+        // the descriptors form a ring over the DMA buffer, or over the frame buffer in PSRAM mode
+        uint8_t *ring = cam->psram_mode ? cam->frames[s_sim.dma_frame].fb.buf : cam->dma_buffer;
+        size_t off = s_sim.dma_pos % cam->dma_buffer_size;
+        memcpy(ring + off, data, len);
+        s_sim.dma_pos += len;
+        eof = len == cam->dma_half_buffer_size && (cam->jpeg_mode || !cam->psram_mode);
+    }
+    pthread_mutex_unlock(&s_sim.lock);
+    return eof;
+}
+
+static void *sim_sensor(void *arg)
+{
+    const cam_sim_config_t *config = s_sim.config;
+    int64_t period = 1000000 / config->fps;
+    int64_t active = period * (config->active > 0 ? config->active : 0.8f);
+    // data starts after the vertical back porch, half of the blanking
+    int64_t blank = (period - active) / 2;
+    uint8_t *frame = malloc(sim_frame_max(config));
+    // the first frame waits for the consumer to ask for it, or a thread started late on a busy
+    // host would find it recycled in grab latest mode
+    if (config->fb_count) {
+        host_queue_wait_drained(s_sim.cam->frame_ready);
+    }
+
+    int64_t t0 = esp_timer_get_time(), last = t0;
+    int64_t gap = active;
+    for (int i = 0; i < config->frames; i++) {
+        uint32_t seq = i + 1;
+        int64_t start = t0 + i * period;
+        sim_pace(&last, start, gap / 2);
+        pthread_mutex_lock(&s_sim.lock);
+        if (s_sim.asleep) {
+            // the sensor clock stops in standby and starts again with the capture, so however
+            // long the host takes to suspend and resume, the frames left are sent after it
+            s_sim.slept = true;
+            while (s_sim.asleep) {
+                pthread_cond_wait(&s_sim.woken, &s_sim.lock);
+            }
+            s_sim.slept = false;
+            s_sim.wake_seq = seq;
+            last = esp_timer_get_time();
+            t0 = last - i * period;
+            start = last;
+        }
+        s_sim.end_us[seq - 1] = last;
+        bool switching = s_sim.switching;
+        if (s_sim.switched && !s_sim.switch_seq) {
+            s_sim.switch_seq = seq;
+        }
+        cam_sim_mode_t mode = s_sim.mode[s_sim.switched];
+        pthread_mutex_unlock(&s_sim.lock);
+        if (switching) {
+            // no frame while the sensor is reprogrammed
+            continue;
+        }
+        sim_vsync();
+        s_sim.stats->sent++;
+
+        size_t chunk = mode.chunk;
+        size_t len = sim_payload(config, &mode, seq, frame);
+        size_t chunks = (len + chunk - 1) / chunk;
+        gap = active / chunks;
+        for (size_t k = 0; k < chunks; k++) {
+            sim_pace(&last, start + blank + gap * (int64_t)(k + 1), gap / 2);
+            size_t n = len - k * chunk < chunk ? len - k * chunk : chunk;
+            if (sim_dma_write(frame + k * chunk, n, k == 0)) {
+                sim_event(CAM_IN_SUC_EOF_EVENT);
+            }
+        }
+    }
+    sim_pace(&last, t0 + config->frames * period, gap / 2);
+    s_sim.end_us[config->frames] = last;
+    sim_vsync();
+    free(frame);
+    s_sim.done = true;
+    return NULL;
+}
+
+static uint32_t sim_checksum(const camera_fb_t *fb)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < fb->len; i++) {
+        h = (h ^ fb->buf[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void sim_sleep_us(uint32_t us)
+{
+    struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * Sharers get a retained reference to every frame, hold it and check it did not
+ * change before they release it. A NULL frame stops them.
+ */
+static void *sim_sharer(void *arg)
+{
+    QueueHandle_t queue = arg;
+    cam_sim_share_t share;
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+    while (xQueueReceive(queue, &share, portMAX_DELAY) == pdTRUE && share.fb) {
+        sim_sleep_us(s_sim.config->sharer_us);
+        if (sim_checksum(share.fb) != share.sum) {
+            __atomic_fetch_add(&s_sim.stats->shared_corrupt, 1, __ATOMIC_RELAXED);
+        }
+        cam_give(share.fb);
+    }
+    return NULL;
+}
+
+/*
+ * Mode switch the way esp_camera_switch_mode does it, with the sensor writes
+ * standing in as switch_us of silence from the sensor
+ */
+static void sim_switch(void)
+{
+    const cam_sim_config_t *config = s_sim.config;
+    cam_obj_t *cam = s_sim.cam;
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.switching = true;
+    pthread_mutex_unlock(&s_sim.lock);
+
+    int64_t t = esp_timer_get_time();
+    esp_err_t err = cam_reconfig(config->switch_format, config->switch_size, config->psram_mode ? 16000000 : 20000000, 0);
+    s_sim.stats->reconfig_us = esp_timer_get_time() - t;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "cam_reconfig failed");
+    }
+    sim_sleep_us(config->switch_us);
+
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.mode[1] = (cam_sim_mode_t) { config->switch_format, cam->recv_size, cam->dma_half_buffer_size };
+    s_sim.switched = true;
+    s_sim.switching = false;
+    pthread_mutex_unlock(&s_sim.lock);
+    cam_start();
+}
+
+/*
+ * Suspend and resume the way esp_camera_suspend and esp_camera_resume do it, or a
+ * full esp_camera_deinit and esp_camera_init. The sensor is silent while asleep
+ * and for the wake_us its wake-up or bring-up takes, then the capture starts and
+ * the sensor with it, in lockstep.
+ */
+static int64_t sim_suspend(void)
+{
+    const cam_sim_config_t *config = s_sim.config;
+    cam_sim_stats_t *stats = s_sim.stats;
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.asleep = true;
+    pthread_mutex_unlock(&s_sim.lock);
+    // until the frame being sent ends, cam_deinit would free the event queue under it
+    bool slept = false;
+    while (!slept && !s_sim.done) {
+        sim_sleep_us(100);
+        pthread_mutex_lock(&s_sim.lock);
+        slept = s_sim.slept;
+        pthread_mutex_unlock(&s_sim.lock);
+    }
+
+    int64_t t = esp_timer_get_time();
+    if (config->reinit) {
+        s_sim.cpu_us += host_task_cpu_time_us(s_sim.cam->task_handle) - s_sim.cpu_start;
+        cam_deinit();
+    } else if (cam_suspend() != ESP_OK) {
+        ESP_LOGE(TAG, "cam_suspend failed");
+    }
+    stats->suspend_call_us = esp_timer_get_time() - t;
+    sim_sleep_us(config->suspend_us);
+
+    t = esp_timer_get_time();
+    sim_sleep_us(config->wake_us);
+    int64_t call = esp_timer_get_time();
+    if (config->reinit) {
+        if (cam_init(&s_sim.cc) != ESP_OK || cam_config(&s_sim.cc, config->frame_size, 0) != ESP_OK) {
+            ESP_LOGE(TAG, "cam_init failed");
+        }
+        s_sim.cpu_start = host_task_cpu_time_us(s_sim.cam->task_handle);
+        cam_start();
+    } else if (cam_resume() != ESP_OK) {
+        ESP_LOGE(TAG, "cam_resume failed");
+    }
+    stats->resume_call_us = esp_timer_get_time() - call;
+    pthread_mutex_lock(&s_sim.lock);
+    s_sim.asleep = false;
+    pthread_cond_signal(&s_sim.woken);
+    pthread_mutex_unlock(&s_sim.lock);
+    return t;
+}
+
+/*
+ * Consumer, at a lower priority than cam_task like an application task would be
+ */
+static void *sim_consumer(void *arg)
+{
+    const cam_sim_config_t *config = s_sim.config;
+    cam_sim_stats_t *stats = s_sim.stats;
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+    uint8_t *expect = malloc(sim_frame_max(config));
+
+    int64_t period = 1000000 / config->fps;
+    TickType_t timeout = ((2 + config->warmup_frames) * period + config->consumer_us + config->idle_us) / 1000 + 20;
+    int64_t first = 0, last = 0;
+    uint32_t last_seq = 0, last_fb_seq = 0;
+    double latency = 0, meta_latency = 0;
+    int64_t switched_at = 0;
+    int64_t woken_at = 0;
+    while (true) {
+        int64_t asked = esp_timer_get_time();
+        // read before the take: the last frame can be queued while a take times out on a slow host
+        bool done = s_sim.done;
+        camera_fb_t *fb = cam_take(timeout);
+        if (!fb) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        first = first ? first : now;
+        last = now;
+        stats->delivered++;
+        stats->meta_dropped += fb->meta.dropped;
+        meta_latency += fb->meta.latency_us;
+        if (last_fb_seq && fb->seq > last_fb_seq) {
+            stats->overwritten += fb->seq - last_fb_seq - 1;
+        }
+        last_fb_seq = fb->seq;
+
+        pthread_mutex_lock(&s_sim.lock);
+        bool switched = s_sim.switched;
+        uint32_t switch_seq = s_sim.switch_seq;
+        uint32_t wake_seq = s_sim.wake_seq;
+        pthread_mutex_unlock(&s_sim.lock);
+        const cam_sim_mode_t *mode = &s_sim.mode[switched];
+        if (switched && !stats->switch_gap_us) {
+            stats->switch_gap_us = now - switched_at;
+        }
+        if (woken_at && !stats->resume_frame_us) {
+            stats->resume_frame_us = now - woken_at;
+        }
+        uint32_t seq = fb->len >= 8 ? sim_get_seq(fb->buf + (mode->format == PIXFORMAT_JPEG ? 4 : 0)) : 0;
+        if (switched && (!switch_seq || seq < switch_seq)) {
+            stats->switch_corrupt++;
+        }
+        if (woken_at && (!wake_seq || seq < wake_seq)) {
+            stats->resume_stale++;
+        }
+        if (seq < 1 || seq > (uint32_t)config->frames) {
+            stats->corrupt++;
+        } else {
+            size_t len = sim_payload(config, mode, seq, expect);
+            if (fb->len < len || memcmp(fb->buf, expect, len)) {
+                stats->corrupt++;
+            } else if (fb->len > len) {
+                stats->padded++;
+            }
+            if (seq < last_seq) {
+                stats->reordered++;
+            }
+            last_seq = seq;
+            if (s_sim.end_us[seq - 1] < asked) {
+                stats->stale++;
+            } else {
+                int skipped = 0;
+                for (uint32_t k = seq - 1; k > 0 && s_sim.end_us[k - 1] >= asked; k--) {
+                    skipped++;
+                }
+                if (stats->delivered == 1 || skipped < stats->skipped_min) {
+                    stats->skipped_min = skipped;
+                }
+            }
+            double l = now - s_sim.end_us[seq];
+            latency += l;
+            stats->latency_max_us = l > stats->latency_max_us ? l : stats->latency_max_us;
+        }
+        if (config->sharers) {
+            cam_sim_share_t share = { fb, sim_checksum(fb) };
+            for (int i = 0; i < config->sharers; i++) {
+                cam_retain(fb);
+                xQueueSend(s_sim.share_queues[i], &share, portMAX_DELAY);
+            }
+        }
+        if (config->frame_cb) {
+            config->frame_cb(fb, config->cb_arg);
+        }
+        if (config->consumer_us) {
+            sim_sleep_us(config->consumer_us);
+        }
+        cam_give(fb);
+        if (config->idle_us) {
+            sim_sleep_us(config->idle_us);
+        }
+        if (config->switch_after && stats->delivered == config->switch_after) {
+            switched_at = now;
+            sim_switch();
+        }
+        if (config->suspend_after && stats->delivered == config->suspend_after) {
+            woken_at = sim_suspend();
+        }
+    }
+    cam_sim_share_t stop = { NULL, 0 };
+    for (int i = 0; i < config->sharers; i++) {
+        xQueueSend(s_sim.share_queues[i], &stop, portMAX_DELAY);
+    }
+    if (stats->delivered) {
+        stats->latency_avg_us = latency / stats->delivered;
+        stats->meta_latency_avg_us = meta_latency / stats->delivered;
+    }
+    if (stats->delivered > 1) {
+        stats->fps = (stats->delivered - 1) * 1e6 / (last - first);
+    }
+    free(expect);
+    return NULL;
+}
+
+esp_err_t cam_sim_run(const cam_sim_config_t *config, cam_sim_stats_t *stats)
+{
+    camera_config_t cc = {
+        .pin_pwdn = -1, .pin_reset = -1, .pin_xclk = -1, .pin_sccb_sda = -1, .pin_sccb_scl = -1,
+        .pin_vsync = 1,
+        .xclk_freq_hz = config->psram_mode ? 16000000 : 20000000,
+        .pixel_format = config->format,
+        .frame_size = config->frame_size,
+        .fb_count = config->fb_count,
+        .fb_location = CAMERA_FB_IN_PSRAM,
+        .grab_mode = config->grab_mode,
+        .grab_warmup_frames = config->warmup_frames,
+        .jpeg_adaptive = config->jpeg_adaptive,
+        .frame_stats = config->frame_stats,
+    };
+    memset(stats, 0, sizeof(cam_sim_stats_t));
+    s_sim.config = config;
+    s_sim.stats = stats;
+    s_sim.done = false;
+    s_sim.dma_on = false;
+    s_sim.vsync_en = false;
+    s_sim.switching = false;
+    s_sim.switched = false;
+    s_sim.switch_seq = 0;
+    s_sim.asleep = false;
+    s_sim.slept = false;
+    s_sim.wake_seq = 0;
+    s_sim.cc = cc;
+    s_sim.cpu_us = 0;
+
+    if (cam_init(&cc) != ESP_OK || cam_config(&cc, config->frame_size, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    cam_obj_t *cam = s_sim.cam;
+    s_sim.mode[0] = (cam_sim_mode_t) { config->format, cam->recv_size, cam->dma_half_buffer_size };
+    if (config->line_cb) {
+        esp_err_t err = cam_set_line_callback(config->line_cb, config->cb_arg);
+        if (err != ESP_OK) {
+            cam_deinit();
+            return err;
+        }
+    }
+    s_sim.end_us = calloc(config->frames + 1, sizeof(int64_t));
+    s_sim.cpu_start = host_task_cpu_time_us(cam->task_handle);
+
+    cam_start();
+    pthread_t sensor, consumer, sharers[4];
+    for (int i = 0; i < config->sharers; i++) {
+        s_sim.share_queues[i] = xQueueCreate(config->fb_count, sizeof(cam_sim_share_t));
+        pthread_create(&sharers[i], NULL, sim_sharer, s_sim.share_queues[i]);
+    }
+    // without frame buffers there is nothing to take
+    if (config->fb_count) {
+        pthread_create(&consumer, NULL, sim_consumer, NULL);
+    }
+    pthread_create(&sensor, NULL, sim_sensor, NULL);
+    // the sensor stands in for the interrupts, above every task
+    struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_FIFO) + configMAX_PRIORITIES };
+    pthread_setschedparam(sensor, SCHED_FIFO, &param);
+    pthread_join(sensor, NULL);
+    if (config->fb_count) {
+        pthread_join(consumer, NULL);
+    }
+    for (int i = 0; i < config->sharers; i++) {
+        pthread_join(sharers[i], NULL);
+        vQueueDelete(s_sim.share_queues[i]);
+    }
+    // a new one after reinit
+    cam = s_sim.cam;
+    stats->starved = cam_get_starved_count();
+    stats->held_at_end = __builtin_popcount(atomic_load(&cam->taken_mask));
+    stats->fb_bytes = sim_fb_bytes(cam);
+    stats->fb_overflows = cam->jpeg_sizer.overflows;
+    cam_get_drop_stats(&stats->drops);
+    stats->fb_resizes = cam->jpeg_sizer.resizes;
+    stats->cpu_us = s_sim.cpu_us + host_task_cpu_time_us(cam->task_handle) - s_sim.cpu_start;
+    stats->cpu_us_per_frame = stats->cpu_us / stats->sent;
+    stats->duration_us = s_sim.end_us[config->frames] - s_sim.end_us[0];
+    cam_deinit();
+    free(s_sim.end_us);
+    return ESP_OK;
+}
+
+void cam_sim_print(const char *name, const cam_sim_stats_t *stats)
+{
+    printf("%-28s sent %4d missed %3d starved %3u ev-ovf %3d overwritten %3d delivered %4d (%5.1f fps) corrupt %3d padded %3d "
+           "latency %6.2f/%6.2f ms cpu %5.1f us/frame\n",
+           name, stats->sent, stats->missed, (unsigned)stats->starved, stats->event_overflows, stats->overwritten, stats->delivered, stats->fps,
+           stats->corrupt, stats->padded, stats->latency_avg_us / 1000, stats->latency_max_us / 1000,
+           stats->cpu_us_per_frame);
+}
@@ -0,0 +1,103 @@
+/*
+ * Host simulator for driver/cam_hal.c.
+ *
+ * cam_hal.c is built against a fake ll_cam backend (cam_sim.c) and the pthread
+ * FreeRTOS shims. A sensor thread replays VSYNC and DMA EOF events with JPEG or
+ * YUV422 payloads at the configured frame rate, while the calling thread takes
+ * frames through cam_take()/cam_give() like esp_camera_fb_get()/return() would.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+typedef struct {
+    pixformat_t format;             // PIXFORMAT_JPEG, PIXFORMAT_YUV422 or PIXFORMAT_GRAYSCALE
+    framesize_t frame_size;
+    bool psram_mode;                // DMA straight into the frame buffers (16 MHz XCLK)
+    size_t fb_count;
+    camera_grab_mode_t grab_mode;
+    uint8_t warmup_frames;          // CAMERA_GRAB_ON_DEMAND warm-up
+    float fps;                      // sensor frame rate
+    float active;                   // part of the frame period with data on the bus, 0 for 0.8
+    size_t jpeg_size;               // mean JPEG size
+    size_t jpeg_jitter;             // JPEG size varies by up to +- this
+    const uint32_t *jpeg_trace;     // JPEG sizes replayed in a loop instead of jpeg_size and jpeg_jitter
+    size_t jpeg_trace_len;
+    bool jpeg_adaptive;             // camera_config_t.jpeg_adaptive
+    bool frame_stats;               // camera_config_t.frame_stats
+    int frames;                     // frames sent by the sensor
+    uint32_t consumer_us;           // time the consumer holds every frame
+    uint32_t idle_us;               // time from returning a frame to asking for the next one
+    int sharers;                    // more consumers the consumer passes a retained reference to, up to 4
+    uint32_t sharer_us;             // time each of them holds every frame
+    camera_line_cb_t line_cb;       // set with cam_set_line_callback, fb_count 0 for rows only
+    void (*frame_cb)(camera_fb_t *fb, void *arg); // run by the consumer on every frame it takes
+    void *cb_arg;                   // passed to both
+    bool lockstep;                  // let cam_task handle every event before the next one,
+                                    // takes host scheduling jitter out of the capture side
+    int switch_after;               // frames the consumer takes before it calls cam_reconfig, 0 for none
+    pixformat_t switch_format;      // mode after the switch
+    framesize_t switch_size;
+    uint32_t switch_us;             // time the sensor takes to switch, it sends nothing meanwhile
+    int suspend_after;              // frames the consumer takes before it calls cam_suspend, 0 for none
+    bool reinit;                    // cam_deinit, then cam_init and cam_config, instead of cam_suspend and cam_resume
+    uint32_t suspend_us;            // time suspended, the sensor sends nothing and its frame timing stops until the resume
+    uint32_t wake_us;               // time the sensor takes to leave standby, or to be brought up again with reinit,
+                                    // before the capture is resumed; it sends nothing meanwhile
+} cam_sim_config_t;
+
+typedef struct {
+    int sent;                       // frames sent by the sensor
+    int missed;                     // frames that started with the DMA stopped
+    int event_overflows;            // events lost on a full event queue
+    int events;                     // VSYNC and EOF interrupts raised
+    int vsyncs;                     // VSYNC interrupts raised
+    int delivered;                  // frames returned by cam_take
+    int corrupt;                    // delivered frames that do not start with the sent payload
+    int padded;                     // delivered frames longer than the sent payload
+    int reordered;                  // delivered frames older than the one before
+    int stale;                      // delivered frames that started before cam_take was called
+    int skipped_min;                // fewest frames started between cam_take and the one it returned
+    int overwritten;                // captured frames replaced by newer ones before cam_take, from fb->seq
+    int shared_corrupt;             // shared frames that changed before their last release
+    uint32_t starved;               // frames not captured because every frame buffer was in use
+    int held_at_end;                // frames still referenced after every consumer stopped
+    size_t fb_bytes;                // allocated for frame buffers at the end
+    size_t fb_bytes_max;            // most allocated for frame buffers at the start of a frame
+    uint32_t fb_overflows;          // JPEG frames larger than their frame buffer
+    uint32_t fb_resizes;            // adaptive JPEG frame buffers reallocated
+    camera_drop_stats_t drops;      // cam_get_drop_stats at the end
+    uint32_t meta_dropped;          // sum of fb->meta.dropped over the delivered frames
+    double meta_latency_avg_us;     // fb->meta.latency_us, from VSYNC rather than the end of the frame
+    double fps;                     // delivered frames per second
+    double latency_avg_us;          // end of frame to cam_take returning it
+    double latency_max_us;
+    double cpu_us_per_frame;        // cam_task CPU time per sent frame
+    double cpu_us;                  // cam_task CPU time
+    double reconfig_us;             // cam_reconfig call
+    double switch_gap_us;           // last frame of the old mode to the first of the new one, as taken
+    int switch_corrupt;             // frames after the switch that are not in the new mode
+    double suspend_call_us;         // cam_suspend, or cam_deinit with reinit
+    double resume_call_us;          // cam_resume, or cam_init, cam_config and cam_start with reinit
+    double resume_frame_us;         // start of the wake-up to the first frame taken after it
+    int resume_stale;               // frames taken after the wake-up that the sensor sent before it
+    double duration_us;             // time the sensor ran
+} cam_sim_stats_t;
+
+/**
+ * @brief Run cam_hal against the simulated sensor
+ *
+ * @param config    Stream and consumer settings
+ * @param stats     Filled with the results
+ *
+ * @return ESP_OK if the driver could be started and stopped, or the error of cam_set_line_callback
+ */
+esp_err_t cam_sim_run(const cam_sim_config_t *config, cam_sim_stats_t *stats);
+
+/**
+ * @brief Print the stats on one line
+ */
+void cam_sim_print(const char *name, const cam_sim_stats_t *stats);
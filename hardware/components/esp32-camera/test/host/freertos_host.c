@@ -0,0 +1,303 @@
+/*
+ * pthread implementation of the FreeRTOS shims in stubs/freertos.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t drained;         // a receiver blocks on the empty queue
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    UBaseType_t receivers;          // tasks blocked in xQueueReceive
+    UBaseType_t senders;            // tasks blocked in xQueueSend
+    uint8_t items[];
+};
+
+struct tskTaskControlBlock {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static void unlock_cleanup(void *arg)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+
+// waits on cond until ready() or timeout, tasks may be cancelled only here
+static bool queue_wait(QueueHandle_t q, pthread_cond_t *cond, bool (*ready)(QueueHandle_t), TickType_t ticks,
+                       UBaseType_t *waiting)
+{
+    if (ready(q)) {
+        return true;
+    }
+    if (!ticks) {
+        return false;
+    }
+    struct timespec ts = deadline(ticks);
+    int old, err = 0;
+    pthread_cleanup_push(unlock_cleanup, &q->lock);
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old);
+    (*waiting)++;
+    if (waiting == &q->receivers) {
+        pthread_cond_broadcast(&q->drained);
+    }
+    while (!ready(q) && err != ETIMEDOUT) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, &q->lock);
+        } else {
+            err = pthread_cond_timedwait(cond, &q->lock, &ts);
+        }
+    }
+    (*waiting)--;
+    pthread_setcancelstate(old, NULL);
+    pthread_cleanup_pop(0);
+    return ready(q);
+}
+
+static bool has_space(QueueHandle_t q)
+{
+    return q->count < q->length;
+}
+
+static bool has_items(QueueHandle_t q)
+{
+    return q->count > 0;
+}
+
+QueueHandle_t xQueueGenericCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(struct QueueDefinition) + length * item_size);
+    if (!q) {
+        return NULL;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, &attr);
+    pthread_cond_init(&q->not_full, &attr);
+    pthread_cond_init(&q->drained, &attr);
+    pthread_condattr_destroy(&attr);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = queue_wait(q, &q->not_full, has_space, ticks, &q->senders);
+    if (ok) {
+        if (q->item_size && item) {
+            memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+        }
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken)
+{
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = queue_wait(q, &q->not_empty, has_items, ticks, &q->receivers);
+    if (ok) {
+        if (q->item_size && item) {
+            memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        }
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t q, void *item, BaseType_t *woken)
+{
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    return xQueueReceive(q, item, 0);
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+void host_queue_wait_drained(QueueHandle_t q)
+{
+    // blocks rather than polls, a real time caller polling would keep a lower priority receiver off a busy CPU
+    pthread_mutex_lock(&q->lock);
+    while (q->count || !q->receivers) {
+        pthread_cond_wait(&q->drained, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->drained);
+    free(q);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueGenericCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t s = xQueueGenericCreate(1, 0);
+    if (s) {
+        xSemaphoreGive(s);
+    }
+    return s;
+}
+
+static void *task_main(void *arg)
+{
+    TaskHandle_t task = (TaskHandle_t)arg;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    TaskHandle_t task = calloc(1, sizeof(struct tskTaskControlBlock));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    // cancellation is only enabled while blocked in a queue
+    int old;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old);
+    int err = pthread_create(&task->thread, NULL, task_main, task);
+    pthread_setcancelstate(old, NULL);
+    // real time priorities when allowed, so driver tasks preempt the test's own threads like on the chip
+    struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_FIFO) + prio };
+    if (!err) {
+        pthread_setschedparam(task->thread, SCHED_FIFO, &param);
+    }
+    if (err) {
+        free(task);
+        return pdFAIL;
+    }
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    free(task);
+}
+
+static bool virtual_delays;
+static uint64_t delayed_ticks;
+
+void vTaskDelay(TickType_t ticks)
+{
+    __atomic_add_fetch(&delayed_ticks, ticks, __ATOMIC_RELAXED);
+    if (virtual_delays) {
+        return;
+    }
+    struct timespec ts = {ticks / 1000, (ticks % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void host_task_virtual_delays(bool on)
+{
+    virtual_delays = on;
+}
+
+uint64_t host_task_delayed_ticks(void)
+{
+    return __atomic_load_n(&delayed_ticks, __ATOMIC_RELAXED);
+}
+
+int64_t host_task_cpu_time_us(TaskHandle_t task)
+{
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(task->thread, &clock) || clock_gettime(clock, &ts)) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
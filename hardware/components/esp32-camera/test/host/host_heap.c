@@ -0,0 +1,71 @@
+#include <malloc.h>
+#include "host_heap.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+// atomic, the cam_hal simulator allocates from several threads
+static size_t s_used;
+static size_t s_peak;
+
+static void heap_add(void *p)
+{
+    if (p) {
+        size_t used = __atomic_add_fetch(&s_used, malloc_usable_size(p), __ATOMIC_RELAXED);
+        size_t peak = __atomic_load_n(&s_peak, __ATOMIC_RELAXED);
+        while (used > peak && !__atomic_compare_exchange_n(&s_peak, &peak, used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+}
+
+static void heap_sub(void *p)
+{
+    if (p) {
+        __atomic_sub_fetch(&s_used, malloc_usable_size(p), __ATOMIC_RELAXED);
+    }
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+    heap_add(p);
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    heap_add(p);
+    return p;
+}
+
+void *__wrap_realloc(void *old, size_t size)
+{
+    heap_sub(old);
+    void *p = __real_realloc(old, size);
+    heap_add(p ? p : old);
+    return p;
+}
+
+void __wrap_free(void *p)
+{
+    heap_sub(p);
+    __real_free(p);
+}
+
+size_t host_heap_used(void)
+{
+    return __atomic_load_n(&s_used, __ATOMIC_RELAXED);
+}
+
+size_t host_heap_peak(void)
+{
+    return __atomic_load_n(&s_peak, __ATOMIC_RELAXED);
+}
+
+void host_heap_reset_peak(void)
+{
+    __atomic_store_n(&s_peak, host_heap_used(), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,24 @@
+/*
+ * Heap accounting for the host tests. Linking with HEAP in camera_host_test()
+ * routes malloc/calloc/realloc/free through host_heap.c.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bytes currently allocated */
+size_t host_heap_used(void);
+
+/* Highest host_heap_used() since the last host_heap_reset_peak() */
+size_t host_heap_peak(void);
+
+/* Restart peak tracking from the current usage */
+void host_heap_reset_peak(void);
+
+#ifdef __cplusplus
+}
+#endif
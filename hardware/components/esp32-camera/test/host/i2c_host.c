@@ -0,0 +1,435 @@
+/*
+ * Fake I2C bus, see i2c_host.h.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2c.h"
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "i2c_host.h"
+
+enum { HOST_I2C_DEVICES = 4, HOST_I2C_INDIRECT = 2 };
+
+typedef enum { OP_START, OP_STOP, OP_WRITE, OP_READ } op_type_t;
+
+typedef struct {
+    op_type_t type;
+    uint8_t data;
+    uint8_t *rx;
+} op_t;
+
+typedef struct {
+    op_t *ops;
+    size_t len;
+    size_t cap;
+} cmd_link_t;
+
+typedef struct {
+    uint16_t addr_reg;              // map offsets of the index and data registers
+    uint16_t data_reg;
+    uint16_t base;                  // map offset of entry 0
+    uint8_t index;
+} indirect_t;
+
+typedef struct {
+    uint8_t addr;
+    uint8_t reg_bytes;
+    bool auto_increment;
+    bool banked;
+    uint8_t bank_reg;
+    uint8_t bank;
+    uint16_t ptr;
+    indirect_t indirect[HOST_I2C_INDIRECT];
+    int indirects;
+    i2c_host_write_hook_t write_hook;
+    uint8_t regs[0x10000];
+} device_t;
+
+// a bus of the IDF 5 master driver, see the end of the file
+struct i2c_master_bus_t {
+    bool used;
+};
+
+static device_t *devices[HOST_I2C_DEVICES];
+static struct i2c_master_bus_t buses[I2C_NUM_MAX];
+static i2c_host_stats_t stats;
+static uint32_t clock_hz = 100000;
+static double bus_busy_us;          // simulated time spent on the bus, ever
+static i2c_host_txn_t *trace;
+static size_t trace_cap, trace_len;
+
+void i2c_host_reset(void)
+{
+    memset(buses, 0, sizeof(buses));
+    for (int i = 0; i < HOST_I2C_DEVICES; i++) {
+        free(devices[i]);
+        devices[i] = NULL;
+    }
+    i2c_host_clear_stats();
+}
+
+void i2c_host_add_device(uint8_t addr, uint8_t reg_bytes, bool auto_increment)
+{
+    for (int i = 0; i < HOST_I2C_DEVICES; i++) {
+        if (!devices[i]) {
+            devices[i] = calloc(1, sizeof(device_t));
+            devices[i]->addr = addr;
+            devices[i]->reg_bytes = reg_bytes;
+            devices[i]->auto_increment = auto_increment;
+            return;
+        }
+    }
+}
+
+static device_t *find_device(uint8_t addr)
+{
+    for (int i = 0; i < HOST_I2C_DEVICES; i++) {
+        if (devices[i] && devices[i]->addr == addr) {
+            return devices[i];
+        }
+    }
+    return NULL;
+}
+
+void i2c_host_set_bank_reg(uint8_t addr, uint8_t bank_reg)
+{
+    device_t *dev = find_device(addr);
+    dev->banked = true;
+    dev->bank_reg = bank_reg;
+}
+
+void i2c_host_add_indirect(uint8_t addr, uint16_t addr_reg, uint16_t data_reg, uint16_t base)
+{
+    device_t *dev = find_device(addr);
+    dev->indirect[dev->indirects++] = (indirect_t){addr_reg, data_reg, base, 0};
+}
+
+void i2c_host_set_write_hook(uint8_t addr, i2c_host_write_hook_t hook)
+{
+    find_device(addr)->write_hook = hook;
+}
+
+// map offset of the register the pointer is at
+static uint16_t device_offset(device_t *dev)
+{
+    if (dev->banked && dev->ptr != dev->bank_reg) {
+        return (dev->bank << 8) | (dev->ptr & 0xff);
+    }
+    return dev->ptr;
+}
+
+// where the register the pointer is at lives in the map, stepping the index of an indirect table
+static uint8_t *device_reg(device_t *dev, bool write, uint8_t data)
+{
+    uint16_t offset = device_offset(dev);
+    for (int i = 0; i < dev->indirects; i++) {
+        indirect_t *ind = &dev->indirect[i];
+        if (offset == ind->addr_reg && write) {
+            ind->index = data;
+        } else if (offset == ind->data_reg) {
+            return &dev->regs[(uint16_t)(ind->base + ind->index++)];
+        }
+    }
+    return &dev->regs[offset];
+}
+
+uint8_t *i2c_host_regs(uint8_t addr)
+{
+    device_t *dev = find_device(addr);
+    return dev ? dev->regs : NULL;
+}
+
+void i2c_host_get_stats(i2c_host_stats_t *out)
+{
+    *out = stats;
+}
+
+void i2c_host_clear_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+double i2c_host_bus_us(const i2c_host_stats_t *s, uint32_t freq)
+{
+    // 9 clocks per byte with the ACK, about one for every START and STOP
+    return (s->bytes * 9.0 + s->starts + s->transactions) * 1e6 / freq;
+}
+
+uint32_t i2c_host_clock(void)
+{
+    return clock_hz;
+}
+
+double i2c_host_now_us(void)
+{
+    return bus_busy_us + host_task_delayed_ticks() * (1000.0 * portTICK_PERIOD_MS);
+}
+
+void i2c_host_trace(i2c_host_txn_t *log, size_t cap)
+{
+    trace = log;
+    trace_cap = log ? cap : 0;
+    trace_len = 0;
+}
+
+size_t i2c_host_trace_len(void)
+{
+    return trace_len;
+}
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf)
+{
+    if (conf->mode == I2C_MODE_MASTER && conf->master.clk_speed) {
+        clock_hz = conf->master.clk_speed;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rx_len, size_t tx_len, int flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t port)
+{
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(cmd_link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+    cmd_link_t *link = cmd;
+    free(link->ops);
+    free(link);
+}
+
+static esp_err_t add_op(i2c_cmd_handle_t cmd, op_type_t type, uint8_t data, uint8_t *rx)
+{
+    cmd_link_t *link = cmd;
+    if (link->len == link->cap) {
+        link->cap = link->cap ? link->cap * 2 : 16;
+        link->ops = realloc(link->ops, link->cap * sizeof(op_t));
+    }
+    link->ops[link->len++] = (op_t){type, data, rx};
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+    return add_op(cmd, OP_START, 0, NULL);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+    return add_op(cmd, OP_STOP, 0, NULL);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+{
+    return add_op(cmd, OP_WRITE, data, NULL);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ack_en)
+{
+    for (size_t i = 0; i < len; i++) {
+        add_op(cmd, OP_WRITE, data[i], NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack)
+{
+    return add_op(cmd, OP_READ, 0, data);
+}
+
+// takes the time of one command list off the simulated clock and traces it
+static esp_err_t end_txn(const i2c_host_stats_t *before, i2c_host_txn_t *txn, bool nack)
+{
+    i2c_host_stats_t used = {
+        .transactions = 1,
+        .starts = stats.starts - before->starts,
+        .bytes = stats.bytes - before->bytes,
+    };
+    txn->bus_us = i2c_host_bus_us(&used, clock_hz);
+    txn->writes = stats.reg_writes - before->reg_writes;
+    txn->reads = stats.reg_reads - before->reg_reads;
+    txn->nack = nack;
+    bus_busy_us += txn->bus_us;
+    if (trace && trace_len < trace_cap) {
+        trace[trace_len] = *txn;
+    }
+    trace_len += trace != NULL;
+    if (nack) {
+        stats.nacks++;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks)
+{
+    cmd_link_t *link = cmd;
+    device_t *dev = NULL;
+    enum { ADDR, REG, DATA } state = ADDR;
+    int reg_bytes = 0, data_bytes = 0;
+    i2c_host_stats_t before = stats;
+    i2c_host_txn_t txn = {.start_us = i2c_host_now_us()};
+    stats.transactions++;
+    for (size_t i = 0; i < link->len; i++) {
+        op_t *op = &link->ops[i];
+        switch (op->type) {
+        case OP_START:
+            stats.starts++;
+            state = ADDR;
+            break;
+        case OP_STOP:
+            break;
+        case OP_WRITE:
+            stats.bytes++;
+            if (state == ADDR) {
+                txn.addr = op->data >> 1;
+                dev = find_device(op->data >> 1);
+                if (!dev) {
+                    return end_txn(&before, &txn, true);
+                }
+                state = (op->data & 1) ? DATA : REG;
+                reg_bytes = data_bytes = 0;
+            } else if (state == REG) {
+                dev->ptr = reg_bytes ? (dev->ptr << 8) | op->data : op->data;
+                if (++reg_bytes == dev->reg_bytes) {
+                    state = DATA;
+                    txn.reg = dev->ptr;
+                }
+            } else {
+                if (data_bytes++ && !dev->auto_increment) {
+                    return end_txn(&before, &txn, true);
+                }
+                uint8_t *reg = device_reg(dev, true, op->data);
+                uint8_t old = *reg;
+                *reg = op->data;
+                if (dev->write_hook) {
+                    dev->write_hook(dev->regs, reg - dev->regs, old, op->data);
+                }
+                if (dev->banked && dev->ptr == dev->bank_reg) {
+                    dev->bank = op->data;
+                }
+                dev->ptr += dev->auto_increment;
+                stats.reg_writes++;
+            }
+            break;
+        case OP_READ:
+            stats.bytes++;
+            if (!dev) {
+                return end_txn(&before, &txn, true);
+            }
+            *op->rx = *device_reg(dev, false, 0);
+            stats.reg_reads++;
+            dev->ptr += dev->auto_increment;
+            break;
+        }
+    }
+    return end_txn(&before, &txn, false);
+}
+
+/*
+ * The IDF 5 master driver: a bus per port, and devices that have to be added to
+ * it before they can be addressed. Transfers run as command lists of the legacy
+ * driver above, on the same devices, clock and stats.
+ */
+struct i2c_master_dev_t {
+    uint8_t addr;
+};
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (bus_config->i2c_port < 0 || bus_config->i2c_port >= I2C_NUM_MAX || buses[bus_config->i2c_port].used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    buses[bus_config->i2c_port].used = true;
+    *ret_bus_handle = &buses[bus_config->i2c_port];
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    bus_handle->used = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_get_bus_handle(i2c_port_t port_num, i2c_master_bus_handle_t *ret_handle)
+{
+    if (port_num < 0 || port_num >= I2C_NUM_MAX || !buses[port_num].used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *ret_handle = &buses[port_num];
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config, i2c_master_dev_handle_t *ret_handle)
+{
+    if (!bus_handle->used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *ret_handle = calloc(1, sizeof(struct i2c_master_dev_t));
+    (*ret_handle)->addr = dev_config->device_address;
+    if (dev_config->scl_speed_hz) {
+        clock_hz = dev_config->scl_speed_hz;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+// one command list: the write, then the read after a repeated START if there is one
+static esp_err_t master_transfer(uint8_t addr, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, addr << 1, true);
+    i2c_master_write(cmd, tx, tx_len, true);
+    if (rx_len) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (addr << 1) | 1, true);
+        for (size_t i = 0; i < rx_len; i++) {
+            i2c_master_read_byte(cmd, &rx[i], i + 1 < rx_len ? I2C_MASTER_ACK : I2C_MASTER_NACK);
+        }
+    }
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(0, cmd, 0);
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms)
+{
+    if (!bus_handle->used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return master_transfer(address, NULL, 0, NULL, 0) == ESP_OK ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, int xfer_timeout_ms)
+{
+    if (!i2c_dev) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return master_transfer(i2c_dev->addr, write_buffer, write_size, NULL, 0);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+                                      uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms)
+{
+    if (!i2c_dev) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return master_transfer(i2c_dev->addr, write_buffer, write_size, read_buffer, read_size);
+}
@@ -0,0 +1,110 @@
+/*
+ * Fake I2C bus behind the legacy driver/i2c.h and the IDF 5 driver/i2c_master.h
+ * shims, for sccb.c and sccb-ng.c.
+ *
+ * Command links, and the transfers of the master driver on devices added to its
+ * bus, run against register maps of the added devices: the first bytes after
+ * the address set the register pointer, the rest are written from there,
+ * incrementing the pointer if the device supports it. Bytes a device would not
+ * take are NACKed and fail the command list. Devices with a bank select register
+ * keep bank n of their 8 bit registers at n * 256 in the map. Indirect tables,
+ * an index register and a data register that steps the index on every access,
+ * keep their entries wherever the test puts them.
+ *
+ * The bus runs on a simulated clock: every command list keeps it busy for its
+ * bits at the SCL frequency of i2c_param_config, and the ticks of vTaskDelay
+ * pass on it as well. Command lists can be traced with their time on it.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    uint32_t transactions;          // i2c_master_cmd_begin calls
+    uint32_t starts;                // START and repeated START conditions
+    uint32_t bytes;                 // bytes on the bus, addresses included
+    uint32_t reg_writes;            // register values written
+    uint32_t reg_reads;             // register values read
+    uint32_t nacks;                 // command lists failed on a NACK
+} i2c_host_stats_t;
+
+typedef struct {
+    double start_us;                // simulated time the command list began at
+    double bus_us;                  // time it kept the bus busy
+    uint8_t addr;                   // 7 bit address of the last device addressed
+    uint16_t reg;                   // register pointer set by the list, 0 if none
+    uint16_t writes;                // register values written
+    uint16_t reads;                 // register values read
+    bool nack;                      // failed on a NACK
+} i2c_host_txn_t;
+
+/**
+ * @brief Remove every device and master bus and clear the stats
+ */
+void i2c_host_reset(void);
+
+/**
+ * @brief Add a device with 1 or 2 byte register addresses and zeroed registers
+ */
+void i2c_host_add_device(uint8_t addr, uint8_t reg_bytes, bool auto_increment);
+
+/**
+ * @brief Make writes to an 8 bit register of the device select the bank of the others
+ */
+void i2c_host_set_bank_reg(uint8_t addr, uint8_t bank_reg);
+
+/**
+ * @brief Make the data register of the device access entry <index> of a table at <base> in the map
+ *
+ * The registers are map offsets, (bank << 8) | register for a banked device.
+ */
+void i2c_host_add_indirect(uint8_t addr, uint16_t addr_reg, uint16_t data_reg, uint16_t base);
+
+/**
+ * @brief Called after every register value the device takes, with the value it had before
+ *
+ * The register is its map offset, like those of i2c_host_add_indirect().
+ */
+typedef void (*i2c_host_write_hook_t)(uint8_t *regs, uint16_t reg, uint8_t old, uint8_t value);
+
+/**
+ * @brief Let the device react to its writes, for registers that change others
+ */
+void i2c_host_set_write_hook(uint8_t addr, i2c_host_write_hook_t hook);
+
+/**
+ * @brief The 64K register map of a device, NULL if there is none at the address
+ */
+uint8_t *i2c_host_regs(uint8_t addr);
+
+void i2c_host_get_stats(i2c_host_stats_t *stats);
+void i2c_host_clear_stats(void);
+
+/**
+ * @brief Time the traffic in the stats keeps the bus busy at the clock frequency
+ */
+double i2c_host_bus_us(const i2c_host_stats_t *stats, uint32_t freq);
+
+/**
+ * @brief SCL frequency of the last i2c_param_config, 100 kHz before the first
+ */
+uint32_t i2c_host_clock(void);
+
+/**
+ * @brief Time on the simulated clock: the bus time of every command list plus the vTaskDelay ticks
+ */
+double i2c_host_now_us(void);
+
+/**
+ * @brief Record the command lists from now on into log, NULL stops recording
+ *
+ * Lists past cap are counted but not kept.
+ */
+void i2c_host_trace(i2c_host_txn_t *log, size_t cap);
+
+/**
+ * @brief Command lists run since i2c_host_trace, kept or not
+ */
+size_t i2c_host_trace_len(void);
@@ -0,0 +1,97 @@
+/*
+ * Fake sensors, see sensor_emu.h.
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sensor_emu.h"
+#include "ov2640_regs.h"
+
+typedef struct {
+    uint16_t reg;
+    uint8_t value;
+} emu_reg_t;
+
+typedef struct {
+    camera_model_t model;
+    uint8_t reg_bytes;
+    bool auto_increment;
+    int bank_reg;                   // -1 if the registers are not banked
+    int ids;
+    emu_reg_t id[4];                // what detect reads, the rest of the registers are 0
+    i2c_host_write_hook_t hook;     // registers that change others, NULL for none
+} emu_sensor_t;
+
+// a new resolution in COM7 reloads the sensor window with its power-on values
+static void ov2640_com7(uint8_t *regs, uint16_t reg, uint8_t old, uint8_t value)
+{
+    static const emu_reg_t window[] = {
+        {COM1, 0x0F}, {REG32, REG32_UXGA}, {HSTART, 0x11}, {HSTOP, 0x75}, {VSTART, 0x01}, {VSTOP, 0x97},
+    };
+    const uint8_t res = COM7_RES_SVGA | COM7_RES_CIF;
+    if (reg != ((BANK_SENSOR << 8) | COM7) || (old & res) == (value & res)) {
+        return;
+    }
+    for (size_t i = 0; i < sizeof(window) / sizeof(window[0]); i++) {
+        regs[(BANK_SENSOR << 8) | window[i].reg] = window[i].value;
+    }
+}
+
+// OV2640 keeps its ID in the sensor bank, bank 1 behind 0xFF
+static const emu_sensor_t emu_sensors[] = {
+    {CAMERA_OV7725, 1, false, -1, 4, {{0x0A, 0x77}, {0x0B, 0x21}, {0x1C, 0x7F}, {0x1D, 0xA2}}},
+    {CAMERA_OV2640, 1, false, 0xFF, 4, {{0x10A, 0x26}, {0x10B, 0x42}, {0x11C, 0x7F}, {0x11D, 0xA2}}, ov2640_com7},
+    {CAMERA_OV3660, 2, true, -1, 2, {{0x300A, 0x36}, {0x300B, 0x60}}},
+    {CAMERA_OV5640, 2, true, -1, 2, {{0x300A, 0x56}, {0x300B, 0x40}}},
+    {CAMERA_OV7670, 1, false, -1, 4, {{0x0A, 0x76}, {0x0B, 0x73}, {0x1C, 0x7F}, {0x1D, 0xA2}}},
+    {CAMERA_NT99141, 2, true, -1, 2, {{0x3000, 0x14}, {0x3001, 0x10}}},
+    {CAMERA_GC2145, 1, false, -1, 2, {{0xF0, 0x21}, {0xF1, 0x45}}},
+    {CAMERA_GC032A, 1, false, -1, 2, {{0xF0, 0x23}, {0xF1, 0x2A}}},
+    {CAMERA_GC0308, 1, false, -1, 1, {{0x00, 0x9B}}},
+    {CAMERA_BF3005, 1, false, -1, 2, {{0xFC, 0x30}, {0xFD, 0x00}}},
+    {CAMERA_BF20A6, 1, false, -1, 2, {{0xFC, 0x20}, {0xFD, 0xA6}}},
+    {CAMERA_SC101IOT, 1, false, -1, 2, {{0xF7, 0xDA}, {0xF8, 0x4A}}},
+    {CAMERA_SC030IOT, 1, false, -1, 2, {{0xF7, 0x9A}, {0xF8, 0x46}}},
+    {CAMERA_SC031GS, 2, true, -1, 2, {{0x3107, 0x00}, {0x3108, 0x31}}},
+    {CAMERA_MEGA_CCM, 2, true, -1, 2, {{0x0000, 0x03}, {0x0001, 0x9E}}},
+};
+
+bool sensor_emu_add(camera_model_t model)
+{
+    for (size_t i = 0; i < sizeof(emu_sensors) / sizeof(emu_sensors[0]); i++) {
+        const emu_sensor_t *emu = &emu_sensors[i];
+        if (emu->model != model) {
+            continue;
+        }
+        uint8_t addr = camera_sensor[model].sccb_addr;
+        i2c_host_add_device(addr, emu->reg_bytes, emu->auto_increment);
+        if (emu->bank_reg >= 0) {
+            i2c_host_set_bank_reg(addr, emu->bank_reg);
+        }
+        uint8_t *regs = i2c_host_regs(addr);
+        for (int r = 0; r < emu->ids; r++) {
+            regs[emu->id[r].reg] = emu->id[r].value;
+        }
+        if (emu->hook) {
+            i2c_host_set_write_hook(addr, emu->hook);
+        }
+        return true;
+    }
+    return false;
+}
+
+void sensor_emu_start(sensor_emu_cost_t *cost)
+{
+    memset(cost, 0, sizeof(*cost));
+    i2c_host_clear_stats();
+    cost->start_ticks = host_task_delayed_ticks();
+    cost->start_us = i2c_host_now_us();
+}
+
+void sensor_emu_stop(sensor_emu_cost_t *cost)
+{
+    i2c_host_get_stats(&cost->bus);
+    cost->bus_us = i2c_host_bus_us(&cost->bus, i2c_host_clock());
+    cost->delay_us = (host_task_delayed_ticks() - cost->start_ticks) * 1000.0 * portTICK_PERIOD_MS;
+    cost->total_us = i2c_host_now_us() - cost->start_us;
+}
@@ -0,0 +1,43 @@
+/*
+ * Fake sensors on the fake I2C bus of i2c_host.h, for bringing the drivers up
+ * on the host. Every model the drivers know gets the SCCB address, register
+ * width and ID registers their detect functions look for; the rest of the
+ * register file reads back what the driver wrote, but for the OV2640 window
+ * that a resolution change in COM7 reloads.
+ *
+ * The cost of a driver call is its traffic and the time it takes on the
+ * simulated clock of the bus: the bits at the SCL frequency plus the ticks the
+ * driver waits in vTaskDelay.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor.h"
+#include "i2c_host.h"
+
+typedef struct {
+    i2c_host_stats_t bus;           // traffic of the call
+    double bus_us;                  // time it kept the bus busy
+    double delay_us;                // time it waited in vTaskDelay
+    double total_us;                // both, the wall time on the chip without the CPU time
+    uint64_t start_ticks;
+    double start_us;
+} sensor_emu_cost_t;
+
+/**
+ * @brief Add the fake of a sensor model to the bus
+ *
+ * @return false if there is none for the model
+ */
+bool sensor_emu_add(camera_model_t model);
+
+/**
+ * @brief Clear the bus stats and start timing a call
+ */
+void sensor_emu_start(sensor_emu_cost_t *cost);
+
+/**
+ * @brief Fill in the cost of the call since sensor_emu_start
+ */
+void sensor_emu_stop(sensor_emu_cost_t *cost);
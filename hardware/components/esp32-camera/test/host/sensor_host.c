@@ -0,0 +1,10 @@
+/*
+ * What the sensor drivers call outside of SCCB, for the host build.
+ */
+#include <stddef.h>
+#include "xclk.h"
+
+esp_err_t xclk_timer_conf(int ledc_timer, int xclk_freq_hz)
+{
+    return ESP_OK;
+}
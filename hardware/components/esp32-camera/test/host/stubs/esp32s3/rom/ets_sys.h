@@ -0,0 +1,6 @@
+// Host build shim: ROM printf goes to stderr
+#pragma once
+
+#include <stdio.h>
+
+#define ets_printf(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
@@ -0,0 +1,15 @@
+// Host build shim: the DMA descriptor layout, with a pointer sized link
+#pragma once
+
+#include <stdint.h>
+
+typedef struct lldesc_s {
+    volatile uint32_t size  : 12,
+                      length: 12,
+                      offset: 5,
+                      sosf  : 1,
+                      eof   : 1,
+                      owner : 1;
+    volatile uint8_t *buf;
+    volatile uintptr_t empty;
+} lldesc_t;
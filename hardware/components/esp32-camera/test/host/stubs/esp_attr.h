@@ -0,0 +1,8 @@
+// Host build shim: placement attributes have no meaning off-target.
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define DRAM_STR(str) (str)
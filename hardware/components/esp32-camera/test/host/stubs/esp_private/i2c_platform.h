@@ -0,0 +1,2 @@
+// Host build shim, the fake bus has no platform state to share
+#pragma once
@@ -0,0 +1,6 @@
+// Host build shim for esp_system.h
+#pragma once
+
+#include "esp_err.h"
+#include "esp_idf_version.h"
+#include "esp_attr.h"
@@ -0,0 +1,31 @@
+// Host build shim: FreeRTOS queues on a pthread mutex and two condition variables.
+// Ticks are milliseconds.
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct QueueDefinition *QueueHandle_t;
+
+QueueHandle_t xQueueGenericCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks);
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks);
+BaseType_t xQueueReceiveFromISR(QueueHandle_t q, void *item, BaseType_t *woken);
+BaseType_t xQueueReset(QueueHandle_t q);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q);
+void vQueueDelete(QueueHandle_t q);
+
+// host only: wait until the queue is empty and a task is blocked receiving from it again
+void host_queue_wait_drained(QueueHandle_t q);
+
+#define xQueueCreate(length, item_size) xQueueGenericCreate((length), (item_size))
+#define xQueueSendToBack xQueueSend
+
+#ifdef __cplusplus
+}
+#endif
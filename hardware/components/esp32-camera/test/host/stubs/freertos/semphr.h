@@ -0,0 +1,13 @@
+// Host build shim: semaphores are queues of empty items, as in FreeRTOS
+#pragma once
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+#define xSemaphoreTake(s, ticks)    xQueueReceive((s), NULL, (ticks))
+#define xSemaphoreGive(s)           xQueueSend((s), NULL, 0)
+#define vSemaphoreDelete(s)         vQueueDelete(s)
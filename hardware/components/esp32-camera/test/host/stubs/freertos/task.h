@@ -0,0 +1,34 @@
+// Host build shim: tasks are pthreads. Deleting another task cancels it while it is
+// blocked on a queue, the only place the driver tasks wait.
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+#define xTaskCreate(fn, name, stack, arg, prio, handle) \
+    xTaskCreatePinnedToCore((fn), (name), (stack), (arg), (prio), (handle), tskNO_AFFINITY)
+
+// host only: CPU time used by the task so far, in microseconds
+int64_t host_task_cpu_time_us(TaskHandle_t task);
+
+// host only: with virtual delays on, vTaskDelay returns at once and the ticks are only counted
+void host_task_virtual_delays(bool on);
+
+// host only: ticks all the tasks have passed to vTaskDelay so far
+uint64_t host_task_delayed_ticks(void);
+
+#ifdef __cplusplus
+}
+#endif
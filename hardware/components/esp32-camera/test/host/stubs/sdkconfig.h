@@ -0,0 +1,21 @@
+// Host build configuration, mirrors the component's Kconfig defaults
+#pragma once
+
+#define CONFIG_OV7670_SUPPORT 1
+#define CONFIG_OV7725_SUPPORT 1
+#define CONFIG_NT99141_SUPPORT 1
+#define CONFIG_OV2640_SUPPORT 1
+#define CONFIG_OV3660_SUPPORT 1
+#define CONFIG_OV5640_SUPPORT 1
+#define CONFIG_GC2145_SUPPORT 1
+#define CONFIG_GC032A_SUPPORT 1
+#define CONFIG_GC0308_SUPPORT 1
+#define CONFIG_BF3005_SUPPORT 1
+#define CONFIG_BF20A6_SUPPORT 1
+#define CONFIG_SC030IOT_SUPPORT 1
+#define CONFIG_MEGA_CCM_SUPPORT 1
+#define CONFIG_SCCB_CLK_FREQ 100000
+#define CONFIG_CAMERA_CACHE_SENSOR_ID 1
+#define CONFIG_CAMERA_TASK_STACK_SIZE 2048
+#define CONFIG_CAMERA_DMA_BUFFER_SIZE_MAX 32768
+#define CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_AUTO 1
@@ -0,0 +1,2 @@
+// Host build shim, intentionally empty
+#pragma once
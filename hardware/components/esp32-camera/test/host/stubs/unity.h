@@ -0,0 +1,74 @@
+// Host build shim: the subset of Unity used by the component tests.
+// Test cases register themselves at load time and are run by unity_host.c.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <setjmp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*unity_test_fn_t)(void);
+
+void unity_host_register(const char *name, const char *tags, unity_test_fn_t fn, const char *file, int line);
+void unity_host_fail(const char *file, int line, const char *fmt, ...) __attribute__((noreturn, format(printf, 3, 4)));
+
+#define UNITY_CAT_(a, b) a##b
+#define UNITY_CAT(a, b) UNITY_CAT_(a, b)
+
+#define TEST_CASE(name_, tags_)                                                             \
+    static void UNITY_CAT(unity_test_, __LINE__)(void);                                     \
+    __attribute__((constructor)) static void UNITY_CAT(unity_reg_, __LINE__)(void)          \
+    {                                                                                       \
+        unity_host_register(name_, tags_, UNITY_CAT(unity_test_, __LINE__), __FILE__, __LINE__); \
+    }                                                                                       \
+    static void UNITY_CAT(unity_test_, __LINE__)(void)
+
+#define TEST_FAIL_MESSAGE(msg) unity_host_fail(__FILE__, __LINE__, "%s", msg)
+#define TEST_ASSERT_MESSAGE(c, msg) do { if (!(c)) unity_host_fail(__FILE__, __LINE__, "%s", msg); } while (0)
+#define TEST_ASSERT(c) do { if (!(c)) unity_host_fail(__FILE__, __LINE__, "expected %s", #c); } while (0)
+#define TEST_ASSERT_TRUE(c) TEST_ASSERT(c)
+#define TEST_ASSERT_FALSE(c) TEST_ASSERT(!(c))
+#define TEST_ASSERT_NULL(p) TEST_ASSERT((p) == NULL)
+#define TEST_ASSERT_NOT_NULL(p) TEST_ASSERT((p) != NULL)
+
+#define TEST_ASSERT_EQUAL_INT64_(e, a) do {                                                  \
+        long long __e = (long long)(e), __a = (long long)(a);                               \
+        if (__e != __a) unity_host_fail(__FILE__, __LINE__, "expected %lld, was %lld (%s)", __e, __a, #a); \
+    } while (0)
+#define TEST_ASSERT_EQUAL(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ASSERT_EQUAL_INT(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ASSERT_EQUAL_UINT8(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ASSERT_EQUAL_UINT16(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ASSERT_EQUAL_UINT32(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ASSERT_EQUAL_HEX8(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ASSERT_EQUAL_HEX32(e, a) TEST_ASSERT_EQUAL_INT64_(e, a)
+#define TEST_ESP_OK(a) TEST_ASSERT_EQUAL_INT64_(0, a)
+
+#define TEST_ASSERT_INT_WITHIN(d, e, a) do {                                                 \
+        long long __d = (long long)(e) - (long long)(a);                                    \
+        if (__d < 0) __d = -__d;                                                             \
+        if (__d > (long long)(d)) unity_host_fail(__FILE__, __LINE__, "expected %lld +/- %lld, was %lld (%s)", (long long)(e), (long long)(d), (long long)(a), #a); \
+    } while (0)
+#define TEST_ASSERT_UINT32_WITHIN(d, e, a) TEST_ASSERT_INT_WITHIN(d, e, a)
+#define TEST_ASSERT_FLOAT_WITHIN(d, e, a) do {                                               \
+        double __d = (double)(e) - (double)(a);                                             \
+        if (__d < 0) __d = -__d;                                                             \
+        if (__d > (double)(d)) unity_host_fail(__FILE__, __LINE__, "expected %f +/- %f, was %f (%s)", (double)(e), (double)(d), (double)(a), #a); \
+    } while (0)
+#define TEST_ASSERT_LESS_OR_EQUAL(t, a) do { if (!((a) <= (t))) unity_host_fail(__FILE__, __LINE__, "%s > %s", #a, #t); } while (0)
+#define TEST_ASSERT_GREATER_OR_EQUAL(t, a) do { if (!((a) >= (t))) unity_host_fail(__FILE__, __LINE__, "%s < %s", #a, #t); } while (0)
+#define TEST_ASSERT_LESS_THAN(t, a) do { if (!((a) < (t))) unity_host_fail(__FILE__, __LINE__, "%s >= %s", #a, #t); } while (0)
+#define TEST_ASSERT_GREATER_THAN(t, a) do { if (!((a) > (t))) unity_host_fail(__FILE__, __LINE__, "%s <= %s", #a, #t); } while (0)
+#define TEST_ASSERT_EQUAL_MEMORY(e, a, len) do {                                             \
+        if (memcmp((e), (a), (len))) unity_host_fail(__FILE__, __LINE__, "memory differs (%s)", #a); \
+    } while (0)
+#define TEST_ASSERT_EQUAL_UINT8_ARRAY(e, a, n) TEST_ASSERT_EQUAL_MEMORY(e, a, n)
+
+#ifdef __cplusplus
+}
+#endif
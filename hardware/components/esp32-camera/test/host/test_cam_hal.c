@@ -0,0 +1,587 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "host_heap.h"
+#include "cam_sim.h"
+
+static cam_sim_config_t jpeg_config(void)
+{
+    cam_sim_config_t config = {
+        .format = PIXFORMAT_JPEG, .frame_size = FRAMESIZE_VGA,
+        .fb_count = 2, .grab_mode = CAMERA_GRAB_LATEST,
+        .fps = 50, .jpeg_size = 20000, .jpeg_jitter = 3000, .frames = 40, .lockstep = true,
+    };
+    return config;
+}
+
+static cam_sim_config_t yuv_config(void)
+{
+    cam_sim_config_t config = {
+        .format = PIXFORMAT_YUV422, .frame_size = FRAMESIZE_QVGA,
+        .fb_count = 2, .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+        .fps = 50, .frames = 40, .lockstep = true,
+    };
+    return config;
+}
+
+TEST_CASE("JPEG frames from the DMA ring reach the consumer intact", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    cam_sim_stats_t stats;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("jpeg dram", &stats);
+    TEST_ASSERT_EQUAL(40, stats.sent);
+    TEST_ASSERT_EQUAL(0, stats.event_overflows);
+    TEST_ASSERT_EQUAL(0, stats.missed);
+    TEST_ASSERT_EQUAL(40, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    TEST_ASSERT_EQUAL(0, stats.padded);
+    TEST_ASSERT_EQUAL(0, stats.reordered);
+}
+
+TEST_CASE("JPEG frames in PSRAM mode reach the consumer intact", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    config.psram_mode = true;
+    cam_sim_stats_t stats;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("jpeg psram", &stats);
+    TEST_ASSERT_EQUAL(40, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    // the length comes from the EOI, not from the number of DMA chunks
+    TEST_ASSERT_EQUAL(0, stats.padded);
+}
+
+TEST_CASE("JPEG length is exact when the EOI is split between DMA chunks", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    // 0xFF ends one 1 KB chunk, 0xD9 starts the next
+    config.jpeg_size = 20 * 1024 + 1;
+    config.jpeg_jitter = 0;
+    cam_sim_stats_t stats;
+    for (int psram = 0; psram < 2; psram++) {
+        config.psram_mode = psram;
+        TEST_ESP_OK(cam_sim_run(&config, &stats));
+        cam_sim_print(psram ? "jpeg psram split eoi" : "jpeg dram split eoi", &stats);
+        TEST_ASSERT_EQUAL(40, stats.delivered);
+        TEST_ASSERT_EQUAL(0, stats.corrupt);
+        TEST_ASSERT_EQUAL(0, stats.padded);
+    }
+}
+
+/*
+ * JPEG size traces for adaptive frame buffers, VGA at quality 10 to 12: a steady
+ * scene, a scene that gets busier for a while, and a steady scene with the odd
+ * large frame.
+ */
+typedef enum { TRACE_STEADY, TRACE_BUSY, TRACE_SPIKES } trace_kind_t;
+
+static uint32_t *make_trace(trace_kind_t kind, size_t frames)
+{
+    uint32_t *trace = malloc(frames * sizeof(uint32_t));
+    uint32_t r = 12345;
+    for (size_t i = 0; i < frames; i++) {
+        r = r * 1103515245u + 12345u;
+        uint32_t noise = (r >> 8) % 4001;
+        uint32_t len = 20000 + noise * 5;
+        if (kind == TRACE_BUSY) {
+            len = i >= frames / 3 && i < frames * 2 / 3 ? 42000 + noise : 22000 + noise;
+        } else if (kind == TRACE_SPIKES) {
+            len = i % 40 == 39 ? 52000 : 24000 + noise;
+        }
+        trace[i] = len;
+    }
+    return trace;
+}
+
+TEST_CASE("Adaptive JPEG frame buffers follow the frame sizes", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    // long enough for the buffers to shrink again after the busy part
+    config.frames = 240;
+    config.jpeg_trace = make_trace(TRACE_BUSY, config.frames);
+    config.jpeg_trace_len = config.frames;
+    cam_sim_stats_t fixed, adaptive;
+    TEST_ESP_OK(cam_sim_run(&config, &fixed));
+    cam_sim_print("jpeg fixed", &fixed);
+    config.jpeg_adaptive = true;
+    TEST_ESP_OK(cam_sim_run(&config, &adaptive));
+    cam_sim_print("jpeg adaptive", &adaptive);
+    printf("frame buffers fixed %zu KB, adaptive %zu KB at the end, %zu KB at most, %u overflows %u resizes\n",
+           fixed.fb_bytes / 1024, adaptive.fb_bytes / 1024, adaptive.fb_bytes_max / 1024,
+           (unsigned)adaptive.fb_overflows, (unsigned)adaptive.fb_resizes);
+
+    TEST_ASSERT_EQUAL(240, fixed.delivered);
+    TEST_ASSERT_EQUAL(0, fixed.fb_overflows);
+    TEST_ASSERT_EQUAL(0, adaptive.corrupt);
+    TEST_ASSERT_EQUAL(0, adaptive.padded);
+    // the first frame and the step up may not fit, the buffers grow and take the rest
+    TEST_ASSERT_LESS_OR_EQUAL(4, adaptive.fb_overflows);
+    TEST_ASSERT_EQUAL(240, adaptive.delivered + adaptive.fb_overflows);
+    // back to small buffers after the busy part, never more than the fixed ones
+    TEST_ASSERT_LESS_THAN(fixed.fb_bytes * 2 / 3, adaptive.fb_bytes);
+    TEST_ASSERT_LESS_OR_EQUAL(fixed.fb_bytes, adaptive.fb_bytes_max);
+    free((void *)config.jpeg_trace);
+}
+
+TEST_CASE("YUV frames are delivered complete in both DMA modes", "[cam_hal]")
+{
+    cam_sim_config_t config = yuv_config();
+    cam_sim_stats_t stats;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("yuv dram", &stats);
+    TEST_ASSERT_EQUAL(40, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    TEST_ASSERT_EQUAL(0, stats.padded);
+
+    config.psram_mode = true;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("yuv psram", &stats);
+    TEST_ASSERT_EQUAL(40, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    TEST_ASSERT_EQUAL(0, stats.padded);
+}
+
+TEST_CASE("A slow consumer gets intact frames in order in both grab modes", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    config.fb_count = 3;
+    config.consumer_us = 25000;
+    cam_sim_stats_t empty, latest;
+
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    TEST_ESP_OK(cam_sim_run(&config, &empty));
+    cam_sim_print("jpeg empty, slow consumer", &empty);
+    // 25 ms per frame can not keep up with 50 fps, the rest is never captured
+    TEST_ASSERT_TRUE(empty.delivered <= 34);
+    TEST_ASSERT_EQUAL(empty.sent - empty.delivered, empty.missed);
+    TEST_ASSERT_EQUAL(0, empty.overwritten);
+    TEST_ASSERT_EQUAL(0, empty.corrupt);
+    TEST_ASSERT_EQUAL(0, empty.reordered);
+
+    config.grab_mode = CAMERA_GRAB_LATEST;
+    TEST_ESP_OK(cam_sim_run(&config, &latest));
+    cam_sim_print("jpeg latest, slow consumer", &latest);
+    // every frame is captured, the ones the consumer is too slow for are recycled
+    TEST_ASSERT_EQUAL(0, latest.missed);
+    TEST_ASSERT_TRUE(latest.overwritten > 0);
+    TEST_ASSERT_TRUE(latest.delivered + latest.overwritten >= latest.sent - 2);
+    TEST_ASSERT_EQUAL(0, latest.corrupt);
+    TEST_ASSERT_EQUAL(0, latest.reordered);
+    TEST_ASSERT_TRUE(latest.latency_avg_us < empty.latency_avg_us * 0.75);
+}
+
+static uint32_t drops_total(const camera_drop_stats_t *d)
+{
+    return d->fb_overflow + d->no_soi + d->no_eoi + d->bad_size + d->event_overflow + d->starved + d->overwritten;
+}
+
+TEST_CASE("Frames carry their drops and latency, the counters give the reason", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    config.fb_count = 3;
+    config.consumer_us = 25000;
+    cam_sim_stats_t stats;
+
+    // too slow for 50 fps: frames are not captured
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    TEST_ASSERT_EQUAL(stats.starved, stats.drops.starved);
+    TEST_ASSERT_EQUAL(stats.starved, drops_total(&stats.drops));
+    // the VSYNC after the last frame finds no buffer, after the last delivery
+    TEST_ASSERT_TRUE(stats.meta_dropped == stats.starved || stats.meta_dropped + 1 == stats.starved);
+
+    // captured and replaced by newer ones, as the sequence numbers show
+    config.grab_mode = CAMERA_GRAB_LATEST;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    TEST_ASSERT_TRUE(stats.drops.overwritten > 0);
+    TEST_ASSERT_EQUAL(stats.drops.overwritten, drops_total(&stats.drops));
+    TEST_ASSERT_EQUAL(stats.overwritten, stats.meta_dropped);
+    // from VSYNC, the capture time longer than from the end of the frame
+    TEST_ASSERT_GREATER_THAN(stats.latency_avg_us + 10000, stats.meta_latency_avg_us);
+
+    // frames that do not fit their buffer
+    config = jpeg_config();
+    config.frames = 60;
+    config.jpeg_trace = make_trace(TRACE_BUSY, config.frames);
+    config.jpeg_trace_len = config.frames;
+    config.jpeg_adaptive = true;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    TEST_ASSERT_TRUE(stats.fb_overflows > 0);
+    TEST_ASSERT_EQUAL(stats.fb_overflows, stats.drops.fb_overflow);
+    TEST_ASSERT_EQUAL(stats.fb_overflows, drops_total(&stats.drops));
+    TEST_ASSERT_EQUAL(stats.fb_overflows, stats.meta_dropped);
+    // the consumer waits past the last frame, that is no lost frame
+    TEST_ASSERT_TRUE(stats.drops.timeout >= 1);
+    free((void *)config.jpeg_trace);
+}
+
+TEST_CASE("Frames shared by three consumers are reused only after the last release", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    config.fb_count = 3;
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    config.sharers = 2;
+    cam_sim_stats_t stats;
+
+    config.sharer_us = 5000;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("jpeg shared 5ms", &stats);
+    TEST_ASSERT_TRUE(stats.delivered >= 38);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    TEST_ASSERT_EQUAL(0, stats.shared_corrupt);
+    TEST_ASSERT_EQUAL(0, stats.held_at_end);
+
+    // the sharers hold each frame for two frame periods: capture runs out of buffers
+    config.sharer_us = 40000;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("jpeg shared 40ms", &stats);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    TEST_ASSERT_EQUAL(0, stats.shared_corrupt);
+    TEST_ASSERT_EQUAL(0, stats.held_at_end);
+    TEST_ASSERT_TRUE(stats.starved > 0);
+    // the VSYNC after the last frame may find no buffer as well
+    TEST_ASSERT_TRUE(stats.starved >= stats.missed && stats.starved <= stats.missed + 1);
+}
+
+TEST_CASE("On demand capture skips the warm-up frames and stops between shots", "[cam_hal]")
+{
+    cam_sim_config_t config = jpeg_config();
+    config.fb_count = 1;
+    config.frames = 60;
+    // one shot every 100 ms, five frame periods
+    config.idle_us = 100000;
+    cam_sim_stats_t continuous, on_demand;
+
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    TEST_ESP_OK(cam_sim_run(&config, &continuous));
+    cam_sim_print("jpeg continuous 100ms", &continuous);
+    // the frame waiting in the buffer was captured before the consumer asked
+    TEST_ASSERT_TRUE(continuous.stale > 0);
+
+    config.grab_mode = CAMERA_GRAB_ON_DEMAND;
+    config.warmup_frames = 2;
+    TEST_ESP_OK(cam_sim_run(&config, &on_demand));
+    cam_sim_print("jpeg on demand 100ms", &on_demand);
+    TEST_ASSERT_TRUE(on_demand.delivered >= 5);
+    TEST_ASSERT_EQUAL(0, on_demand.corrupt);
+    TEST_ASSERT_EQUAL(0, on_demand.stale);
+    // two skipped frames, then the one delivered
+    TEST_ASSERT_EQUAL(2, on_demand.skipped_min);
+    // VSYNC runs for the warm-up, the frame and the VSYNC that ends it, then stays off
+    TEST_ASSERT_EQUAL(continuous.sent + 1, continuous.vsyncs);
+    TEST_ASSERT_TRUE(on_demand.vsyncs <= (on_demand.delivered + 1) * (config.warmup_frames + 2));
+    TEST_ASSERT_TRUE(on_demand.events < continuous.events);
+    TEST_ASSERT_TRUE(on_demand.cpu_us < continuous.cpu_us);
+}
+
+/*
+ * Line callback checks: bands run on cam_task, the frames on the consumer, the
+ * results are read on the main thread after the run.
+ */
+enum { LINE_FRAMES = 40 };
+
+typedef struct {
+    uint32_t seq;                       // frame the last band belonged to
+    uint16_t next_y;                    // first row the next band should start at
+    int bands, gaps;
+    uint32_t sum[LINE_FRAMES + 2];      // FNV-1a of the bands of every frame, by sequence number
+    bool complete[LINE_FRAMES + 2];     // the band ending the frame came
+    int frames, checked, mismatched, incomplete;
+} line_check_t;
+
+static uint32_t fnv(uint32_t h, const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void line_check_band(const camera_line_band_t *band, void *arg)
+{
+    line_check_t *c = arg;
+    if (band->seq != c->seq) {
+        c->seq = band->seq;
+        c->next_y = 0;
+        if (band->seq < LINE_FRAMES + 2) {
+            c->sum[band->seq] = 2166136261u;
+        }
+    }
+    c->bands++;
+    if (band->y != c->next_y || band->len != band->rows * band->width * 2u || band->seq >= LINE_FRAMES + 2) {
+        c->gaps++;
+        return;
+    }
+    c->next_y += band->rows;
+    c->sum[band->seq] = fnv(c->sum[band->seq], band->buf, band->len);
+    if (c->next_y == band->height) {
+        c->complete[band->seq] = true;
+        c->frames++;
+    }
+}
+
+static void line_check_frame(camera_fb_t *fb, void *arg)
+{
+    line_check_t *c = arg;
+    c->checked++;
+    if (fb->seq >= LINE_FRAMES + 2 || !c->complete[fb->seq]) {
+        c->incomplete++;
+    } else if (c->sum[fb->seq] != fnv(2166136261u, fb->buf, fb->len)) {
+        c->mismatched++;
+    }
+}
+
+TEST_CASE("Line callback gets every row before the frame is delivered", "[cam_hal]")
+{
+    cam_sim_config_t config = yuv_config();
+    config.frames = LINE_FRAMES;
+    config.line_cb = line_check_band;
+    config.frame_cb = line_check_frame;
+    static line_check_t framed, rows_only;
+    cam_sim_stats_t stats;
+
+    config.cb_arg = &framed;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("yuv line callback", &stats);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+    TEST_ASSERT_EQUAL(LINE_FRAMES, framed.frames);
+    TEST_ASSERT_EQUAL(0, framed.gaps);
+    // a QVGA frame is several DMA transfers
+    TEST_ASSERT_TRUE(framed.bands >= 4 * LINE_FRAMES);
+    TEST_ASSERT_EQUAL(stats.delivered, framed.checked);
+    TEST_ASSERT_EQUAL(0, framed.incomplete);
+    TEST_ASSERT_EQUAL(0, framed.mismatched);
+
+    // no frame buffers: the same rows through a buffer for one DMA transfer
+    config.fb_count = 0;
+    config.cb_arg = &rows_only;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    cam_sim_print("yuv rows only", &stats);
+    TEST_ASSERT_EQUAL(0, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.missed);
+    TEST_ASSERT_EQUAL(LINE_FRAMES, rows_only.frames);
+    TEST_ASSERT_EQUAL(0, rows_only.gaps);
+    for (int seq = 1; seq <= LINE_FRAMES; seq++) {
+        TEST_ASSERT_EQUAL_HEX32(framed.sum[seq], rows_only.sum[seq]);
+    }
+
+    // rows only exist where cam_task copies them
+    config.fb_count = 2;
+    config.psram_mode = true;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, cam_sim_run(&config, &stats));
+    config = jpeg_config();
+    config.line_cb = line_check_band;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, cam_sim_run(&config, &stats));
+}
+
+TEST_CASE("cam_hal capture benchmark", "[cam_hal][bench]")
+{
+    static const struct {
+        const char *name;
+        pixformat_t format;
+        bool psram;
+        size_t fb_count;
+        camera_grab_mode_t grab;
+        uint32_t consumer_us;
+    } runs[] = {
+        {"jpeg dram 1fb empty", PIXFORMAT_JPEG, false, 1, CAMERA_GRAB_WHEN_EMPTY, 0},
+        {"jpeg dram 2fb latest", PIXFORMAT_JPEG, false, 2, CAMERA_GRAB_LATEST, 0},
+        {"jpeg dram 3fb latest 20ms", PIXFORMAT_JPEG, false, 3, CAMERA_GRAB_LATEST, 20000},
+        {"jpeg psram 2fb latest", PIXFORMAT_JPEG, true, 2, CAMERA_GRAB_LATEST, 0},
+        {"yuv dram 2fb empty", PIXFORMAT_YUV422, false, 2, CAMERA_GRAB_WHEN_EMPTY, 0},
+        {"yuv psram 2fb latest 20ms", PIXFORMAT_YUV422, true, 2, CAMERA_GRAB_LATEST, 20000},
+    };
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        cam_sim_config_t config = runs[i].format == PIXFORMAT_JPEG ? jpeg_config() : yuv_config();
+        config.psram_mode = runs[i].psram;
+        config.fb_count = runs[i].fb_count;
+        config.grab_mode = runs[i].grab;
+        config.consumer_us = runs[i].consumer_us;
+        config.fps = 60;
+        config.frames = 120;
+        config.lockstep = false;
+        cam_sim_stats_t stats;
+        TEST_ESP_OK(cam_sim_run(&config, &stats));
+        cam_sim_print(runs[i].name, &stats);
+    }
+}
+
+/*
+ * Frame buffer RAM on replayed size traces: fixed buffers are sized for the
+ * resolution, adaptive ones for the frames. Memory is the buffers allocated at
+ * the end of the trace and the most allocated at any frame start.
+ */
+TEST_CASE("Adaptive JPEG frame buffer memory benchmark", "[cam_hal][bench]")
+{
+    static const char *names[] = {"steady 20-40 KB", "busy 22 -> 42 KB", "spikes 24 + 52 KB"};
+    enum { FRAMES = 300 };
+    printf("VGA JPEG 25 fps, 2 frame buffers, grab latest\n");
+    printf("  %-20s %9s %9s %9s %6s %8s %9s\n", "trace", "fixed KB", "end KB", "max KB", "saved", "overflow", "delivered");
+    for (int t = 0; t < 3; t++) {
+        cam_sim_config_t config = jpeg_config();
+        config.frames = FRAMES;
+        config.fps = 25;
+        config.jpeg_trace = make_trace(t, FRAMES);
+        config.jpeg_trace_len = FRAMES;
+        cam_sim_stats_t fixed, adaptive;
+        TEST_ESP_OK(cam_sim_run(&config, &fixed));
+        config.jpeg_adaptive = true;
+        TEST_ESP_OK(cam_sim_run(&config, &adaptive));
+        printf("  %-20s %9zu %9zu %9zu %5.0f%% %8u %9d\n", names[t], fixed.fb_bytes / 1024,
+               adaptive.fb_bytes / 1024, adaptive.fb_bytes_max / 1024,
+               100.0 - 100.0 * adaptive.fb_bytes / fixed.fb_bytes, (unsigned)adaptive.fb_overflows, adaptive.delivered);
+        free((void *)config.jpeg_trace);
+    }
+}
+
+/*
+ * One shot every 15 minutes: continuous capture costs the same every hour whatever the
+ * consumer does, on demand capture costs a warm-up and a frame per shot.
+ */
+TEST_CASE("On demand capture cost per hour", "[cam_hal][bench]")
+{
+    cam_sim_config_t config = jpeg_config();
+    config.fb_count = 1;
+    config.frames = 120;
+    config.fps = 25;
+    config.idle_us = 400000;
+    config.lockstep = false;
+    cam_sim_stats_t continuous, on_demand;
+
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    TEST_ESP_OK(cam_sim_run(&config, &continuous));
+    config.grab_mode = CAMERA_GRAB_ON_DEMAND;
+    config.warmup_frames = 2;
+    TEST_ESP_OK(cam_sim_run(&config, &on_demand));
+
+    double hour = 3600e6, shots = 4;
+    double cont_cpu = continuous.cpu_us / continuous.duration_us * hour;
+    double cont_isr = continuous.events / continuous.duration_us * hour;
+    double shot_cpu = on_demand.cpu_us / on_demand.delivered;
+    double shot_isr = (double)on_demand.events / on_demand.delivered;
+    printf("VGA JPEG 25 fps, 4 shots per hour\n");
+    printf("  continuous  %10.0f ms cam_task CPU  %10.0f interrupts per hour\n", cont_cpu / 1000, cont_isr);
+    printf("  on demand   %10.2f ms cam_task CPU  %10.0f interrupts per hour (%.2f ms, %.0f per shot)\n",
+           shot_cpu * shots / 1000, shot_isr * shots, shot_cpu / 1000, shot_isr);
+}
+
+/*
+ * Demo of the line callback: VGA YUV422 at 10 fps to JPEG. The usual way encodes the frame once
+ * esp_camera_fb_get() returns it, and needs two frame buffers to capture the next
+ * frame meanwhile. With the callback the rows go into the encoder as they arrive,
+ * without frame buffers, and the JPEG is done one DMA transfer after the last row.
+ */
+typedef struct {
+    bool stream;                        // encode from the line callback
+    jpg_stream_t *jpg;
+    size_t jpg_len;
+    int64_t last_row_us;                // last band of the frame reached the callback
+    int jpegs, failed;
+    double latency_us, latency_max_us;
+} line_jpeg_t;
+
+static size_t line_jpeg_out(void *arg, size_t index, const void *data, size_t len)
+{
+    ((line_jpeg_t *)arg)->jpg_len += len;
+    return len;
+}
+
+static void line_jpeg_done(line_jpeg_t *j, bool ok)
+{
+    double l = esp_timer_get_time() - j->last_row_us;
+    j->jpegs += ok;
+    j->failed += !ok;
+    j->latency_us += l;
+    j->latency_max_us = l > j->latency_max_us ? l : j->latency_max_us;
+}
+
+static void line_jpeg_band(const camera_line_band_t *band, void *arg)
+{
+    line_jpeg_t *j = arg;
+    bool last = band->y + band->rows == band->height;
+    if (last) {
+        j->last_row_us = esp_timer_get_time();
+    }
+    if (!j->stream) {
+        return;
+    }
+    if (band->y == 0) {
+        // a frame cut short by the event queue overflowing
+        if (j->jpg) {
+            jpg_stream_end(j->jpg);
+            j->failed++;
+        }
+        j->jpg = jpg_stream_start(band->width, band->height, PIXFORMAT_YUV422, 80, line_jpeg_out, j);
+    }
+    if (!j->jpg) {
+        return;
+    }
+    if (!jpg_stream_rows(j->jpg, band->buf, band->rows)) {
+        jpg_stream_end(j->jpg);
+        j->jpg = NULL;
+        j->failed++;
+    } else if (last) {
+        line_jpeg_done(j, jpg_stream_end(j->jpg));
+        j->jpg = NULL;
+    }
+}
+
+static void line_jpeg_frame(camera_fb_t *fb, void *arg)
+{
+    line_jpeg_t *j = arg;
+    line_jpeg_done(j, fmt2jpg_cb(fb->buf, fb->len, 640, 480, PIXFORMAT_YUV422, 80, line_jpeg_out, j));
+}
+
+TEST_CASE("Line callback JPEG pipeline benchmark", "[cam_hal][bench]")
+{
+    static const struct {
+        const char *name;
+        bool stream;
+        size_t fb_count;
+    } runs[] = {
+        {"encode the frame, 1 fb", false, 1},
+        {"encode the frame, 2 fb", false, 2},
+        {"encode the rows, no fb", true, 0},
+    };
+
+    // encoder working memory, measured alone: the simulator allocates from other threads
+    line_jpeg_t j = { 0 };
+    uint8_t *yuv = calloc(640 * 480, 2);
+    size_t base = host_heap_used();
+    host_heap_reset_peak();
+    TEST_ASSERT_TRUE(fmt2jpg_cb(yuv, 640 * 480 * 2, 640, 480, PIXFORMAT_YUV422, 80, line_jpeg_out, &j));
+    size_t frame_ram = host_heap_peak() - base;
+    host_heap_reset_peak();
+    jpg_stream_t *jpg = jpg_stream_start(640, 480, PIXFORMAT_YUV422, 80, line_jpeg_out, &j);
+    for (int y = 0; y < 480; y += 16) {
+        TEST_ASSERT_TRUE(jpg_stream_rows(jpg, yuv + y * 640 * 2, 16));
+    }
+    TEST_ASSERT_TRUE(jpg_stream_end(jpg));
+    size_t stream_ram = host_heap_peak() - base;
+    free(yuv);
+
+    printf("VGA YUV422 10 fps to JPEG\n");
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        cam_sim_config_t config = yuv_config();
+        config.frame_size = FRAMESIZE_VGA;
+        config.fps = 10;
+        config.frames = 50;
+        config.fb_count = runs[i].fb_count;
+        config.lockstep = false;
+        config.line_cb = line_jpeg_band;
+        config.frame_cb = runs[i].stream ? NULL : line_jpeg_frame;
+        memset(&j, 0, sizeof(j));
+        j.stream = runs[i].stream;
+        config.cb_arg = &j;
+        cam_sim_stats_t stats;
+        TEST_ESP_OK(cam_sim_run(&config, &stats));
+        size_t encoder_ram = runs[i].stream ? stream_ram : frame_ram;
+        printf("  %-24s %5.1f JPEG/s  latency after the last row %6.2f/%6.2f ms  RAM %4zu KB frame buffers + %3zu KB encoder  ev-ovf %d failed %d\n",
+               runs[i].name, j.jpegs * 1e6 / stats.duration_us, j.latency_us / (j.jpegs ? j.jpegs : 1) / 1000,
+               j.latency_max_us / 1000, stats.fb_bytes / 1024, encoder_ram / 1024, stats.event_overflows, j.failed);
+    }
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "cam_jpeg.h"
+
+/*
+ * The scans cam_hal.c used before: memcmp at every offset, the EOI backward from
+ * the end of the buffer.
+ */
+static int old_find_soi(const uint8_t *buf, size_t len)
+{
+    static const uint8_t soi[] = {0xFF, 0xD8, 0xFF};
+    for (size_t i = 0; i + 3 <= len; i++) {
+        if (memcmp(&buf[i], soi, 3) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int old_find_eoi(const uint8_t *buf, size_t len)
+{
+    static const uint8_t eoi[] = {0xFF, 0xD9};
+    const uint8_t *p = buf + len - 2;
+    while (p > buf) {
+        if (memcmp(p, eoi, 2) == 0) {
+            return p - buf;
+        }
+        p--;
+    }
+    return -1;
+}
+
+static int ref_find_eoi(const uint8_t *buf, size_t from, size_t len)
+{
+    for (size_t i = from; i + 2 <= len; i++) {
+        if (buf[i] == 0xFF && buf[i + 1] == 0xD9) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// random bytes with a 0xFF every ff_every bytes on average, stuffed like entropy coded data
+static void fill_entropy(uint8_t *buf, size_t len, int ff_every, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        if (rand() % ff_every == 0 && i + 1 < len) {
+            buf[i++] = 0xFF;
+            buf[i] = 0x00;
+        } else {
+            buf[i] = rand() % 0xFF;
+        }
+    }
+}
+
+// SOI, entropy data and EOI, followed by zero padding
+static size_t make_jpeg(uint8_t *buf, size_t len, size_t padding, int ff_every, unsigned seed)
+{
+    fill_entropy(buf, len, ff_every, seed);
+    buf[0] = 0xFF;
+    buf[1] = 0xD8;
+    buf[2] = 0xFF;
+    buf[3] = 0xE0;
+    buf[len - 2] = 0xFF;
+    buf[len - 1] = 0xD9;
+    memset(buf + len, 0, padding);
+    return len + padding;
+}
+
+TEST_CASE("Word-at-a-time 0xFF search matches a byte loop", "[cam_jpeg]")
+{
+    uint8_t buf[300];
+    for (int seed = 0; seed < 20; seed++) {
+        srand(seed);
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            // dense enough to put 0xFF in every byte lane, plus 0xFE and 0x7F neighbours
+            int r = rand() % 8;
+            buf[i] = r == 0 ? 0xFF : r == 1 ? 0xFE : r == 2 ? 0x7F : rand() & 0xFF;
+        }
+        for (size_t start = 0; start < 8; start++) {
+            for (size_t len = 0; len + start <= sizeof(buf); len += 7) {
+                size_t expect = 0;
+                while (expect < len && buf[start + expect] != 0xFF) {
+                    expect++;
+                }
+                TEST_ASSERT_EQUAL(expect, cam_jpeg_find_ff(buf + start, len));
+            }
+        }
+    }
+    memset(buf, 0xFE, sizeof(buf));
+    TEST_ASSERT_EQUAL(sizeof(buf), cam_jpeg_find_ff(buf, sizeof(buf)));
+    buf[sizeof(buf) - 1] = 0xFF;
+    TEST_ASSERT_EQUAL(sizeof(buf) - 1, cam_jpeg_find_ff(buf, sizeof(buf)));
+}
+
+TEST_CASE("SOI and EOI searches find the first marker", "[cam_jpeg]")
+{
+    uint8_t buf[512];
+    for (int seed = 0; seed < 50; seed++) {
+        fill_entropy(buf, sizeof(buf), 4, seed);
+        size_t soi = rand() % (sizeof(buf) - 3);
+        size_t eoi = rand() % (sizeof(buf) - 2);
+        buf[soi] = 0xFF;
+        buf[soi + 1] = 0xD8;
+        buf[soi + 2] = 0xFF;
+        buf[eoi] = 0xFF;
+        buf[eoi + 1] = 0xD9;
+        TEST_ASSERT_EQUAL(old_find_soi(buf, sizeof(buf)), cam_jpeg_find_soi(buf, sizeof(buf)));
+        for (size_t from = 0; from < 8; from++) {
+            TEST_ASSERT_EQUAL(ref_find_eoi(buf, from, sizeof(buf)), cam_jpeg_find_eoi(buf, from, sizeof(buf)));
+        }
+    }
+    // markers cut off at the end of the data
+    static const uint8_t cut[] = {0x00, 0xFF, 0xD8};
+    TEST_ASSERT_EQUAL(-1, cam_jpeg_find_soi(cut, sizeof(cut)));
+    TEST_ASSERT_EQUAL(-1, cam_jpeg_find_eoi(cut, 0, 2));
+    TEST_ASSERT_EQUAL(-1, cam_jpeg_find_soi(cut, 0));
+    TEST_ASSERT_EQUAL(-1, cam_jpeg_find_eoi(cut, 0, 0));
+}
+
+TEST_CASE("Incremental EOI search finds markers split between chunks", "[cam_jpeg]")
+{
+    enum { CHUNK = 64 };
+    uint8_t buf[16 * CHUNK];
+    for (size_t len = 16; len <= sizeof(buf); len += 13) {
+        make_jpeg(buf, len, sizeof(buf) - len, 8, len);
+        // chunks arrive one at a time and each search starts one byte before the new data
+        int eoi = -1;
+        for (size_t start = 0; start < sizeof(buf) && eoi < 0; start += CHUNK) {
+            eoi = cam_jpeg_find_eoi(buf, start ? start - 1 : 0, start + CHUNK);
+        }
+        TEST_ASSERT_EQUAL(len - 2, eoi);
+    }
+}
+
+TEST_CASE("JPEG sizer follows the 95th percentile of recent frames", "[cam_jpeg]")
+{
+    cam_jpeg_sizer_t sizer;
+    size_t size;
+    cam_jpeg_sizer_init(&sizer, 1024, 60000);
+    TEST_ASSERT_EQUAL(0, cam_jpeg_sizer_target(&sizer));
+    TEST_ASSERT_FALSE(cam_jpeg_sizer_resize(&sizer, 40 * 1024, &size));
+
+    // 20 KB plus the margin, in whole DMA chunks
+    cam_jpeg_sizer_add(&sizer, 20000);
+    TEST_ASSERT_EQUAL(25 * 1024, cam_jpeg_sizer_target(&sizer));
+    TEST_ASSERT_TRUE(cam_jpeg_sizer_resize(&sizer, 40 * 1024, &size));
+    TEST_ASSERT_EQUAL(25 * 1024, size);
+    // within a quarter above the target the buffer is kept, below it grows
+    TEST_ASSERT_FALSE(cam_jpeg_sizer_resize(&sizer, 30 * 1024, &size));
+    TEST_ASSERT_TRUE(cam_jpeg_sizer_resize(&sizer, 24 * 1024, &size));
+
+    // a full history: one frame in 20 may be larger than the target
+    for (int i = 0; i < CAM_JPEG_SIZE_HISTORY; i++) {
+        cam_jpeg_sizer_add(&sizer, i == 5 ? 40000 : 10000 + i * 100);
+    }
+    TEST_ASSERT_EQUAL((10000 + 31 * 100) * 5 / 4 / 1024 * 1024 + 1024, cam_jpeg_sizer_target(&sizer));
+    for (int i = 0; i < CAM_JPEG_SIZE_HISTORY; i++) {
+        TEST_ASSERT_TRUE(i == 0 || sizer.sorted[i - 1] <= sizer.sorted[i]);
+    }
+
+    // a single overflow grows the buffers although the percentile leaves it out
+    cam_jpeg_sizer_overflow(&sizer, 25 * 1024);
+    TEST_ASSERT_EQUAL(1, sizer.overflows);
+    TEST_ASSERT_EQUAL(40000, sizer.sorted[30]);
+    TEST_ASSERT_EQUAL(50 * 1024, cam_jpeg_sizer_target(&sizer));
+    // capped at the fixed size
+    cam_jpeg_sizer_overflow(&sizer, 50000);
+    TEST_ASSERT_EQUAL(60000, sizer.sorted[CAM_JPEG_SIZE_HISTORY - 1]);
+    TEST_ASSERT_EQUAL(60000, cam_jpeg_sizer_target(&sizer));
+
+    // the large frames leave the history, the buffers shrink once the overflow is old enough
+    for (int i = 0; i < CAM_JPEG_OVERFLOW_HOLD - 1; i++) {
+        cam_jpeg_sizer_add(&sizer, 8000);
+    }
+    TEST_ASSERT_EQUAL(60000, cam_jpeg_sizer_target(&sizer));
+    cam_jpeg_sizer_add(&sizer, 8000);
+    TEST_ASSERT_EQUAL(10 * 1024, cam_jpeg_sizer_target(&sizer));
+    for (int i = 0; i < CAM_JPEG_SIZE_HISTORY; i++) {
+        TEST_ASSERT_EQUAL(8000, sizer.sorted[i]);
+    }
+}
+
+/*
+ * Per frame cost of finding the JPEG: the old code checked the SOI in the first chunk
+ * and scanned back from the end of the buffer, the new one looks for the EOI in every
+ * chunk as it arrives and stops there. Padding stands for the zeros some sensors send
+ * after the image and for PSRAM mode, where the length is rounded up to whole chunks.
+ */
+TEST_CASE("JPEG marker scan benchmark", "[cam_jpeg][bench]")
+{
+    enum { CHUNK = 1024, FRAMES = 200 };
+    static const size_t sizes[] = {8000, 20000, 60000};
+    static const size_t paddings[] = {0, 1000, 16000};
+    uint8_t *buf = malloc(60000 + 16000 + CHUNK);
+    printf("%8s %8s %14s %14s\n", "jpeg", "padding", "old us/frame", "new us/frame");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t p = 0; p < sizeof(paddings) / sizeof(paddings[0]); p++) {
+            size_t total = make_jpeg(buf, sizes[s], paddings[p], 100, s);
+            int64_t t = esp_timer_get_time();
+            for (int f = 0; f < FRAMES; f++) {
+                TEST_ASSERT_EQUAL(0, old_find_soi(buf, CHUNK));
+                TEST_ASSERT_EQUAL(sizes[s] - 2, old_find_eoi(buf, total));
+            }
+            int64_t old_t = esp_timer_get_time() - t;
+            t = esp_timer_get_time();
+            for (int f = 0; f < FRAMES; f++) {
+                TEST_ASSERT_EQUAL(0, cam_jpeg_find_soi(buf, CHUNK));
+                int eoi = -1;
+                for (size_t start = 0; start < total && eoi < 0; start += CHUNK) {
+                    size_t end = start + CHUNK < total ? start + CHUNK : total;
+                    eoi = cam_jpeg_find_eoi(buf, start ? start - 1 : 0, end);
+                }
+                TEST_ASSERT_EQUAL(sizes[s] - 2, eoi);
+            }
+            int64_t new_t = esp_timer_get_time() - t;
+            printf("%8zu %8zu %14.2f %14.2f\n", sizes[s], paddings[p], (double)old_t / FRAMES, (double)new_t / FRAMES);
+        }
+    }
+    free(buf);
+}
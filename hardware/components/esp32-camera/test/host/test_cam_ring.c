@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "cam_ring.h"
+
+TEST_CASE("Ring keeps entries in order up to its capacity", "[cam_ring]")
+{
+    cam_ring_t ring;
+    uint8_t v;
+    cam_ring_init(&ring, 3);
+    TEST_ASSERT_FALSE(cam_ring_pop(&ring, &v));
+    // wrap the 32 bit counters and the slot index a few times
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_TRUE(cam_ring_push(&ring, round + i));
+        }
+        TEST_ASSERT_FALSE(cam_ring_push(&ring, 99));
+        TEST_ASSERT_EQUAL(3, cam_ring_count(&ring));
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_TRUE(cam_ring_pop(&ring, &v));
+            TEST_ASSERT_EQUAL((uint8_t)(round + i), v);
+        }
+        TEST_ASSERT_FALSE(cam_ring_pop(&ring, &v));
+    }
+    cam_ring_init(&ring, 100);
+    TEST_ASSERT_EQUAL(CAM_RING_MAX, ring.size);
+}
+
+/*
+ * Stress: the producer plays cam_task in grab latest mode, with frames that carry
+ * their sequence number in every byte. It fills free frames and recycles the oldest
+ * queued one when none is free. The consumer takes the newest frame and checks that
+ * no byte changes while it holds it, which would mean both sides got the same frame.
+ */
+enum { STRESS_FRAMES = 4, STRESS_BYTES = 64, STRESS_PUSHES = 2000000 };
+
+typedef struct {
+    cam_ring_t ring;
+    _Atomic uint32_t free_mask;
+    uint32_t frames[STRESS_FRAMES][STRESS_BYTES];
+    _Atomic int done;
+    int pushed, recycled, taken, freed_unseen;
+    int torn, reordered;
+} stress_t;
+
+static void stress_fill(uint32_t *frame, uint32_t seq)
+{
+    for (int i = 0; i < STRESS_BYTES; i++) {
+        frame[i] = seq;
+    }
+}
+
+static void *stress_producer(void *arg)
+{
+    stress_t *s = arg;
+    uint32_t seq = 0;
+    while (s->pushed < STRESS_PUSHES) {
+        int pos = -1;
+        uint32_t mask = atomic_load(&s->free_mask);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (atomic_compare_exchange_weak(&s->free_mask, &mask, mask & ~(1u << bit))) {
+                pos = bit;
+                break;
+            }
+        }
+        uint8_t oldest;
+        if (pos < 0 && cam_ring_count(&s->ring) > 1 && cam_ring_pop(&s->ring, &oldest)) {
+            pos = oldest;
+            s->recycled++;
+        }
+        if (pos < 0) {
+            sched_yield();
+            continue;
+        }
+        stress_fill(s->frames[pos], ++seq);
+        if (!cam_ring_push(&s->ring, pos)) {
+            // a frame is in the ring at most once, this can not happen
+            s->torn++;
+        }
+        s->pushed++;
+        if ((seq & 63) == 0) {
+            sched_yield();
+        }
+    }
+    atomic_store(&s->done, 1);
+    return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{
+    stress_t *s = arg;
+    uint32_t last = 0;
+    uint8_t pos, newer;
+    while (!atomic_load(&s->done) || cam_ring_count(&s->ring)) {
+        if (!cam_ring_pop(&s->ring, &pos)) {
+            sched_yield();
+            continue;
+        }
+        while (cam_ring_pop(&s->ring, &newer)) {
+            atomic_fetch_or(&s->free_mask, 1u << pos);
+            s->freed_unseen++;
+            pos = newer;
+        }
+        s->taken++;
+        uint32_t seq = s->frames[pos][0];
+        if (seq <= last) {
+            s->reordered++;
+        }
+        last = seq;
+        // hold the frame across a reschedule, then check nobody wrote it meanwhile
+        sched_yield();
+        for (int i = 0; i < STRESS_BYTES; i++) {
+            if (s->frames[pos][i] != seq) {
+                s->torn++;
+                break;
+            }
+        }
+        atomic_fetch_or(&s->free_mask, 1u << pos);
+    }
+    return NULL;
+}
+
+TEST_CASE("Producer recycling and consumer popping never share a frame", "[cam_ring]")
+{
+    stress_t *s = calloc(1, sizeof(stress_t));
+    cam_ring_init(&s->ring, STRESS_FRAMES);
+    atomic_store(&s->free_mask, (1u << STRESS_FRAMES) - 1);
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, stress_consumer, s);
+    pthread_create(&producer, NULL, stress_producer, s);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    printf("pushed %d, recycled by the producer %d, taken %d, skipped by the consumer %d\n",
+           s->pushed, s->recycled, s->taken, s->freed_unseen);
+    TEST_ASSERT_EQUAL(0, s->torn);
+    TEST_ASSERT_EQUAL(0, s->reordered);
+    // every push was popped exactly once
+    TEST_ASSERT_EQUAL(s->pushed, s->recycled + s->taken + s->freed_unseen);
+    TEST_ASSERT_EQUAL((1u << STRESS_FRAMES) - 1, atomic_load(&s->free_mask));
+    free(s);
+}
+
+/*
+ * Hand-off latency, the way cam_task passes frames to cam_take: the ring plus a
+ * binary semaphore to wake the consumer, against the FreeRTOS queue of frame
+ * pointers it replaced. On the host both block on the pthread shims, so the numbers
+ * compare the data structures, not the RTOS.
+ */
+enum { LAT_FRAMES = 20000 };
+
+typedef struct {
+    bool use_ring;
+    cam_ring_t ring;
+    SemaphoreHandle_t ready;
+    QueueHandle_t queue;
+    int64_t sent_at[LAT_FRAMES];
+    int64_t latency;
+    int64_t worst;
+} latency_t;
+
+static void *latency_consumer(void *arg)
+{
+    latency_t *l = arg;
+    for (int i = 0; i < LAT_FRAMES; i++) {
+        uint8_t pos;
+        if (l->use_ring) {
+            while (!cam_ring_pop(&l->ring, &pos)) {
+                xSemaphoreTake(l->ready, portMAX_DELAY);
+            }
+        } else {
+            void *fb;
+            xQueueReceive(l->queue, &fb, portMAX_DELAY);
+        }
+        int64_t d = esp_timer_get_time() - l->sent_at[i];
+        l->latency += d;
+        l->worst = d > l->worst ? d : l->worst;
+    }
+    return NULL;
+}
+
+static void latency_run(latency_t *l)
+{
+    pthread_t consumer;
+    l->latency = l->worst = 0;
+    pthread_create(&consumer, NULL, latency_consumer, l);
+    for (int i = 0; i < LAT_FRAMES; i++) {
+        // let the consumer block again, like between two frames
+        if ((i & 7) == 0) {
+            sched_yield();
+        }
+        l->sent_at[i] = esp_timer_get_time();
+        if (l->use_ring) {
+            while (!cam_ring_push(&l->ring, i & 3)) {
+                sched_yield();
+            }
+            xSemaphoreGive(l->ready);
+        } else {
+            void *fb = l;
+            while (xQueueSend(l->queue, &fb, 0) != pdTRUE) {
+                sched_yield();
+            }
+        }
+    }
+    pthread_join(consumer, NULL);
+}
+
+TEST_CASE("Frame hand-off benchmark against the FreeRTOS queue", "[cam_ring][bench]")
+{
+    latency_t *l = calloc(1, sizeof(latency_t));
+    cam_ring_init(&l->ring, 4);
+    l->ready = xSemaphoreCreateBinary();
+    l->queue = xQueueCreate(4, sizeof(void *));
+
+    // uncontended cost of one push and pop
+    enum { OPS = 1000000 };
+    uint8_t pos;
+    void *fb = l;
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < OPS; i++) {
+        cam_ring_push(&l->ring, i & 3);
+        cam_ring_pop(&l->ring, &pos);
+    }
+    int64_t ring_ops = esp_timer_get_time() - t;
+    t = esp_timer_get_time();
+    for (int i = 0; i < OPS; i++) {
+        xQueueSend(l->queue, &fb, 0);
+        xQueueReceive(l->queue, &fb, 0);
+    }
+    int64_t queue_ops = esp_timer_get_time() - t;
+    printf("push + pop        ring %6.1f ns   queue %6.1f ns\n", ring_ops * 1000.0 / OPS, queue_ops * 1000.0 / OPS);
+
+    l->use_ring = true;
+    latency_run(l);
+    printf("hand-off latency  ring %6.2f us avg %6lld us max\n", (double)l->latency / LAT_FRAMES, (long long)l->worst);
+    l->use_ring = false;
+    latency_run(l);
+    printf("hand-off latency  queue %5.2f us avg %6lld us max\n", (double)l->latency / LAT_FRAMES, (long long)l->worst);
+
+    vSemaphoreDelete(l->ready);
+    vQueueDelete(l->queue);
+    free(l);
+}
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "img_resize.h"
+#include "cam_stats.h"
+#include "cam_sim.h"
+
+/*
+ * Reference: every pixel on its own, the tile found from the grid lines, the
+ * gradient with the frame edges left out of the sum instead of counted as 0.
+ */
+static void ref_stats(const uint8_t *buf, int width, int height, int bpp, camera_frame_stats_t *ref)
+{
+    uint64_t tile_sum[CAMERA_STATS_GRID * CAMERA_STATS_GRID] = {0};
+    uint32_t tile_n[CAMERA_STATS_GRID * CAMERA_STATS_GRID] = {0};
+    uint64_t sum = 0, grad = 0;
+    memset(ref, 0, sizeof(*ref));
+    for (int y = 0; y < height; y++) {
+        int ty = CAMERA_STATS_GRID - 1;
+        while (ty * height / CAMERA_STATS_GRID > y) {
+            ty--;
+        }
+        for (int x = 0; x < width; x++) {
+            int tx = CAMERA_STATS_GRID - 1;
+            while (tx * width / CAMERA_STATS_GRID > x) {
+                tx--;
+            }
+            int v = buf[(y * width + x) * bpp];
+            ref->hist[v / 4]++;
+            sum += v;
+            tile_sum[ty * CAMERA_STATS_GRID + tx] += v;
+            tile_n[ty * CAMERA_STATS_GRID + tx]++;
+            if (x > 0) {
+                int d = v - buf[(y * width + x - 1) * bpp];
+                grad += d * d;
+            }
+            if (y > 0) {
+                int d = v - buf[((y - 1) * width + x) * bpp];
+                grad += d * d;
+            }
+        }
+    }
+    ref->count = width * height;
+    ref->mean = (sum + ref->count / 2) / ref->count;
+    ref->sharpness = grad / ref->count;
+    for (int i = 0; i < CAMERA_STATS_GRID * CAMERA_STATS_GRID; i++) {
+        ref->tiles[i] = tile_n[i] ? (tile_sum[i] + tile_n[i] / 2) / tile_n[i] : 0;
+    }
+}
+
+static void assert_stats_equal(const camera_frame_stats_t *ref, const camera_frame_stats_t *got)
+{
+    TEST_ASSERT_EQUAL(ref->count, got->count);
+    TEST_ASSERT_EQUAL(ref->mean, got->mean);
+    TEST_ASSERT_EQUAL(ref->sharpness, got->sharpness);
+    TEST_ASSERT_EQUAL_MEMORY(ref->hist, got->hist, sizeof(ref->hist));
+    TEST_ASSERT_EQUAL_MEMORY(ref->tiles, got->tiles, sizeof(ref->tiles));
+}
+
+// the frame as cam_task hands it over, in copies of chunk bytes
+static void run_stats(cam_stats_t *st, const uint8_t *buf, size_t len, size_t chunk, camera_frame_stats_t *out)
+{
+    cam_stats_start(st, out);
+    for (size_t done = 0; done < len;) {
+        done = done + chunk < len ? done + chunk : len;
+        cam_stats_add(st, buf, done);
+    }
+    cam_stats_finish(st);
+}
+
+static void check_frame(const uint8_t *buf, int width, int height, int bpp)
+{
+    // whole rows, a DMA buffer, shorter than a row, and odd
+    size_t chunks[] = {width * bpp * 4, 1024, width * bpp / 2 + 1, 7};
+    camera_frame_stats_t ref, got;
+    cam_stats_t st;
+    ref_stats(buf, width, height, bpp, &ref);
+    cam_stats_config(&st, width, height, bpp);
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        memset(&got, 0x5a, sizeof(got));
+        run_stats(&st, buf, width * height * bpp, chunks[c], &got);
+        assert_stats_equal(&ref, &got);
+    }
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len);
+    if (fread(buf, 1, *len, f) != *len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+/*
+ * The parking lot dataset as the camera would send it, in YUV422 and GRAYSCALE.
+ * Returns the number of frames, 0 if the dataset is not there.
+ */
+static int load_dataset(int max, uint8_t **yuv, uint8_t **gray, uint16_t *w, uint16_t *h)
+{
+    const char *dir_name = DATASET_DIR "/test/images";
+    DIR *dir = opendir(dir_name);
+    if (!dir) {
+        printf("%s not found, skipping\n", dir_name);
+        return 0;
+    }
+    int count = 0;
+    struct dirent *e;
+    while (count < max && (e = readdir(dir))) {
+        if (!strstr(e->d_name, ".jpg")) {
+            continue;
+        }
+        char path[1024];
+        size_t jpg_len = 0;
+        snprintf(path, sizeof(path), "%s/%s", dir_name, e->d_name);
+        uint8_t *jpg = load_file(path, &jpg_len);
+        uint16_t fw, fh;
+        if (!jpg || !jpg_get_size(jpg, jpg_len, &fw, &fh) || (count && (fw != *w || fh != *h))) {
+            free(jpg);
+            continue;
+        }
+        *w = fw;
+        *h = fh;
+        uint8_t *rgb = malloc(fw * fh * 3);
+        yuv[count] = malloc(fw * fh * 2);
+        gray[count] = malloc(fw * fh);
+        TEST_ASSERT_TRUE(fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, rgb));
+        TEST_ASSERT_TRUE(fmt_convert(rgb, PIXFORMAT_RGB888, yuv[count], PIXFORMAT_YUV422, fw, fh, NULL));
+        TEST_ASSERT_TRUE(fmt_convert(rgb, PIXFORMAT_RGB888, gray[count], PIXFORMAT_GRAYSCALE, fw, fh, NULL));
+        free(rgb);
+        free(jpg);
+        count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+TEST_CASE("Frame stats match the reference on the dataset images", "[cam_stats]")
+{
+    enum { MAX_FRAMES = 4 };
+    uint8_t *yuv[MAX_FRAMES], *gray[MAX_FRAMES];
+    uint16_t w = 0, h = 0;
+    int count = load_dataset(MAX_FRAMES, yuv, gray, &w, &h);
+    for (int i = 0; i < count; i++) {
+        check_frame(yuv[i], w, h, 2);
+        check_frame(gray[i], w, h, 1);
+        free(yuv[i]);
+        free(gray[i]);
+    }
+}
+
+TEST_CASE("Frame stats match the reference on frames the grid does not divide", "[cam_stats]")
+{
+    static const int sizes[][2] = {{100, 37}, {13, 5}, {2, 2}, {320, 240}};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int w = sizes[s][0], h = sizes[s][1];
+        uint8_t *buf = malloc(w * h * 2);
+        uint32_t r = 12345 + s;
+        for (int i = 0; i < w * h * 2; i++) {
+            r = r * 1103515245 + 12345;
+            buf[i] = (r >> 16) & 0xff;
+        }
+        check_frame(buf, w, h, 2);
+        check_frame(buf, w, h, 1);
+        free(buf);
+    }
+
+    // flat frames: no gradient, every tile on the value, one bin
+    uint8_t flat[64 * 48];
+    camera_frame_stats_t got;
+    cam_stats_t st;
+    memset(flat, 200, sizeof(flat));
+    cam_stats_config(&st, 64, 48, 1);
+    run_stats(&st, flat, sizeof(flat), 1024, &got);
+    TEST_ASSERT_EQUAL(200, got.mean);
+    TEST_ASSERT_EQUAL(0, got.sharpness);
+    TEST_ASSERT_EQUAL(64 * 48, got.hist[200 / 4]);
+    for (int i = 0; i < CAMERA_STATS_GRID * CAMERA_STATS_GRID; i++) {
+        TEST_ASSERT_EQUAL(200, got.tiles[i]);
+    }
+
+    // a frame without stats is left alone
+    cam_stats_start(&st, NULL);
+    cam_stats_add(&st, flat, sizeof(flat));
+    cam_stats_finish(&st);
+    TEST_ASSERT_EQUAL(0, st.y);
+}
+
+// cam_take leaves the geometry to esp_camera_fb_get(), the check knows it
+typedef struct {
+    int width;
+    int height;
+    int bpp;
+    int frames;
+    int wrong;
+} stats_check_t;
+
+static void check_fb_stats(camera_fb_t *fb, void *arg)
+{
+    stats_check_t *check = arg;
+    camera_frame_stats_t ref;
+    check->frames++;
+    if (!fb->stats) {
+        check->wrong++;
+        return;
+    }
+    ref_stats(fb->buf, check->width, check->height, check->bpp, &ref);
+    if (ref.count != fb->stats->count || ref.mean != fb->stats->mean || ref.sharpness != fb->stats->sharpness
+        || memcmp(ref.hist, fb->stats->hist, sizeof(ref.hist)) || memcmp(ref.tiles, fb->stats->tiles, sizeof(ref.tiles))) {
+        check->wrong++;
+    }
+}
+
+TEST_CASE("Frames from cam_task carry their stats", "[cam_stats]")
+{
+    static const pixformat_t formats[] = {PIXFORMAT_YUV422, PIXFORMAT_GRAYSCALE};
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        stats_check_t check = {320, 240, formats[f] == PIXFORMAT_YUV422 ? 2 : 1};
+        cam_sim_config_t config = {
+            .format = formats[f], .frame_size = FRAMESIZE_QVGA,
+            .fb_count = 2, .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+            .fps = 50, .frames = 20, .lockstep = true,
+            .frame_stats = true, .frame_cb = check_fb_stats, .cb_arg = &check,
+        };
+        cam_sim_stats_t stats;
+        TEST_ESP_OK(cam_sim_run(&config, &stats));
+        cam_sim_print(f ? "gray stats" : "yuv stats", &stats);
+        TEST_ASSERT_EQUAL(0, stats.corrupt);
+        TEST_ASSERT_EQUAL(stats.delivered, check.frames);
+        TEST_ASSERT_TRUE(check.frames > 0);
+        TEST_ASSERT_EQUAL(0, check.wrong);
+    }
+}
+
+TEST_CASE("Frame stats are refused where cam_task does not copy the frame", "[cam_stats]")
+{
+    cam_sim_config_t config = {
+        .format = PIXFORMAT_JPEG, .frame_size = FRAMESIZE_QVGA,
+        .fb_count = 2, .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+        .fps = 50, .jpeg_size = 8000, .frames = 2, .lockstep = true,
+        .frame_stats = true,
+    };
+    cam_sim_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_FAIL, cam_sim_run(&config, &stats));
+    config.format = PIXFORMAT_YUV422;
+    config.psram_mode = true;
+    TEST_ASSERT_EQUAL(ESP_FAIL, cam_sim_run(&config, &stats));
+    config.psram_mode = false;
+    config.fb_count = 0;
+    TEST_ASSERT_EQUAL(ESP_FAIL, cam_sim_run(&config, &stats));
+}
+
+/*
+ * The stats cost against what the application would do without them: decode
+ * the JPEG of the frame again, or run the reference over the raw frame.
+ */
+TEST_CASE("Frame stats benchmark", "[cam_stats][bench]")
+{
+    enum { MAX_FRAMES = 4, RUNS = 20 };
+    uint8_t *yuv[MAX_FRAMES], *gray[MAX_FRAMES];
+    uint16_t w = 0, h = 0;
+    int count = load_dataset(MAX_FRAMES, yuv, gray, &w, &h);
+    if (!count) {
+        return;
+    }
+    camera_frame_stats_t out;
+    cam_stats_t st;
+    uint8_t *copy_buf = malloc(w * h * 2);
+    printf("%ux%u, %d dataset frames, us per frame\n", w, h, count);
+    for (int g = 0; g < 2; g++) {
+        uint8_t **frames = g ? gray : yuv;
+        int bpp = g ? 1 : 2;
+        cam_stats_config(&st, w, h, bpp);
+        int64_t t = esp_timer_get_time();
+        for (int r = 0; r < RUNS; r++) {
+            // DMA buffers of 16 rows
+            run_stats(&st, frames[r % count], w * h * bpp, w * bpp * 16, &out);
+        }
+        double fused = (double)(esp_timer_get_time() - t) / RUNS;
+        t = esp_timer_get_time();
+        for (int r = 0; r < RUNS; r++) {
+            memcpy(copy_buf, frames[r % count], w * h * bpp);
+        }
+        double copy = (double)(esp_timer_get_time() - t) / RUNS;
+        printf("  %-9s stats %8.1f   frame copy %8.1f\n", g ? "GRAYSCALE" : "YUV422", fused, copy);
+    }
+
+    size_t jpg_len = 0;
+    uint8_t *jpg = NULL, *rgb = malloc(w * h * 3);
+    TEST_ASSERT_TRUE(fmt2jpg(yuv[0], w * h * 2, w, h, PIXFORMAT_YUV422, 80, &jpg, &jpg_len));
+    int64_t t = esp_timer_get_time();
+    for (int r = 0; r < RUNS; r++) {
+        fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, rgb);
+    }
+    printf("  %-9s decode again %8.1f\n", "JPEG q80", (double)(esp_timer_get_time() - t) / RUNS);
+    free(jpg);
+    free(rgb);
+    free(copy_buf);
+    for (int i = 0; i < count; i++) {
+        free(yuv[i]);
+        free(gray[i]);
+    }
+}
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "camera_ae.h"
+
+/*
+ * An OV2640 as far as exposure goes: a frame shows the scene in the light of
+ * the exposure and gain set before the frame before it, gamma encoded and
+ * clipped at white. The scene is a smooth pattern around 1.0, the light is the
+ * exposure level that puts the scene's middle at white.
+ */
+enum { SIM_AEC_MAX = 1200, SIM_AGC_MAX = 30 };
+
+static struct {
+    sensor_t sensor;
+    float light;                    // aec_value * gain that puts a scene of 1.0 at white
+    pixformat_t format;
+    uint16_t width, height;
+    bool luma_plane;
+    int aec_value, agc_gain;        // settings for the frame after the next
+    int next_aec, next_agc;         // settings of the next frame
+    uint32_t frames;                // frames handed out
+    uint32_t returned;              // frames given back
+    camera_fb_t fb;
+    uint8_t *gray;
+} sim;
+
+static int sim_set_aec_value(sensor_t *s, int value)
+{
+    sim.aec_value = value < 0 ? 0 : value > SIM_AEC_MAX ? SIM_AEC_MAX : value;
+    s->status.aec_value = sim.aec_value;
+    return 0;
+}
+
+static int sim_set_agc_gain(sensor_t *s, int gain)
+{
+    sim.agc_gain = gain < 0 ? 0 : gain > SIM_AGC_MAX ? SIM_AGC_MAX : gain;
+    s->status.agc_gain = sim.agc_gain;
+    return 0;
+}
+
+static int sim_set_ctrl(sensor_t *s, int enable)
+{
+    return 0;
+}
+
+// a sensor that stopped answering on the bus
+static int sim_set_fail(sensor_t *s, int value)
+{
+    return -1;
+}
+
+static void sim_start(pixformat_t format, uint16_t width, uint16_t height, float light)
+{
+    free(sim.gray);
+    free(sim.fb.buf);
+    free(sim.fb.luma);
+    memset(&sim, 0, sizeof(sim));
+    sim.sensor.id.PID = OV2640_PID;
+    sim.sensor.set_aec_value = sim_set_aec_value;
+    sim.sensor.set_agc_gain = sim_set_agc_gain;
+    sim.sensor.set_exposure_ctrl = sim_set_ctrl;
+    sim.sensor.set_gain_ctrl = sim_set_ctrl;
+    // left by the sensor's own AEC in the light it was started in
+    sim.sensor.status.aec_value = sim.aec_value = sim.next_aec = 300;
+    sim.format = format;
+    sim.width = width;
+    sim.height = height;
+    sim.light = light;
+    sim.gray = malloc(width * height);
+}
+
+static void sim_render(void)
+{
+    float exposure = sim.next_aec * (sim.next_agc + 1.0f) / sim.light;
+    for (int y = 0; y < sim.height; y++) {
+        for (int x = 0; x < sim.width; x++) {
+            float scene = 0.5f + 0.4f * sinf(x * 0.05f) * cosf(y * 0.07f) + 0.1f * ((x / 16 + y / 16) & 1);
+            float linear = fminf(scene * exposure, 1.0f);
+            sim.gray[y * sim.width + x] = lroundf(255 * powf(linear, 1 / 2.2f));
+        }
+    }
+    free(sim.fb.buf);
+    free(sim.fb.luma);
+    memset(&sim.fb, 0, sizeof(sim.fb));
+    size_t n = sim.width * sim.height;
+    sim.fb.width = sim.width;
+    sim.fb.height = sim.height;
+    sim.fb.format = sim.format;
+    if (sim.format == PIXFORMAT_GRAYSCALE) {
+        sim.fb.len = n;
+        sim.fb.buf = malloc(n);
+        memcpy(sim.fb.buf, sim.gray, n);
+    } else {
+        // YUV422 with neutral chroma, also what the sensor compresses, or grey RGB565
+        sim.fb.len = n * 2;
+        sim.fb.buf = malloc(n * 2);
+        for (size_t i = 0; i < n; i++) {
+            uint8_t v = sim.gray[i];
+            if (sim.format != PIXFORMAT_RGB565) {
+                sim.fb.buf[i * 2] = v;
+                sim.fb.buf[i * 2 + 1] = 128;
+            } else {
+                uint16_t p = (v >> 3) << 11 | (v >> 2) << 5 | v >> 3;
+                sim.fb.buf[i * 2] = p >> 8;
+                sim.fb.buf[i * 2 + 1] = p & 0xff;
+            }
+        }
+        if (sim.format == PIXFORMAT_JPEG) {
+            uint8_t *yuv = sim.fb.buf;
+            TEST_ASSERT_TRUE(fmt2jpg(yuv, n * 2, sim.width, sim.height, PIXFORMAT_YUV422, 80, &sim.fb.buf, &sim.fb.len));
+            free(yuv);
+        }
+    }
+    if (sim.luma_plane) {
+        // what the DMA filter makes with luma_scale 4
+        sim.fb.luma_width = sim.width / 4;
+        sim.fb.luma_height = sim.height / 4;
+        sim.fb.luma = malloc(sim.fb.luma_width * sim.fb.luma_height);
+        for (size_t y = 0; y < sim.fb.luma_height; y++) {
+            for (size_t x = 0; x < sim.fb.luma_width; x++) {
+                int sum = 0;
+                for (int i = 0; i < 16; i++) {
+                    sum += sim.gray[(y * 4 + i / 4) * sim.width + x * 4 + i % 4];
+                }
+                sim.fb.luma[y * sim.fb.luma_width + x] = sum / 16;
+            }
+        }
+    }
+}
+
+camera_fb_t *esp_camera_fb_get(void)
+{
+    sim_render();
+    sim.next_aec = sim.aec_value;
+    sim.next_agc = sim.agc_gain;
+    sim.frames++;
+    return &sim.fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    sim.returned++;
+}
+
+sensor_t *esp_camera_sensor_get(void)
+{
+    return &sim.sensor;
+}
+
+// mean luma of the full frame the sensor made, not the sampled one
+static int frame_mean(void)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < (size_t)sim.width * sim.height; i++) {
+        sum += sim.gray[i];
+    }
+    return sum / (sim.width * sim.height);
+}
+
+TEST_CASE("Luma histogram of every frame format", "[ae]")
+{
+    static const pixformat_t formats[] = {PIXFORMAT_GRAYSCALE, PIXFORMAT_YUV422, PIXFORMAT_RGB565, PIXFORMAT_JPEG};
+    camera_luma_hist_t hist;
+    for (int plane = 0; plane < 2; plane++) {
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+            sim_start(formats[f], 320, 240, 1200);
+            sim.luma_plane = plane;
+            esp_camera_fb_get();
+            TEST_ESP_OK(camera_luma_histogram(&sim.fb, &hist));
+            uint32_t count = 0;
+            for (int i = 0; i < CAMERA_AE_BINS; i++) {
+                count += hist.bins[i];
+            }
+            TEST_ASSERT_EQUAL(hist.count, count);
+            TEST_ASSERT_TRUE(hist.count >= (plane ? 80 * 60 : 1000));
+            TEST_ASSERT_INT_WITHIN(4, frame_mean(), hist.mean);
+        }
+    }
+    sim.luma_plane = false;
+    esp_camera_fb_get();
+    sim.fb.format = PIXFORMAT_RAW;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, camera_luma_histogram(&sim.fb, &hist));
+    sim.fb.format = PIXFORMAT_JPEG;
+    sim.fb.len = 16;
+    TEST_ASSERT_EQUAL(ESP_FAIL, camera_luma_histogram(&sim.fb, &hist));
+}
+
+// light levels from a sunny rack to a lamp at night, in exposure lines at 1x
+static const float lights[] = {12, 60, 300, 1500, 6000, 20000};
+
+TEST_CASE("Auto exposure settles on the target within a few frames", "[ae]")
+{
+    static const pixformat_t formats[] = {PIXFORMAT_YUV422, PIXFORMAT_JPEG};
+    camera_ae_t ae;
+    camera_ae_config_t config = CAMERA_AE_CONFIG_DEFAULT();
+    camera_fb_t *fb;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        for (size_t l = 0; l < sizeof(lights) / sizeof(lights[0]); l++) {
+            sim_start(formats[f], 320, 240, lights[l]);
+            TEST_ESP_OK(camera_ae_init(&ae, &sim.sensor, &config));
+            TEST_ESP_OK(camera_ae_capture(&ae, 12, &fb));
+            TEST_ASSERT_TRUE(fb == &sim.fb);
+            TEST_ASSERT_EQUAL(CAMERA_AE_CONVERGED, ae.state);
+            TEST_ASSERT_INT_WITHIN(config.tolerance + 4, config.target, frame_mean());
+
+            // the next capture starts exposed
+            uint32_t frames = sim.frames;
+            TEST_ESP_OK(camera_ae_capture(&ae, 12, &fb));
+            TEST_ASSERT_EQUAL(frames + 1, sim.frames);
+        }
+    }
+}
+
+TEST_CASE("Auto exposure follows the light and stops at its limits", "[ae]")
+{
+    camera_ae_t ae;
+    camera_fb_t *fb;
+    sim_start(PIXFORMAT_YUV422, 320, 240, 300);
+    TEST_ESP_OK(camera_ae_init(&ae, &sim.sensor, NULL));
+    TEST_ESP_OK(camera_ae_capture(&ae, 12, &fb));
+
+    // dusk: a hundred times darker, the gain takes over from the exposure
+    sim.light = 30000;
+    TEST_ESP_OK(camera_ae_capture(&ae, 12, &fb));
+    TEST_ASSERT_EQUAL(CAMERA_AE_CONVERGED, ae.state);
+    TEST_ASSERT_TRUE(sim.agc_gain > 0);
+    // and no more gain than it takes
+    TEST_ASSERT_TRUE(sim.aec_value * (sim.agc_gain + 1) > SIM_AEC_MAX * sim.agc_gain);
+
+    // night: too dark for everything, the frame comes at full exposure and gain
+    sim.light = 1e6;
+    TEST_ESP_OK(camera_ae_capture(&ae, 16, &fb));
+    TEST_ASSERT_EQUAL(CAMERA_AE_LIMITED, ae.state);
+    TEST_ASSERT_EQUAL(SIM_AEC_MAX, sim.aec_value);
+    TEST_ASSERT_EQUAL(SIM_AGC_MAX, sim.agc_gain);
+
+    // glare: too bright at the shortest exposure
+    sim.light = 0.5f;
+    TEST_ESP_OK(camera_ae_capture(&ae, 16, &fb));
+    TEST_ASSERT_EQUAL(CAMERA_AE_LIMITED, ae.state);
+    TEST_ASSERT_EQUAL(1, sim.aec_value);
+    TEST_ASSERT_EQUAL(0, sim.agc_gain);
+
+    // too few frames to get there: the last one, still searching
+    sim.light = 300;
+    uint32_t frames = sim.frames, returned = sim.returned;
+    TEST_ESP_OK(camera_ae_capture(&ae, 2, &fb));
+    TEST_ASSERT_EQUAL(CAMERA_AE_SEARCHING, ae.state);
+    TEST_ASSERT_TRUE(fb == &sim.fb);
+    // only the frame handed out is left for the caller to give back
+    TEST_ASSERT_EQUAL(frames + 2, sim.frames);
+    TEST_ASSERT_EQUAL(returned + 1, sim.returned);
+
+    // on an error every frame taken is back with the driver
+    sim.light = 0.5f;
+    sim.sensor.set_aec_value = sim_set_fail;
+    frames = sim.frames;
+    returned = sim.returned;
+    TEST_ASSERT_TRUE(camera_ae_capture(&ae, 2, &fb) != ESP_OK);
+    TEST_ASSERT_NULL(fb);
+    TEST_ASSERT_TRUE(sim.frames > frames);
+    TEST_ASSERT_EQUAL(sim.frames - frames, sim.returned - returned);
+    sim.sensor.set_aec_value = sim_set_aec_value;
+
+    camera_ae_config_t config = CAMERA_AE_CONFIG_DEFAULT();
+    config.damping = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_ae_init(&ae, &sim.sensor, &config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_ae_capture(&ae, 0, &fb));
+    TEST_ASSERT_NULL(fb);
+    sim.sensor.set_agc_gain = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, camera_ae_init(&ae, &sim.sensor, NULL));
+}
+
+/*
+ * Frames until the exposure is stable from the settings the sensor's own AEC
+ * left, for each light level, and the time a histogram takes per frame format
+ * at VGA, the application's frame size.
+ */
+TEST_CASE("Auto exposure benchmark", "[ae][bench]")
+{
+    static const pixformat_t formats[] = {PIXFORMAT_GRAYSCALE, PIXFORMAT_YUV422, PIXFORMAT_RGB565, PIXFORMAT_JPEG};
+    static const char *format_names[] = {"GRAYSCALE", "YUV422", "RGB565", "JPEG"};
+    camera_ae_t ae;
+    camera_fb_t *fb;
+    printf("%-10s %8s %6s %6s %8s %6s\n", "light", "frames", "steps", "mean", "aec", "agc");
+    for (size_t l = 0; l < sizeof(lights) / sizeof(lights[0]); l++) {
+        sim_start(PIXFORMAT_YUV422, 320, 240, lights[l]);
+        TEST_ESP_OK(camera_ae_init(&ae, &sim.sensor, NULL));
+        TEST_ESP_OK(camera_ae_capture(&ae, 20, &fb));
+        printf("%-10.0f %8u %6u %6d %8d %6d\n", lights[l], (unsigned)sim.frames, (unsigned)ae.steps, frame_mean(),
+               sim.aec_value, sim.agc_gain);
+    }
+
+    printf("\n%-10s %14s\n", "VGA", "histogram us");
+    camera_luma_hist_t hist;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        sim_start(formats[f], 640, 480, 300);
+        esp_camera_fb_get();
+        enum { RUNS = 20 };
+        int64_t t = esp_timer_get_time();
+        for (int i = 0; i < RUNS; i++) {
+            TEST_ESP_OK(camera_luma_histogram(&sim.fb, &hist));
+        }
+        printf("%-10s %14.1f\n", format_names[f], (esp_timer_get_time() - t) / (double)RUNS);
+    }
+}
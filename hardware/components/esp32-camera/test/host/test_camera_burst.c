@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "img_resize.h"
+#include "camera_burst.h"
+
+/*
+ * The driver side of a burst: esp_camera_fb_get() hands out prepared frames in
+ * turn and counts the ones the application holds.
+ */
+enum { SIM_FRAMES_MAX = 8 };
+
+static struct {
+    camera_fb_t *frames[SIM_FRAMES_MAX];
+    int count;                      // frames the driver has
+    int next;                       // next one to hand out
+    int held;                       // handed out and not returned
+    int held_max;
+    int returned;
+} sim;
+
+static void sim_start(camera_fb_t **frames, int count)
+{
+    memset(&sim, 0, sizeof(sim));
+    memcpy(sim.frames, frames, count * sizeof(frames[0]));
+    sim.count = count;
+}
+
+camera_fb_t *esp_camera_fb_get(void)
+{
+    if (sim.next == sim.count) {
+        return NULL;
+    }
+    sim.held++;
+    sim.held_max = sim.held > sim.held_max ? sim.held : sim.held_max;
+    return sim.frames[sim.next++];
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    sim.held--;
+    sim.returned++;
+}
+
+/*
+ * Frames of one scene, as if the camera or the scene moved by blur pixels while
+ * the frame was exposed, with a bit of sensor noise that differs every frame.
+ */
+static void motion_blur(const uint8_t *rgb, uint8_t *out, int w, int h, int blur, bool vertical, uint32_t seed)
+{
+    int step = vertical ? w * 3 : 3;
+    int len = vertical ? h : w;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int pos = vertical ? y : x;
+            for (int c = 0; c < 3; c++) {
+                int sum = 0, n = 0;
+                for (int k = -(blur / 2); k < blur - blur / 2; k++) {
+                    if (pos + k >= 0 && pos + k < len) {
+                        sum += rgb[(y * w + x) * 3 + c + k * step];
+                        n++;
+                    }
+                }
+                seed = seed * 1103515245 + 12345;
+                int v = (sum + n / 2) / n + (int)((seed >> 16) % 7) - 3;
+                out[(y * w + x) * 3 + c] = v < 0 ? 0 : v > 255 ? 255 : v;
+            }
+        }
+    }
+}
+
+static camera_fb_t *make_frame(const uint8_t *rgb, int w, int h, pixformat_t format, int quality)
+{
+    camera_fb_t *fb = calloc(1, sizeof(camera_fb_t));
+    fb->width = w;
+    fb->height = h;
+    fb->format = format;
+    if (format == PIXFORMAT_JPEG) {
+        uint8_t *yuv = malloc(w * h * 2);
+        TEST_ASSERT_TRUE(fmt_convert(rgb, PIXFORMAT_RGB888, yuv, PIXFORMAT_YUV422, w, h, NULL));
+        TEST_ASSERT_TRUE(fmt2jpg(yuv, w * h * 2, w, h, PIXFORMAT_YUV422, quality, &fb->buf, &fb->len));
+        free(yuv);
+    } else {
+        fb->len = w * h * fmt_bytes_per_pixel(format);
+        fb->buf = malloc(fb->len);
+        TEST_ASSERT_TRUE(fmt_convert(rgb, PIXFORMAT_RGB888, fb->buf, format, w, h, NULL));
+    }
+    return fb;
+}
+
+static void free_frame(camera_fb_t *fb)
+{
+    free(fb->buf);
+    free(fb);
+}
+
+// mean squared difference to the right and lower neighbour over every pixel
+static uint32_t ref_sharpness(const uint8_t *gray, int w, int h)
+{
+    uint64_t sum = 0;
+    for (int y = 0; y + 1 < h; y++) {
+        for (int x = 0; x + 1 < w; x++) {
+            int v = gray[y * w + x];
+            int dx = gray[y * w + x + 1] - v;
+            int dy = gray[(y + 1) * w + x] - v;
+            sum += dx * dx + dy * dy;
+        }
+    }
+    return sum / ((w - 1) * (h - 1));
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len);
+    if (fread(buf, 1, *len, f) != *len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+// the parking lot dataset in RGB888, 0 frames if it is not there
+static int load_dataset(int max, uint8_t **rgb, uint16_t *w, uint16_t *h)
+{
+    const char *dir_name = DATASET_DIR "/test/images";
+    DIR *dir = opendir(dir_name);
+    if (!dir) {
+        printf("%s not found, skipping\n", dir_name);
+        return 0;
+    }
+    int count = 0;
+    struct dirent *e;
+    while (count < max && (e = readdir(dir))) {
+        if (!strstr(e->d_name, ".jpg")) {
+            continue;
+        }
+        char path[1024];
+        size_t jpg_len = 0;
+        snprintf(path, sizeof(path), "%s/%s", dir_name, e->d_name);
+        uint8_t *jpg = load_file(path, &jpg_len);
+        uint16_t fw, fh;
+        if (!jpg || !jpg_get_size(jpg, jpg_len, &fw, &fh) || (count && (fw != *w || fh != *h))) {
+            free(jpg);
+            continue;
+        }
+        *w = fw;
+        *h = fh;
+        rgb[count] = malloc(fw * fh * 3);
+        TEST_ASSERT_TRUE(fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, rgb[count]));
+        free(jpg);
+        count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+// a test scene without the dataset: blocks and fine stripes, with edges that do
+// not line up with the 8x8 JPEG blocks or the sampling grid, as in a real scene
+static uint8_t *test_scene(int w, int h)
+{
+    uint8_t *rgb = malloc(w * h * 3);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t v = ((x / 7 + y / 7) & 1) ? 200 : 40;
+            v += (x % 3 == 0) ? 30 : 0;
+            rgb[(y * w + x) * 3] = v;
+            rgb[(y * w + x) * 3 + 1] = v;
+            rgb[(y * w + x) * 3 + 2] = 255 - v;
+        }
+    }
+    return rgb;
+}
+
+static const int blurs[] = {1, 2, 3, 5, 9};
+enum { BURST = sizeof(blurs) / sizeof(blurs[0]) };
+
+/*
+ * One burst per scene: the sharp frame among frames blurred by 2 to 9 pixels,
+ * across on even scenes and down on odd ones, in a different place every time.
+ * Returns the bursts in which the sharp frame was picked.
+ */
+static int run_bursts(uint8_t **rgb, int scenes, int w, int h, pixformat_t format, int quality, int *ordered)
+{
+    uint8_t *blurred = malloc(w * h * 3);
+    int picked = 0;
+    *ordered = 0;
+    for (int s = 0; s < scenes; s++) {
+        camera_fb_t *frames[BURST];
+        uint32_t scores[BURST];
+        int sharp = s % BURST;
+        for (int i = 0; i < BURST; i++) {
+            int blur = blurs[(i - sharp + BURST) % BURST];
+            motion_blur(rgb[s], blurred, w, h, blur, s & 1, s * 77 + i);
+            frames[i] = make_frame(blurred, w, h, format, quality);
+            TEST_ESP_OK(camera_frame_sharpness(frames[i], &scores[i]));
+        }
+        // the scores fall as the blur grows
+        bool in_order = true;
+        for (int b = 1; b < BURST; b++) {
+            in_order &= scores[(sharp + b) % BURST] < scores[(sharp + b - 1) % BURST];
+        }
+        *ordered += in_order;
+
+        camera_fb_t *fb;
+        uint32_t score;
+        sim_start(frames, BURST);
+        TEST_ESP_OK(camera_burst_capture(BURST, &fb, &score));
+        TEST_ASSERT_TRUE(sim.held_max <= 2);
+        TEST_ASSERT_EQUAL(BURST - 1, sim.returned);
+        picked += fb == frames[sharp];
+        for (int i = 0; i < BURST; i++) {
+            free_frame(frames[i]);
+        }
+    }
+    free(blurred);
+    return picked;
+}
+
+TEST_CASE("Burst picks the sharp frame of the dataset images with synthetic blur", "[burst]")
+{
+    enum { MAX_SCENES = 8 };
+    uint8_t *rgb[MAX_SCENES];
+    uint16_t w = 0, h = 0;
+    int scenes = load_dataset(MAX_SCENES, rgb, &w, &h);
+    if (!scenes) {
+        rgb[0] = test_scene(320, 240);
+        w = 320;
+        h = 240;
+        scenes = 1;
+    }
+    static const struct {
+        const char *name;
+        pixformat_t format;
+        int quality;
+    } formats[] = {
+        {"YUV422", PIXFORMAT_YUV422, 0},
+        {"GRAYSCALE", PIXFORMAT_GRAYSCALE, 0},
+        {"RGB565", PIXFORMAT_RGB565, 0},
+        {"JPEG q80", PIXFORMAT_JPEG, 80},
+        {"JPEG q50", PIXFORMAT_JPEG, 50},
+    };
+    printf("%ux%u, %d scenes, bursts of %d with blur 1 to 9 pixels\n", w, h, scenes, BURST);
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        int ordered;
+        int picked = run_bursts(rgb, scenes, w, h, formats[f].format, formats[f].quality, &ordered);
+        printf("  %-10s sharp frame picked %d/%d, scores in blur order %d/%d\n", formats[f].name, picked, scenes, ordered, scenes);
+        TEST_ASSERT_EQUAL(scenes, picked);
+        TEST_ASSERT_EQUAL(scenes, ordered);
+    }
+    for (int i = 0; i < scenes; i++) {
+        free(rgb[i]);
+    }
+}
+
+TEST_CASE("Sharpness scores of every format are in the same units", "[burst]")
+{
+    const int w = 320, h = 240;
+    uint8_t *rgb = test_scene(w, h);
+    uint8_t *blurred = malloc(w * h * 3);
+    uint8_t *gray = malloc(w * h);
+    for (int blur = 1; blur <= 5; blur += 2) {
+        motion_blur(rgb, blurred, w, h, blur, false, blur);
+        TEST_ASSERT_TRUE(fmt_convert(blurred, PIXFORMAT_RGB888, gray, PIXFORMAT_GRAYSCALE, w, h, NULL));
+        uint32_t ref = ref_sharpness(gray, w, h);
+        static const pixformat_t formats[] = {PIXFORMAT_GRAYSCALE, PIXFORMAT_YUV422, PIXFORMAT_JPEG};
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+            camera_fb_t *fb = make_frame(blurred, w, h, formats[f], 90);
+            uint32_t score;
+            TEST_ESP_OK(camera_frame_sharpness(fb, &score));
+            // sampled, or estimated from the coefficients inside the blocks; YUV422 luma
+            // is in the 16..235 range, a little less than full range grayscale
+            TEST_ASSERT_INT_WITHIN(ref * 3 / 10, ref, score);
+            free_frame(fb);
+        }
+    }
+
+    // frame stats are used as they are
+    camera_frame_stats_t stats = { .sharpness = 1234 };
+    camera_fb_t fb = { .buf = gray, .len = w * h, .width = w, .height = h, .format = PIXFORMAT_GRAYSCALE, .stats = &stats };
+    uint32_t score;
+    TEST_ESP_OK(camera_frame_sharpness(&fb, &score));
+    TEST_ASSERT_EQUAL(1234, score);
+
+    // a grayscale JPEG has one component
+    uint8_t *jpg = NULL;
+    size_t jpg_len = 0;
+    TEST_ASSERT_TRUE(fmt2jpg(gray, w * h, w, h, PIXFORMAT_GRAYSCALE, 90, &jpg, &jpg_len));
+    camera_fb_t gray_jpg = { .buf = jpg, .len = jpg_len, .width = w, .height = h, .format = PIXFORMAT_JPEG };
+    TEST_ESP_OK(camera_frame_sharpness(&gray_jpg, &score));
+    uint32_t ref = ref_sharpness(gray, w, h);
+    TEST_ASSERT_INT_WITHIN(ref * 3 / 10, ref, score);
+
+    // cut short, and not a JPEG
+    gray_jpg.len /= 2;
+    TEST_ASSERT_EQUAL(ESP_FAIL, camera_frame_sharpness(&gray_jpg, &score));
+    gray_jpg.buf = gray;
+    TEST_ASSERT_EQUAL(ESP_FAIL, camera_frame_sharpness(&gray_jpg, &score));
+    camera_fb_t raw = { .buf = gray, .len = w * h, .width = w, .height = h, .format = PIXFORMAT_RAW };
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, camera_frame_sharpness(&raw, &score));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_frame_sharpness(NULL, &score));
+    free(jpg);
+    free(gray);
+    free(blurred);
+    free(rgb);
+}
+
+// a JPEG cut down to the segments given, in a buffer of exactly its size
+static camera_fb_t *segments_frame(const uint8_t *const *segs, const size_t *lens, int count)
+{
+    static const uint8_t soi[] = {0xFF, 0xD8};
+    size_t len = sizeof(soi);
+    for (int i = 0; i < count; i++) {
+        len += lens[i];
+    }
+    camera_fb_t *fb = calloc(1, sizeof(camera_fb_t));
+    fb->buf = malloc(len);
+    memcpy(fb->buf, soi, sizeof(soi));
+    fb->len = sizeof(soi);
+    for (int i = 0; i < count; i++) {
+        memcpy(fb->buf + fb->len, segs[i], lens[i]);
+        fb->len += lens[i];
+    }
+    fb->width = fb->height = 8;
+    fb->format = PIXFORMAT_JPEG;
+    return fb;
+}
+
+TEST_CASE("Sharpness of a corrupt JPEG fails without reading or writing past it", "[burst]")
+{
+    static const uint8_t sof[] = {0xFF, 0xC0, 0x00, 0x0B, 8, 0x00, 0x08, 0x00, 0x08, 1, 1, 0x11, 0};
+    uint32_t score;
+
+    // more codes of a length than there are codes of that length
+    static const uint8_t counts[] = {200, 3};
+    for (size_t c = 0; c < sizeof(counts); c++) {
+        uint8_t dht[4 + 17 + 200] = {0xFF, 0xC4, 0x00, 2 + 17 + counts[c], 0x11, counts[c]};
+        for (int k = 0; k < counts[c]; k++) {
+            dht[21 + k] = k;
+        }
+        const uint8_t *segs[] = {dht, sof};
+        const size_t lens[] = {4 + 17 + counts[c], sizeof(sof)};
+        camera_fb_t *fb = segments_frame(segs, lens, 2);
+        TEST_ASSERT_EQUAL(ESP_FAIL, camera_frame_sharpness(fb, &score));
+        free_frame(fb);
+    }
+
+    // a scan header without its component count, at the very end of the data
+    static const uint8_t sos[] = {0xFF, 0xDA, 0x00, 0x02};
+    const uint8_t *segs[] = {sof, sos};
+    const size_t lens[] = {sizeof(sof), sizeof(sos)};
+    camera_fb_t *fb = segments_frame(segs, lens, 2);
+    TEST_ASSERT_EQUAL(ESP_FAIL, camera_frame_sharpness(fb, &score));
+    free_frame(fb);
+}
+
+TEST_CASE("Burst returns every frame but the sharpest at once", "[burst]")
+{
+    const int w = 64, h = 48;
+    uint8_t *rgb = test_scene(w, h);
+    uint8_t *blurred = malloc(w * h * 3);
+    camera_fb_t *frames[4];
+    for (int i = 0; i < 4; i++) {
+        motion_blur(rgb, blurred, w, h, i == 2 ? 1 : 4, false, i);
+        frames[i] = make_frame(blurred, w, h, PIXFORMAT_GRAYSCALE, 0);
+    }
+    camera_fb_t *fb;
+    uint32_t score, expect;
+    TEST_ESP_OK(camera_frame_sharpness(frames[2], &expect));
+
+    sim_start(frames, 4);
+    TEST_ESP_OK(camera_burst_capture(4, &fb, &score));
+    TEST_ASSERT_TRUE(fb == frames[2]);
+    TEST_ASSERT_EQUAL(expect, score);
+    TEST_ASSERT_EQUAL(1, sim.held);
+    TEST_ASSERT_EQUAL(2, sim.held_max);
+
+    // the driver runs out: the best of what came
+    sim_start(frames, 2);
+    TEST_ESP_OK(camera_burst_capture(4, &fb, NULL));
+    TEST_ASSERT_TRUE(fb == frames[0] || fb == frames[1]);
+    TEST_ASSERT_EQUAL(1, sim.held);
+    sim_start(frames, 0);
+    TEST_ASSERT_EQUAL(ESP_FAIL, camera_burst_capture(4, &fb, NULL));
+    TEST_ASSERT_NULL(fb);
+
+    // frames that cannot be scored go back and are left out
+    frames[1]->format = PIXFORMAT_RAW;
+    frames[2]->format = PIXFORMAT_RAW;
+    sim_start(frames, 4);
+    TEST_ESP_OK(camera_burst_capture(4, &fb, NULL));
+    TEST_ASSERT_TRUE(fb == frames[0] || fb == frames[3]);
+    TEST_ASSERT_EQUAL(1, sim.held);
+    sim_start(&frames[1], 2);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, camera_burst_capture(2, &fb, NULL));
+    TEST_ASSERT_EQUAL(0, sim.held);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_burst_capture(0, &fb, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_burst_capture(4, NULL, NULL));
+    for (int i = 0; i < 4; i++) {
+        free_frame(frames[i]);
+    }
+    free(blurred);
+    free(rgb);
+}
+
+/*
+ * Scoring cost per frame on the dataset, against decoding the JPEG again and
+ * running the reference over every pixel.
+ */
+TEST_CASE("Sharpness scoring benchmark", "[burst][bench]")
+{
+    enum { RUNS = 20 };
+    uint8_t *rgb[1];
+    uint16_t w = 0, h = 0;
+    if (!load_dataset(1, rgb, &w, &h)) {
+        rgb[0] = test_scene(640, 480);
+        w = 640;
+        h = 480;
+    }
+    static const struct {
+        const char *name;
+        pixformat_t format;
+    } formats[] = {
+        {"YUV422", PIXFORMAT_YUV422},
+        {"GRAYSCALE", PIXFORMAT_GRAYSCALE},
+        {"RGB565", PIXFORMAT_RGB565},
+        {"JPEG q80", PIXFORMAT_JPEG},
+    };
+    uint8_t *gray = malloc(w * h);
+    uint8_t *out = malloc(w * h * 3);
+    TEST_ASSERT_TRUE(fmt_convert(rgb[0], PIXFORMAT_RGB888, gray, PIXFORMAT_GRAYSCALE, w, h, NULL));
+    printf("%ux%u, us per frame\n", w, h);
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        camera_fb_t *fb = make_frame(rgb[0], w, h, formats[f].format, 80);
+        uint32_t score = 0;
+        int64_t t = esp_timer_get_time();
+        for (int r = 0; r < RUNS; r++) {
+            camera_frame_sharpness(fb, &score);
+        }
+        double scored = (double)(esp_timer_get_time() - t) / RUNS;
+        t = esp_timer_get_time();
+        for (int r = 0; r < RUNS; r++) {
+            if (fb->format == PIXFORMAT_JPEG) {
+                fmt2rgb888(fb->buf, fb->len, PIXFORMAT_JPEG, out);
+            } else {
+                ref_sharpness(gray, w, h);
+            }
+        }
+        double full = (double)(esp_timer_get_time() - t) / RUNS;
+        printf("  %-10s score %6u %8.1f   %s %8.1f\n", formats[f].name, (unsigned)score, scored,
+               fb->format == PIXFORMAT_JPEG ? "full decode" : "every pixel", full);
+        free_frame(fb);
+    }
+    printf("  %-10s score %6u (every pixel)\n", "reference", (unsigned)ref_sharpness(gray, w, h));
+    free(out);
+    free(gray);
+    free(rgb[0]);
+}
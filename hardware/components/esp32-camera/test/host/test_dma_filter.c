@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "ll_cam_dma_filter.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+/*
+ * Synthetic I2S DMA input: a YUYV frame spread over dma_elem_t the way the two
+ * YUV422 sampling modes put it in the FIFO, with junk in the unused bytes.
+ *   SM_0A0B_0C0D  00 s1 00 s2, 00 s3 00 s4, ...  two samples per element
+ *   SM_0A00_0B00  00 s1 00 00, 00 s2 00 00, ...  one sample per element
+ */
+static void fill_yuyv(uint8_t *yuyv, size_t len, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        yuyv[i] = rand();
+    }
+}
+
+static size_t make_dma(dma_elem_t *dma, const uint8_t *yuyv, size_t len, bool highspeed)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; i += highspeed ? 1 : 2, n++) {
+        dma[n].val = rand();
+        dma[n].sample1 = yuyv[i];
+        if (!highspeed) {
+            dma[n].sample2 = yuyv[i + 1];
+        }
+    }
+    return n * sizeof(dma_elem_t);
+}
+
+static void ref_luma(const uint8_t *yuyv, int width, int height, int scale, uint8_t *plane)
+{
+    for (int py = 0; py < height / scale; py++) {
+        for (int px = 0; px < width / scale; px++) {
+            int sum = 0;
+            for (int y = 0; y < scale; y++) {
+                for (int x = 0; x < scale; x++) {
+                    sum += yuyv[((py * scale + y) * width + px * scale + x) * 2];
+                }
+            }
+            plane[py * (width / scale) + px] = (sum + scale * scale / 2) / (scale * scale);
+        }
+    }
+}
+
+typedef struct {
+    int width, height;
+    size_t yuyv_len, dma_line;
+    uint8_t *yuyv, *out, *plane, *expect;
+    dma_elem_t *dma;
+    cam_luma_t luma;
+} frame_t;
+
+static void frame_init(frame_t *f, int width, int height, int scale, bool highspeed, unsigned seed)
+{
+    f->width = width;
+    f->height = height;
+    f->yuyv_len = width * height * 2;
+    f->yuyv = malloc(f->yuyv_len);
+    f->out = malloc(f->yuyv_len + 8);
+    f->plane = malloc(width * height / (scale * scale));
+    f->expect = malloc(width * height / (scale * scale));
+    f->dma = malloc(f->yuyv_len * sizeof(dma_elem_t));
+    fill_yuyv(f->yuyv, f->yuyv_len, seed);
+    f->dma_line = make_dma(f->dma, f->yuyv, f->yuyv_len, highspeed) / height;
+    ref_luma(f->yuyv, width, height, scale, f->expect);
+    memset(&f->luma, 0, sizeof(f->luma));
+    f->luma.shift = scale == 4 ? 2 : 3;
+    f->luma.width = width;
+    f->luma.acc = calloc(width / scale, sizeof(uint16_t));
+}
+
+static void frame_free(frame_t *f)
+{
+    free(f->yuyv);
+    free(f->out);
+    free(f->plane);
+    free(f->expect);
+    free(f->dma);
+    free(f->luma.acc);
+}
+
+// one frame, lines DMA lines per transfer like cam_task copies them
+static size_t run_luma(frame_t *f, dma_luma_filter_t filter, int lines)
+{
+    size_t out_len = 0;
+    cam_luma_start(&f->luma, f->plane);
+    for (int y = 0; y < f->height; y += lines) {
+        int n = y + lines <= f->height ? lines : f->height - y;
+        out_len += filter(f->out + out_len, (const uint8_t *)f->dma + y * f->dma_line, n * f->dma_line, &f->luma);
+    }
+    return out_len;
+}
+
+TEST_CASE("YUYV filters build the luma plane while copying the frame", "[dma_filter]")
+{
+    static const struct {
+        int width, height;
+    } sizes[] = {{320, 240}, {96, 96}, {160, 120}};
+    static const int scales[] = {4, 8};
+    static const int lines[] = {8, 3, 1};
+    for (int hs = 0; hs < 2; hs++) {
+        dma_luma_filter_t filter = hs ? ll_cam_dma_filter_yuyv_highspeed_luma : ll_cam_dma_filter_yuyv_luma;
+        dma_filter_t plain = hs ? ll_cam_dma_filter_yuyv_highspeed : ll_cam_dma_filter_yuyv;
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (size_t k = 0; k < 2; k++) {
+                frame_t f;
+                frame_init(&f, sizes[s].width, sizes[s].height, scales[k], hs, s * 2 + k);
+                for (size_t l = 0; l < 3; l++) {
+                    // the sums start over with every frame
+                    memset(f.plane, 0xAA, f.width * f.height / (scales[k] * scales[k]));
+                    TEST_ASSERT_EQUAL(f.yuyv_len, run_luma(&f, filter, lines[l]));
+                    TEST_ASSERT_EQUAL_MEMORY(f.yuyv, f.out, f.yuyv_len);
+                    TEST_ASSERT_EQUAL_MEMORY(f.expect, f.plane, f.width * f.height / (scales[k] * scales[k]));
+                    TEST_ASSERT_EQUAL(0, f.luma.y % f.height);
+                }
+                // same full resolution output as the filter without the plane
+                memset(f.out, 0, f.yuyv_len);
+                TEST_ASSERT_EQUAL(f.yuyv_len, plain(f.out, (const uint8_t *)f.dma, f.dma_line * f.height));
+                TEST_ASSERT_EQUAL_MEMORY(f.yuyv, f.out, f.yuyv_len);
+                frame_free(&f);
+            }
+        }
+    }
+}
+
+/*
+ * What the plane costs: made by the filter while the samples are in registers,
+ * against a second pass over the frame buffer afterwards.
+ */
+static void luma_pass(const uint8_t *yuyv, int width, int height, int scale, uint16_t *acc, uint8_t *plane)
+{
+    int bits = scale == 4 ? 4 : 6;
+    for (int y = 0; y < height; y++) {
+        const uint8_t *p = yuyv + y * width * 2;
+        for (int x = 0; x < width; x++) {
+            acc[x / scale] += p[x * 2];
+        }
+        if ((y + 1) % scale == 0) {
+            for (int x = 0; x < width / scale; x++) {
+                *plane++ = (acc[x] + (1 << (bits - 1))) >> bits;
+                acc[x] = 0;
+            }
+        }
+    }
+}
+
+TEST_CASE("Luma plane in the DMA filter benchmark", "[dma_filter][bench]")
+{
+    enum { FRAMES = 200 };
+    frame_t f;
+    frame_init(&f, 640, 480, 8, false, 1);
+    // DMA transfers of 8 lines
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < FRAMES; i++) {
+        for (int y = 0; y < f.height; y += 8) {
+            ll_cam_dma_filter_yuyv(f.out + y * f.width * 2, (const uint8_t *)f.dma + y * f.dma_line, 8 * f.dma_line);
+        }
+    }
+    double plain = (double)(esp_timer_get_time() - t) / FRAMES;
+    t = esp_timer_get_time();
+    for (int i = 0; i < FRAMES; i++) {
+        run_luma(&f, ll_cam_dma_filter_yuyv_luma, 8);
+    }
+    double fused = (double)(esp_timer_get_time() - t) / FRAMES;
+    t = esp_timer_get_time();
+    for (int i = 0; i < FRAMES; i++) {
+        luma_pass(f.out, f.width, f.height, 8, f.luma.acc, f.plane);
+    }
+    double pass = (double)(esp_timer_get_time() - t) / FRAMES;
+    TEST_ASSERT_EQUAL_MEMORY(f.expect, f.plane, f.width * f.height / 64);
+    printf("VGA YUYV, 1/8 luma plane, us per frame\n");
+    printf("  filter                     %8.1f\n", plain);
+    printf("  filter making the plane    %8.1f  (+%.1f)\n", fused, fused - plain);
+    printf("  filter, then a plane pass  %8.1f  (+%.1f, reads the %zu KB frame again)\n", plain + pass, pass, f.yuyv_len / 1024);
+    frame_free(&f);
+}
+
+/*
+ * The filters as they were before they stored whole words: a byte store per sample.
+ */
+static size_t old_filter_jpeg(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const dma_elem_t* dma_el = (const dma_elem_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 4;
+    // manually unrolling 4 iterations of the loop here
+    for (size_t i = 0; i < end; ++i) {
+        dst[0] = dma_el[0].sample1;
+        dst[1] = dma_el[1].sample1;
+        dst[2] = dma_el[2].sample1;
+        dst[3] = dma_el[3].sample1;
+        dma_el += 4;
+        dst += 4;
+    }
+    return elements;
+}
+
+static size_t old_filter_grayscale(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const dma_elem_t* dma_el = (const dma_elem_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 4;
+    for (size_t i = 0; i < end; ++i) {
+        // manually unrolling 4 iterations of the loop here
+        dst[0] = dma_el[0].sample1;
+        dst[1] = dma_el[1].sample1;
+        dst[2] = dma_el[2].sample1;
+        dst[3] = dma_el[3].sample1;
+        dma_el += 4;
+        dst += 4;
+    }
+    return elements;
+}
+
+static size_t old_filter_grayscale_highspeed(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const dma_elem_t* dma_el = (const dma_elem_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 8;
+    for (size_t i = 0; i < end; ++i) {
+        // manually unrolling 4 iterations of the loop here
+        dst[0] = dma_el[0].sample1;
+        dst[1] = dma_el[2].sample1;
+        dst[2] = dma_el[4].sample1;
+        dst[3] = dma_el[6].sample1;
+        dma_el += 8;
+        dst += 4;
+    }
+    // the final sample of a line in SM_0A0B_0B0C sampling mode needs special handling
+    if ((elements & 0x7) != 0) {
+        dst[0] = dma_el[0].sample1;
+        dst[1] = dma_el[2].sample1;
+        elements += 1;
+    }
+    return elements / 2;
+}
+
+static size_t old_filter_yuyv(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const dma_elem_t* dma_el = (const dma_elem_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 4;
+    for (size_t i = 0; i < end; ++i) {
+        dst[0] = dma_el[0].sample1;//y0
+        dst[1] = dma_el[0].sample2;//u
+        dst[2] = dma_el[1].sample1;//y1
+        dst[3] = dma_el[1].sample2;//v
+
+        dst[4] = dma_el[2].sample1;//y0
+        dst[5] = dma_el[2].sample2;//u
+        dst[6] = dma_el[3].sample1;//y1
+        dst[7] = dma_el[3].sample2;//v
+        dma_el += 4;
+        dst += 8;
+    }
+    return elements * 2;
+}
+
+static size_t old_filter_yuyv_highspeed(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    const dma_elem_t* dma_el = (const dma_elem_t*)src;
+    size_t elements = len / sizeof(dma_elem_t);
+    size_t end = elements / 8;
+    for (size_t i = 0; i < end; ++i) {
+        dst[0] = dma_el[0].sample1;//y0
+        dst[1] = dma_el[1].sample1;//u
+        dst[2] = dma_el[2].sample1;//y1
+        dst[3] = dma_el[3].sample1;//v
+
+        dst[4] = dma_el[4].sample1;//y0
+        dst[5] = dma_el[5].sample1;//u
+        dst[6] = dma_el[6].sample1;//y1
+        dst[7] = dma_el[7].sample1;//v
+        dma_el += 8;
+        dst += 8;
+    }
+    if ((elements & 0x7) != 0) {
+        dst[0] = dma_el[0].sample1;//y0
+        dst[1] = dma_el[1].sample1;//u
+        dst[2] = dma_el[2].sample1;//y1
+        dst[3] = dma_el[2].sample2;//v
+        elements += 4;
+    }
+    return elements;
+}
+
+typedef struct {
+    const char *name;
+    dma_filter_t filter, old;
+} filter_pair_t;
+
+static const filter_pair_t filter_pairs[] = {
+    {"jpeg", ll_cam_dma_filter_jpeg, old_filter_jpeg},
+    {"grayscale", ll_cam_dma_filter_grayscale, old_filter_grayscale},
+    {"grayscale_highspeed", ll_cam_dma_filter_grayscale_highspeed, old_filter_grayscale_highspeed},
+    {"yuyv", ll_cam_dma_filter_yuyv, old_filter_yuyv},
+    {"yuyv_highspeed", ll_cam_dma_filter_yuyv_highspeed, old_filter_yuyv_highspeed},
+};
+
+static void fill_dma(dma_elem_t *dma, size_t elements, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < elements; i++) {
+        dma[i].val = ((uint32_t)rand() << 16) ^ rand();
+    }
+}
+
+TEST_CASE("Word-wide DMA filters match the byte filters", "[dma_filter]")
+{
+    enum { MAX_ELEMENTS = 1024 };
+    dma_elem_t *dma = malloc(MAX_ELEMENTS * sizeof(dma_elem_t));
+    uint8_t *out = malloc(MAX_ELEMENTS * 2 + 16);
+    uint8_t *expect = malloc(MAX_ELEMENTS * 2 + 16);
+    for (size_t f = 0; f < sizeof(filter_pairs) / sizeof(filter_pairs[0]); f++) {
+        // DMA transfers are whole multiples of 4 elements, odd multiples end lines in the highspeed modes
+        for (size_t elements = 4; elements <= MAX_ELEMENTS; elements += elements < 64 ? 4 : 60) {
+            fill_dma(dma, elements, elements + f);
+            // the frame buffer position is only aligned at the start of the frame
+            for (size_t offset = 0; offset < 4; offset++) {
+                memset(out, 0x5A, MAX_ELEMENTS * 2 + 16);
+                memset(expect, 0x5A, MAX_ELEMENTS * 2 + 16);
+                size_t n = filter_pairs[f].filter(out + offset, (const uint8_t *)dma, elements * sizeof(dma_elem_t));
+                size_t old_n = filter_pairs[f].old(expect + offset, (const uint8_t *)dma, elements * sizeof(dma_elem_t));
+                TEST_ASSERT_MESSAGE(old_n == n, filter_pairs[f].name);
+                TEST_ASSERT_MESSAGE(memcmp(expect, out, MAX_ELEMENTS * 2 + 16) == 0, filter_pairs[f].name);
+            }
+        }
+    }
+    // the byte filters left the last elements % 4 samples out, the word filters copy them
+    fill_dma(dma, 7, 1);
+    memset(out, 0, 16);
+    TEST_ASSERT_EQUAL(7, ll_cam_dma_filter_jpeg(out + 1, (const uint8_t *)dma, 7 * sizeof(dma_elem_t)));
+    for (size_t i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL(dma[i].sample1, out[1 + i]);
+    }
+    TEST_ASSERT_EQUAL(0, out[8]);
+    free(dma);
+    free(out);
+    free(expect);
+}
+
+static uint64_t bench_clock(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+static double bench_filter(dma_filter_t filter, uint8_t *out, const dma_elem_t *dma, size_t len, int runs, uint64_t *clocks)
+{
+    size_t bytes = 0;
+    uint64_t c = bench_clock();
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < runs; i++) {
+        bytes += filter(out, (const uint8_t *)dma, len);
+    }
+    t = esp_timer_get_time() - t;
+    *clocks = bench_clock() - c;
+    return (double)bytes / t;
+}
+
+/*
+ * Throughput of the copy the CPU does for every DMA transfer, in a 4 KB DMA buffer
+ * like cam_hal uses without PSRAM. Cycles are host TSC cycles, so the ratio between
+ * old and new says more than the numbers themselves.
+ */
+TEST_CASE("Word-wide DMA filter benchmark", "[dma_filter][bench]")
+{
+    enum { ELEMENTS = 1024, RUNS = 20000 };
+    dma_elem_t *dma = malloc(ELEMENTS * sizeof(dma_elem_t));
+    uint8_t *out = malloc(ELEMENTS * 2);
+    fill_dma(dma, ELEMENTS, 3);
+#ifdef HAVE_TSC
+    const char *unit = "B/cycle";
+#else
+    const char *unit = "B/us";
+#endif
+    printf("%-20s %10s %10s %10s %10s\n", "filter", "old MB/s", "new MB/s", "old", "new");
+    for (size_t f = 0; f < sizeof(filter_pairs) / sizeof(filter_pairs[0]); f++) {
+        uint64_t old_c, new_c;
+        double old_mbs = bench_filter(filter_pairs[f].old, out, dma, sizeof(dma_elem_t) * ELEMENTS, RUNS, &old_c);
+        double new_mbs = bench_filter(filter_pairs[f].filter, out, dma, sizeof(dma_elem_t) * ELEMENTS, RUNS, &new_c);
+        size_t bytes = filter_pairs[f].filter(out, (const uint8_t *)dma, sizeof(dma_elem_t) * ELEMENTS) * (size_t)RUNS;
+        printf("%-20s %10.0f %10.0f %10.3f %10.3f %s\n", filter_pairs[f].name, old_mbs, new_mbs,
+               (double)bytes / old_c, (double)bytes / new_c, unit);
+    }
+    free(dma);
+    free(out);
+}
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "yuv.h"
+
+static const pixformat_t raw_formats[] = {
+    PIXFORMAT_RGB565, PIXFORMAT_RGB555, PIXFORMAT_RGB444, PIXFORMAT_YUV422, PIXFORMAT_GRAYSCALE, PIXFORMAT_RGB888,
+};
+#define RAW_FORMAT_CNT (sizeof(raw_formats) / sizeof(raw_formats[0]))
+
+static const char *get_fmt_name(pixformat_t format)
+{
+    switch (format) {
+    case PIXFORMAT_RGB565: return "RGB565";
+    case PIXFORMAT_RGB555: return "RGB555";
+    case PIXFORMAT_RGB444: return "RGB444";
+    case PIXFORMAT_YUV422: return "YUV422";
+    case PIXFORMAT_GRAYSCALE: return "GRAY";
+    case PIXFORMAT_RGB888: return "RGB888";
+    default:
+        break;
+    }
+    return "UNKNOW";
+}
+
+static void fill_random(uint8_t *buf, size_t len, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() & 0xFF;
+    }
+}
+
+/*
+ * Float reference model. A pixel is decoded into its domain (RGB, YUV or
+ * gray), moved across domains with the textbook BT.601 equations and
+ * compared in the destination domain.
+ */
+typedef enum { DOM_RGB, DOM_YUV, DOM_GRAY } dom_t;
+typedef struct {
+    dom_t dom;
+    float c[3];
+} ref_px_t;
+
+static dom_t fmt_domain(pixformat_t f)
+{
+    return f == PIXFORMAT_YUV422 ? DOM_YUV : (f == PIXFORMAT_GRAYSCALE ? DOM_GRAY : DOM_RGB);
+}
+
+static ref_px_t ref_load(pixformat_t f, const uint8_t *line, size_t x)
+{
+    ref_px_t p = {fmt_domain(f), {0, 0, 0}};
+    const uint8_t *s = line + x * fmt_bytes_per_pixel(f);
+    switch (f) {
+    case PIXFORMAT_RGB565:
+        p.c[0] = s[0] >> 3 << 3;
+        p.c[1] = (((s[0] & 7) << 3) | (s[1] >> 5)) << 2;
+        p.c[2] = (s[1] & 0x1F) << 3;
+        break;
+    case PIXFORMAT_RGB555:
+        p.c[0] = ((s[0] >> 2) & 0x1F) << 3;
+        p.c[1] = (((s[0] & 3) << 3) | (s[1] >> 5)) << 3;
+        p.c[2] = (s[1] & 0x1F) << 3;
+        break;
+    case PIXFORMAT_RGB444:
+        p.c[0] = (s[0] & 0xF) << 4;
+        p.c[1] = (s[1] >> 4) << 4;
+        p.c[2] = (s[1] & 0xF) << 4;
+        break;
+    case PIXFORMAT_RGB888:
+        p.c[0] = s[2];
+        p.c[1] = s[1];
+        p.c[2] = s[0];
+        break;
+    case PIXFORMAT_GRAYSCALE:
+        p.c[0] = s[0];
+        break;
+    case PIXFORMAT_YUV422: {
+        const uint8_t *pair = line + (x & ~1) * 2;
+        p.c[0] = pair[(x & 1) * 2];
+        p.c[1] = pair[1];
+        p.c[2] = pair[3];
+    }
+    break;
+    default:
+        break;
+    }
+    return p;
+}
+
+static float clampf(float v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static ref_px_t ref_cast(ref_px_t p, dom_t to)
+{
+    ref_px_t o = {to, {0, 0, 0}};
+    if (p.dom == to) {
+        return p;
+    }
+    if (p.dom == DOM_RGB && to == DOM_YUV) {
+        o.c[0] = 16 + (65.738f * p.c[0] + 129.057f * p.c[1] + 25.064f * p.c[2]) / 256;
+        o.c[1] = 128 + (-37.945f * p.c[0] - 74.494f * p.c[1] + 112.439f * p.c[2]) / 256;
+        o.c[2] = 128 + (112.439f * p.c[0] - 94.154f * p.c[1] - 18.285f * p.c[2]) / 256;
+    } else if (p.dom == DOM_RGB && to == DOM_GRAY) {
+        o.c[0] = 0.299f * p.c[0] + 0.587f * p.c[1] + 0.114f * p.c[2];
+    } else if (p.dom == DOM_YUV && to == DOM_RGB) {
+        float y = 1.164f * (p.c[0] - 16), u = p.c[1] - 128, v = p.c[2] - 128;
+        o.c[0] = clampf(y + 1.596f * v);
+        o.c[1] = clampf(y - 0.813f * v - 0.391f * u);
+        o.c[2] = clampf(y + 2.018f * u);
+    } else if (p.dom == DOM_YUV && to == DOM_GRAY) {
+        o.c[0] = p.c[0];
+    } else if (p.dom == DOM_GRAY && to == DOM_RGB) {
+        o.c[0] = o.c[1] = o.c[2] = p.c[0];
+    } else if (p.dom == DOM_GRAY && to == DOM_YUV) {
+        o.c[0] = p.c[0];
+        o.c[1] = o.c[2] = 128;
+    }
+    return o;
+}
+
+// quantisation step of the destination channels plus colour math rounding
+static float ref_tolerance(pixformat_t f, int channel)
+{
+    switch (f) {
+    case PIXFORMAT_RGB565: return channel == 1 ? 4 + 3 : 8 + 3;
+    case PIXFORMAT_RGB555: return 8 + 3;
+    case PIXFORMAT_RGB444: return 16 + 3;
+    default:
+        break;
+    }
+    return 3;
+}
+
+static void check_pair(pixformat_t sf, pixformat_t df, uint16_t w, uint16_t h)
+{
+    size_t slen = w * h * fmt_bytes_per_pixel(sf);
+    uint8_t *src = malloc(slen);
+    uint8_t *dst = malloc(w * h * fmt_bytes_per_pixel(df));
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(dst);
+    fill_random(src, slen, sf * 16 + df);
+
+    TEST_ASSERT_TRUE(fmt_convert(src, sf, dst, df, w, h, NULL));
+
+    size_t sl = w * fmt_bytes_per_pixel(sf), dl = w * fmt_bytes_per_pixel(df);
+    for (size_t y = 0; y < h; y++) {
+        for (size_t x = 0; x < w; x++) {
+            ref_px_t expect = ref_cast(ref_load(sf, src + y * sl, x), fmt_domain(df));
+            if (df == PIXFORMAT_YUV422) {
+                // chroma of a YUYV pair is the mean of both pixels
+                ref_px_t n = ref_cast(ref_load(sf, src + y * sl, x ^ 1), DOM_YUV);
+                expect.c[1] = (expect.c[1] + n.c[1]) / 2;
+                expect.c[2] = (expect.c[2] + n.c[2]) / 2;
+            }
+            ref_px_t got = ref_load(df, dst + y * dl, x);
+            int channels = expect.dom == DOM_GRAY ? 1 : 3;
+            for (int c = 0; c < channels; c++) {
+                if (fabsf(clampf(expect.c[c]) - got.c[c]) > ref_tolerance(df, c)) {
+                    char msg[128];
+                    snprintf(msg, sizeof(msg), "%s -> %s at %zu,%zu ch %d: ref %.1f got %.0f", get_fmt_name(sf), get_fmt_name(df),
+                             x, y, c, clampf(expect.c[c]), got.c[c]);
+                    free(src);
+                    free(dst);
+                    TEST_FAIL_MESSAGE(msg);
+                }
+            }
+        }
+    }
+    free(src);
+    free(dst);
+}
+
+TEST_CASE("Conversions every format pair matches float reference", "[conversions]")
+{
+    for (size_t s = 0; s < RAW_FORMAT_CNT; s++) {
+        for (size_t d = 0; d < RAW_FORMAT_CNT; d++) {
+            check_pair(raw_formats[s], raw_formats[d], 64, 16);
+        }
+    }
+}
+
+TEST_CASE("Conversions ROI with strides matches full conversion", "[conversions]")
+{
+    const uint16_t w = 96, h = 40;
+    for (size_t s = 0; s < RAW_FORMAT_CNT; s++) {
+        for (size_t d = 0; d < RAW_FORMAT_CNT; d++) {
+            pixformat_t sf = raw_formats[s], df = raw_formats[d];
+            size_t sbpp = fmt_bytes_per_pixel(sf), dbpp = fmt_bytes_per_pixel(df);
+            uint8_t *src = malloc(w * h * sbpp);
+            uint8_t *full = malloc(w * h * dbpp);
+            // destination wider than the ROI to check dst_stride
+            fmt_roi_t roi = {.x = 10, .y = 7, .width = 30, .height = 20, .src_stride = 0, .dst_stride = 40 * dbpp};
+            uint8_t *crop = calloc(1, roi.dst_stride * roi.height);
+            fill_random(src, w * h * sbpp, 7);
+            TEST_ASSERT_TRUE(fmt_convert(src, sf, full, df, w, h, NULL));
+            TEST_ASSERT_TRUE(fmt_convert(src, sf, crop, df, w, h, &roi));
+            for (size_t y = 0; y < roi.height; y++) {
+                TEST_ASSERT_EQUAL_MEMORY(full + ((roi.y + y) * w + roi.x) * dbpp, crop + y * roi.dst_stride, roi.width * dbpp);
+            }
+            free(src);
+            free(full);
+            free(crop);
+        }
+    }
+}
+
+TEST_CASE("Conversions reject invalid formats and regions", "[conversions]")
+{
+    uint8_t src[64] = {0}, dst[128];
+    fmt_roi_t outside = {.x = 4, .y = 0, .width = 8, .height = 1};
+    fmt_roi_t odd = {.x = 1, .y = 0, .width = 2, .height = 1};
+    TEST_ASSERT_FALSE(fmt_convert(src, PIXFORMAT_JPEG, dst, PIXFORMAT_RGB888, 8, 1, NULL));
+    TEST_ASSERT_FALSE(fmt_convert(src, PIXFORMAT_RGB565, dst, PIXFORMAT_RAW, 8, 1, NULL));
+    TEST_ASSERT_FALSE(fmt_convert(src, PIXFORMAT_RGB565, dst, PIXFORMAT_RGB888, 8, 1, &outside));
+    TEST_ASSERT_FALSE(fmt_convert(src, PIXFORMAT_YUV422, dst, PIXFORMAT_RGB888, 8, 1, &odd));
+    TEST_ASSERT_EQUAL(0, fmt_bytes_per_pixel(PIXFORMAT_JPEG));
+}
+
+TEST_CASE("Conversions fmt2rgb888 and fmt2bmp keep their output", "[conversions]")
+{
+    // the converters used to carry their own loops, compare against those
+    const size_t pix = 64;
+    uint8_t src[64 * 2], out[64 * 3], expect[64 * 3];
+    fill_random(src, sizeof(src), 3);
+
+    TEST_ASSERT_TRUE(fmt2rgb888(src, pix * 2, PIXFORMAT_RGB565, out));
+    for (size_t i = 0; i < pix; i++) {
+        uint8_t hb = src[i * 2], lb = src[i * 2 + 1];
+        expect[i * 3 + 0] = (lb & 0x1F) << 3;
+        expect[i * 3 + 1] = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
+        expect[i * 3 + 2] = hb & 0xF8;
+    }
+    TEST_ASSERT_EQUAL_MEMORY(expect, out, pix * 3);
+
+    TEST_ASSERT_TRUE(fmt2rgb888(src, pix * 2, PIXFORMAT_YUV422, out));
+    for (size_t i = 0; i < pix; i += 2) {
+        const uint8_t *s = src + i * 2;
+        uint8_t r, g, b;
+        yuv2rgb(s[0], s[1], s[3], &r, &g, &b);
+        expect[i * 3 + 0] = b;
+        expect[i * 3 + 1] = g;
+        expect[i * 3 + 2] = r;
+        yuv2rgb(s[2], s[1], s[3], &r, &g, &b);
+        expect[i * 3 + 3] = b;
+        expect[i * 3 + 4] = g;
+        expect[i * 3 + 5] = r;
+    }
+    TEST_ASSERT_EQUAL_MEMORY(expect, out, pix * 3);
+
+    uint8_t *bmp = NULL;
+    size_t bmp_len = 0;
+    TEST_ASSERT_TRUE(fmt2bmp(src, pix * 2, 8, 8, PIXFORMAT_YUV422, &bmp, &bmp_len));
+    TEST_ASSERT_EQUAL(54 + pix * 3, bmp_len);
+    TEST_ASSERT_EQUAL_MEMORY(expect, bmp + 54, pix * 3);
+    free(bmp);
+}
+
+static size_t jpg_mem_write(void *arg, size_t index, const void *data, size_t len)
+{
+    memcpy((uint8_t *)arg + index, data, len);
+    return len;
+}
+
+TEST_CASE("Conversions JPEG round trip through the row converters", "[conversions]")
+{
+    const uint16_t w = 64, h = 48;
+    uint8_t *src = malloc(w * h * 2);
+    uint8_t *jpg = malloc(64 * 1024);
+    uint8_t *rgb = malloc(w * h * 3);
+    for (size_t y = 0; y < h; y++) {
+        for (size_t x = 0; x < w; x++) {
+            // smooth RGB565 gradient, big-endian
+            uint16_t c = ((x * 31 / w) << 11) | ((y * 63 / h) << 5) | 16;
+            src[(y * w + x) * 2] = c >> 8;
+            src[(y * w + x) * 2 + 1] = c & 0xFF;
+        }
+    }
+    size_t jpg_len = 0;
+    TEST_ASSERT_TRUE(fmt2jpg_cb(src, w * h * 2, w, h, PIXFORMAT_RGB565, 90, jpg_mem_write, jpg));
+    uint8_t *out = NULL;
+    TEST_ASSERT_TRUE(fmt2jpg(src, w * h * 2, w, h, PIXFORMAT_RGB565, 90, &out, &jpg_len));
+    TEST_ASSERT_EQUAL_MEMORY(out, jpg, jpg_len);
+    TEST_ASSERT_TRUE(fmt2rgb888(out, jpg_len, PIXFORMAT_JPEG, rgb));
+
+    uint8_t *ref = malloc(w * h * 3);
+    TEST_ASSERT_TRUE(fmt_convert(src, PIXFORMAT_RGB565, ref, PIXFORMAT_RGB888, w, h, NULL));
+    long err = 0;
+    for (size_t i = 0; i < (size_t)w * h * 3; i++) {
+        err += abs((int)ref[i] - (int)rgb[i]);
+    }
+    TEST_ASSERT_LESS_THAN(4, err / (w * h * 3));
+    free(out);
+    free(ref);
+    free(src);
+    free(jpg);
+    free(rgb);
+}
+
+TEST_CASE("Conversions JPEG from rows in bands matches the whole frame", "[conversions]")
+{
+    const uint16_t w = 40, h = 30;
+    static const pixformat_t formats[] = {PIXFORMAT_YUV422, PIXFORMAT_RGB565, PIXFORMAT_GRAYSCALE};
+    uint8_t *src = malloc(w * h * 2);
+    uint8_t *a = malloc(64 * 1024);
+    uint8_t *b = malloc(64 * 1024);
+    for (size_t i = 0; i < (size_t)w * h * 2; i++) {
+        src[i] = i * 7 + (i >> 5);
+    }
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        size_t row = w * (formats[f] == PIXFORMAT_GRAYSCALE ? 1 : 2);
+        memset(a, 0, 64 * 1024);
+        memset(b, 0, 64 * 1024);
+        TEST_ASSERT_TRUE(fmt2jpg_cb(src, row * h, w, h, formats[f], 80, jpg_mem_write, a));
+        // bands of 7 rows, not a multiple of the MCU height
+        jpg_stream_t *jpg = jpg_stream_start(w, h, formats[f], 80, jpg_mem_write, b);
+        TEST_ASSERT_NOT_NULL(jpg);
+        for (uint16_t y = 0; y < h; y += 7) {
+            TEST_ASSERT_TRUE(jpg_stream_rows(jpg, src + y * row, y + 7 <= h ? 7 : h - y));
+        }
+        TEST_ASSERT_FALSE(jpg_stream_rows(jpg, src, 1));
+        TEST_ASSERT_TRUE(jpg_stream_end(jpg));
+        TEST_ASSERT_EQUAL_MEMORY(a, b, 64 * 1024);
+    }
+    // an image cut short is not finished
+    jpg_stream_t *jpg = jpg_stream_start(w, h, PIXFORMAT_RGB565, 80, jpg_mem_write, b);
+    TEST_ASSERT_TRUE(jpg_stream_rows(jpg, src, h - 1));
+    TEST_ASSERT_FALSE(jpg_stream_end(jpg));
+    TEST_ASSERT_NULL(jpg_stream_start(w, h, PIXFORMAT_JPEG, 80, jpg_mem_write, b));
+    free(src);
+    free(a);
+    free(b);
+}
+
+TEST_CASE("Conversions format matrix benchmark", "[conversions][bench]")
+{
+    const uint16_t w = 640, h = 480;
+    const int times = 8;
+    uint8_t *src = malloc(w * h * 3);
+    uint8_t *dst = malloc(w * h * 3);
+    fill_random(src, w * h * 3, 1);
+
+    printf("Conversion MP/s, VGA (rows: source, columns: destination)\n");
+    printf("%-8s", "");
+    for (size_t d = 0; d < RAW_FORMAT_CNT; d++) {
+        printf(" %8s", get_fmt_name(raw_formats[d]));
+    }
+    printf("\n");
+    for (size_t s = 0; s < RAW_FORMAT_CNT; s++) {
+        printf("%-8s", get_fmt_name(raw_formats[s]));
+        for (size_t d = 0; d < RAW_FORMAT_CNT; d++) {
+            int64_t t = esp_timer_get_time();
+            for (int i = 0; i < times; i++) {
+                fmt_convert(src, raw_formats[s], dst, raw_formats[d], w, h, NULL);
+            }
+            t = esp_timer_get_time() - t;
+            printf(" %8.1f", (double)w * h * times / (t ? t : 1));
+        }
+        printf("\n");
+    }
+    free(src);
+    free(dst);
+}
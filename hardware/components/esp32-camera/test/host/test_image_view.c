@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+
+static void fill_random(uint8_t *buf, size_t len, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() & 0xFF;
+    }
+}
+
+static camera_fb_t *make_fb(uint16_t w, uint16_t h, pixformat_t format)
+{
+    camera_fb_t *fb = calloc(1, sizeof(camera_fb_t));
+    fb->width = w;
+    fb->height = h;
+    fb->format = format;
+    fb->len = w * h * fmt_bytes_per_pixel(format);
+    fb->buf = malloc(fb->len);
+    fill_random(fb->buf, fb->len, w + format);
+    return fb;
+}
+
+static void free_fb(camera_fb_t *fb)
+{
+    free(fb->buf);
+    free(fb);
+}
+
+TEST_CASE("View of a frame buffer and its crops", "[image_view]")
+{
+    camera_fb_t *fb = make_fb(64, 48, PIXFORMAT_RGB565);
+    image_view_t view, crop;
+    TEST_ASSERT_TRUE(fb_view(fb, &view));
+    TEST_ASSERT_EQUAL(64 * 2, view.stride);
+    TEST_ASSERT_EQUAL(1, view.step);
+
+    TEST_ASSERT_TRUE(view_crop(&view, 10, 5, 20, 30, &crop));
+    TEST_ASSERT_TRUE(crop.buf == fb->buf + 5 * 128 + 20);
+    uint8_t a[20 * 30 * 3], b[20 * 30 * 3];
+    fmt_roi_t roi = {.x = 10, .y = 5, .width = 20, .height = 30};
+    TEST_ASSERT_TRUE(view2rgb888(&crop, a));
+    TEST_ASSERT_TRUE(fmt_convert(fb->buf, PIXFORMAT_RGB565, b, PIXFORMAT_RGB888, 64, 48, &roi));
+    TEST_ASSERT_EQUAL_MEMORY(b, a, sizeof(a));
+
+    // crop of a crop, in place
+    TEST_ASSERT_TRUE(view_crop(&crop, 2, 3, 4, 5, &crop));
+    TEST_ASSERT_TRUE(crop.buf == fb->buf + 8 * 128 + 24);
+    TEST_ASSERT_FALSE(view_crop(&crop, 1, 0, 4, 1, &crop));
+    TEST_ASSERT_FALSE(view_crop(&view, 60, 0, 5, 1, &crop));
+    TEST_ASSERT_FALSE(view_crop(&view, 0, 0, 0, 1, &crop));
+
+    fb->format = PIXFORMAT_JPEG;
+    TEST_ASSERT_FALSE(fb_view(fb, &view));
+    free_fb(fb);
+
+    fb = make_fb(64, 48, PIXFORMAT_YUV422);
+    TEST_ASSERT_TRUE(fb_view(fb, &view));
+    TEST_ASSERT_FALSE(view_crop(&view, 3, 0, 4, 4, &crop));
+    TEST_ASSERT_TRUE(view_crop(&view, 4, 0, 5, 4, &crop));
+    free_fb(fb);
+}
+
+TEST_CASE("View subsampling picks every n-th pixel", "[image_view]")
+{
+    static const pixformat_t formats[] = {PIXFORMAT_RGB565, PIXFORMAT_GRAYSCALE, PIXFORMAT_RGB888, PIXFORMAT_YUV422};
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        camera_fb_t *fb = make_fb(64, 48, formats[f]);
+        size_t bpp = fmt_bytes_per_pixel(formats[f]);
+        image_view_t view, sub;
+        TEST_ASSERT_TRUE(fb_view(fb, &view));
+        TEST_ASSERT_TRUE(view_crop(&view, 6, 2, 50, 40, &view));
+        TEST_ASSERT_TRUE(view_subsample(&view, 3, &sub));
+        TEST_ASSERT_EQUAL(17, sub.width);
+        TEST_ASSERT_EQUAL(14, sub.height);
+
+        uint8_t out[17 * 14 * 3];
+        TEST_ASSERT_TRUE(view_convert(&sub, out, formats[f], 0));
+        for (int y = 0; y < sub.height; y++) {
+            const uint8_t *row = fb->buf + (2 + y * 3) * fb->width * bpp;
+            for (int x = 0; x < sub.width; x++) {
+                size_t p = 6 + x * 3;
+                const uint8_t *o = out + (y * sub.width + x) * bpp;
+                if (formats[f] == PIXFORMAT_YUV422) {
+                    // luma is exact, chroma comes from the pair of the first pixel
+                    TEST_ASSERT_EQUAL(row[p * 2], o[0]);
+                } else {
+                    TEST_ASSERT_EQUAL_MEMORY(row + p * bpp, o, bpp);
+                }
+            }
+        }
+        free_fb(fb);
+    }
+    image_view_t view = {.step = 100}, sub;
+    TEST_ASSERT_FALSE(view_subsample(&view, 3, &sub));
+    TEST_ASSERT_FALSE(view_subsample(&view, 0, &sub));
+}
+
+TEST_CASE("View encoders match encoding a copied crop", "[image_view]")
+{
+    camera_fb_t *fb = make_fb(160, 120, PIXFORMAT_RGB565);
+    image_view_t view, crop;
+    TEST_ASSERT_TRUE(fb_view(fb, &view));
+    TEST_ASSERT_TRUE(view_crop(&view, 17, 9, 33, 21, &crop));
+
+    uint8_t *copy = malloc(80 * 60 * 2);
+    for (int y = 0; y < 21; y++) {
+        memcpy(copy + y * 66, crop.buf + y * crop.stride, 66);
+    }
+    uint8_t *a = NULL, *b = NULL;
+    size_t a_len = 0, b_len = 0;
+    TEST_ASSERT_TRUE(view2jpg(&crop, 80, &a, &a_len));
+    TEST_ASSERT_TRUE(fmt2jpg(copy, 33 * 21 * 2, 33, 21, PIXFORMAT_RGB565, 80, &b, &b_len));
+    TEST_ASSERT_EQUAL(b_len, a_len);
+    TEST_ASSERT_EQUAL_MEMORY(b, a, a_len);
+    free(a);
+    free(b);
+
+    // 33 pixels of RGB888 need one byte of padding per BMP row
+    TEST_ASSERT_TRUE(view2bmp(&crop, &a, &a_len));
+    TEST_ASSERT_EQUAL(54 + 100 * 21, a_len);
+    uint8_t rgb[33 * 21 * 3];
+    TEST_ASSERT_TRUE(view2rgb888(&crop, rgb));
+    for (int y = 0; y < 21; y++) {
+        TEST_ASSERT_EQUAL_MEMORY(rgb + y * 99, a + 54 + y * 100, 99);
+        TEST_ASSERT_EQUAL(0, a[54 + y * 100 + 99]);
+    }
+    free(a);
+
+    // subsampled views go through the gather path of both encoders
+    image_view_t sub;
+    TEST_ASSERT_TRUE(view_subsample(&view, 2, &sub));
+    TEST_ASSERT_TRUE(view_convert(&sub, copy, PIXFORMAT_RGB565, 0));
+    TEST_ASSERT_TRUE(view2jpg(&sub, 80, &a, &a_len));
+    TEST_ASSERT_TRUE(fmt2jpg(copy, 80 * 60 * 2, 80, 60, PIXFORMAT_RGB565, 80, &b, &b_len));
+    TEST_ASSERT_EQUAL_MEMORY(b, a, a_len);
+    free(a);
+    free(b);
+    TEST_ASSERT_TRUE(view2bmp(&sub, &a, &a_len));
+    TEST_ASSERT_TRUE(fmt2bmp(copy, 80 * 60 * 2, 80, 60, PIXFORMAT_RGB565, &b, &b_len));
+    TEST_ASSERT_EQUAL(b_len, a_len);
+    TEST_ASSERT_EQUAL_MEMORY(b, a, a_len);
+    free(a);
+    free(b);
+    free(copy);
+    free_fb(fb);
+}
+
+static size_t null_write(void *arg, size_t index, const void *data, size_t len)
+{
+    *(size_t *)arg += len;
+    return len;
+}
+
+TEST_CASE("View crop then encode benchmark", "[image_view][bench]")
+{
+    const int times = 20;
+    camera_fb_t *fb = make_fb(640, 480, PIXFORMAT_RGB565);
+    image_view_t view, crop;
+    fb_view(fb, &view);
+    // a parking slot sized region
+    view_crop(&view, 200, 120, 240, 240, &crop);
+    size_t len = 0;
+
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        uint8_t *copy = malloc(crop.width * crop.height * 2);
+        for (int y = 0; y < crop.height; y++) {
+            memcpy(copy + y * crop.width * 2, crop.buf + y * crop.stride, crop.width * 2);
+        }
+        fmt2jpg_cb(copy, crop.width * crop.height * 2, crop.width, crop.height, PIXFORMAT_RGB565, 12, null_write, &len);
+        free(copy);
+    }
+    int64_t copied = (esp_timer_get_time() - t) / times;
+
+    t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        view2jpg_cb(&crop, 12, null_write, &len);
+    }
+    int64_t direct = (esp_timer_get_time() - t) / times;
+    printf("240x240 crop of VGA RGB565 to JPEG: copy+encode %.3f ms (+%u B), view %.3f ms (+0 B)\n",
+           copied / 1000.0, crop.width * crop.height * 2, direct / 1000.0);
+    free_fb(fb);
+}
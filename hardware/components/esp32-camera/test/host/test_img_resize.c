@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "img_resize.h"
+
+static void fill_random(uint8_t *buf, size_t len, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() & 0xFF;
+    }
+}
+
+// smooth pattern that survives JPEG, channels offset so they differ
+static void fill_pattern(uint8_t *buf, uint16_t w, uint16_t h, int ch)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < ch; c++) {
+                buf[(y * w + x) * ch + c] = 128 + 100 * sinf((x + c * 17) * 0.031f) * cosf((y + c * 5) * 0.023f);
+            }
+        }
+    }
+}
+
+/*
+ * Float reference: separable weights computed in double straight from the
+ * filter definition, no tables, no rounding until the end.
+ */
+static int ref_weights(double *w, int *first, int src, int dst, int i, img_resize_filter_t filter)
+{
+    double s = (double)src / dst;
+    if (filter == IMG_RESIZE_BILINEAR) {
+        double c = (i + 0.5) * s - 0.5;
+        if (c < 0) {
+            c = 0;
+        }
+        *first = (int)c;
+        if (*first >= src - 1) {
+            *first = src - 1;
+            w[0] = 1;
+            return 1;
+        }
+        w[1] = c - *first;
+        w[0] = 1 - w[1];
+        return 2;
+    }
+    double b0 = i * s, b1 = (i + 1) * s;
+    *first = (int)floor(b0);
+    int n = 0;
+    for (int j = *first; j < src && j < b1; j++) {
+        w[n++] = (fmin(b1, j + 1) - fmax(b0, j)) / s;
+    }
+    return n;
+}
+
+static void ref_resize(const uint8_t *src, int sw, int sh, int ch, uint8_t *dst, int dw, int dh, img_resize_filter_t filter)
+{
+    double wx[64], wy[64];
+    int fx, fy;
+    for (int y = 0; y < dh; y++) {
+        int ny = ref_weights(wy, &fy, sh, dh, y, filter);
+        for (int x = 0; x < dw; x++) {
+            int nx = ref_weights(wx, &fx, sw, dw, x, filter);
+            for (int c = 0; c < ch; c++) {
+                double acc = 0;
+                for (int j = 0; j < ny; j++) {
+                    for (int i = 0; i < nx; i++) {
+                        acc += wy[j] * wx[i] * src[((fy + j) * sw + fx + i) * ch + c];
+                    }
+                }
+                dst[(y * dw + x) * ch + c] = (uint8_t)lround(acc);
+            }
+        }
+    }
+}
+
+static void check_against_ref(int sw, int sh, int dw, int dh, pixformat_t format, img_resize_filter_t filter)
+{
+    int ch = format == PIXFORMAT_GRAYSCALE ? 1 : 3;
+    uint8_t *src = malloc(sw * sh * ch);
+    uint8_t *out = malloc(dw * dh * ch);
+    uint8_t *ref = malloc(dw * dh * ch);
+    fill_random(src, sw * sh * ch, sw + dw);
+
+    img_resize_config_t config = {
+        .src_width = sw, .src_height = sh, .src_format = format,
+        .dst_width = dw, .dst_height = dh, .dst_format = format,
+        .filter = filter,
+    };
+    TEST_ASSERT_TRUE(img_resize(src, &config, out));
+    ref_resize(src, sw, sh, ch, ref, dw, dh, filter);
+
+    int max_err = 0;
+    for (int i = 0; i < dw * dh * ch; i++) {
+        int e = abs((int)out[i] - (int)ref[i]);
+        if (e > max_err) {
+            max_err = e;
+        }
+    }
+    free(src);
+    free(out);
+    free(ref);
+    TEST_ASSERT_LESS_OR_EQUAL(1, max_err);
+}
+
+TEST_CASE("Resize area filter matches float reference", "[img_resize]")
+{
+    check_against_ref(640, 48, 320, 24, PIXFORMAT_GRAYSCALE, IMG_RESIZE_AREA);
+    check_against_ref(160, 120, 64, 50, PIXFORMAT_RGB888, IMG_RESIZE_AREA);
+    check_against_ref(100, 75, 33, 17, PIXFORMAT_GRAYSCALE, IMG_RESIZE_AREA);
+    check_against_ref(40, 30, 97, 71, PIXFORMAT_RGB888, IMG_RESIZE_AREA);
+}
+
+TEST_CASE("Resize bilinear filter matches float reference", "[img_resize]")
+{
+    check_against_ref(640, 48, 320, 24, PIXFORMAT_RGB888, IMG_RESIZE_BILINEAR);
+    check_against_ref(100, 75, 33, 17, PIXFORMAT_GRAYSCALE, IMG_RESIZE_BILINEAR);
+    check_against_ref(32, 20, 80, 50, PIXFORMAT_RGB888, IMG_RESIZE_BILINEAR);
+}
+
+typedef struct {
+    uint16_t next_y;
+    uint16_t width;
+    uint8_t *dst;
+} line_sink_t;
+
+static bool sink_line(void *arg, uint16_t y, const uint8_t *line)
+{
+    line_sink_t *s = (line_sink_t *)arg;
+    TEST_ASSERT_EQUAL(s->next_y, y);
+    memcpy(s->dst + y * s->width * 3, line, s->width * 3);
+    s->next_y++;
+    return true;
+}
+
+TEST_CASE("Resize letterbox pads and streams lines in order", "[img_resize]")
+{
+    const uint16_t sw = 640, sh = 480, d = 320;
+    uint8_t *src = malloc(sw * sh * 2);
+    uint8_t *out = malloc(d * d * 3);
+    uint8_t *whole = malloc(d * d * 3);
+    fill_random(src, sw * sh * 2, 11);
+
+    img_resize_config_t config = {
+        .src_width = sw, .src_height = sh, .src_format = PIXFORMAT_RGB565,
+        .dst_width = d, .dst_height = d, .dst_format = PIXFORMAT_RGB888,
+        .filter = IMG_RESIZE_AREA, .letterbox = true, .pad_value = 114,
+    };
+    line_sink_t sink = { 0, d, out };
+    img_resize_handle_t r = img_resize_create(&config, sink_line, &sink);
+    TEST_ASSERT_NOT_NULL(r);
+    fmt_roi_t roi;
+    img_resize_get_content(r, &roi);
+    TEST_ASSERT_EQUAL(0, roi.x);
+    TEST_ASSERT_EQUAL(40, roi.y);
+    TEST_ASSERT_EQUAL(320, roi.width);
+    TEST_ASSERT_EQUAL(240, roi.height);
+    // uneven chunks, like MCU bands or DMA lines
+    for (uint16_t y = 0; y < sh;) {
+        uint16_t n = (y % 7) + 1;
+        if (y + n > sh) {
+            n = sh - y;
+        }
+        TEST_ASSERT_TRUE(img_resize_write(r, src + y * sw * 2, n));
+        y += n;
+    }
+    TEST_ASSERT_FALSE(img_resize_write(r, src, 1));
+    img_resize_delete(r);
+    TEST_ASSERT_EQUAL(d, sink.next_y);
+
+    for (int i = 0; i < d * roi.y * 3; i++) {
+        TEST_ASSERT_EQUAL(114, out[i]);
+        TEST_ASSERT_EQUAL(114, out[d * d * 3 - 1 - i]);
+    }
+    TEST_ASSERT_TRUE(img_resize(src, &config, whole));
+    TEST_ASSERT_EQUAL_MEMORY(whole, out, d * d * 3);
+
+    // the same picture without letterbox, converted first, must match the content rows
+    uint8_t *rgb = malloc(sw * sh * 3);
+    uint8_t *plain = malloc(320 * 240 * 3);
+    TEST_ASSERT_TRUE(fmt_convert(src, PIXFORMAT_RGB565, rgb, PIXFORMAT_RGB888, sw, sh, NULL));
+    img_resize_config_t plain_cfg = {
+        .src_width = sw, .src_height = sh, .src_format = PIXFORMAT_RGB888,
+        .dst_width = 320, .dst_height = 240, .dst_format = PIXFORMAT_RGB888,
+        .filter = IMG_RESIZE_AREA,
+    };
+    TEST_ASSERT_TRUE(img_resize(rgb, &plain_cfg, plain));
+    TEST_ASSERT_EQUAL_MEMORY(plain, out + roi.y * d * 3, 320 * 240 * 3);
+    free(rgb);
+    free(plain);
+    free(src);
+    free(out);
+    free(whole);
+}
+
+TEST_CASE("Resize rejects bad configuration", "[img_resize]")
+{
+    img_resize_config_t config = {
+        .src_width = 64, .src_height = 48, .src_format = PIXFORMAT_JPEG,
+        .dst_width = 32, .dst_height = 24, .dst_format = PIXFORMAT_RGB888,
+    };
+    uint8_t dst[32 * 24 * 3];
+    TEST_ASSERT_NULL(img_resize_create(&config, sink_line, NULL));
+    config.src_format = PIXFORMAT_GRAYSCALE;
+    config.dst_height = 0;
+    TEST_ASSERT_NULL(img_resize_create(&config, sink_line, NULL));
+    TEST_ASSERT_FALSE(jpg_resize(dst, sizeof(dst), &config, dst));
+}
+
+// fmt2jpg output is capped at 128KB, keep the quality camera-like
+static uint8_t *encode_pattern(uint16_t w, uint16_t h, size_t *len)
+{
+    uint8_t *rgb = malloc(w * h * 3);
+    uint8_t *jpg = NULL;
+    fill_pattern(rgb, w, h, 3);
+    TEST_ASSERT_TRUE(fmt2jpg(rgb, w * h * 3, w, h, PIXFORMAT_RGB888, 40, &jpg, len));
+    TEST_ASSERT_LESS_THAN(128 * 1024, *len);
+    free(rgb);
+    return jpg;
+}
+
+TEST_CASE("Resize JPEG decode scale plus resampler", "[img_resize]")
+{
+    const uint16_t sw = 640, sh = 480;
+    size_t jpg_len = 0;
+    uint8_t *jpg = encode_pattern(sw, sh, &jpg_len);
+    uint8_t *full = malloc(sw * sh * 3);
+    uint8_t *ref = malloc(320 * 320 * 3);
+    uint8_t *out = malloc(320 * 320 * 3);
+    TEST_ASSERT_TRUE(fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, full));
+
+    // 640 -> 300 lets the decoder halve first, the result must stay close to a full decode
+    img_resize_config_t config = {
+        .src_width = sw, .src_height = sh, .src_format = PIXFORMAT_RGB888,
+        .dst_width = 300, .dst_height = 300, .dst_format = PIXFORMAT_RGB888,
+        .filter = IMG_RESIZE_AREA, .letterbox = true, .pad_value = 114,
+    };
+    TEST_ASSERT_TRUE(img_resize(full, &config, ref));
+    TEST_ASSERT_TRUE(jpg_resize(jpg, jpg_len, &config, out));
+    long err = 0;
+    for (int i = 0; i < 300 * 300 * 3; i++) {
+        err += abs((int)ref[i] - (int)out[i]);
+    }
+    TEST_ASSERT_LESS_THAN(2, err / (300 * 300 * 3));
+
+    config.dst_format = PIXFORMAT_GRAYSCALE;
+    config.letterbox = false;
+    TEST_ASSERT_TRUE(jpg_resize(jpg, jpg_len, &config, out));
+    free(jpg);
+    free(full);
+    free(ref);
+    free(out);
+}
+
+static void bench_frame(const char *name, uint16_t sw, uint16_t sh, pixformat_t sf, uint16_t dw, uint16_t dh, bool letterbox,
+                        img_resize_filter_t filter)
+{
+    const int times = 10;
+    size_t slen = sw * sh * fmt_bytes_per_pixel(sf);
+    uint8_t *src = malloc(slen);
+    uint8_t *dst = malloc(dw * dh * 3);
+    fill_random(src, slen, 5);
+    img_resize_config_t config = {
+        .src_width = sw, .src_height = sh, .src_format = sf,
+        .dst_width = dw, .dst_height = dh, .dst_format = PIXFORMAT_RGB888,
+        .filter = filter, .letterbox = letterbox, .pad_value = 114,
+    };
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        img_resize(src, &config, dst);
+    }
+    t = (esp_timer_get_time() - t) / times;
+    printf("%-28s %-8s %7.2f ms %8.1f MP/s (source)\n", name, filter == IMG_RESIZE_AREA ? "area" : "bilinear",
+           t / 1000.0, (double)sw * sh / (t ? t : 1));
+    free(src);
+    free(dst);
+}
+
+TEST_CASE("Resize benchmark", "[img_resize][bench]")
+{
+    bench_frame("VGA RGB565 -> 320x240", 640, 480, PIXFORMAT_RGB565, 320, 240, false, IMG_RESIZE_AREA);
+    bench_frame("VGA RGB565 -> 320x240", 640, 480, PIXFORMAT_RGB565, 320, 240, false, IMG_RESIZE_BILINEAR);
+    bench_frame("VGA RGB565 -> 320x320 lb", 640, 480, PIXFORMAT_RGB565, 320, 320, true, IMG_RESIZE_AREA);
+    bench_frame("UXGA RGB565 -> 640x640 lb", 1600, 1200, PIXFORMAT_RGB565, 640, 640, true, IMG_RESIZE_AREA);
+    bench_frame("UXGA RGB565 -> 640x640 lb", 1600, 1200, PIXFORMAT_RGB565, 640, 640, true, IMG_RESIZE_BILINEAR);
+
+    const int times = 3;
+    size_t jpg_len = 0;
+    uint8_t *jpg = encode_pattern(1600, 1200, &jpg_len);
+    uint8_t *dst = malloc(640 * 640 * 3);
+    uint8_t *full = malloc(1600 * 1200 * 3);
+    img_resize_config_t config = {
+        .dst_width = 640, .dst_height = 640, .dst_format = PIXFORMAT_RGB888,
+        .filter = IMG_RESIZE_AREA, .letterbox = true, .pad_value = 114,
+    };
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        jpg_resize(jpg, jpg_len, &config, dst);
+    }
+    int64_t fused = (esp_timer_get_time() - t) / times;
+    t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, full);
+    }
+    int64_t decode = (esp_timer_get_time() - t) / times;
+    printf("UXGA JPEG -> 640x640 lb     fused %7.2f ms, full decode alone %7.2f ms (%zu KB less RAM)\n",
+           fused / 1000.0, decode / 1000.0, (size_t)1600 * 1200 * 3 / 1024);
+    free(jpg);
+    free(dst);
+    free(full);
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "host_heap.h"
+#include "img_converters.h"
+#include "img_resize.h"
+#include "img_tensor.h"
+
+static void fill_random(uint8_t *buf, size_t len, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() & 0xFF;
+    }
+}
+
+static void fill_pattern(uint8_t *buf, uint16_t w, uint16_t h)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                buf[(y * w + x) * 3 + c] = 128 + 100 * sinf((x + c * 17) * 0.031f) * cosf((y + c * 5) * 0.023f);
+            }
+        }
+    }
+}
+
+static img_tensor_config_t int8_config(uint16_t w, uint16_t h)
+{
+    img_tensor_config_t config = {
+        .width = w, .height = h, .channels = 3, .type = IMG_TENSOR_INT8,
+        .mean = {123.7f, 116.3f, 103.5f}, .std = {58.4f, 57.1f, 57.4f},
+        .scale = {0.0186f, 0.0175f, 0.0171f}, .zero_point = {-3, 2, 5},
+        .filter = IMG_RESIZE_AREA, .letterbox = true, .pad_value = 114,
+    };
+    return config;
+}
+
+TEST_CASE("Tensor int8 and float match resize then normalise", "[img_tensor]")
+{
+    const uint16_t sw = 160, sh = 120, d = 64;
+    uint8_t *src = malloc(sw * sh * 2);
+    uint8_t *rgb = malloc(d * d * 3);
+    int8_t *q = malloc(3 * d * d);
+    float *f = malloc(3 * d * d * sizeof(float));
+    fill_random(src, sw * sh * 2, 1);
+
+    img_tensor_config_t config = int8_config(d, d);
+    img_resize_config_t rc = {
+        .src_width = sw, .src_height = sh, .src_format = PIXFORMAT_RGB565,
+        .dst_width = d, .dst_height = d, .dst_format = PIXFORMAT_RGB888,
+        .filter = IMG_RESIZE_AREA, .letterbox = true, .pad_value = 114,
+    };
+    TEST_ASSERT_TRUE(img_resize(src, &rc, rgb));
+    fmt_roi_t content;
+    TEST_ASSERT_TRUE(img_to_tensor(src, sw, sh, PIXFORMAT_RGB565, &config, q, &content));
+    TEST_ASSERT_EQUAL(8, content.y);
+    TEST_ASSERT_EQUAL(48, content.height);
+    config.type = IMG_TENSOR_FLOAT;
+    TEST_ASSERT_TRUE(img_to_tensor(src, sw, sh, PIXFORMAT_RGB565, &config, f, NULL));
+
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < d * d; i++) {
+            // RGB888 buffers are B, G, R
+            float x = (rgb[i * 3 + 2 - c] - config.mean[c]) / config.std[c];
+            long e = lroundf(x / config.scale[c]) + config.zero_point[c];
+            e = e < -128 ? -128 : (e > 127 ? 127 : e);
+            TEST_ASSERT_EQUAL(e, q[c * d * d + i]);
+            TEST_ASSERT_FLOAT_WITHIN(1e-5, x, f[c * d * d + i]);
+        }
+    }
+    free(src);
+    free(rgb);
+    free(q);
+    free(f);
+}
+
+TEST_CASE("Tensor planes are R, G, B and padding is normalised", "[img_tensor]")
+{
+    const uint16_t sw = 40, sh = 20, d = 16;
+    uint8_t src[40 * 20 * 3];
+    float out[3 * 16 * 16];
+    for (int i = 0; i < sw * sh; i++) {
+        // pure red in the B, G, R layout
+        src[i * 3 + 0] = 0;
+        src[i * 3 + 1] = 0;
+        src[i * 3 + 2] = 255;
+    }
+    img_tensor_config_t config = {
+        .width = d, .height = d, .channels = 3, .type = IMG_TENSOR_FLOAT,
+        .mean = {0, 0, 0}, .std = {255, 255, 255},
+        .letterbox = true, .pad_value = 114,
+    };
+    fmt_roi_t content;
+    TEST_ASSERT_TRUE(img_to_tensor(src, sw, sh, PIXFORMAT_RGB888, &config, out, &content));
+    TEST_ASSERT_EQUAL(4, content.y);
+    TEST_ASSERT_EQUAL(8, content.height);
+    for (int c = 0; c < 3; c++) {
+        for (int y = 0; y < d; y++) {
+            for (int x = 0; x < d; x++) {
+                bool inside = y >= content.y && y < content.y + content.height;
+                float expect = inside ? (c == 0 ? 1.0f : 0.0f) : 114 / 255.0f;
+                TEST_ASSERT_FLOAT_WITHIN(1e-6, expect, out[(c * d + y) * d + x]);
+            }
+        }
+    }
+
+    // gray input into a single channel tensor
+    uint8_t gray[40 * 20];
+    int8_t luma[16 * 16];
+    memset(gray, 200, sizeof(gray));
+    img_tensor_config_t lc = {
+        .width = d, .height = d, .channels = 1, .type = IMG_TENSOR_INT8,
+        .mean = {128}, .std = {1}, .scale = {1}, .zero_point = {0},
+    };
+    TEST_ASSERT_TRUE(img_to_tensor(gray, sw, sh, PIXFORMAT_GRAYSCALE, &lc, luma, NULL));
+    for (int i = 0; i < d * d; i++) {
+        TEST_ASSERT_EQUAL(72, luma[i]);
+    }
+}
+
+TEST_CASE("Tensor rejects bad configuration", "[img_tensor]")
+{
+    int8_t out[16];
+    img_tensor_config_t config = int8_config(4, 4);
+    config.channels = 2;
+    TEST_ASSERT_NULL(img_tensor_create(&config, out));
+    config = int8_config(4, 4);
+    config.scale[1] = 0;
+    TEST_ASSERT_NULL(img_tensor_create(&config, out));
+    config = int8_config(4, 4);
+    img_tensor_handle_t t = img_tensor_create(&config, out);
+    TEST_ASSERT_NOT_NULL(t);
+    uint8_t line[4 * 3] = {0};
+    TEST_ASSERT_FALSE(img_tensor_write_line(t, 4, line));
+    img_tensor_delete(t);
+}
+
+TEST_CASE("Tensor from JPEG matches tensor from decoded frame", "[img_tensor]")
+{
+    const uint16_t sw = 640, sh = 480, d = 320;
+    uint8_t *rgb = malloc(sw * sh * 3);
+    uint8_t *jpg = NULL;
+    size_t jpg_len = 0;
+    fill_pattern(rgb, sw, sh);
+    TEST_ASSERT_TRUE(fmt2jpg(rgb, sw * sh * 3, sw, sh, PIXFORMAT_RGB888, 80, &jpg, &jpg_len));
+    TEST_ASSERT_TRUE(fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, rgb));
+
+    img_tensor_config_t config = int8_config(d, d);
+    int8_t *a = malloc(img_tensor_size(&config));
+    int8_t *b = malloc(img_tensor_size(&config));
+    fmt_roi_t ca, cb;
+    TEST_ASSERT_TRUE(img_to_tensor(rgb, sw, sh, PIXFORMAT_RGB888, &config, a, &ca));
+    TEST_ASSERT_TRUE(jpg_to_tensor(jpg, jpg_len, &config, b, &cb));
+    TEST_ASSERT_EQUAL_MEMORY(&ca, &cb, sizeof(fmt_roi_t));
+    long err = 0;
+    for (size_t i = 0; i < img_tensor_size(&config); i++) {
+        err += abs(a[i] - b[i]);
+    }
+    // the decoder halves the image itself, a few quantisation steps at most
+    TEST_ASSERT_LESS_THAN(3, err / (long)img_tensor_size(&config));
+    free(rgb);
+    free(jpg);
+    free(a);
+    free(b);
+}
+
+/*
+ * Naive chain for comparison: full RGB888 decode, full resize, normalise.
+ */
+static bool naive_jpg_to_tensor(const uint8_t *jpg, size_t len, uint16_t sw, uint16_t sh, const img_tensor_config_t *config, int8_t *out)
+{
+    uint8_t *full = malloc(sw * sh * 3);
+    uint8_t *small = malloc(config->width * config->height * 3);
+    img_resize_config_t rc = {
+        .src_width = sw, .src_height = sh, .src_format = PIXFORMAT_RGB888,
+        .dst_width = config->width, .dst_height = config->height, .dst_format = PIXFORMAT_RGB888,
+        .filter = config->filter, .letterbox = config->letterbox, .pad_value = config->pad_value,
+    };
+    bool ret = fmt2rgb888(jpg, len, PIXFORMAT_JPEG, full) && img_resize(full, &rc, small);
+    size_t plane = config->width * config->height;
+    for (size_t i = 0; ret && i < plane; i++) {
+        for (int c = 0; c < 3; c++) {
+            float x = (small[i * 3 + 2 - c] - config->mean[c]) / config->std[c];
+            long q = lroundf(x / config->scale[c]) + config->zero_point[c];
+            out[c * plane + i] = q < -128 ? -128 : (q > 127 ? 127 : q);
+        }
+    }
+    free(full);
+    free(small);
+    return ret;
+}
+
+static void bench_tensor(uint16_t sw, uint16_t sh, uint16_t d)
+{
+    const int times = 3;
+    uint8_t *rgb = malloc(sw * sh * 3);
+    uint8_t *jpg = NULL;
+    size_t jpg_len = 0;
+    fill_pattern(rgb, sw, sh);
+    fmt2jpg(rgb, sw * sh * 3, sw, sh, PIXFORMAT_RGB888, 40, &jpg, &jpg_len);
+    uint8_t *rgb565 = malloc(sw * sh * 2);
+    fmt_convert(rgb, PIXFORMAT_RGB888, rgb565, PIXFORMAT_RGB565, sw, sh, NULL);
+    free(rgb);
+
+    img_tensor_config_t config = int8_config(d, d);
+    int8_t *out = malloc(img_tensor_size(&config));
+
+    host_heap_reset_peak();
+    size_t base = host_heap_used();
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        img_to_tensor(rgb565, sw, sh, PIXFORMAT_RGB565, &config, out, NULL);
+    }
+    int64_t frame_t = (esp_timer_get_time() - t) / times;
+    size_t frame_ram = host_heap_peak() - base;
+
+    host_heap_reset_peak();
+    t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        jpg_to_tensor(jpg, jpg_len, &config, out, NULL);
+    }
+    int64_t jpg_t = (esp_timer_get_time() - t) / times;
+    size_t jpg_ram = host_heap_peak() - base;
+
+    host_heap_reset_peak();
+    t = esp_timer_get_time();
+    for (int i = 0; i < times; i++) {
+        naive_jpg_to_tensor(jpg, jpg_len, sw, sh, &config, out);
+    }
+    int64_t naive_t = (esp_timer_get_time() - t) / times;
+    size_t naive_ram = host_heap_peak() - base;
+
+    printf("%4ux%-4u -> %ux%u int8 (tensor %zu KB not counted)\n", sw, sh, d, d, img_tensor_size(&config) / 1024);
+    printf("  RGB565 frame   %7.2f ms %7.1f MP/s  peak scratch %7zu B\n", frame_t / 1000.0, (double)sw * sh / frame_t, frame_ram);
+    printf("  JPEG fused     %7.2f ms %7.1f MP/s  peak scratch %7zu B\n", jpg_t / 1000.0, (double)sw * sh / jpg_t, jpg_ram);
+    printf("  JPEG naive     %7.2f ms %7.1f MP/s  peak scratch %7zu B\n", naive_t / 1000.0, (double)sw * sh / naive_t, naive_ram);
+    free(jpg);
+    free(rgb565);
+    free(out);
+}
+
+TEST_CASE("Tensor packer benchmark", "[img_tensor][bench]")
+{
+    bench_tensor(640, 480, 320);
+    bench_tensor(1600, 1200, 640);
+}
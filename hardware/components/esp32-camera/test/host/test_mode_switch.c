@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "esp_timer.h"
+#include "sccb.h"
+#include "sccb_shadow.h"
+#include "sensor.h"
+#include "ov2640.h"
+#include "ov2640_regs.h"
+#include "i2c_host.h"
+#include "sensor_emu.h"
+#include "freertos/FreeRTOS.h"
+#include "cam_hal.h"
+#include "cam_sim.h"
+
+enum { ADDR = OV2640_SCCB_ADDR };
+
+typedef struct {
+    pixformat_t format;
+    framesize_t size;
+} switch_mode_t;
+
+// motion checks in low resolution, captures in high resolution, and back
+static const switch_mode_t modes[] = {
+    {PIXFORMAT_YUV422, FRAMESIZE_QVGA}, {PIXFORMAT_JPEG, FRAMESIZE_UXGA}, {PIXFORMAT_YUV422, FRAMESIZE_QVGA},
+    {PIXFORMAT_JPEG, FRAMESIZE_SVGA}, {PIXFORMAT_JPEG, FRAMESIZE_SVGA}, {PIXFORMAT_RGB565, FRAMESIZE_CIF},
+    {PIXFORMAT_JPEG, FRAMESIZE_VGA}, {PIXFORMAT_JPEG, FRAMESIZE_QVGA}, {PIXFORMAT_JPEG, FRAMESIZE_UXGA},
+};
+#define MODES (sizeof(modes) / sizeof(modes[0]))
+
+typedef enum { SWITCH_FULL_NO_SHADOW, SWITCH_FULL, SWITCH_DELTA } switch_kind_t;
+
+static bool all_volatile(uint8_t bank, uint16_t reg)
+{
+    return true;
+}
+
+// an OV2640 after esp_camera_init in VGA JPEG
+static void start_ov2640(sensor_t *sensor, switch_kind_t kind)
+{
+    i2c_host_reset();
+    TEST_ASSERT_TRUE(sensor_emu_add(CAMERA_OV2640));
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->slv_addr = SCCB_Probe();
+    sensor->xclk_freq_hz = 20000000;
+    TEST_ASSERT_EQUAL(OV2640_PID, ov2640_detect(sensor->slv_addr, &sensor->id));
+    ov2640_init(sensor);
+    if (kind == SWITCH_FULL_NO_SHADOW) {
+        sensor->shadow->is_volatile = all_volatile;
+    }
+    TEST_ASSERT_EQUAL(0, sensor->reset(sensor));
+    sensor->status.framesize = FRAMESIZE_VGA;
+    sensor->pixformat = PIXFORMAT_JPEG;
+    TEST_ASSERT_EQUAL(0, sensor->set_framesize(sensor, FRAMESIZE_VGA));
+    TEST_ASSERT_EQUAL(0, sensor->set_pixformat(sensor, PIXFORMAT_JPEG));
+    sensor->set_quality(sensor, 10);
+}
+
+// the sensor half of esp_camera_switch_mode, or of esp_camera_init without set_mode
+static void switch_sensor(sensor_t *sensor, switch_kind_t kind, const switch_mode_t *mode)
+{
+    if (kind == SWITCH_DELTA) {
+        TEST_ASSERT_EQUAL(0, sensor->set_mode(sensor, mode->format, mode->size));
+    } else {
+        sensor->pixformat = mode->format;
+        TEST_ASSERT_EQUAL(0, sensor->set_framesize(sensor, mode->size));
+        TEST_ASSERT_EQUAL(0, sensor->set_pixformat(sensor, mode->format));
+    }
+    TEST_ASSERT_EQUAL(mode->format, sensor->pixformat);
+    TEST_ASSERT_EQUAL(mode->size, sensor->status.framesize);
+}
+
+TEST_CASE("OV2640 mode switches leave the registers the full lists do", "[mode_switch]")
+{
+    sensor_t sensor;
+    static uint8_t expect[MODES][0x10000];
+    // every write of the lists goes out, COM7 reloads the window on the fake sensor
+    start_ov2640(&sensor, SWITCH_FULL_NO_SHADOW);
+    for (size_t i = 0; i < MODES; i++) {
+        switch_sensor(&sensor, SWITCH_FULL_NO_SHADOW, &modes[i]);
+        memcpy(expect[i], i2c_host_regs(ADDR), 0x10000);
+    }
+    sccb_shadow_delete(sensor.shadow);
+
+    for (switch_kind_t kind = SWITCH_FULL; kind <= SWITCH_DELTA; kind++) {
+        start_ov2640(&sensor, kind);
+        for (size_t i = 0; i < MODES; i++) {
+            switch_sensor(&sensor, kind, &modes[i]);
+            TEST_ASSERT_EQUAL(0, memcmp(expect[i], i2c_host_regs(ADDR), 0x10000));
+        }
+        sccb_shadow_delete(sensor.shadow);
+    }
+}
+
+TEST_CASE("OV2640 COM7 reloads the window the shadow then writes again", "[mode_switch]")
+{
+    static const uint8_t window[] = {COM1, REG32, HSTART, HSTOP, VSTART, VSTOP};
+    static const switch_mode_t cif = {PIXFORMAT_JPEG, FRAMESIZE_CIF}, svga = {PIXFORMAT_JPEG, FRAMESIZE_SVGA};
+    sensor_t sensor;
+    for (switch_kind_t kind = SWITCH_FULL; kind <= SWITCH_DELTA; kind++) {
+        start_ov2640(&sensor, kind);
+        for (int i = 0; i < 4; i++) {
+            switch_sensor(&sensor, kind, i & 1 ? &cif : &svga);
+            const uint8_t *regs = i2c_host_regs(ADDR);
+            // COM1 and HSTART are the same in both lists, the rest differ from the reloaded values
+            for (size_t r = 0; r < sizeof(window); r++) {
+                uint8_t value;
+                TEST_ASSERT_TRUE(sccb_shadow_get(sensor.shadow, BANK_SENSOR, window[r], &value));
+                TEST_ASSERT_EQUAL_HEX8(value, regs[(BANK_SENSOR << 8) | window[r]]);
+            }
+            TEST_ASSERT_EQUAL_HEX8(0x0A, regs[(BANK_SENSOR << 8) | COM1]);
+        }
+        sccb_shadow_delete(sensor.shadow);
+    }
+}
+
+TEST_CASE("OV2640 switch to the mode it is in touches nothing", "[mode_switch]")
+{
+    sensor_t sensor;
+    i2c_host_stats_t stats;
+    start_ov2640(&sensor, SWITCH_DELTA);
+    i2c_host_clear_stats();
+    int64_t t = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(0, sensor.set_mode(&sensor, PIXFORMAT_JPEG, FRAMESIZE_VGA));
+    t = esp_timer_get_time() - t;
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.transactions);
+    // no settle time either
+    TEST_ASSERT_TRUE(t < 5000);
+
+    // only the frame size changes: the window, no pixel format list
+    TEST_ASSERT_EQUAL(0, sensor.set_mode(&sensor, PIXFORMAT_JPEG, FRAMESIZE_QVGA));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_TRUE(stats.reg_writes < 20);
+    TEST_ASSERT_EQUAL(0, stats.reg_reads);
+    sccb_shadow_delete(sensor.shadow);
+}
+
+static cam_sim_config_t switch_config(pixformat_t from, framesize_t from_size, pixformat_t to, framesize_t to_size)
+{
+    cam_sim_config_t config = {
+        .format = from, .frame_size = from_size,
+        .fb_count = 2, .grab_mode = CAMERA_GRAB_LATEST,
+        .fps = 25, .jpeg_size = 20000, .jpeg_jitter = 3000, .frames = 40, .lockstep = true,
+        .switch_after = 10, .switch_format = to, .switch_size = to_size, .switch_us = 20000,
+    };
+    return config;
+}
+
+static void refuse_while_held(camera_fb_t *fb, void *arg)
+{
+    int *tries = arg;
+    if (!(*tries)++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cam_reconfig(PIXFORMAT_JPEG, FRAMESIZE_VGA, 20000000, 0));
+    }
+}
+
+TEST_CASE("cam_reconfig switches the capture without cam_deinit", "[mode_switch]")
+{
+    static const struct {
+        pixformat_t from;
+        framesize_t from_size;
+        pixformat_t to;
+        framesize_t to_size;
+    } switches[] = {
+        {PIXFORMAT_YUV422, FRAMESIZE_QQVGA, PIXFORMAT_JPEG, FRAMESIZE_VGA},
+        {PIXFORMAT_JPEG, FRAMESIZE_VGA, PIXFORMAT_YUV422, FRAMESIZE_QVGA},
+        {PIXFORMAT_YUV422, FRAMESIZE_QQVGA, PIXFORMAT_RGB565, FRAMESIZE_QVGA},
+        {PIXFORMAT_JPEG, FRAMESIZE_VGA, PIXFORMAT_JPEG, FRAMESIZE_UXGA},
+    };
+    cam_sim_stats_t stats;
+    char name[40];
+    for (size_t i = 0; i < sizeof(switches) / sizeof(switches[0]); i++) {
+        for (int psram = 0; psram < 2; psram++) {
+            cam_sim_config_t config = switch_config(switches[i].from, switches[i].from_size, switches[i].to, switches[i].to_size);
+            config.psram_mode = psram;
+            TEST_ESP_OK(cam_sim_run(&config, &stats));
+            snprintf(name, sizeof(name), "switch %d %s", (int)i, psram ? "psram" : "dram");
+            cam_sim_print(name, &stats);
+            TEST_ASSERT_EQUAL(0, stats.corrupt);
+            TEST_ASSERT_EQUAL(0, stats.switch_corrupt);
+            TEST_ASSERT_EQUAL(0, stats.reordered);
+            TEST_ASSERT_TRUE(stats.switch_gap_us > 0);
+            // the sensor is silent for switch_us, then every frame goes through again
+            TEST_ASSERT_TRUE(stats.delivered >= config.frames - 8);
+        }
+    }
+
+    // the application still holds a frame
+    int tries = 0;
+    cam_sim_config_t config = switch_config(PIXFORMAT_YUV422, FRAMESIZE_QQVGA, PIXFORMAT_JPEG, FRAMESIZE_VGA);
+    config.switch_after = 0;
+    config.frames = 5;
+    config.frame_cb = refuse_while_held;
+    config.cb_arg = &tries;
+    TEST_ESP_OK(cam_sim_run(&config, &stats));
+    TEST_ASSERT_EQUAL(5, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.corrupt);
+}
+
+/*
+ * Low resolution YUV for motion checks, switching to UXGA JPEG for a capture
+ * and back. The sensor switch is timed on the fake OV2640: bus time at the SCCB
+ * clock plus the settle stalls. The capture gap is the time between the last
+ * frame of the old mode and the first of the new one in the cam_hal simulator,
+ * with the sensor silent for as long as its switch takes.
+ */
+TEST_CASE("Mode switch latency benchmark", "[mode_switch][bench]")
+{
+    static const char *names[] = {"full lists, no shadow", "full lists, shadow", "register delta"};
+    static const switch_mode_t there = {PIXFORMAT_JPEG, FRAMESIZE_UXGA}, back = {PIXFORMAT_YUV422, FRAMESIZE_QVGA};
+    double switch_us[3];
+    sensor_t sensor;
+    i2c_host_stats_t stats;
+
+    printf("%-24s %8s %8s %13s %8s %10s %10s\n", "sensor switch", "writes", "reads", "transactions", "bus ms", "stalls ms", "total ms");
+    for (int kind = 0; kind < 3; kind++) {
+        start_ov2640(&sensor, kind);
+        switch_sensor(&sensor, kind, &back);
+        i2c_host_clear_stats();
+        int64_t t = esp_timer_get_time();
+        switch_sensor(&sensor, kind, &there);
+        switch_sensor(&sensor, kind, &back);
+        double wall = (esp_timer_get_time() - t) / 2.0;
+        i2c_host_get_stats(&stats);
+        double bus = i2c_host_bus_us(&stats, CONFIG_SCCB_CLK_FREQ) / 2;
+        switch_us[kind] = bus + wall;
+        printf("%-24s %8.1f %8.1f %13.1f %8.2f %10.2f %10.2f\n", names[kind], stats.reg_writes / 2.0, stats.reg_reads / 2.0,
+               stats.transactions / 2.0, bus / 1000, wall / 1000, switch_us[kind] / 1000);
+        sccb_shadow_delete(sensor.shadow);
+    }
+
+    // cam_hal without the sensor: cam_reconfig against cam_deinit, cam_init and cam_config
+    camera_config_t cc = {
+        .pin_pwdn = -1, .pin_reset = -1, .pin_xclk = -1, .pin_sccb_sda = -1, .pin_sccb_scl = -1, .pin_vsync = 1,
+        .xclk_freq_hz = 20000000, .pixel_format = PIXFORMAT_YUV422, .frame_size = FRAMESIZE_QVGA,
+        .fb_count = 2, .fb_location = CAMERA_FB_IN_PSRAM, .grab_mode = CAMERA_GRAB_LATEST,
+    };
+    enum { ROUNDS = 20 };
+    TEST_ESP_OK(cam_init(&cc));
+    TEST_ESP_OK(cam_config(&cc, cc.frame_size, 0));
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < ROUNDS; i++) {
+        TEST_ESP_OK(cam_reconfig(i & 1 ? PIXFORMAT_YUV422 : PIXFORMAT_JPEG, i & 1 ? FRAMESIZE_QVGA : FRAMESIZE_UXGA, cc.xclk_freq_hz, 0));
+    }
+    double reconfig_us = (double)(esp_timer_get_time() - t) / ROUNDS;
+    t = esp_timer_get_time();
+    for (int i = 0; i < ROUNDS; i++) {
+        cam_deinit();
+        cc.pixel_format = i & 1 ? PIXFORMAT_YUV422 : PIXFORMAT_JPEG;
+        cc.frame_size = i & 1 ? FRAMESIZE_QVGA : FRAMESIZE_UXGA;
+        TEST_ESP_OK(cam_init(&cc));
+        TEST_ESP_OK(cam_config(&cc, cc.frame_size, 0));
+    }
+    double reinit_us = (double)(esp_timer_get_time() - t) / ROUNDS;
+    cam_deinit();
+    printf("cam_hal on the host: cam_reconfig %.1f us, cam_deinit + cam_init + cam_config %.1f us\n", reconfig_us, reinit_us);
+
+    printf("%-24s %12s %12s %10s\n", "capture gap", "QVGA->UXGA", "UXGA->QVGA", "reconfig");
+    cam_sim_stats_t sim;
+    for (int kind = 0; kind < 3; kind++) {
+        double gap[2], reconfig = 0;
+        for (int dir = 0; dir < 2; dir++) {
+            const switch_mode_t *from = dir ? &there : &back, *to = dir ? &back : &there;
+            cam_sim_config_t config = switch_config(from->format, from->size, to->format, to->size);
+            config.jpeg_size = 60000;
+            config.jpeg_jitter = 5000;
+            config.fps = 15;
+            config.frames = 20;
+            config.switch_after = 5;
+            config.switch_us = switch_us[kind];
+            TEST_ESP_OK(cam_sim_run(&config, &sim));
+            TEST_ASSERT_EQUAL(0, sim.switch_corrupt);
+            gap[dir] = sim.switch_gap_us;
+            reconfig += sim.reconfig_us / 2;
+        }
+        printf("%-24s %9.2f ms %9.2f ms %7.1f us\n", names[kind], gap[0] / 1000, gap[1] / 1000, reconfig);
+    }
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "host_heap.h"
+#include "img_converters.h"
+#include "img_resize.h"
+
+static void fill_random(uint8_t *buf, size_t len, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() & 0xFF;
+    }
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t calls;
+} sink_t;
+
+static size_t sink_write(void *arg, size_t index, const void *data, size_t len)
+{
+    sink_t *s = (sink_t *)arg;
+    TEST_ASSERT_EQUAL(s->len, index);
+    s->buf = realloc(s->buf, index + len);
+    memcpy(s->buf + index, data, len);
+    s->len += len;
+    s->calls++;
+    return len;
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t line_len;
+    int lines;
+} lines_t;
+
+static bool lines_write(void *arg, uint16_t y, const uint8_t *line)
+{
+    lines_t *l = (lines_t *)arg;
+    TEST_ASSERT_EQUAL(l->lines, y);
+    memcpy(l->buf + y * l->line_len, line, l->line_len);
+    l->lines++;
+    return true;
+}
+
+TEST_CASE("QOI round trip is lossless for every raw format", "[qoi]")
+{
+    static const pixformat_t formats[] = {PIXFORMAT_RGB565, PIXFORMAT_RGB555, PIXFORMAT_RGB444,
+                                          PIXFORMAT_RGB888, PIXFORMAT_YUV422, PIXFORMAT_GRAYSCALE};
+    const uint16_t w = 70, h = 33;
+    uint8_t *src = malloc(w * h * 3);
+    uint8_t *expect = malloc(w * h * 3);
+    uint8_t *got = malloc(w * h * 3);
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        size_t len = w * h * fmt_bytes_per_pixel(formats[f]);
+        // random noise, then a flat band and a soft gradient so every op is used
+        fill_random(src, len, f);
+        memset(src + len / 3, 0x40, len / 6);
+        for (size_t i = len * 2 / 3; i < len; i++) {
+            src[i] = (i / 7) & 0xff;
+        }
+        uint8_t *qoi = NULL;
+        size_t qoi_len = 0;
+        TEST_ASSERT_TRUE(fmt2qoi(src, len, w, h, formats[f], &qoi, &qoi_len));
+        TEST_ASSERT_TRUE(fmt2rgb888(src, len, formats[f], expect));
+        TEST_ASSERT_TRUE(qoi2rgb888(qoi, qoi_len, got));
+        TEST_ASSERT_EQUAL_MEMORY(expect, got, w * h * 3);
+
+        // streaming output is the same bytes
+        sink_t s = {0};
+        TEST_ASSERT_TRUE(fmt2qoi_cb(src, len, w, h, formats[f], sink_write, &s));
+        TEST_ASSERT_EQUAL(qoi_len, s.len);
+        TEST_ASSERT_EQUAL_MEMORY(qoi, s.buf, qoi_len);
+        TEST_ASSERT_TRUE(s.calls > 1 || qoi_len <= 512);
+        free(s.buf);
+
+        // lines come back in the source format, the others have unused bits or subsampled chroma
+        if (formats[f] == PIXFORMAT_RGB565 || formats[f] == PIXFORMAT_RGB888) {
+            lines_t l = { got, w * fmt_bytes_per_pixel(formats[f]), 0 };
+            TEST_ASSERT_TRUE(qoi_decode_cb(qoi, qoi_len, formats[f], lines_write, &l));
+            TEST_ASSERT_EQUAL(h, l.lines);
+            TEST_ASSERT_EQUAL_MEMORY(src, got, len);
+        }
+        free(qoi);
+    }
+    free(src);
+    free(expect);
+    free(got);
+}
+
+TEST_CASE("QOI stream follows the specification", "[qoi]")
+{
+    // 2x2 RGB888 (B, G, R): red, red, red + small diff, red again from the index
+    uint8_t src[2 * 2 * 3] = {0, 0, 200,  0, 0, 200,  1, 0, 201,  0, 0, 200};
+    uint8_t *qoi = NULL;
+    size_t len = 0;
+    TEST_ASSERT_TRUE(fmt2qoi(src, sizeof(src), 2, 2, PIXFORMAT_RGB888, &qoi, &len));
+    static const uint8_t expect[] = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 2, 3, 0,
+        0xfe, 200, 0, 0,        // QOI_OP_RGB
+        0xc0,                   // QOI_OP_RUN of 1
+        0x40 | 3 << 4 | 2 << 2 | 3, // QOI_OP_DIFF +1, 0, +1
+        0x00 | ((200 * 3 + 255 * 11) % 64), // QOI_OP_INDEX
+        0, 0, 0, 0, 0, 0, 0, 1,
+    };
+    TEST_ASSERT_EQUAL(sizeof(expect), len);
+    TEST_ASSERT_EQUAL_MEMORY(expect, qoi, len);
+
+    uint16_t w, h;
+    TEST_ASSERT_TRUE(qoi_get_size(qoi, len, &w, &h));
+    TEST_ASSERT_EQUAL(2, w);
+    TEST_ASSERT_EQUAL(2, h);
+    qoi[0] = 'x';
+    TEST_ASSERT_FALSE(qoi_get_size(qoi, len, &w, &h));
+    free(qoi);
+
+    // a long flat image is runs of 62
+    uint8_t flat[200 * 3] = {0};
+    TEST_ASSERT_TRUE(fmt2qoi(flat, sizeof(flat), 200, 1, PIXFORMAT_RGB888, &qoi, &len));
+    TEST_ASSERT_EQUAL(14 + 4 + 8, len);
+    TEST_ASSERT_EQUAL(0xc0 | 61, qoi[14]);
+    TEST_ASSERT_EQUAL(0xc0 | 13, qoi[17]);
+    free(qoi);
+}
+
+TEST_CASE("QOI decoder reads alpha and rejects short data", "[qoi]")
+{
+    static const uint8_t rgba[] = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 1, 4, 0,
+        0xff, 10, 20, 30, 128,  // QOI_OP_RGBA
+        0x80 | 34, 0x88,        // QOI_OP_LUMA dg +2
+        0xfe, 1, 2, 3,          // QOI_OP_RGB
+        0, 0, 0, 0, 0, 0, 0, 1,
+    };
+    uint8_t out[3 * 3];
+    TEST_ASSERT_TRUE(qoi2rgb888(rgba, sizeof(rgba), out));
+    static const uint8_t expect[] = {30, 20, 10,  32, 22, 12,  3, 2, 1};
+    TEST_ASSERT_EQUAL_MEMORY(expect, out, sizeof(expect));
+    TEST_ASSERT_FALSE(qoi2rgb888(rgba, sizeof(rgba) - 4, out));
+}
+
+/*
+ * Camera-like frames for the benchmark: the parking lot dataset decoded to raw.
+ */
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len);
+    if (fread(buf, 1, *len, f) != *len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+static size_t null_write(void *arg, size_t index, const void *data, size_t len)
+{
+    *(size_t *)arg += len;
+    return len;
+}
+
+static void bench_format(const char *name, uint8_t **frames, int count, uint16_t w, uint16_t h, pixformat_t format)
+{
+    size_t len = w * h * fmt_bytes_per_pixel(format);
+    size_t qoi_size = 0, bmp_size = 0, jpg_size = 0;
+    int64_t qoi_t = 0, bmp_t = 0, jpg_t = 0;
+    size_t qoi_ram = 0, bmp_ram = 0, jpg_ram = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t *out = NULL;
+        size_t out_len = 0, base = host_heap_used();
+
+        host_heap_reset_peak();
+        int64_t t = esp_timer_get_time();
+        view2qoi_cb(&(image_view_t){frames[i], w, h, w * fmt_bytes_per_pixel(format), 1, format}, null_write, &qoi_size);
+        qoi_t += esp_timer_get_time() - t;
+        qoi_ram = host_heap_peak() - base;
+
+        host_heap_reset_peak();
+        t = esp_timer_get_time();
+        fmt2bmp(frames[i], len, w, h, format, &out, &out_len);
+        bmp_t += esp_timer_get_time() - t;
+        bmp_ram = host_heap_peak() - base;
+        bmp_size += out_len;
+        free(out);
+
+        host_heap_reset_peak();
+        t = esp_timer_get_time();
+        fmt2jpg_cb(frames[i], len, w, h, format, 90, null_write, &jpg_size);
+        jpg_t += esp_timer_get_time() - t;
+        jpg_ram = host_heap_peak() - base;
+    }
+    printf("%ux%u %s, %d dataset frames, raw %zu B\n", w, h, name, count, len);
+    printf("  QOI (lossless)  %7.2f ms  %7zu B  peak scratch %7zu B\n", qoi_t / 1000.0 / count, qoi_size / count, qoi_ram);
+    printf("  BMP (lossless)  %7.2f ms  %7zu B  peak scratch %7zu B\n", bmp_t / 1000.0 / count, bmp_size / count, bmp_ram);
+    printf("  JPEG q90        %7.2f ms  %7zu B  peak scratch %7zu B\n", jpg_t / 1000.0 / count, jpg_size / count, jpg_ram);
+}
+
+TEST_CASE("QOI against BMP and JPEG benchmark", "[qoi][bench]")
+{
+    const char *dir_name = DATASET_DIR "/test/images";
+    DIR *dir = opendir(dir_name);
+    if (!dir) {
+        printf("%s not found, skipping\n", dir_name);
+        return;
+    }
+    enum { MAX_FRAMES = 8 };
+    uint8_t *rgb565[MAX_FRAMES], *rgb888[MAX_FRAMES];
+    uint16_t w = 0, h = 0;
+    int count = 0;
+    struct dirent *e;
+    while (count < MAX_FRAMES && (e = readdir(dir))) {
+        if (!strstr(e->d_name, ".jpg")) {
+            continue;
+        }
+        char path[1024];
+        size_t jpg_len = 0;
+        snprintf(path, sizeof(path), "%s/%s", dir_name, e->d_name);
+        uint8_t *jpg = load_file(path, &jpg_len);
+        uint16_t fw, fh;
+        if (!jpg || !jpg_get_size(jpg, jpg_len, &fw, &fh) || (count && (fw != w || fh != h))) {
+            free(jpg);
+            continue;
+        }
+        w = fw;
+        h = fh;
+        rgb888[count] = malloc(w * h * 3);
+        rgb565[count] = malloc(w * h * 2);
+        TEST_ASSERT_TRUE(fmt2rgb888(jpg, jpg_len, PIXFORMAT_JPEG, rgb888[count]));
+        fmt_convert(rgb888[count], PIXFORMAT_RGB888, rgb565[count], PIXFORMAT_RGB565, w, h, NULL);
+        free(jpg);
+        count++;
+    }
+    closedir(dir);
+    if (!count) {
+        printf("no frames in %s, skipping\n", dir_name);
+        return;
+    }
+    bench_format("RGB565", rgb565, count, w, h, PIXFORMAT_RGB565);
+    bench_format("RGB888", rgb888, count, w, h, PIXFORMAT_RGB888);
+    for (int i = 0; i < count; i++) {
+        free(rgb565[i]);
+        free(rgb888[i]);
+    }
+}
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "sccb.h"
+#include "sensor.h"
+#include "ov5640.h"
+#include "ov5640_regs.h"
+#include "ov5640_settings.h"
+#include "i2c_host.h"
+
+enum { ADDR = 0x3C };
+
+// the loop the sensor drivers ran before: one transaction per register
+static int old_write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
+{
+    int ret = 0;
+    for (int i = 0; !ret && regs[i][0] != REGLIST_TAIL; i++) {
+        if (regs[i][0] != REG_DLY) {
+            ret = SCCB_Write16(slv_addr, regs[i][0], regs[i][1]);
+        }
+    }
+    return ret;
+}
+
+// register lists with runs of consecutive registers, rewrites and a few delays
+static void make_list(uint16_t (*regs)[2], int len, unsigned seed)
+{
+    srand(seed);
+    uint16_t reg = 0x3000;
+    for (int i = 0; i < len - 1; i++) {
+        int r = rand() % 100;
+        if (r < 2) {
+            regs[i][0] = REG_DLY;
+            regs[i][1] = 1;
+            continue;
+        }
+        if (r < 10) {
+            reg = 0x3000 + rand() % 0x3000;
+        } else if (r < 15) {
+            reg -= rand() % 4;
+        } else {
+            reg++;
+        }
+        regs[i][0] = reg;
+        regs[i][1] = rand() & 0xff;
+    }
+    regs[len - 1][0] = REGLIST_TAIL;
+}
+
+static uint8_t *snapshot(uint8_t addr)
+{
+    uint8_t *copy = malloc(0x10000);
+    memcpy(copy, i2c_host_regs(addr), 0x10000);
+    return copy;
+}
+
+TEST_CASE("Batched writes leave the registers single writes do", "[sccb]")
+{
+    enum { LEN = 600 };
+    static uint16_t regs[LEN][2];
+    static const struct {
+        uint8_t reg_bytes;
+        uint8_t burst;
+        bool chain;
+    } modes[] = {
+        {1, 1, false}, {1, 1, true}, {1, 8, false}, {1, UINT8_MAX, true},
+        {2, 1, false}, {2, 1, true}, {2, 8, true}, {2, UINT8_MAX, false}, {2, UINT8_MAX, true},
+    };
+    i2c_host_stats_t stats;
+    for (int seed = 0; seed < 4; seed++) {
+        make_list(regs, LEN, seed);
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            int writes = 0;
+            i2c_host_reset();
+            i2c_host_add_device(ADDR, modes[m].reg_bytes, true);
+            for (int i = 0; regs[i][0] != REGLIST_TAIL; i++) {
+                if (regs[i][0] != REG_DLY) {
+                    uint16_t reg = modes[m].reg_bytes == 2 ? regs[i][0] : regs[i][0] & 0xff;
+                    int ret = modes[m].reg_bytes == 2 ? SCCB_Write16(ADDR, reg, regs[i][1]) : SCCB_Write(ADDR, reg, regs[i][1]);
+                    TEST_ASSERT_EQUAL(0, ret);
+                    writes++;
+                }
+            }
+            uint8_t *expect = snapshot(ADDR);
+
+            i2c_host_reset();
+            i2c_host_add_device(ADDR, modes[m].reg_bytes, true);
+            sccb_batch_t batch;
+            sccb_batch_mode_t mode = { .burst = modes[m].burst, .chain = modes[m].chain };
+            SCCB_Batch_Init(&batch, ADDR, modes[m].reg_bytes, &mode);
+            for (int i = 0; regs[i][0] != REGLIST_TAIL; i++) {
+                if (regs[i][0] == REG_DLY) {
+                    TEST_ASSERT_EQUAL(0, SCCB_Batch_Delay(&batch, regs[i][1]));
+                } else {
+                    uint16_t reg = modes[m].reg_bytes == 2 ? regs[i][0] : regs[i][0] & 0xff;
+                    TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, reg, regs[i][1]));
+                }
+            }
+            TEST_ASSERT_EQUAL(0, SCCB_Batch_Flush(&batch));
+            i2c_host_get_stats(&stats);
+            TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+            TEST_ASSERT_EQUAL(writes, stats.reg_writes);
+            TEST_ASSERT_EQUAL(0, stats.nacks);
+            if (modes[m].burst == 1 && !modes[m].chain) {
+                TEST_ASSERT_EQUAL(writes, stats.transactions);
+            } else {
+                TEST_ASSERT_TRUE(stats.transactions < writes / 2);
+            }
+            free(expect);
+        }
+    }
+}
+
+// the list through a batch, with the flushes of its delays
+static void batch_write_regs(sccb_batch_mode_t *mode, const uint16_t (*regs)[2])
+{
+    sccb_batch_t batch;
+    SCCB_Batch_Init(&batch, ADDR, 2, mode);
+    for (int i = 0; regs[i][0] != REGLIST_TAIL; i++) {
+        if (regs[i][0] == REG_DLY) {
+            TEST_ASSERT_EQUAL(0, SCCB_Batch_Delay(&batch, regs[i][1]));
+        } else {
+            TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, regs[i][0], regs[i][1]));
+        }
+    }
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Flush(&batch));
+}
+
+TEST_CASE("A sensor without auto-increment falls back to single writes", "[sccb]")
+{
+    enum { LEN = 200 };
+    static uint16_t regs[LEN][2];
+    make_list(regs, LEN, 7);
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 2, false);
+    TEST_ASSERT_EQUAL(0, old_write_regs(ADDR, regs));
+    i2c_host_stats_t single;
+    i2c_host_get_stats(&single);
+    uint8_t *expect = snapshot(ADDR);
+
+    i2c_host_stats_t stats;
+    for (int chain = 0; chain < 2; chain++) {
+        i2c_host_reset();
+        i2c_host_add_device(ADDR, 2, false);
+        sccb_batch_mode_t mode = { .burst = UINT8_MAX, .chain = chain };
+        batch_write_regs(&mode, regs);
+        i2c_host_get_stats(&stats);
+        // only the first burst is refused, the rest of the list goes out one register at a time
+        TEST_ASSERT_EQUAL(1, stats.nacks);
+        TEST_ASSERT_EQUAL(1, mode.burst);
+        TEST_ASSERT_FALSE(mode.chain);
+        TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+        if (!chain) {
+            // the runs sent before it are not sent again, the refused one took its first value
+            TEST_ASSERT_EQUAL(single.reg_writes + 1, stats.reg_writes);
+        }
+
+        // the next list of the sensor goes out one register at a time from the start
+        i2c_host_clear_stats();
+        batch_write_regs(&mode, regs);
+        i2c_host_get_stats(&stats);
+        TEST_ASSERT_EQUAL(0, stats.nacks);
+        TEST_ASSERT_EQUAL(single.reg_writes, stats.transactions);
+    }
+
+    // nothing on the bus fails the batch
+    i2c_host_reset();
+    sccb_batch_t batch;
+    sccb_batch_mode_t mode = { .burst = UINT8_MAX, .chain = true };
+    SCCB_Batch_Init(&batch, ADDR, 2, &mode);
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, 0x3000, 1));
+    TEST_ASSERT_TRUE(SCCB_Batch_Flush(&batch) != 0);
+    free(expect);
+}
+
+TEST_CASE("OV5640 reset loads the default registers in batches", "[sccb]")
+{
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 2, true);
+    TEST_ASSERT_EQUAL(0, SCCB_Write16(ADDR, SYSTEM_CTROL0, 0x82));
+    TEST_ASSERT_EQUAL(0, old_write_regs(ADDR, sensor_default_regs));
+    i2c_host_stats_t old_stats, stats;
+    i2c_host_get_stats(&old_stats);
+    uint8_t *expect = snapshot(ADDR);
+
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 2, true);
+    sensor_t sensor = {.slv_addr = ADDR, .xclk_freq_hz = 20000000};
+    ov5640_init(&sensor);
+    TEST_ASSERT_EQUAL(0, sensor.reset(&sensor));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+    TEST_ASSERT_EQUAL(old_stats.reg_writes, stats.reg_writes);
+    printf("reset: %u registers, %u transactions before, %u now\n",
+           (unsigned)stats.reg_writes, (unsigned)old_stats.transactions, (unsigned)stats.transactions);
+    TEST_ASSERT_TRUE(stats.transactions * 4 < old_stats.transactions);
+    free(expect);
+}
+
+/*
+ * Bus traffic of bringing up an OV5640 and switching frame sizes, the way
+ * esp_camera_init and set_framesize do it. Before the batches every register
+ * written was a transaction and every register read two.
+ */
+TEST_CASE("SCCB transactions of sensor setup benchmark", "[sccb][bench]")
+{
+    static const framesize_t sizes[] = {FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_UXGA, FRAMESIZE_QSXGA};
+    i2c_host_stats_t stats;
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 2, true);
+    sensor_t sensor = {.slv_addr = ADDR, .xclk_freq_hz = 20000000};
+    ov5640_init(&sensor);
+    printf("%-20s %9s %9s %14s %12s %12s %12s\n", "step", "writes", "reads", "old transact.", "transact.", "old bus ms", "bus ms");
+    for (int step = -2; step < (int)(sizeof(sizes) / sizeof(sizes[0])); step++) {
+        i2c_host_clear_stats();
+        const char *name;
+        char buf[32];
+        if (step == -2) {
+            name = "reset";
+            TEST_ASSERT_EQUAL(0, sensor.reset(&sensor));
+        } else if (step == -1) {
+            name = "set_pixformat";
+            sensor.pixformat = PIXFORMAT_JPEG;
+            TEST_ASSERT_EQUAL(0, sensor.set_pixformat(&sensor, PIXFORMAT_JPEG));
+        } else {
+            snprintf(buf, sizeof(buf), "framesize %ux%u", resolution[sizes[step]].width, resolution[sizes[step]].height);
+            name = buf;
+            TEST_ASSERT_EQUAL(0, sensor.set_framesize(&sensor, sizes[step]));
+        }
+        i2c_host_get_stats(&stats);
+        // one 4 byte transaction per write, a 3 byte and a 2 byte one per read
+        i2c_host_stats_t old = {
+            .transactions = stats.reg_writes + 2 * stats.reg_reads,
+            .starts = stats.reg_writes + 2 * stats.reg_reads,
+            .bytes = 4 * stats.reg_writes + 5 * stats.reg_reads,
+        };
+        printf("%-20s %9u %9u %14u %12u %12.2f %12.2f\n", name, (unsigned)stats.reg_writes, (unsigned)stats.reg_reads,
+               (unsigned)old.transactions, (unsigned)stats.transactions,
+               i2c_host_bus_us(&old, CONFIG_SCCB_CLK_FREQ) / 1000, i2c_host_bus_us(&stats, CONFIG_SCCB_CLK_FREQ) / 1000);
+    }
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "sccb.h"
+#include "sensor.h"
+#include "ov5640.h"
+#include "ov5640_regs.h"
+#include "ov5640_settings.h"
+#include "i2c_host.h"
+
+/*
+ * The batches on sccb-ng.c, the driver of IDF 5.4 and later. The master driver
+ * has no repeated START between writes, so every run is a transmit of its own
+ * whether the batch asks for a chain or not.
+ */
+
+enum { ADDR = 0x3C };
+
+// the bus of esp_camera_init with the sensor SCCB_Probe would have installed
+static void bus_start(uint8_t reg_bytes, bool auto_increment)
+{
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, reg_bytes, auto_increment);
+    TEST_ESP_OK(SCCB_Init(26, 27));
+    TEST_ASSERT_EQUAL(0, SCCB_Install_Device(ADDR));
+    i2c_host_clear_stats();
+}
+
+static void bus_end(void)
+{
+    TEST_ESP_OK(SCCB_Deinit());
+}
+
+// the loop the sensor drivers ran before: one transaction per register
+static int old_write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
+{
+    int ret = 0;
+    for (int i = 0; !ret && regs[i][0] != REGLIST_TAIL; i++) {
+        if (regs[i][0] != REG_DLY) {
+            ret = SCCB_Write16(slv_addr, regs[i][0], regs[i][1]);
+        }
+    }
+    return ret;
+}
+
+// register lists with runs of consecutive registers, rewrites and a few delays
+static void make_list(uint16_t (*regs)[2], int len, unsigned seed)
+{
+    srand(seed);
+    uint16_t reg = 0x3000;
+    for (int i = 0; i < len - 1; i++) {
+        int r = rand() % 100;
+        if (r < 2) {
+            regs[i][0] = REG_DLY;
+            regs[i][1] = 1;
+            continue;
+        }
+        if (r < 10) {
+            reg = 0x3000 + rand() % 0x3000;
+        } else if (r < 15) {
+            reg -= rand() % 4;
+        } else {
+            reg++;
+        }
+        regs[i][0] = reg;
+        regs[i][1] = rand() & 0xff;
+    }
+    regs[len - 1][0] = REGLIST_TAIL;
+}
+
+static uint8_t *snapshot(uint8_t addr)
+{
+    uint8_t *copy = malloc(0x10000);
+    memcpy(copy, i2c_host_regs(addr), 0x10000);
+    return copy;
+}
+
+// the list through a batch, with the flushes of its delays
+static void batch_write_regs(sccb_batch_mode_t *mode, uint8_t reg_bytes, const uint16_t (*regs)[2])
+{
+    sccb_batch_t batch;
+    SCCB_Batch_Init(&batch, ADDR, reg_bytes, mode);
+    for (int i = 0; regs[i][0] != REGLIST_TAIL; i++) {
+        if (regs[i][0] == REG_DLY) {
+            TEST_ASSERT_EQUAL(0, SCCB_Batch_Delay(&batch, regs[i][1]));
+        } else {
+            uint16_t reg = reg_bytes == 2 ? regs[i][0] : regs[i][0] & 0xff;
+            TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, reg, regs[i][1]));
+        }
+    }
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Flush(&batch));
+}
+
+TEST_CASE("sccb-ng batched writes leave the registers single writes do", "[sccb]")
+{
+    enum { LEN = 600 };
+    static uint16_t regs[LEN][2];
+    static const struct {
+        uint8_t reg_bytes;
+        uint8_t burst;
+    } modes[] = {
+        {1, 1}, {1, 8}, {1, UINT8_MAX}, {2, 1}, {2, 8}, {2, UINT8_MAX},
+    };
+    i2c_host_stats_t stats;
+    for (int seed = 0; seed < 4; seed++) {
+        make_list(regs, LEN, seed);
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            uint8_t reg_bytes = modes[m].reg_bytes;
+            int writes = 0;
+            bus_start(reg_bytes, true);
+            for (int i = 0; regs[i][0] != REGLIST_TAIL; i++) {
+                if (regs[i][0] != REG_DLY) {
+                    uint16_t reg = reg_bytes == 2 ? regs[i][0] : regs[i][0] & 0xff;
+                    int ret = reg_bytes == 2 ? SCCB_Write16(ADDR, reg, regs[i][1]) : SCCB_Write(ADDR, reg, regs[i][1]);
+                    TEST_ASSERT_EQUAL(0, ret);
+                    writes++;
+                }
+            }
+            uint8_t *expect = snapshot(ADDR);
+            bus_end();
+
+            uint32_t transactions[2];
+            for (int chain = 0; chain < 2; chain++) {
+                bus_start(reg_bytes, true);
+                sccb_batch_mode_t mode = { .burst = modes[m].burst, .chain = chain };
+                batch_write_regs(&mode, reg_bytes, regs);
+                i2c_host_get_stats(&stats);
+                TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+                TEST_ASSERT_EQUAL(writes, stats.reg_writes);
+                TEST_ASSERT_EQUAL(0, stats.nacks);
+                // every transmit starts once, there is no repeated START to chain runs with
+                TEST_ASSERT_EQUAL(stats.transactions, stats.starts);
+                TEST_ASSERT_EQUAL(modes[m].burst, mode.burst);
+                transactions[chain] = stats.transactions;
+                bus_end();
+            }
+            // asking for a chain sends the same runs
+            TEST_ASSERT_EQUAL(transactions[0], transactions[1]);
+            if (modes[m].burst == 1) {
+                TEST_ASSERT_EQUAL(writes, transactions[0]);
+            } else {
+                TEST_ASSERT_TRUE(transactions[0] < writes / 2);
+            }
+            free(expect);
+        }
+    }
+}
+
+TEST_CASE("sccb-ng falls back to single writes on a sensor without auto-increment", "[sccb]")
+{
+    enum { LEN = 200 };
+    static uint16_t regs[LEN][2];
+    make_list(regs, LEN, 7);
+    bus_start(2, false);
+    TEST_ASSERT_EQUAL(0, old_write_regs(ADDR, regs));
+    i2c_host_stats_t single;
+    i2c_host_get_stats(&single);
+    uint8_t *expect = snapshot(ADDR);
+    bus_end();
+
+    i2c_host_stats_t stats;
+    bus_start(2, false);
+    sccb_batch_mode_t mode = { .burst = UINT8_MAX, .chain = true };
+    batch_write_regs(&mode, 2, regs);
+    i2c_host_get_stats(&stats);
+    // only the first run of more than one register is refused, the ones before it are not sent again
+    TEST_ASSERT_EQUAL(1, stats.nacks);
+    TEST_ASSERT_EQUAL(1, mode.burst);
+    TEST_ASSERT_FALSE(mode.chain);
+    TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+    TEST_ASSERT_EQUAL(single.reg_writes + 1, stats.reg_writes);
+
+    // the next list of the sensor goes out one register at a time from the start
+    i2c_host_clear_stats();
+    batch_write_regs(&mode, 2, regs);
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.nacks);
+    TEST_ASSERT_EQUAL(single.reg_writes, stats.transactions);
+    bus_end();
+    free(expect);
+}
+
+TEST_CASE("sccb-ng batches to a device that was not installed fail", "[sccb]")
+{
+    static const uint8_t runs[] = {2, 0x30, 0x00, 0x11, 0x22};
+    i2c_host_stats_t stats;
+    // on the bus, but SCCB_Probe never installed it
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 2, true);
+    TEST_ESP_OK(SCCB_Init(26, 27));
+    i2c_host_clear_stats();
+
+    size_t sent = sizeof(runs);
+    TEST_ASSERT_EQUAL(-1, SCCB_Write_Runs(ADDR, 2, false, runs, sizeof(runs), &sent));
+    TEST_ASSERT_EQUAL(0, sent);
+
+    sccb_batch_t batch;
+    sccb_batch_mode_t mode = { .burst = UINT8_MAX, .chain = false };
+    SCCB_Batch_Init(&batch, ADDR, 2, &mode);
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, 0x3000, 1));
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, 0x3001, 2));
+    TEST_ASSERT_TRUE(SCCB_Batch_Flush(&batch) != 0);
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.transactions);
+    TEST_ASSERT_EQUAL(0, i2c_host_regs(ADDR)[0x3000]);
+    bus_end();
+}
+
+TEST_CASE("sccb-ng OV5640 reset loads the default registers in batches", "[sccb]")
+{
+    bus_start(2, true);
+    TEST_ASSERT_EQUAL(0, SCCB_Write16(ADDR, SYSTEM_CTROL0, 0x82));
+    TEST_ASSERT_EQUAL(0, old_write_regs(ADDR, sensor_default_regs));
+    i2c_host_stats_t old_stats, stats;
+    i2c_host_get_stats(&old_stats);
+    uint8_t *expect = snapshot(ADDR);
+    bus_end();
+
+    bus_start(2, true);
+    sensor_t sensor = {.slv_addr = ADDR, .xclk_freq_hz = 20000000};
+    ov5640_init(&sensor);
+    TEST_ASSERT_EQUAL(0, sensor.reset(&sensor));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+    TEST_ASSERT_EQUAL(old_stats.reg_writes, stats.reg_writes);
+    printf("reset: %u registers, %u transactions before, %u now\n",
+           (unsigned)stats.reg_writes, (unsigned)old_stats.transactions, (unsigned)stats.transactions);
+    // a transaction per run of consecutive registers, the chains of sccb.c save more
+    TEST_ASSERT_TRUE(stats.transactions * 3 < old_stats.transactions);
+    bus_end();
+    free(expect);
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "sccb.h"
+#include "sccb_shadow.h"
+#include "sensor.h"
+#include "ov2640.h"
+#include "ov2640_regs.h"
+#include "i2c_host.h"
+
+enum { ADDR = OV2640_SCCB_ADDR };
+
+// a shadow that keeps nothing: the drivers behave like before it
+static bool all_volatile(uint8_t bank, uint16_t reg)
+{
+    return true;
+}
+
+static void fake_ov2640(void)
+{
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 1, false);
+    i2c_host_set_bank_reg(ADDR, BANK_SEL);
+    i2c_host_regs(ADDR)[(BANK_SENSOR << 8) | REG_PID] = OV2640_PID;
+}
+
+static void start_ov2640(sensor_t *sensor, bool shadowed)
+{
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->slv_addr = SCCB_Probe();
+    TEST_ASSERT_EQUAL(ADDR, sensor->slv_addr);
+    sensor->xclk_freq_hz = 10000000;
+    TEST_ASSERT_EQUAL(OV2640_PID, ov2640_detect(sensor->slv_addr, &sensor->id));
+    ov2640_init(sensor);
+    TEST_ASSERT_NOT_NULL(sensor->shadow);
+    if (!shadowed) {
+        sensor->shadow->is_volatile = all_volatile;
+    }
+}
+
+// what esp_camera_init does for an OV2640 after the probe, then init_camera in src/Cam.c
+static void init_camera_settings(sensor_t *s)
+{
+    TEST_ASSERT_EQUAL(0, s->reset(s));
+    s->status.framesize = FRAMESIZE_VGA;
+    s->pixformat = PIXFORMAT_JPEG;
+    TEST_ASSERT_EQUAL(0, s->set_framesize(s, FRAMESIZE_VGA));
+    s->set_pixformat(s, PIXFORMAT_JPEG);
+    s->set_gainceiling(s, GAINCEILING_2X);
+    s->set_bpc(s, false);
+    s->set_wpc(s, true);
+    s->set_lenc(s, true);
+    s->set_quality(s, 10);
+    s->init_status(s);
+
+    s->set_brightness(s, 1);
+    s->set_saturation(s, -3);
+    s->set_gain_ctrl(s, 0);
+    s->set_exposure_ctrl(s, 0);
+    s->set_whitebal(s, 0);
+    s->set_awb_gain(s, 1);
+    s->set_wb_mode(s, 0);
+    s->set_contrast(s, 2);
+}
+
+TEST_CASE("OV2640 ends up with the same registers with and without the shadow", "[sccb_shadow]")
+{
+    sensor_t sensor;
+    fake_ov2640();
+    start_ov2640(&sensor, false);
+    init_camera_settings(&sensor);
+    uint8_t *expect = malloc(0x10000);
+    memcpy(expect, i2c_host_regs(ADDR), 0x10000);
+    sccb_shadow_delete(sensor.shadow);
+
+    fake_ov2640();
+    start_ov2640(&sensor, true);
+    init_camera_settings(&sensor);
+    TEST_ASSERT_EQUAL(0, memcmp(expect, i2c_host_regs(ADDR), 0x10000));
+    TEST_ASSERT_TRUE(sensor.shadow->hits > 0);
+    sccb_shadow_delete(sensor.shadow);
+    free(expect);
+}
+
+TEST_CASE("Field updates need no reads and unchanged values no writes", "[sccb_shadow]")
+{
+    sensor_t sensor;
+    i2c_host_stats_t stats;
+    fake_ov2640();
+    start_ov2640(&sensor, true);
+    init_camera_settings(&sensor);
+
+    // every CTRL0 to CTRL3 field was read once by init_status, flip four of them
+    camera_status_t status = sensor.status;
+    i2c_host_clear_stats();
+    TEST_ASSERT_EQUAL(0, sensor.set_raw_gma(&sensor, !status.raw_gma));
+    TEST_ASSERT_EQUAL(0, sensor.set_dcw(&sensor, !status.dcw));
+    TEST_ASSERT_EQUAL(0, sensor.set_bpc(&sensor, !status.bpc));
+    TEST_ASSERT_EQUAL(0, sensor.set_awb_gain(&sensor, !status.awb_gain));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.reg_reads);
+    TEST_ASSERT_EQUAL(4, stats.reg_writes);
+    sensor.init_status(&sensor);
+    TEST_ASSERT_EQUAL(!status.raw_gma, sensor.status.raw_gma);
+    TEST_ASSERT_EQUAL(!status.bpc, sensor.status.bpc);
+
+    // the same values again: no writes, and no bank switches for them either
+    i2c_host_clear_stats();
+    TEST_ASSERT_EQUAL(0, sensor.set_raw_gma(&sensor, !status.raw_gma));
+    TEST_ASSERT_EQUAL(0, sensor.set_bpc(&sensor, !status.bpc));
+    TEST_ASSERT_EQUAL(0, sensor.set_gain_ctrl(&sensor, 0));
+    TEST_ASSERT_EQUAL(0, sensor.set_gainceiling(&sensor, GAINCEILING_2X));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.reg_reads);
+    TEST_ASSERT_EQUAL(0, stats.transactions);
+
+    // registers the AEC and AGC change always come from the sensor
+    i2c_host_regs(ADDR)[(BANK_SENSOR << 8) | GAIN] = 0x21;
+    TEST_ASSERT_EQUAL(0x21, sensor.get_reg(&sensor, (BANK_SENSOR << 8) | GAIN, 0xff));
+    sccb_shadow_delete(sensor.shadow);
+}
+
+TEST_CASE("Verify mode reports registers changed behind the shadow", "[sccb_shadow]")
+{
+    sensor_t sensor;
+    fake_ov2640();
+    start_ov2640(&sensor, true);
+    init_camera_settings(&sensor);
+    sensor.shadow->verify = true;
+
+    // in step: the hardware is read, nothing is reported
+    TEST_ASSERT_EQUAL(0, sensor.set_lenc(&sensor, 1));
+    TEST_ASSERT_EQUAL(0, sensor.shadow->mismatches);
+
+    // the sensor lost the lens correction bit, the shadow still has it
+    i2c_host_regs(ADDR)[(BANK_DSP << 8) | CTRL1] &= ~0x02;
+    TEST_ASSERT_EQUAL(0, sensor.set_lenc(&sensor, 1));
+    TEST_ASSERT_EQUAL(1, sensor.shadow->mismatches);
+    TEST_ASSERT_EQUAL(0x02, i2c_host_regs(ADDR)[(BANK_DSP << 8) | CTRL1] & 0x02);
+
+    // a read reports it too and returns what the sensor has
+    i2c_host_regs(ADDR)[(BANK_DSP << 8) | QS] = 33;
+    TEST_ASSERT_EQUAL(33, sensor.get_reg(&sensor, (BANK_DSP << 8) | QS, 0xff));
+    TEST_ASSERT_EQUAL(2, sensor.shadow->mismatches);
+    sccb_shadow_delete(sensor.shadow);
+}
+
+TEST_CASE("SCCB transactions of init_camera benchmark", "[sccb_shadow][bench]")
+{
+    sensor_t sensor;
+    i2c_host_stats_t stats[2];
+    for (int shadowed = 0; shadowed < 2; shadowed++) {
+        fake_ov2640();
+        start_ov2640(&sensor, shadowed);
+        init_camera_settings(&sensor);
+        // and a second round of the settings, like a reconfiguration at run time
+        i2c_host_clear_stats();
+        init_camera_settings(&sensor);
+        sensor.init_status(&sensor);
+        i2c_host_get_stats(&stats[shadowed]);
+        sccb_shadow_delete(sensor.shadow);
+    }
+    fake_ov2640();
+    start_ov2640(&sensor, false);
+    i2c_host_clear_stats();
+    init_camera_settings(&sensor);
+    i2c_host_stats_t first_off, first_on;
+    i2c_host_get_stats(&first_off);
+    sccb_shadow_delete(sensor.shadow);
+    fake_ov2640();
+    start_ov2640(&sensor, true);
+    i2c_host_clear_stats();
+    init_camera_settings(&sensor);
+    i2c_host_get_stats(&first_on);
+    sccb_shadow_delete(sensor.shadow);
+
+    printf("%-24s %8s %8s %13s %8s\n", "init_camera", "writes", "reads", "transactions", "bus ms");
+    const i2c_host_stats_t *rows[] = {&first_off, &first_on, &stats[0], &stats[1]};
+    const char *names[] = {"first, no shadow", "first, shadow", "again, no shadow", "again, shadow"};
+    for (int i = 0; i < 4; i++) {
+        printf("%-24s %8u %8u %13u %8.2f\n", names[i], (unsigned)rows[i]->reg_writes, (unsigned)rows[i]->reg_reads,
+               (unsigned)rows[i]->transactions, i2c_host_bus_us(rows[i], CONFIG_SCCB_CLK_FREQ) / 1000);
+    }
+    TEST_ASSERT_TRUE(first_on.transactions < first_off.transactions);
+    TEST_ASSERT_TRUE(stats[1].transactions < stats[0].transactions);
+}
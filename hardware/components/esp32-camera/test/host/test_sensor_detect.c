@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "esp_timer.h"
+#include "sccb.h"
+#include "sccb_shadow.h"
+#include "sensor.h"
+#include "sensor_detect.h"
+#include "ov2640_regs.h"
+#include "i2c_host.h"
+
+// the sensors the board might carry, with their ID registers
+static void add_sensor(camera_model_t model)
+{
+    uint8_t addr = camera_sensor[model].sccb_addr;
+    uint16_t pid = camera_sensor[model].pid;
+    if (model == CAMERA_OV2640) {
+        i2c_host_add_device(addr, 1, false);
+        i2c_host_set_bank_reg(addr, BANK_SEL);
+        i2c_host_regs(addr)[(BANK_SENSOR << 8) | REG_PID] = pid;
+    } else {
+        i2c_host_add_device(addr, 2, true);
+        i2c_host_regs(addr)[0x300A] = pid >> 8;
+        i2c_host_regs(addr)[0x300B] = pid & 0xff;
+    }
+}
+
+// one boot: the SCCB driver set up from scratch and the sensor of camera_probe, from a fresh sensor_t
+static esp_err_t boot(sensor_t *sensor, camera_model_t *model)
+{
+    memset(sensor, 0, sizeof(*sensor));
+    TEST_ESP_OK(SCCB_Init(26, 27));
+    esp_err_t err = sensor_detect(sensor, model);
+    sccb_shadow_delete(sensor->shadow);
+    sensor->shadow = NULL;
+    TEST_ESP_OK(SCCB_Deinit());
+    return err;
+}
+
+TEST_CASE("A remembered sensor is only asked for its ID", "[detect]")
+{
+    static const camera_model_t models[] = {CAMERA_OV2640, CAMERA_OV3660, CAMERA_OV5640};
+    sensor_t sensor;
+    camera_model_t model;
+    i2c_host_stats_t cold, warm;
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+        sensor_detect_forget();
+        i2c_host_reset();
+        add_sensor(models[m]);
+        TEST_ESP_OK(boot(&sensor, &model));
+        TEST_ASSERT_EQUAL(models[m], model);
+        i2c_host_get_stats(&cold);
+
+        i2c_host_clear_stats();
+        TEST_ESP_OK(boot(&sensor, &model));
+        TEST_ASSERT_EQUAL(models[m], model);
+        TEST_ASSERT_EQUAL(camera_sensor[models[m]].pid, sensor.id.PID);
+        TEST_ASSERT_EQUAL(camera_sensor[models[m]].sccb_addr, sensor.slv_addr);
+        i2c_host_get_stats(&warm);
+        TEST_ASSERT_EQUAL(0, warm.nacks);
+        TEST_ASSERT_TRUE(warm.transactions < cold.transactions);
+    }
+}
+
+TEST_CASE("Another sensor than the remembered one is probed for", "[detect]")
+{
+    sensor_t sensor;
+    camera_model_t model;
+    sensor_detect_forget();
+    i2c_host_reset();
+    add_sensor(CAMERA_OV2640);
+    TEST_ESP_OK(boot(&sensor, &model));
+    TEST_ASSERT_EQUAL(CAMERA_OV2640, model);
+
+    // a sensor at another address
+    i2c_host_reset();
+    add_sensor(CAMERA_OV5640);
+    TEST_ESP_OK(boot(&sensor, &model));
+    TEST_ASSERT_EQUAL(CAMERA_OV5640, model);
+
+    // the same address, another ID
+    i2c_host_reset();
+    add_sensor(CAMERA_OV3660);
+    TEST_ESP_OK(boot(&sensor, &model));
+    TEST_ASSERT_EQUAL(CAMERA_OV3660, model);
+    i2c_host_stats_t stats;
+    i2c_host_clear_stats();
+    TEST_ESP_OK(boot(&sensor, &model));
+    TEST_ASSERT_EQUAL(CAMERA_OV3660, model);
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.nacks);
+
+    // nothing on the bus, and nothing remembered after that
+    i2c_host_reset();
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, boot(&sensor, &model));
+    TEST_ASSERT_EQUAL(CAMERA_NONE, model);
+    add_sensor(CAMERA_OV3660);
+    i2c_host_clear_stats();
+    TEST_ESP_OK(boot(&sensor, &model));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_TRUE(stats.nacks > 0);
+}
+
+/*
+ * Sensor detection in esp_camera_init, with every driver enabled: a cold boot
+ * probes the addresses and asks the drivers in turn, a warm one asks only the
+ * remembered driver. Bus time at the SCCB clock plus the time in the drivers.
+ */
+TEST_CASE("Sensor detection benchmark", "[detect][bench]")
+{
+    static const camera_model_t models[] = {CAMERA_OV2640, CAMERA_OV3660, CAMERA_OV5640};
+    sensor_t sensor;
+    camera_model_t model;
+    i2c_host_stats_t stats;
+    printf("%-8s %-6s %13s %6s %8s %10s %10s\n", "sensor", "boot", "transactions", "nacks", "bus ms", "driver ms", "total ms");
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+        sensor_detect_forget();
+        i2c_host_reset();
+        add_sensor(models[m]);
+        for (int warm = 0; warm < 2; warm++) {
+            i2c_host_clear_stats();
+            int64_t t = esp_timer_get_time();
+            TEST_ESP_OK(boot(&sensor, &model));
+            double wall = esp_timer_get_time() - t;
+            i2c_host_get_stats(&stats);
+            double bus = i2c_host_bus_us(&stats, CONFIG_SCCB_CLK_FREQ);
+            printf("%-8s %-6s %13u %6u %8.2f %10.2f %10.2f\n", camera_sensor[models[m]].name, warm ? "warm" : "cold",
+                   (unsigned)stats.transactions, (unsigned)stats.nacks, bus / 1000, wall / 1000, (bus + wall) / 1000);
+        }
+    }
+}
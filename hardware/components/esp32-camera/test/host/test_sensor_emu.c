@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sccb.h"
+#include "sccb_shadow.h"
+#include "sensor.h"
+#include "sensor_detect.h"
+#include "sensor_emu.h"
+
+// the application's camera, see init_camera() in src/Cam.c and app_main()
+enum { APP_SDA = 26, APP_SCL = 27, APP_XCLK = 10000000, APP_QUALITY = 10, SKIPPED = 1000 };
+#define APP_FRAMESIZE FRAMESIZE_VGA
+
+static pixformat_t app_pixformat(sensor_t *s)
+{
+    return esp_camera_sensor_get_info(&s->id)->support_jpeg ? PIXFORMAT_JPEG : PIXFORMAT_RGB565;
+}
+
+// the sensor calls of esp_camera_init, camera_probe first
+static int step_probe(sensor_t *s)
+{
+    camera_model_t model;
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    if (sensor_detect(s, &model) != ESP_OK) {
+        return -1;
+    }
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    return s->reset(s);
+}
+
+static int step_framesize(sensor_t *s)
+{
+    framesize_t max = esp_camera_sensor_get_info(&s->id)->max_size;
+    framesize_t framesize = APP_FRAMESIZE > max ? max : APP_FRAMESIZE;
+    s->status.framesize = framesize;
+    s->pixformat = app_pixformat(s);
+    return s->set_framesize(s, framesize);
+}
+
+static int step_pixformat(sensor_t *s)
+{
+    return s->set_pixformat(s, app_pixformat(s));
+}
+
+static int step_ov2640_defaults(sensor_t *s)
+{
+    if (s->id.PID != OV2640_PID) {
+        return SKIPPED;
+    }
+    return s->set_gainceiling(s, GAINCEILING_2X) | s->set_bpc(s, false) | s->set_wpc(s, true) | s->set_lenc(s, true);
+}
+
+static int step_quality(sensor_t *s)
+{
+    return app_pixformat(s) == PIXFORMAT_JPEG ? s->set_quality(s, APP_QUALITY) : SKIPPED;
+}
+
+static int step_init_status(sensor_t *s)
+{
+    return s->init_status(s);
+}
+
+// the setters init_camera() calls after esp_camera_init, some drivers leave them out
+#define APP_SETTER(fn, value) \
+    static int step_##fn(sensor_t *s) { return s->fn ? s->fn(s, value) : SKIPPED; }
+APP_SETTER(set_brightness, 1)
+APP_SETTER(set_saturation, -3)
+APP_SETTER(set_gain_ctrl, 0)
+APP_SETTER(set_exposure_ctrl, 0)
+APP_SETTER(set_whitebal, 0)
+APP_SETTER(set_awb_gain, 1)
+APP_SETTER(set_wb_mode, 0)
+APP_SETTER(set_contrast, 2)
+
+static int step_vflip(sensor_t *s)
+{
+    return s->id.PID == OV3660_PID ? s->set_vflip(s, 1) : SKIPPED;
+}
+
+typedef struct {
+    const char *name;
+    int (*call)(sensor_t *s);
+    bool init;                      // part of esp_camera_init, the rest is the application's
+} step_t;
+
+static const step_t app_steps[] = {
+    {"probe + reset", step_probe, true},
+    {"set_framesize", step_framesize, true},
+    {"set_pixformat", step_pixformat, true},
+    {"ov2640 defaults", step_ov2640_defaults, true},
+    {"set_quality", step_quality, true},
+    {"init_status", step_init_status, true},
+    {"set_brightness", step_set_brightness, false},
+    {"set_saturation", step_set_saturation, false},
+    {"set_gain_ctrl", step_set_gain_ctrl, false},
+    {"set_exposure_ctrl", step_set_exposure_ctrl, false},
+    {"set_whitebal", step_set_whitebal, false},
+    {"set_awb_gain", step_set_awb_gain, false},
+    {"set_wb_mode", step_set_wb_mode, false},
+    {"set_contrast", step_set_contrast, false},
+    {"set_vflip", step_vflip, false},
+};
+
+#define STEP_COUNT (sizeof(app_steps) / sizeof(app_steps[0]))
+
+// a power-on of the fake sensor, the application's camera bring-up call by call
+static void bring_up(camera_model_t model, sensor_t *s, sensor_emu_cost_t cost[STEP_COUNT], int ret[STEP_COUNT])
+{
+    host_task_virtual_delays(true);
+    i2c_host_reset();
+    sensor_detect_forget();
+    TEST_ASSERT_TRUE(sensor_emu_add(model));
+    TEST_ESP_OK(SCCB_Init(APP_SDA, APP_SCL));
+    memset(s, 0, sizeof(*s));
+    s->xclk_freq_hz = APP_XCLK;
+    for (size_t i = 0; i < STEP_COUNT; i++) {
+        sensor_emu_start(&cost[i]);
+        ret[i] = app_steps[i].call(s);
+        sensor_emu_stop(&cost[i]);
+    }
+    host_task_virtual_delays(false);
+}
+
+static void end(sensor_t *s)
+{
+    sccb_shadow_delete(s->shadow);
+    s->shadow = NULL;
+    SCCB_Deinit();
+}
+
+TEST_CASE("The trace times every command list on the simulated clock", "[emu]")
+{
+    i2c_host_txn_t log[4];
+    i2c_host_reset();
+    TEST_ASSERT_TRUE(sensor_emu_add(CAMERA_OV2640));
+    TEST_ESP_OK(SCCB_Init(APP_SDA, APP_SCL));
+    TEST_ASSERT_EQUAL(CONFIG_SCCB_CLK_FREQ, i2c_host_clock());
+    host_task_virtual_delays(true);
+    i2c_host_trace(log, 4);
+    TEST_ASSERT_EQUAL(0, SCCB_Write(OV2640_SCCB_ADDR, 0xFF, 0x01));
+    vTaskDelay(5 / portTICK_PERIOD_MS);
+    TEST_ASSERT_EQUAL(0x26, SCCB_Read(OV2640_SCCB_ADDR, 0x0A));
+    TEST_ASSERT_EQUAL(-1, SCCB_Write(0x55, 0x12, 0x80));
+    i2c_host_trace(NULL, 0);
+    host_task_virtual_delays(false);
+
+    // address, register and value: 3 bytes of 9 bits, the START and the STOP
+    double bit_us = 1e6 / CONFIG_SCCB_CLK_FREQ;
+    TEST_ASSERT_EQUAL(OV2640_SCCB_ADDR, log[0].addr);
+    TEST_ASSERT_EQUAL(0xFF, log[0].reg);
+    TEST_ASSERT_EQUAL(1, log[0].writes);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 29 * bit_us, log[0].bus_us);
+    // the read sets the pointer and reads in two lists, 5 ms after the write
+    TEST_ASSERT_EQUAL(0x0A, log[1].reg);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, log[0].start_us + log[0].bus_us + 5000, log[1].start_us);
+    TEST_ASSERT_EQUAL(1, log[2].reads);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, log[1].start_us + log[1].bus_us, log[2].start_us);
+    TEST_ASSERT_TRUE(log[3].nack);
+    TEST_ASSERT_EQUAL(0x55, log[3].addr);
+    SCCB_Deinit();
+}
+
+TEST_CASE("Every emulated sensor is found and brought up by its driver", "[emu]")
+{
+    sensor_t s;
+    sensor_emu_cost_t cost[STEP_COUNT];
+    int ret[STEP_COUNT];
+    for (camera_model_t model = 0; model < CAMERA_MODEL_MAX; model++) {
+        i2c_host_reset();
+        sensor_detect_forget();
+        TEST_ASSERT_TRUE(sensor_emu_add(model));
+        memset(&s, 0, sizeof(s));
+        camera_model_t found;
+        esp_err_t err = sensor_detect(&s, &found);
+        end(&s);
+        if (err == ESP_ERR_NOT_SUPPORTED) {
+            // answers on the bus, but its driver is not in this build
+            printf("%s: no driver\n", camera_sensor[model].name);
+            continue;
+        }
+        TEST_ESP_OK(err);
+        TEST_ASSERT_EQUAL(model, found);
+        TEST_ASSERT_EQUAL(camera_sensor[model].pid, s.id.PID);
+
+        bring_up(model, &s, cost, ret);
+        for (size_t i = 0; i < STEP_COUNT; i++) {
+            if (ret[i] != 0 && ret[i] != SKIPPED) {
+                printf("%s: %s returned %d\n", camera_sensor[model].name, app_steps[i].name, ret[i]);
+            }
+            // only the probe asks addresses where there is no sensor
+            TEST_ASSERT_TRUE(i == 0 || cost[i].bus.nacks == 0);
+        }
+        TEST_ASSERT_EQUAL(0, ret[0]);
+        end(&s);
+    }
+}
+
+/*
+ * Budgets of the application's camera bring-up on the sensors it runs with,
+ * on the simulated clock. A change that makes a driver slower to start fails
+ * here; one that makes it faster should lower the budget.
+ */
+TEST_CASE("The camera bring-up stays within its budget", "[emu]")
+{
+    static const struct {
+        camera_model_t model;
+        uint32_t init_transactions;     // esp_camera_init, about 10% over what it takes now
+        double init_ms;
+        uint32_t app_transactions;      // the setters of init_camera()
+        double app_ms;
+    } budgets[] = {
+        {CAMERA_OV2640, 255, 137.5, 20, 6.0},
+        {CAMERA_OV3660, 70, 315.0, 21, 7.5},
+        {CAMERA_OV5640, 66, 750.0, 22, 8.0},
+    };
+    sensor_t s;
+    sensor_emu_cost_t cost[STEP_COUNT];
+    int ret[STEP_COUNT];
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+        bring_up(budgets[b].model, &s, cost, ret);
+        end(&s);
+        uint32_t transactions[2] = {0};
+        double ms[2] = {0};
+        for (size_t i = 0; i < STEP_COUNT; i++) {
+            // the application does not check its setters, OV2640 refuses the saturation of -3
+            TEST_ASSERT_TRUE(!app_steps[i].init || ret[i] == 0 || ret[i] == SKIPPED);
+            transactions[app_steps[i].init] += cost[i].bus.transactions;
+            ms[app_steps[i].init] += cost[i].total_us / 1000;
+        }
+        printf("%s: esp_camera_init %u transactions %.2f ms, setters %u transactions %.2f ms\n",
+               camera_sensor[budgets[b].model].name, (unsigned)transactions[1], ms[1], (unsigned)transactions[0], ms[0]);
+        TEST_ASSERT_LESS_OR_EQUAL(budgets[b].init_transactions, transactions[1]);
+        TEST_ASSERT_LESS_OR_EQUAL(budgets[b].init_ms, ms[1]);
+        TEST_ASSERT_LESS_OR_EQUAL(budgets[b].app_transactions, transactions[0]);
+        TEST_ASSERT_LESS_OR_EQUAL(budgets[b].app_ms, ms[0]);
+    }
+}
+
+/*
+ * What every call of the application's camera bring-up costs on each of the
+ * emulated sensors with a driver: its traffic, the bus time at the SCCB clock,
+ * the driver's vTaskDelay waits and both on the simulated clock.
+ */
+TEST_CASE("Sensor call cost report", "[emu][bench]")
+{
+    sensor_t s;
+    sensor_emu_cost_t cost[STEP_COUNT];
+    int ret[STEP_COUNT];
+    printf("SCCB clock %u Hz\n", (unsigned)CONFIG_SCCB_CLK_FREQ);
+    printf("%-9s %-18s %13s %7s %6s %8s %9s %9s\n", "sensor", "call", "transactions", "writes", "reads", "bus ms", "delay ms", "total ms");
+    for (camera_model_t model = 0; model < CAMERA_MODEL_MAX; model++) {
+        i2c_host_reset();
+        sensor_detect_forget();
+        sensor_emu_add(model);
+        memset(&s, 0, sizeof(s));
+        camera_model_t found;
+        esp_err_t err = sensor_detect(&s, &found);
+        end(&s);
+        if (err != ESP_OK) {
+            continue;
+        }
+        bring_up(model, &s, cost, ret);
+        end(&s);
+        double total = 0;
+        for (size_t i = 0; i < STEP_COUNT; i++) {
+            if (ret[i] == SKIPPED) {
+                continue;
+            }
+            total += cost[i].total_us;
+            printf("%-9s %-18s %13u %7u %6u %8.2f %9.2f %9.2f%s\n", camera_sensor[model].name, app_steps[i].name,
+                   (unsigned)cost[i].bus.transactions, (unsigned)cost[i].bus.reg_writes, (unsigned)cost[i].bus.reg_reads,
+                   cost[i].bus_us / 1000, cost[i].delay_us / 1000, cost[i].total_us / 1000, ret[i] ? " (refused)" : "");
+        }
+        printf("%-9s %-18s %61.2f\n", camera_sensor[model].name, "bring-up", total / 1000);
+    }
+}
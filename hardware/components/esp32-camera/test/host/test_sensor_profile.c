@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "esp_timer.h"
+#include "sccb.h"
+#include "sccb_shadow.h"
+#include "sensor.h"
+#include "ov2640.h"
+#include "ov2640_regs.h"
+#include "i2c_host.h"
+
+enum { ADDR = OV2640_SCCB_ADDR, SDE_MAP = 0x1000, PROFILE_MAX = 1024 };
+
+// settings that differ from the defaults almost everywhere
+static const camera_status_t tuned = {
+    .framesize = FRAMESIZE_SVGA, .quality = 20, .brightness = -1, .contrast = 2, .saturation = 1,
+    .special_effect = 3, .wb_mode = 2, .awb = 1, .awb_gain = 0, .aec = 0, .aec2 = 1, .ae_level = 1,
+    .aec_value = 600, .agc = 0, .agc_gain = 12, .gainceiling = GAINCEILING_16X, .bpc = 1, .wpc = 0,
+    .raw_gma = 0, .lenc = 0, .hmirror = 1, .vflip = 1, .dcw = 0, .colorbar = 0,
+};
+
+static bool all_volatile(uint8_t bank, uint16_t reg)
+{
+    return true;
+}
+
+// an OV2640 after esp_camera_init, the SDE table behind BPADDR/BPDATA kept at SDE_MAP
+static void start_ov2640(sensor_t *sensor, bool use_shadow, pixformat_t pixformat, framesize_t framesize)
+{
+    i2c_host_reset();
+    i2c_host_add_device(ADDR, 1, false);
+    i2c_host_set_bank_reg(ADDR, BANK_SEL);
+    i2c_host_add_indirect(ADDR, (BANK_DSP << 8) | BPADDR, (BANK_DSP << 8) | BPDATA, SDE_MAP);
+    i2c_host_regs(ADDR)[(BANK_SENSOR << 8) | REG_PID] = OV2640_PID;
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->slv_addr = SCCB_Probe();
+    sensor->xclk_freq_hz = 20000000;
+    TEST_ASSERT_EQUAL(OV2640_PID, ov2640_detect(sensor->slv_addr, &sensor->id));
+    ov2640_init(sensor);
+    if (!use_shadow) {
+        sensor->shadow->is_volatile = all_volatile;
+    }
+    TEST_ASSERT_EQUAL(0, sensor->reset(sensor));
+    sensor->pixformat = pixformat;
+    TEST_ASSERT_EQUAL(0, sensor->set_framesize(sensor, framesize));
+    TEST_ASSERT_EQUAL(0, sensor->set_pixformat(sensor, pixformat));
+}
+
+// the setter calls of esp_camera_load_from_nvs
+static void apply_status(sensor_t *s, const camera_status_t *st, pixformat_t pf)
+{
+    s->set_ae_level(s, st->ae_level);
+    s->set_aec2(s, st->aec2);
+    s->set_aec_value(s, st->aec_value);
+    s->set_agc_gain(s, st->agc_gain);
+    s->set_awb_gain(s, st->awb_gain);
+    s->set_bpc(s, st->bpc);
+    s->set_brightness(s, st->brightness);
+    s->set_colorbar(s, st->colorbar);
+    s->set_contrast(s, st->contrast);
+    s->set_dcw(s, st->dcw);
+    s->set_denoise(s, st->denoise);
+    s->set_exposure_ctrl(s, st->aec);
+    s->set_framesize(s, st->framesize);
+    s->set_gain_ctrl(s, st->agc);
+    s->set_gainceiling(s, st->gainceiling);
+    s->set_hmirror(s, st->hmirror);
+    s->set_lenc(s, st->lenc);
+    s->set_quality(s, st->quality);
+    s->set_raw_gma(s, st->raw_gma);
+    s->set_saturation(s, st->saturation);
+    s->set_sharpness(s, st->sharpness);
+    s->set_special_effect(s, st->special_effect);
+    s->set_vflip(s, st->vflip);
+    s->set_wb_mode(s, st->wb_mode);
+    s->set_whitebal(s, st->awb);
+    s->set_wpc(s, st->wpc);
+    s->set_pixformat(s, pf);
+}
+
+// both banks and the SDE table, BPADDR holds whichever index was written last
+static void assert_same_regs(const uint8_t *expect, const uint8_t *regs)
+{
+    for (int i = 0; i < 0x200; i++) {
+        if (i != ((BANK_DSP << 8) | BPADDR) && expect[i] != regs[i]) {
+            printf("bank %d register 0x%02x: 0x%02x, expected 0x%02x\n", i >> 8, i & 0xff, regs[i], expect[i]);
+            TEST_FAIL_MESSAGE("registers differ");
+        }
+    }
+    TEST_ASSERT_EQUAL_MEMORY(&expect[SDE_MAP], &regs[SDE_MAP], 16);
+}
+
+TEST_CASE("OV2640 profile restores the registers the setters do", "[profile]")
+{
+    static const struct {
+        pixformat_t pixformat;
+        framesize_t framesize;
+    } boots[] = {
+        {PIXFORMAT_JPEG, FRAMESIZE_SVGA}, {PIXFORMAT_YUV422, FRAMESIZE_QVGA}, {PIXFORMAT_JPEG, FRAMESIZE_UXGA},
+    };
+    sensor_t sensor;
+    uint8_t buf[PROFILE_MAX];
+    for (size_t b = 0; b < sizeof(boots) / sizeof(boots[0]); b++) {
+        start_ov2640(&sensor, true, PIXFORMAT_JPEG, FRAMESIZE_VGA);
+        apply_status(&sensor, &tuned, PIXFORMAT_JPEG);
+        int len = sensor.save_regs(&sensor, buf, sizeof(buf));
+        TEST_ASSERT_TRUE(len > 0);
+        uint8_t *expect = malloc(0x10000);
+        memcpy(expect, i2c_host_regs(ADDR), 0x10000);
+        sccb_shadow_delete(sensor.shadow);
+
+        start_ov2640(&sensor, true, boots[b].pixformat, boots[b].framesize);
+        sensor.pixformat = PIXFORMAT_JPEG;
+        TEST_ASSERT_EQUAL(0, sensor.load_regs(&sensor, buf, len));
+        assert_same_regs(expect, i2c_host_regs(ADDR));
+        // the shadow holds what was written, a setter after the restore starts from it
+        TEST_ASSERT_EQUAL(tuned.quality, sensor.get_reg(&sensor, QS, 0xff));
+        TEST_ASSERT_EQUAL(0, sensor.set_quality(&sensor, 30));
+        TEST_ASSERT_EQUAL(30, i2c_host_regs(ADDR)[(BANK_DSP << 8) | QS]);
+        free(expect);
+        sccb_shadow_delete(sensor.shadow);
+    }
+}
+
+TEST_CASE("OV2640 profile refuses snapshots it did not write", "[profile]")
+{
+    sensor_t sensor;
+    uint8_t buf[PROFILE_MAX];
+    start_ov2640(&sensor, true, PIXFORMAT_JPEG, FRAMESIZE_VGA);
+    TEST_ASSERT_EQUAL(-1, sensor.save_regs(&sensor, buf, 64));
+    int len = sensor.save_regs(&sensor, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(len > 0);
+    uint8_t *before = malloc(0x10000);
+    memcpy(before, i2c_host_regs(ADDR), 0x10000);
+    i2c_host_stats_t stats;
+    i2c_host_clear_stats();
+
+    // cut short, a bank that does not exist, a register that is not saved, an SDE index past the table
+    TEST_ASSERT_EQUAL(-1, sensor.load_regs(&sensor, buf, len - 1));
+    uint8_t bad[] = {3, 1, 0x44, 0x00};
+    TEST_ASSERT_EQUAL(-1, sensor.load_regs(&sensor, bad, sizeof(bad)));
+    bad[0] = BANK_DSP;
+    bad[2] = MC_BIST;
+    TEST_ASSERT_EQUAL(-1, sensor.load_regs(&sensor, bad, sizeof(bad)));
+    bad[0] = 2;
+    bad[2] = 16;
+    TEST_ASSERT_EQUAL(-1, sensor.load_regs(&sensor, bad, sizeof(bad)));
+    i2c_host_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.transactions);
+    TEST_ASSERT_EQUAL(0, memcmp(before, i2c_host_regs(ADDR), 0x10000));
+
+    // nothing on the bus fails the restore and the shadow forgets what it knew
+    i2c_host_reset();
+    TEST_ASSERT_EQUAL(-1, sensor.load_regs(&sensor, buf, len));
+    uint32_t hits = sensor.shadow->hits;
+    sensor.get_reg(&sensor, QS, 0xff);
+    TEST_ASSERT_EQUAL(hits, sensor.shadow->hits);
+    free(before);
+    sccb_shadow_delete(sensor.shadow);
+}
+
+/*
+ * Restoring tuned settings at boot, after esp_camera_init in VGA JPEG: the 26
+ * setters of esp_camera_load_from_nvs against one load_regs pass of a snapshot.
+ * Bus time at the SCCB clock plus the settle stalls, on the fake OV2640.
+ */
+TEST_CASE("Profile restore benchmark", "[profile][bench]")
+{
+    static const char *names[] = {"setters, no shadow", "setters, shadow", "register snapshot"};
+    sensor_t sensor;
+    uint8_t buf[PROFILE_MAX];
+    i2c_host_stats_t stats;
+
+    start_ov2640(&sensor, true, PIXFORMAT_JPEG, FRAMESIZE_VGA);
+    apply_status(&sensor, &tuned, PIXFORMAT_JPEG);
+    int len = sensor.save_regs(&sensor, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(len > 0);
+    sccb_shadow_delete(sensor.shadow);
+    printf("snapshot: %d bytes\n", len);
+
+    printf("%-20s %8s %8s %13s %8s %10s %10s\n", "restore", "writes", "reads", "transactions", "bus ms", "stalls ms", "total ms");
+    for (int kind = 0; kind < 3; kind++) {
+        start_ov2640(&sensor, kind != 0, PIXFORMAT_JPEG, FRAMESIZE_VGA);
+        i2c_host_clear_stats();
+        int64_t t = esp_timer_get_time();
+        if (kind == 2) {
+            TEST_ASSERT_EQUAL(0, sensor.load_regs(&sensor, buf, len));
+        } else {
+            apply_status(&sensor, &tuned, PIXFORMAT_JPEG);
+        }
+        double wall = esp_timer_get_time() - t;
+        i2c_host_get_stats(&stats);
+        double bus = i2c_host_bus_us(&stats, CONFIG_SCCB_CLK_FREQ);
+        printf("%-20s %8u %8u %13u %8.2f %10.2f %10.2f\n", names[kind], (unsigned)stats.reg_writes, (unsigned)stats.reg_reads,
+               (unsigned)stats.transactions, bus / 1000, wall / 1000, (bus + wall) / 1000);
+        sccb_shadow_delete(sensor.shadow);
+    }
+}
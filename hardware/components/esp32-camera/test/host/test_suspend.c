@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sccb.h"
+#include "sccb_shadow.h"
+#include "sensor.h"
+#include "sensor_detect.h"
+#include "sensor_emu.h"
+#include "ov2640_regs.h"
+#include "cam_hal.h"
+#include "cam_sim.h"
+
+// the application's camera, see init_camera() in src/Cam.c
+enum { APP_SDA = 26, APP_SCL = 27, APP_XCLK = 10000000, APP_QUALITY = 10 };
+#define APP_FRAMESIZE FRAMESIZE_VGA
+
+static const camera_model_t models[] = {CAMERA_OV2640, CAMERA_OV3660, CAMERA_OV5640};
+#define MODELS (sizeof(models) / sizeof(models[0]))
+
+/*
+ * The sensor calls of esp_camera_init on a power-on of the fake sensor, with
+ * the waits of camera_probe around the detection
+ */
+static int sensor_init(camera_model_t model, sensor_t *s)
+{
+    i2c_host_reset();
+    sensor_detect_forget();
+    TEST_ASSERT_TRUE(sensor_emu_add(model));
+    TEST_ESP_OK(SCCB_Init(APP_SDA, APP_SCL));
+    memset(s, 0, sizeof(*s));
+    s->xclk_freq_hz = APP_XCLK;
+    camera_model_t found;
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    if (sensor_detect(s, &found) != ESP_OK || found != model) {
+        return -1;
+    }
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    s->status.framesize = APP_FRAMESIZE;
+    s->pixformat = PIXFORMAT_JPEG;
+    int ret = s->reset(s) || s->set_framesize(s, APP_FRAMESIZE) || s->set_pixformat(s, PIXFORMAT_JPEG);
+    if (s->id.PID == OV2640_PID) {
+        ret |= s->set_gainceiling(s, GAINCEILING_2X) | s->set_bpc(s, false) | s->set_wpc(s, true) | s->set_lenc(s, true);
+    }
+    return ret || s->set_quality(s, APP_QUALITY) || s->init_status(s);
+}
+
+static void sensor_end(sensor_t *s)
+{
+    sccb_shadow_delete(s->shadow);
+    s->shadow = NULL;
+    SCCB_Deinit();
+}
+
+// COM2 standby of the OV2640, SYSTEM_CTROL0 power down of the OV3660 and OV5640
+static bool in_standby(const sensor_t *s)
+{
+    const uint8_t *regs = i2c_host_regs(s->slv_addr);
+    return s->id.PID == OV2640_PID ? regs[(BANK_SENSOR << 8) | COM2] & COM2_STDBY : regs[0x3008] & 0x40;
+}
+
+TEST_CASE("Sensor standby keeps the registers and the shadow", "[suspend]")
+{
+    static uint8_t before[0x10000];
+    sensor_t s;
+    i2c_host_stats_t bus;
+    host_task_virtual_delays(true);
+    for (size_t m = 0; m < MODELS; m++) {
+        TEST_ASSERT_EQUAL(0, sensor_init(models[m], &s));
+        TEST_ASSERT_NOT_NULL(s.set_standby);
+        memcpy(before, i2c_host_regs(s.slv_addr), sizeof(before));
+
+        i2c_host_clear_stats();
+        TEST_ASSERT_EQUAL(0, s.set_standby(&s, 1));
+        TEST_ASSERT_TRUE(in_standby(&s));
+        i2c_host_get_stats(&bus);
+        printf("%s: standby %u writes %u reads, ", camera_sensor[models[m]].name, (unsigned)bus.reg_writes, (unsigned)bus.reg_reads);
+
+        // waking up is the standby bit, the shadow answers the rest
+        i2c_host_clear_stats();
+        TEST_ASSERT_EQUAL(0, s.set_standby(&s, 0));
+        i2c_host_get_stats(&bus);
+        printf("wake %u writes %u reads\n", (unsigned)bus.reg_writes, (unsigned)bus.reg_reads);
+        TEST_ASSERT_FALSE(in_standby(&s));
+        TEST_ASSERT_LESS_OR_EQUAL(2, bus.reg_writes);
+        TEST_ASSERT_LESS_OR_EQUAL(1, bus.reg_reads);
+        TEST_ASSERT_EQUAL_MEMORY(before, i2c_host_regs(s.slv_addr), sizeof(before));
+
+        // a setter after the wake-up writes no more than it would have before
+        i2c_host_clear_stats();
+        TEST_ASSERT_EQUAL(0, s.set_quality(&s, APP_QUALITY));
+        i2c_host_get_stats(&bus);
+        TEST_ASSERT_EQUAL(0, bus.reg_writes);
+        sensor_end(&s);
+    }
+    host_task_virtual_delays(false);
+}
+
+static cam_sim_config_t suspend_config(pixformat_t format, framesize_t size)
+{
+    cam_sim_config_t config = {
+        .format = format, .frame_size = size,
+        .fb_count = 2, .grab_mode = CAMERA_GRAB_LATEST,
+        .fps = 25, .jpeg_size = 20000, .jpeg_jitter = 3000, .frames = 40, .lockstep = true,
+        .suspend_after = 10, .suspend_us = 200000, .wake_us = 5000,
+    };
+    return config;
+}
+
+TEST_CASE("cam_suspend parks the capture and cam_resume starts it again", "[suspend]")
+{
+    static const struct {
+        pixformat_t format;
+        framesize_t size;
+    } modes[] = {
+        {PIXFORMAT_JPEG, FRAMESIZE_VGA},
+        {PIXFORMAT_YUV422, FRAMESIZE_QVGA},
+    };
+    cam_sim_stats_t stats;
+    char name[40];
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        for (int psram = 0; psram < 2; psram++) {
+            cam_sim_config_t config = suspend_config(modes[i].format, modes[i].size);
+            config.psram_mode = psram;
+            // a frame shared before the suspend is still released after it
+            config.sharers = 1;
+            config.sharer_us = 30000;
+            TEST_ESP_OK(cam_sim_run(&config, &stats));
+            snprintf(name, sizeof(name), "suspend %d %s", (int)i, psram ? "psram" : "dram");
+            cam_sim_print(name, &stats);
+            TEST_ASSERT_EQUAL(0, stats.corrupt);
+            TEST_ASSERT_EQUAL(0, stats.reordered);
+            TEST_ASSERT_EQUAL(0, stats.resume_stale);
+            TEST_ASSERT_EQUAL(0, stats.shared_corrupt);
+            TEST_ASSERT_EQUAL(0, stats.held_at_end);
+            TEST_ASSERT_TRUE(stats.resume_frame_us > 0);
+            // the sensor stops while suspended, so every frame is sent; the one queued at the suspend
+            // is dropped, and on a slow host the ones that start with both frame buffers held
+            TEST_ASSERT_EQUAL(config.frames, stats.sent);
+            TEST_ASSERT_EQUAL(stats.sent, stats.delivered + stats.missed + stats.overwritten);
+        }
+    }
+
+    // what is refused while suspended
+    camera_config_t cc = {
+        .pin_pwdn = -1, .pin_reset = -1, .pin_xclk = -1, .pin_sccb_sda = -1, .pin_sccb_scl = -1, .pin_vsync = 1,
+        .xclk_freq_hz = 20000000, .pixel_format = PIXFORMAT_JPEG, .frame_size = FRAMESIZE_VGA,
+        .fb_count = 2, .fb_location = CAMERA_FB_IN_PSRAM, .grab_mode = CAMERA_GRAB_LATEST,
+    };
+    TEST_ESP_OK(cam_init(&cc));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cam_suspend());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cam_resume());
+    TEST_ESP_OK(cam_config(&cc, cc.frame_size, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cam_resume());
+    TEST_ESP_OK(cam_suspend());
+    TEST_ESP_OK(cam_suspend());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cam_reconfig(PIXFORMAT_YUV422, FRAMESIZE_QVGA, cc.xclk_freq_hz, 0));
+    TEST_ESP_OK(cam_resume());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cam_resume());
+    TEST_ESP_OK(cam_reconfig(PIXFORMAT_YUV422, FRAMESIZE_QVGA, cc.xclk_freq_hz, 0));
+    // cam_task is deleted parked
+    TEST_ESP_OK(cam_suspend());
+    TEST_ESP_OK(cam_deinit());
+}
+
+/*
+ * The wake-up between two shots: esp_camera_resume against esp_camera_deinit
+ * and esp_camera_init. The sensor half is timed on the fake sensors, bus time at
+ * the SCCB clock plus the waits; the capture half and the wait for the first
+ * frame run in the cam_hal simulator, with the sensor silent for as long as its
+ * half takes. XCLK and the SCCB driver install are left out of both.
+ */
+TEST_CASE("Resume to first frame benchmark", "[suspend][bench]")
+{
+    sensor_t s;
+    sensor_emu_cost_t init_cost, wake_cost;
+    cam_sim_stats_t sim;
+    enum { ROUNDS = 3 };
+    printf("%-8s %-8s %13s %9s %12s %16s\n", "sensor", "wake-up", "transactions", "sensor ms", "cam_hal us", "first frame ms");
+    for (size_t m = 0; m < MODELS; m++) {
+        host_task_virtual_delays(true);
+        sensor_emu_start(&init_cost);
+        TEST_ASSERT_EQUAL(0, sensor_init(models[m], &s));
+        sensor_emu_stop(&init_cost);
+        TEST_ASSERT_EQUAL(0, s.set_standby(&s, 1));
+        sensor_emu_start(&wake_cost);
+        TEST_ASSERT_EQUAL(0, s.set_standby(&s, 0));
+        sensor_emu_stop(&wake_cost);
+        sensor_end(&s);
+        host_task_virtual_delays(false);
+
+        double frame_ms[2];
+        for (int reinit = 1; reinit >= 0; reinit--) {
+            const sensor_emu_cost_t *cost = reinit ? &init_cost : &wake_cost;
+            double first = 0, call = 0;
+            for (int r = 0; r < ROUNDS; r++) {
+                cam_sim_config_t config = suspend_config(PIXFORMAT_JPEG, APP_FRAMESIZE);
+                config.suspend_us = 100000;
+                config.reinit = reinit;
+                config.wake_us = cost->total_us;
+                // about ten frames left for after the wake-up
+                config.frames = config.suspend_after + 10;
+                TEST_ESP_OK(cam_sim_run(&config, &sim));
+                TEST_ASSERT_EQUAL(0, sim.resume_stale);
+                TEST_ASSERT_EQUAL(0, sim.corrupt);
+                first += sim.resume_frame_us / ROUNDS;
+                call += sim.resume_call_us / ROUNDS;
+            }
+            frame_ms[reinit] = first / 1000;
+            printf("%-8s %-8s %13u %9.2f %12.1f %16.2f\n", camera_sensor[models[m]].name, reinit ? "init" : "resume",
+                   (unsigned)cost->bus.transactions, cost->total_us / 1000, call, frame_ms[reinit]);
+        }
+        TEST_ASSERT_TRUE(frame_ms[0] < frame_ms[1]);
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * Minimal Unity-style runner for the host build of the component tests.
+ *
+ * Usage: test_xxx [filter]
+ *   Without a filter every case except the "[bench]" ones is run.
+ *   A filter is matched against the tags first and then against the name.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <setjmp.h>
+#include "unity.h"
+
+#define UNITY_HOST_MAX_TESTS 256
+
+typedef struct {
+    const char *name;
+    const char *tags;
+    unity_test_fn_t fn;
+    const char *file;
+    int line;
+} unity_host_test_t;
+
+static unity_host_test_t s_tests[UNITY_HOST_MAX_TESTS];
+static int s_test_cnt;
+static jmp_buf s_abort;
+
+void unity_host_register(const char *name, const char *tags, unity_test_fn_t fn, const char *file, int line)
+{
+    if (s_test_cnt < UNITY_HOST_MAX_TESTS) {
+        s_tests[s_test_cnt++] = (unity_host_test_t) {name, tags, fn, file, line};
+    }
+}
+
+void unity_host_fail(const char *file, int line, const char *fmt, ...)
+{
+    va_list args;
+    fprintf(stderr, "%s:%d: FAIL: ", file, line);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    longjmp(s_abort, 1);
+}
+
+static int test_selected(const unity_host_test_t *t, const char *filter)
+{
+    if (!filter) {
+        return strstr(t->tags, "[bench]") == NULL;
+    }
+    return strstr(t->tags, filter) != NULL || strstr(t->name, filter) != NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    int run = 0, failed = 0;
+
+    for (int i = 0; i < s_test_cnt; i++) {
+        const unity_host_test_t *t = &s_tests[i];
+        if (!test_selected(t, filter)) {
+            continue;
+        }
+        run++;
+        if (setjmp(s_abort) == 0) {
+            t->fn();
+            printf("%s:%d:%s:PASS\n", t->file, t->line, t->name);
+        } else {
+            failed++;
+            printf("%s:%d:%s:FAIL\n", t->file, t->line, t->name);
+        }
+    }
+    printf("-----------------------\n%d Tests %d Failures 0 Ignored\n%s\n", run, failed, failed ? "FAIL" : "OK");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 
 // Camera Components
 #include "esp_camera.h"
+#include "camera_ae.h"
 #include "esp_heap_caps.h"
 #include "esp_psram.h"
 
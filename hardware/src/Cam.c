@@ -1,5 +1,9 @@
 #include "Cam.h"
 
+// Exposure and gain set from the frames, the sensor's own AEC/AGC stay off
+static camera_ae_t cam_ae;
+static bool cam_ae_ready = false;
+
 // Initialize Camera Settings
 esp_err_t init_camera(uint32_t xclk_freq_hz, pixformat_t pixel_format, framesize_t frame_size, uint8_t fb_count)
 {
@@ -35,6 +39,8 @@ esp_err_t init_camera(uint32_t xclk_freq_hz, pixformat_t pixel_format, framesize
         // Frame buffer useful for higher quality image or larger images
         .fb_count = fb_count,
         .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+        // JPEG frame buffers sized to the recent frames, fits more buffers in DRAM
+        .jpeg_adaptive = true,
         // frame buffer location in DRAM instead of PRAM cause ESPIDF and PlatformIO couldnt register PRAM
         .fb_location = CAMERA_FB_IN_DRAM};
 
@@ -104,6 +110,13 @@ esp_err_t init_camera(uint32_t xclk_freq_hz, pixformat_t pixel_format, framesize
         s->set_vflip(s, 1); // Flip the image vertically
     }
 
+    // Software auto exposure, converges over the first frames of every picture
+    cam_ae_ready = camera_ae_init(&cam_ae, s, NULL) == ESP_OK;
+    if (!cam_ae_ready)
+    {
+        ESP_LOGW(CAM_TAG, "Auto exposure not available, exposure stays fixed");
+    }
+
     // Get the basic information of the sensor.
     camera_sensor_info_t *s_info = esp_camera_sensor_get_info(&(s->id));
 
@@ -118,7 +131,24 @@ esp_err_t init_camera(uint32_t xclk_freq_hz, pixformat_t pixel_format, framesize
 void take_pic() {
     //Get picture
     ESP_LOGI(CAM_TAG, "Taking picture...");
-    camera_fb_t *pic = esp_camera_fb_get();
+    camera_fb_t *pic = NULL;
+    if (cam_ae_ready)
+    {
+        // a few frames until the exposure fits the light, the last one if it does not settle
+        esp_err_t err = camera_ae_capture(&cam_ae, 12, &pic);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(CAM_TAG, "Auto exposure capture failed (%s)", esp_err_to_name(err));
+        }
+        else if (cam_ae.state == CAMERA_AE_SEARCHING)
+        {
+            ESP_LOGW(CAM_TAG, "Exposure not settled, mean luma %u", cam_ae.mean);
+        }
+    }
+    else
+    {
+        pic = esp_camera_fb_get();
+    }
 
     //Check if pic valid
     if (pic)
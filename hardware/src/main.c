@@ -83,8 +83,17 @@ void app_main()
         vTaskDelay(5000 / portTICK_PERIOD_MS);
         unmount_sd_card();
 
-        // iterate every 15 minutes
+        // iterate every 15 minutes, camera in standby until the next picture
+        bool suspended = (ESP_OK == esp_camera_suspend());
+        if (!suspended)
+        {
+            ESP_LOGE(MAIN_TAG, "Camera Suspend Failed!");
+        }
         vTaskDelay(900000 / portTICK_PERIOD_MS);
+        if (suspended && ESP_OK != esp_camera_resume())
+        {
+            ESP_LOGE(MAIN_TAG, "Camera Resume Failed!");
+        }
     }
 
     ESP_LOGI(MAIN_TAG, "All tests completed.");